@@ -17,6 +17,8 @@
 #include <od_memory.h>
 #include <config_reader.h>
 #include <misc.h>
+#include <murmurhash.h>
+#include <util.h>
 
 od_address_range_t od_address_range_create_default(void)
 {
@@ -184,41 +186,54 @@ static bool od_address_hostname_match(const char *pattern,
 }
 
 /*
- * Check to see if a connecting IP matches a given host name.
+ * Forward-confirmed host names of client addresses.
+ *
+ * Reverse and forward lookups are done by the resolvers thread pool
+ * before routing, the name is kept by the client and rules matching
+ * never blocks with the router lock held. The cache only saves repeated
+ * lookups: it is direct mapped, a colliding address evicts the older one.
  */
-static bool od_address_check_hostname(struct sockaddr_storage *client_sa,
-				      const char *hostname)
+typedef struct {
+	int used;
+	struct sockaddr_storage addr;
+	uint64_t resolved_ms;
+	/* empty if the address has no confirmed name */
+	char hostname[NI_MAXHOST];
+} od_address_hostname_slot_t;
+
+static pthread_mutex_t od_address_hostname_lock = PTHREAD_MUTEX_INITIALIZER;
+static od_address_hostname_slot_t
+	od_address_hostname_slots[OD_ADDRESS_HOSTNAME_CACHE_SLOTS];
+
+static inline od_address_hostname_slot_t *
+od_address_hostname_slot(struct sockaddr_storage *sa)
 {
-	struct addrinfo *gai_result, *gai;
-	int ret;
-	bool found;
-
-	char client_hostname[NI_MAXHOST];
-
-	ret = getnameinfo((const struct sockaddr *)client_sa,
-			  sizeof(*client_sa), client_hostname,
-			  sizeof(client_hostname), NULL, 0, NI_NAMEREQD);
-
-	if (ret != 0) {
-		return false;
-	}
-
-	/* Now see if remote host name matches this pg_hba line */
-	if (!od_address_hostname_match(hostname, client_hostname)) {
-		return false;
+	uint32_t hash = 0;
+	if (sa->ss_family == AF_INET) {
+		struct sockaddr_in *sin = (struct sockaddr_in *)sa;
+		hash = od_murmur_hash(&sin->sin_addr, sizeof(sin->sin_addr));
+	} else {
+		struct sockaddr_in6 *sin = (struct sockaddr_in6 *)sa;
+		hash = od_murmur_hash(&sin->sin6_addr, sizeof(sin->sin6_addr));
 	}
+	return &od_address_hostname_slots[hash %
+					  OD_ADDRESS_HOSTNAME_CACHE_SLOTS];
+}
 
-	/* Lookup IP from host name and check against original IP */
-	ret = getaddrinfo(client_hostname, NULL, NULL, &gai_result);
+static inline int od_address_hostname_confirm(struct sockaddr_storage *sa,
+					      char *hostname)
+{
+	/* lookup IP from host name and check against original IP */
+	struct addrinfo *gai_result, *gai;
+	int ret = machine_getaddrinfo(hostname, NULL, NULL, &gai_result, 0);
 	if (ret != 0) {
-		return false;
+		return 0;
 	}
 
-	found = false;
+	int found = 0;
 	for (gai = gai_result; gai; gai = gai->ai_next) {
-		found = od_address_equals(gai->ai_addr,
-					  (struct sockaddr *)client_sa);
-		if (found) {
+		if (od_address_equals(gai->ai_addr, (struct sockaddr *)sa)) {
+			found = 1;
 			break;
 		}
 	}
@@ -230,12 +245,58 @@ static bool od_address_check_hostname(struct sockaddr_storage *client_sa,
 	return found;
 }
 
+void od_address_hostname_resolve(struct sockaddr_storage *sa,
+				 uint64_t ttl_ms, char *hostname,
+				 size_t hostname_len)
+{
+	hostname[0] = 0;
+	if (sa->ss_family != AF_INET && sa->ss_family != AF_INET6) {
+		return;
+	}
+
+	od_address_hostname_slot_t *slot = od_address_hostname_slot(sa);
+	uint64_t now_ms = machine_time_ms();
+
+	pthread_mutex_lock(&od_address_hostname_lock);
+	int fresh = slot->used &&
+		    od_address_equals((struct sockaddr *)&slot->addr,
+				      (struct sockaddr *)sa) &&
+		    now_ms - slot->resolved_ms < ttl_ms;
+	if (fresh) {
+		od_snprintf(hostname, hostname_len, "%s", slot->hostname);
+	}
+	pthread_mutex_unlock(&od_address_hostname_lock);
+	if (fresh) {
+		return;
+	}
+
+	char resolved[NI_MAXHOST];
+	int ret = machine_getnameinfo((const struct sockaddr *)sa, sizeof(*sa),
+				      resolved, sizeof(resolved), NI_NAMEREQD,
+				      0);
+	if (ret != 0 || !od_address_hostname_confirm(sa, resolved)) {
+		resolved[0] = 0;
+	}
+	od_snprintf(hostname, hostname_len, "%s", resolved);
+
+	pthread_mutex_lock(&od_address_hostname_lock);
+	slot->used = 1;
+	slot->addr = *sa;
+	slot->resolved_ms = machine_time_ms();
+	od_snprintf(slot->hostname, sizeof(slot->hostname), "%s", resolved);
+	pthread_mutex_unlock(&od_address_hostname_lock);
+}
+
 bool od_address_validate(const od_address_range_t *address_range,
-			 struct sockaddr_storage *sa)
+			 struct sockaddr_storage *sa, const char *hostname)
 {
 	if (address_range->is_hostname) {
-		return od_address_check_hostname(sa,
-						 address_range->string_value);
+		/* the name of the client address is resolved before */
+		if (hostname == NULL || hostname[0] == 0) {
+			return false;
+		}
+		return od_address_hostname_match(address_range->string_value,
+						 hostname);
 	}
 
 	if (address_range->addr.ss_family != sa->ss_family) {
@@ -0,0 +1,249 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <admission.h>
+
+const uint32_t od_admission_hgram_bounds_ms[] = {
+	1, 5, 10, 50, 100, 500, 1000, 5000, 10000,
+};
+
+void od_admission_init(od_admission_t *admission)
+{
+	pthread_mutex_init(&admission->lock, NULL);
+	od_list_init(&admission->queues);
+	admission->current = NULL;
+	admission->chosen_ms = 0;
+	atomic_init(&admission->waiting, 0);
+}
+
+void od_admission_free(od_admission_t *admission)
+{
+	assert(od_list_empty(&admission->queues));
+	pthread_mutex_destroy(&admission->lock);
+}
+
+void od_admission_queue_init(od_admission_queue_t *queue)
+{
+	od_list_init(&queue->tickets);
+	od_list_init(&queue->link);
+	queue->weight = 1;
+	queue->priority = 0;
+	queue->deficit = 0;
+	queue->active = 0;
+	queue->blocked = 0;
+	atomic_init(&queue->waiting, 0);
+	for (int i = 0; i < OD_ADMISSION_HGRAM_BUCKETS; i++) {
+		atomic_init(&queue->wait_hgram[i], 0);
+	}
+}
+
+static inline od_admission_queue_t *
+od_admission_next_queue_locked(od_admission_t *admission)
+{
+	od_admission_queue_t *next = NULL;
+
+	/* first queue of the highest priority */
+	od_list_t *i;
+	od_list_foreach (&admission->queues, i) {
+		od_admission_queue_t *queue;
+		queue = od_container_of(i, od_admission_queue_t, link);
+		if (queue->blocked) {
+			continue;
+		}
+		if (next == NULL || queue->priority > next->priority) {
+			next = queue;
+		}
+	}
+
+	return next;
+}
+
+static inline void od_admission_choose_locked(od_admission_t *admission)
+{
+	if (admission->current != NULL) {
+		return;
+	}
+
+	od_admission_queue_t *queue = od_admission_next_queue_locked(admission);
+	if (queue == NULL) {
+		return;
+	}
+
+	/* deficit round robin, every ticket costs one */
+	if (queue->deficit == 0) {
+		queue->deficit = queue->weight;
+	}
+	queue->deficit--;
+	if (queue->deficit == 0) {
+		/* round of this queue is over */
+		od_list_unlink(&queue->link);
+		od_list_append(&admission->queues, &queue->link);
+	}
+
+	od_admission_ticket_t *ticket;
+	ticket = od_container_of(queue->tickets.next, od_admission_ticket_t,
+				 link);
+	admission->current = ticket;
+	admission->chosen_ms = machine_time_ms();
+	atomic_fetch_add(&ticket->chosen_count, 1);
+	mm_wait_list_notify(&ticket->chosen);
+}
+
+static inline void od_admission_yield_locked(od_admission_t *admission,
+					     od_admission_ticket_t *ticket)
+{
+	ticket->blocked = 1;
+	ticket->queue->blocked = 1;
+	admission->current = NULL;
+	od_admission_choose_locked(admission);
+}
+
+int od_admission_enqueue(od_admission_t *admission,
+			 od_admission_queue_t *queue,
+			 od_admission_ticket_t *ticket, int weight,
+			 int priority)
+{
+	ticket->queue = queue;
+	ticket->blocked = 0;
+	atomic_init(&ticket->chosen_count, 0);
+	mm_wait_list_init(&ticket->chosen, &ticket->chosen_count);
+
+	pthread_mutex_lock(&admission->lock);
+
+	if (!queue->active) {
+		queue->weight = weight > 0 ? weight : 1;
+		queue->priority = priority;
+		queue->deficit = 0;
+		queue->active = 1;
+		od_list_append(&admission->queues, &queue->link);
+	}
+	od_list_append(&queue->tickets, &ticket->link);
+	atomic_fetch_add(&queue->waiting, 1);
+	atomic_fetch_add(&admission->waiting, 1);
+
+	od_admission_choose_locked(admission);
+
+	pthread_mutex_unlock(&admission->lock);
+	return OK_RESPONSE;
+}
+
+void od_admission_dequeue(od_admission_t *admission,
+			  od_admission_ticket_t *ticket)
+{
+	od_admission_queue_t *queue = ticket->queue;
+
+	pthread_mutex_lock(&admission->lock);
+
+	od_list_unlink(&ticket->link);
+	atomic_fetch_sub(&queue->waiting, 1);
+	atomic_fetch_sub(&admission->waiting, 1);
+
+	/* the next ticket of the queue may have room */
+	if (ticket->blocked) {
+		queue->blocked = 0;
+	}
+
+	if (od_list_empty(&queue->tickets)) {
+		od_list_unlink(&queue->link);
+		od_list_init(&queue->link);
+		queue->active = 0;
+		queue->blocked = 0;
+	}
+
+	if (admission->current == ticket) {
+		admission->current = NULL;
+	}
+	od_admission_choose_locked(admission);
+
+	pthread_mutex_unlock(&admission->lock);
+
+	/* nobody chooses a dequeued ticket */
+	mm_wait_list_destroy(&ticket->chosen);
+	ticket->queue = NULL;
+}
+
+int od_admission_turn(od_admission_t *admission, od_admission_ticket_t *ticket)
+{
+	pthread_mutex_lock(&admission->lock);
+	od_admission_ticket_t *current = admission->current;
+	if (current != NULL && current != ticket &&
+	    machine_time_ms() - admission->chosen_ms >=
+		    OD_ADMISSION_HEAD_TIMEOUT_MS) {
+		/* chosen one does not try to attach for too long */
+		od_admission_yield_locked(admission, current);
+	}
+	int turn = admission->current == ticket;
+	pthread_mutex_unlock(&admission->lock);
+	return turn;
+}
+
+void od_admission_yield(od_admission_t *admission,
+			od_admission_ticket_t *ticket)
+{
+	pthread_mutex_lock(&admission->lock);
+	if (admission->current == ticket) {
+		od_admission_yield_locked(admission, ticket);
+	}
+	pthread_mutex_unlock(&admission->lock);
+}
+
+int od_admission_blocked(od_admission_t *admission,
+			 od_admission_ticket_t *ticket)
+{
+	pthread_mutex_lock(&admission->lock);
+	int blocked = ticket->blocked;
+	pthread_mutex_unlock(&admission->lock);
+	return blocked;
+}
+
+void od_admission_unblock(od_admission_t *admission,
+			  od_admission_ticket_t *ticket)
+{
+	pthread_mutex_lock(&admission->lock);
+	if (ticket->blocked) {
+		ticket->blocked = 0;
+		ticket->queue->blocked = 0;
+		od_admission_choose_locked(admission);
+	}
+	pthread_mutex_unlock(&admission->lock);
+}
+
+int od_admission_wait(od_admission_t *admission,
+		      od_admission_ticket_t *ticket, uint32_t timeout_ms)
+{
+	pthread_mutex_lock(&admission->lock);
+	int turn = admission->current == ticket;
+	/* choose after the unlock changes the count, wait does not sleep */
+	uint64_t chosen_count = atomic_load(&ticket->chosen_count);
+	pthread_mutex_unlock(&admission->lock);
+	if (turn) {
+		return 0;
+	}
+
+	int rc;
+	rc = mm_wait_list_compare_wait(&ticket->chosen, chosen_count,
+				       timeout_ms);
+	if (rc == -1 && machine_timedout()) {
+		return -1;
+	}
+	return 0;
+}
+
+void od_admission_queue_wait_time(od_admission_queue_t *queue,
+				  uint64_t time_ms)
+{
+	int bucket = 0;
+	for (; bucket < OD_ADMISSION_HGRAM_BUCKETS - 1; bucket++) {
+		if (time_ms <= od_admission_hgram_bounds_ms[bucket]) {
+			break;
+		}
+	}
+	atomic_fetch_add(&queue->wait_hgram[bucket], 1);
+}
@@ -44,7 +44,8 @@ od_attach_extended_try_endpoint(od_instance_t *instance, char *context,
 		int rc = od_backend_connect(server, context, NULL, client);
 		if (rc == NOT_OK_RESPONSE) {
 			od_router_close(router, client);
-			od_storage_endpoint_status_set_dead(&endpoint->status);
+			od_storage_endpoint_status_set_dead(
+				od_storage_endpoint_status_of(endpoint));
 			return OD_ESERVER_CONNECT;
 		}
 	}
@@ -52,24 +53,35 @@ od_attach_extended_try_endpoint(od_instance_t *instance, char *context,
 	int rc = od_backend_startup_preallocated(server, NULL, client);
 	if (rc != OK_RESPONSE) {
 		od_router_close(router, client);
-		od_storage_endpoint_status_set_dead(&endpoint->status);
+		od_storage_endpoint_status_set_dead(
+			od_storage_endpoint_status_of(endpoint));
 		return OD_ESERVER_CONNECT;
 	}
 
 	return OD_OK;
 }
 
+int od_attach_extended_endpoint(od_instance_t *instance, char *context,
+				od_router_t *router, od_client_t *client,
+				od_storage_endpoint_t *endpoint)
+{
+	od_frontend_status_t status;
+	status = od_attach_extended_try_endpoint(instance, context, router,
+						 client, endpoint);
+	return status == OD_OK ? OK_RESPONSE : NOT_OK_RESPONSE;
+}
+
 int od_attach_extended(od_instance_t *instance, char *context,
 		       od_router_t *router, od_client_t *client)
 {
 	od_rule_storage_t *storage = client->rule->storage;
 
 	od_endpoint_attach_candidate_t candidates[OD_STORAGE_MAX_ENDPOINTS];
-	od_frontend_attach_init_candidates(instance, storage, candidates,
-					   OD_TARGET_SESSION_ATTRS_ANY,
-					   1 /* prefer localhost */);
+	size_t count = od_frontend_attach_init_candidates(
+		instance, storage, candidates, OD_TARGET_SESSION_ATTRS_ANY,
+		NULL, -1 /* any shard */, 1 /* prefer localhost */);
 
-	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+	for (size_t i = 0; i < count; ++i) {
 		od_storage_endpoint_t *endpoint = candidates[i].endpoint;
 		od_frontend_status_t status = OD_EATTACH;
 
@@ -0,0 +1,170 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <kiwi/kiwi.h>
+
+#include <attach_hint.h>
+
+#define OD_ATTACH_HINT_PREFIX "odyssey:"
+
+static inline const char *od_attach_hint_skip_spaces(const char *pos,
+						     const char *end)
+{
+	while (pos < end && (isspace((unsigned char)*pos) || *pos == ',')) {
+		pos++;
+	}
+	return pos;
+}
+
+static inline int od_attach_hint_is(const char *value, size_t len,
+				    const char *expected)
+{
+	return strlen(expected) == len &&
+	       strncasecmp(value, expected, len) == 0;
+}
+
+static inline int od_attach_hint_set(od_attach_hint_t *hint, const char *key,
+				     size_t key_len, const char *value,
+				     size_t value_len)
+{
+	if (od_attach_hint_is(key, key_len, "tsa")) {
+		if (od_attach_hint_is(value, value_len, "read-only")) {
+			hint->tsa = OD_TARGET_SESSION_ATTRS_RO;
+		} else if (od_attach_hint_is(value, value_len, "read-write")) {
+			hint->tsa = OD_TARGET_SESSION_ATTRS_RW;
+		} else if (od_attach_hint_is(value, value_len, "any")) {
+			hint->tsa = OD_TARGET_SESSION_ATTRS_ANY;
+		} else {
+			return -1;
+		}
+		return 0;
+	}
+
+	if (od_attach_hint_is(key, key_len, "az")) {
+		if (value_len == 0 || value_len >= sizeof(hint->az)) {
+			return -1;
+		}
+		memcpy(hint->az, value, value_len);
+		hint->az[value_len] = 0;
+		return 0;
+	}
+
+	if (od_attach_hint_is(key, key_len, "shard")) {
+		if (value_len == 0 || value_len > sizeof(hint->shard_key)) {
+			return -1;
+		}
+		memcpy(hint->shard_key, value, value_len);
+		hint->shard_key_len = value_len;
+		return 0;
+	}
+
+	/* unknown keys are reserved */
+	return 0;
+}
+
+static int od_attach_hint_parse_comment(od_attach_hint_t *hint,
+					const char *pos, const char *end)
+{
+	pos = od_attach_hint_skip_spaces(pos, end);
+	if (end - pos < 2 || memcmp(pos, "/*", 2) != 0) {
+		return 0;
+	}
+	pos = od_attach_hint_skip_spaces(pos + 2, end);
+
+	size_t prefix_len = strlen(OD_ATTACH_HINT_PREFIX);
+	if ((size_t)(end - pos) < prefix_len ||
+	    strncasecmp(pos, OD_ATTACH_HINT_PREFIX, prefix_len) != 0) {
+		return 0;
+	}
+	pos += prefix_len;
+
+	/* applied only if the comment is well-formed and complete */
+	od_attach_hint_t parsed;
+	od_attach_hint_init(&parsed);
+
+	for (;;) {
+		pos = od_attach_hint_skip_spaces(pos, end);
+		if (end - pos >= 2 && memcmp(pos, "*/", 2) == 0) {
+			break;
+		}
+
+		const char *key = pos;
+		while (pos < end && *pos != '=' && *pos != '*' &&
+		       !isspace((unsigned char)*pos)) {
+			pos++;
+		}
+		if (pos == end || *pos != '=') {
+			return 0;
+		}
+		size_t key_len = pos - key;
+
+		const char *value = ++pos;
+		while (pos < end && *pos != ',' && *pos != '*' &&
+		       !isspace((unsigned char)*pos)) {
+			pos++;
+		}
+		if (pos == end) {
+			return 0;
+		}
+
+		if (od_attach_hint_set(&parsed, key, key_len, value,
+				       pos - value) == -1) {
+			return 0;
+		}
+	}
+
+	if (parsed.tsa == OD_TARGET_SESSION_ATTRS_UNDEF && parsed.az[0] == 0 &&
+	    parsed.shard_key_len == 0) {
+		return 0;
+	}
+	*hint = parsed;
+	return 1;
+}
+
+int od_attach_hint_parse(od_attach_hint_t *hint, const char *data,
+			 size_t size)
+{
+	if (size < sizeof(kiwi_header_t)) {
+		return 0;
+	}
+
+	kiwi_header_t *header = (kiwi_header_t *)data;
+	uint32_t len = kiwi_read_size((char *)data, sizeof(kiwi_header_t));
+	if (len < sizeof(uint32_t)) {
+		return 0;
+	}
+	if (size > len + 1) {
+		size = len + 1;
+	}
+
+	const char *pos = data + sizeof(kiwi_header_t);
+	const char *end = data + size;
+
+	switch (header->type) {
+	case KIWI_FE_QUERY:
+		break;
+	case KIWI_FE_PARSE:
+		/* skip statement name */
+		pos = memchr(pos, 0, end - pos);
+		if (pos == NULL) {
+			return 0;
+		}
+		pos++;
+		break;
+	default:
+		return 0;
+	}
+
+	/* query is zero-terminated */
+	const char *query_end = memchr(pos, 0, end - pos);
+	if (query_end != NULL) {
+		end = query_end;
+	}
+
+	return od_attach_hint_parse_comment(hint, pos, end);
+}
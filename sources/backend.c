@@ -23,6 +23,7 @@
 #include <auth.h>
 #include <util.h>
 #include <query.h>
+#include <dns_cache.h>
 #include <tls.h>
 
 void od_backend_close(od_server_t *server)
@@ -31,7 +32,6 @@ void od_backend_close(od_server_t *server)
 	assert(server->io.io == NULL);
 	assert(server->tls == NULL);
 	server->is_transaction = 0;
-	server->idle_time = 0;
 	kiwi_key_init(&server->key);
 	kiwi_key_init(&server->key_client);
 	od_server_free(server);
@@ -364,8 +364,10 @@ int od_backend_connect_to(od_server_t *server, char *context,
 	struct sockaddr_un saddr_un;
 	struct sockaddr_in saddr_v4;
 	struct sockaddr_in6 saddr_v6;
+	struct sockaddr_storage saddr_resolved;
+	socklen_t saddr_resolved_len;
 	struct sockaddr *saddr;
-	struct addrinfo *ai = NULL;
+	int resolved = 0;
 
 	/* resolve server address */
 	if (address->type == OD_ADDRESS_TYPE_TCP) {
@@ -389,21 +391,21 @@ int od_backend_connect_to(od_server_t *server, char *context,
 			saddr = (struct sockaddr *)&saddr_v4;
 		}
 
-		/* schedule getaddrinfo() execution */
+		/* resolve hostname through the cache */
 		if (rc_resolve != 1) {
-			char rport[16];
-			od_snprintf(rport, sizeof(rport), "%d", address->port);
-
-			rc = machine_getaddrinfo(address->host, rport, NULL,
-						 &ai, 0);
-			if (rc != 0) {
+			rc = od_dns_cache_resolve(
+				address->host, address->port,
+				instance->config.dns_cache_ttl_ms,
+				instance->config.dns_cache_negative_ttl_ms,
+				&saddr_resolved, &saddr_resolved_len);
+			if (rc != OK_RESPONSE) {
 				od_error(&instance->logger, context, NULL,
 					 server, "failed to resolve %s:%d",
 					 address->host, address->port);
 				return NOT_OK_RESPONSE;
 			}
-			assert(ai != NULL);
-			saddr = ai->ai_addr;
+			saddr = (struct sockaddr *)&saddr_resolved;
+			resolved = 1;
 		}
 		/* connected */
 
@@ -425,11 +427,13 @@ int od_backend_connect_to(od_server_t *server, char *context,
 	rc = machine_connect(
 		server->io.io, saddr,
 		(uint32_t)instance->config.backend_connect_timeout_ms);
-	if (ai) {
-		freeaddrinfo(ai);
-	}
 
 	if (rc == NOT_OK_RESPONSE) {
+		/* the host may have moved, resolve it on the next connect */
+		if (resolved) {
+			od_dns_cache_invalidate(address->host, address->port);
+		}
+
 		if (address->type == OD_ADDRESS_TYPE_TCP) {
 			od_error(&instance->logger, context, server->client,
 				 server,
@@ -536,10 +540,11 @@ error:
 	return NOT_OK_RESPONSE;
 }
 
-static inline od_retcode_t
-od_backend_update_endpoint_status(od_instance_t *instance, od_client_t *client,
-				  od_server_t *server, char *context,
-				  od_storage_endpoint_t *endpoint)
+od_retcode_t od_backend_update_endpoint_status(od_instance_t *instance,
+					       od_client_t *client,
+					       od_server_t *server,
+					       char *context,
+					       od_storage_endpoint_t *endpoint)
 {
 	od_storage_endpoint_status_t status;
 	od_storage_endpoint_status_init(&status);
@@ -564,7 +569,19 @@ od_backend_update_endpoint_status(od_instance_t *instance, od_client_t *client,
 	status.last_update_time_ms = machine_time_ms();
 	status.alive = 1;
 
-	od_storage_endpoint_status_set(&endpoint->status, &status);
+	od_storage_endpoint_status_t *current;
+	current = od_storage_endpoint_status_of(endpoint);
+
+	od_storage_endpoint_status_t prev;
+	od_storage_endpoint_status_init(&prev);
+	od_storage_endpoint_status_get(current, &prev);
+	od_storage_endpoint_status_set(current, &status);
+
+	/* background refreshes must not flood the log */
+	if (prev.last_update_time_ms != 0 && prev.alive &&
+	    prev.is_read_write == status.is_read_write) {
+		return OK_RESPONSE;
+	}
 
 	char addr[256];
 	od_address_to_str(&endpoint->address, addr, sizeof(addr) - 1);
@@ -588,19 +605,36 @@ int od_backend_check_tsa(od_storage_endpoint_t *endpoint, char *context,
 	od_instance_t *instance = global->instance;
 	od_rule_storage_t *storage = client->rule->storage;
 
+	od_storage_endpoint_status_t status;
+	od_storage_endpoint_status_init(&status);
+	od_storage_endpoint_status_get(od_storage_endpoint_status_of(endpoint),
+				       &status);
+
+	/*
+	 * usually the status is kept fresh by the endpoints monitor,
+	 * otherwise only one client refreshes it and others use the
+	 * last known one
+	 */
 	if (od_storage_endpoint_status_is_outdated(
-		    &endpoint->status,
-		    storage->endpoints_status_poll_interval_ms)) {
-		if (od_backend_update_endpoint_status(instance, client, server,
-						      context, endpoint) !=
-		    OK_RESPONSE) {
-			return NOT_OK_RESPONSE;
+		    &status, storage->endpoints_status_poll_interval_ms)) {
+		int refresh;
+		refresh = od_storage_endpoint_status_refresh_begin(endpoint);
+		if (refresh || status.last_update_time_ms == 0) {
+			od_retcode_t rc = od_backend_update_endpoint_status(
+				instance, client, server, context, endpoint);
+			if (refresh) {
+				od_storage_endpoint_status_refresh_end(
+					endpoint);
+			}
+			if (rc != OK_RESPONSE) {
+				return NOT_OK_RESPONSE;
+			}
+			od_storage_endpoint_status_get(
+				od_storage_endpoint_status_of(endpoint),
+				&status);
 		}
 	}
 
-	od_storage_endpoint_status_t status;
-	od_storage_endpoint_status_get(&endpoint->status, &status);
-
 	if (!od_tsa_match_rw_state(attrs, status.is_read_write)) {
 		return NOT_OK_RESPONSE;
 	}
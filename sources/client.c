@@ -14,6 +14,8 @@
 #include <config.h>
 #include <relay.h>
 #include <list.h>
+#include <address.h>
+#include <util.h>
 
 machine_cond_t *od_client_get_io_cond(od_client_t *client)
 {
@@ -31,6 +33,7 @@ void od_client_init(od_client_t *client)
 	client->config_listen = NULL;
 	client->server = NULL;
 	client->route = NULL;
+	client->hostname = NULL;
 	client->global = NULL;
 	client->time_accept = 0;
 	client->time_setup = 0;
@@ -39,6 +42,7 @@ void od_client_init(od_client_t *client)
 	client->ldap_storage_username_len = 0;
 	client->ldap_storage_password = NULL;
 	client->ldap_storage_password_len = 0;
+	client->ldap_storage_credentials_name = NULL;
 	client->ldap_auth_dn = NULL;
 #endif
 	client->external_id = NULL;
@@ -46,6 +50,7 @@ void od_client_init(od_client_t *client)
 	kiwi_be_startup_init(&client->startup);
 	kiwi_vars_init(&client->vars);
 	kiwi_key_init(&client->key);
+	od_attach_hint_init(&client->attach_hint);
 
 	od_io_init(&client->io);
 	od_relay_init(&client->relay, &client->io);
@@ -77,11 +82,12 @@ void od_client_free(od_client_t *client)
 	kiwi_password_free(&client->password);
 	kiwi_password_free(&client->received_password);
 	if (client->prep_stmt_ids) {
-		od_hashmap_free(client->prep_stmt_ids);
+		od_lhashmap_free(client->prep_stmt_ids);
 	}
 	if (client->external_id) {
 		od_free(client->external_id);
 	}
+	od_free(client->hostname);
 	od_free(client);
 }
 
@@ -94,3 +100,16 @@ uint32_t od_client_login_timeout(const od_client_t *client)
 	/* TODO: do not use infinite timeout */
 	return UINT32_MAX;
 }
+
+void od_client_hostname_resolve(od_client_t *client,
+				struct sockaddr_storage *sa, uint64_t ttl_ms)
+{
+	if (client->hostname != NULL) {
+		return;
+	}
+
+	char hostname[NI_MAXHOST];
+	od_address_hostname_resolve(sa, ttl_ms, hostname, sizeof(hostname));
+	/* empty name is kept too, so the peer is not resolved again */
+	client->hostname = od_strdup(hostname);
+}
@@ -61,6 +61,7 @@ void od_config_init(od_config_t *config)
 
 	config->workers = 1;
 	config->resolvers = 1;
+	config->offload_workers = 4;
 	config->client_max_set = 0;
 	config->client_max = 0;
 	config->client_max_routing = 0;
@@ -75,6 +76,9 @@ void od_config_init(od_config_t *config)
 
 	config->backend_connect_timeout_ms = 30U * 1000U; /* 30 seconds */
 	config->cancel_timeout_ms = 5U * 1000U; /* 5 seconds */
+	config->dns_cache_ttl_ms = 10U * 1000U; /* 10 seconds */
+	config->dns_cache_negative_ttl_ms = 1000U;
+	config->hostname_cache_ttl_ms = 60U * 1000U; /* 1 minute */
 	config->virtual_processing = 0;
 
 	config->graceful_shutdown_timeout_ms = 30 * 1000; /* 30 seconds */
@@ -102,6 +106,11 @@ void od_config_reload(od_config_t *current_config, od_config_t *new_config)
 	current_config->backend_connect_timeout_ms =
 		new_config->backend_connect_timeout_ms;
 	current_config->cancel_timeout_ms = new_config->cancel_timeout_ms;
+	current_config->dns_cache_ttl_ms = new_config->dns_cache_ttl_ms;
+	current_config->dns_cache_negative_ttl_ms =
+		new_config->dns_cache_negative_ttl_ms;
+	current_config->hostname_cache_ttl_ms =
+		new_config->hostname_cache_ttl_ms;
 	current_config->smart_search_path_enquoting =
 		new_config->smart_search_path_enquoting;
 	current_config->disable_nolinger = new_config->disable_nolinger;
@@ -204,6 +213,13 @@ int od_config_validate(od_config_t *config, od_logger_t *logger)
 		return -1;
 	}
 
+	/* offload_workers */
+	if (config->offload_workers <= 0) {
+		od_error(logger, "config", NULL, NULL,
+			 "bad offload_workers number");
+		return -1;
+	}
+
 	/* coroutine_stack_size */
 	if (config->coroutine_stack_size < 4) {
 		od_error(logger, "config", NULL, NULL,
@@ -369,10 +385,18 @@ void od_config_print(od_config_t *config, od_logger_t *logger)
 	       config->workers);
 	od_log(logger, "config", NULL, NULL, "resolvers               %d",
 	       config->resolvers);
+	od_log(logger, "config", NULL, NULL, "offload_workers         %d",
+	       config->offload_workers);
 	od_log(logger, "config", NULL, NULL, "backend_connect_timeout_ms %u",
 	       config->backend_connect_timeout_ms);
 	od_log(logger, "config", NULL, NULL, "cancel_timeout_ms         %u",
 	       config->cancel_timeout_ms);
+	od_log(logger, "config", NULL, NULL, "dns_cache_ttl_ms          %d",
+	       config->dns_cache_ttl_ms);
+	od_log(logger, "config", NULL, NULL, "dns_cache_negative_ttl_ms %d",
+	       config->dns_cache_negative_ttl_ms);
+	od_log(logger, "config", NULL, NULL, "hostname_cache_ttl_ms     %d",
+	       config->hostname_cache_ttl_ms);
 	od_log(logger, "config", NULL, NULL, "enable_host_watcher.    %d",
 	       config->host_watcher_enabled);
 
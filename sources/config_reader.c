@@ -84,6 +84,7 @@ typedef enum {
 	OD_LREADAHEAD,
 	OD_LWORKERS,
 	OD_LRESOLVERS,
+	OD_LOFFLOAD_WORKERS,
 	OD_LPIPELINE,
 	OD_LSMART_SEARCH_PATH_ENQUOTING,
 	OD_LPACKET_READ_SIZE,
@@ -105,6 +106,9 @@ typedef enum {
 	OD_LAPPLICATION_NAME_ADD_HOST,
 	OD_LBACKEND_CONNECT_TIMEOUT_MS,
 	OD_LCANCEL_TIMEOUT_MS,
+	OD_LDNS_CACHE_TTL_MS,
+	OD_LDNS_CACHE_NEGATIVE_TTL_MS,
+	OD_LHOSTNAME_CACHE_TTL_MS,
 	OD_LSERVER_LIFETIME,
 	OD_LTLS,
 	OD_LTLS_CA_FILE,
@@ -114,6 +118,10 @@ typedef enum {
 	OD_LCOMPRESSION,
 	OD_LSTORAGE,
 	OD_LENDPOINTS_STATUS_POLL_INTERVAL,
+	OD_LLOAD_BALANCE,
+	OD_LSHARDS,
+	OD_LSHARD_BY,
+	OD_LSHARD_RANGES,
 	OD_LTYPE,
 	OD_LSERVERS_MAX_ROUTING,
 	OD_LDEFAULT,
@@ -130,18 +138,27 @@ typedef enum {
 	OD_LLDAPPOOL_TTL,
 #endif
 	OD_LPOOL_MIN_SIZE,
+	OD_LPOOL_WARMUP,
 	OD_LPOOL_SIZE,
 	OD_LPOOL_TIMEOUT,
 	OD_LPOOL_TTL,
 	OD_LPOOL_DISCARD,
 	OD_LPOOL_SMART_DISCARD,
+	OD_LPOOL_RESET_TRACKING,
 	OD_LPOOL_DISCARD_QUERY,
 	OD_LPOOL_CANCEL,
 	OD_LPOOL_ROLLBACK,
 	OD_LPOOL_RESERVE_PREPARED_STATEMENT,
+	OD_LPOOL_PREPARED_STATEMENTS_MAX,
+	OD_LPOOL_PREPARED_STATEMENTS_MAX_BYTES,
+	OD_LPOOL_PREPARED_STATEMENTS_DEPLOY,
 	OD_LPOOL_CLIENT_IDLE_TIMEOUT,
 	OD_LPOOL_IDLE_IN_TRANSACTION_TIMEOUT,
 	OD_LPOOL_PIN_ON_LISTEN,
+	OD_LPOOL_WEIGHT,
+	OD_LPOOL_PRIORITY,
+	OD_LSHARED_POOL_MIN_SIZE,
+	OD_LSHARED_POOL_MAX_SIZE,
 	OD_LSHARED_POOL,
 	OD_LSTORAGE_DB,
 	OD_LSTORAGE_USER,
@@ -173,6 +190,8 @@ typedef enum {
 	OD_LLDAP_SCHEME,
 	OD_LLDAP_SCOPE,
 	OD_LLDAP_SEARCH_FILTER,
+	OD_LLDAP_CACHE_TTL,
+	OD_LLDAP_CACHE_SIZE,
 	OD_LLDAP_ENDPOINT_NAME,
 	OD_LLDAP_STORAGE_CREDENTIALS_ATTR,
 	OD_LLDAP_STORAGE_CREDENTIALS,
@@ -181,6 +200,7 @@ typedef enum {
 	OD_LWATCHDOG,
 	OD_LWATCHDOG_LAG_QUERY,
 	OD_LWATCHDOG_LAG_INTERVAL,
+	OD_LWATCHDOG_LAG_POLL_INTERVAL,
 	OD_LCATCHUP_TIMEOUT,
 	OD_LCATCHUP_CHECKS,
 	OD_LOPTIONS,
@@ -276,6 +296,7 @@ static od_keyword_t od_config_keywords[] = {
 	od_keyword("readahead", OD_LREADAHEAD),
 	od_keyword("workers", OD_LWORKERS),
 	od_keyword("resolvers", OD_LRESOLVERS),
+	od_keyword("offload_workers", OD_LOFFLOAD_WORKERS),
 	od_keyword("pipeline", OD_LPIPELINE),
 	od_keyword("packet_read_size", OD_LPACKET_READ_SIZE),
 	od_keyword("packet_write_queue", OD_LPACKET_WRITE_QUEUE),
@@ -298,6 +319,9 @@ static od_keyword_t od_config_keywords[] = {
 	od_keyword("backend_connect_timeout_ms",
 		   OD_LBACKEND_CONNECT_TIMEOUT_MS),
 	od_keyword("cancel_timeout_ms", OD_LCANCEL_TIMEOUT_MS),
+	od_keyword("dns_cache_ttl_ms", OD_LDNS_CACHE_TTL_MS),
+	od_keyword("dns_cache_negative_ttl_ms", OD_LDNS_CACHE_NEGATIVE_TTL_MS),
+	od_keyword("hostname_cache_ttl_ms", OD_LHOSTNAME_CACHE_TTL_MS),
 
 	/*   tls */
 	od_keyword("tls", OD_LTLS),
@@ -311,6 +335,10 @@ static od_keyword_t od_config_keywords[] = {
 	od_keyword("storage", OD_LSTORAGE),
 	od_keyword("endpoints_status_poll_interval",
 		   OD_LENDPOINTS_STATUS_POLL_INTERVAL),
+	od_keyword("load_balance", OD_LLOAD_BALANCE),
+	od_keyword("shards", OD_LSHARDS),
+	od_keyword("shard_by", OD_LSHARD_BY),
+	od_keyword("shard_ranges", OD_LSHARD_RANGES),
 	od_keyword("type", OD_LTYPE),
 	od_keyword("server_max_routing", OD_LSERVERS_MAX_ROUTING),
 	od_keyword("default", OD_LDEFAULT),
@@ -330,20 +358,32 @@ static od_keyword_t od_config_keywords[] = {
 	od_keyword("ldap_pool_ttl", OD_LLDAPPOOL_TTL),
 #endif
 	od_keyword("min_pool_size", OD_LPOOL_MIN_SIZE),
+	od_keyword("pool_warmup", OD_LPOOL_WARMUP),
 	od_keyword("pool_size", OD_LPOOL_SIZE),
 	od_keyword("pool_timeout", OD_LPOOL_TIMEOUT),
 	od_keyword("pool_ttl", OD_LPOOL_TTL),
 	od_keyword("pool_discard", OD_LPOOL_DISCARD),
 	od_keyword("pool_discard_query", OD_LPOOL_DISCARD_QUERY),
 	od_keyword("pool_smart_discard", OD_LPOOL_SMART_DISCARD),
+	od_keyword("pool_reset_tracking", OD_LPOOL_RESET_TRACKING),
 	od_keyword("pool_cancel", OD_LPOOL_CANCEL),
 	od_keyword("pool_rollback", OD_LPOOL_ROLLBACK),
 	od_keyword("pool_reserve_prepared_statement",
 		   OD_LPOOL_RESERVE_PREPARED_STATEMENT),
+	od_keyword("pool_prepared_statements_max",
+		   OD_LPOOL_PREPARED_STATEMENTS_MAX),
+	od_keyword("pool_prepared_statements_max_bytes",
+		   OD_LPOOL_PREPARED_STATEMENTS_MAX_BYTES),
+	od_keyword("pool_prepared_statements_deploy",
+		   OD_LPOOL_PREPARED_STATEMENTS_DEPLOY),
 	od_keyword("pool_client_idle_timeout", OD_LPOOL_CLIENT_IDLE_TIMEOUT),
 	od_keyword("pool_idle_in_transaction_timeout",
 		   OD_LPOOL_IDLE_IN_TRANSACTION_TIMEOUT),
 	od_keyword("pool_pin_on_listen", OD_LPOOL_PIN_ON_LISTEN),
+	od_keyword("pool_weight", OD_LPOOL_WEIGHT),
+	od_keyword("pool_priority", OD_LPOOL_PRIORITY),
+	od_keyword("shared_pool_min_size", OD_LSHARED_POOL_MIN_SIZE),
+	od_keyword("shared_pool_max_size", OD_LSHARED_POOL_MAX_SIZE),
 	od_keyword("shared_pool", OD_LSHARED_POOL),
 	od_keyword("storage_db", OD_LSTORAGE_DB),
 	od_keyword("storage_user", OD_LSTORAGE_USER),
@@ -383,6 +423,8 @@ static od_keyword_t od_config_keywords[] = {
 	od_keyword("ldapscheme", OD_LLDAP_SCHEME),
 	od_keyword("ldapsearchfilter", OD_LLDAP_SEARCH_FILTER),
 	od_keyword("ldapscope", OD_LLDAP_SCOPE),
+	od_keyword("ldapcachettl", OD_LLDAP_CACHE_TTL),
+	od_keyword("ldapcachesize", OD_LLDAP_CACHE_SIZE),
 	od_keyword("ldap_endpoint_name", OD_LLDAP_ENDPOINT_NAME),
 	od_keyword("ldap_storage_credentials_attr",
 		   OD_LLDAP_STORAGE_CREDENTIALS_ATTR),
@@ -395,6 +437,8 @@ static od_keyword_t od_config_keywords[] = {
 	od_keyword("watchdog", OD_LWATCHDOG),
 	od_keyword("watchdog_lag_query", OD_LWATCHDOG_LAG_QUERY),
 	od_keyword("watchdog_lag_interval", OD_LWATCHDOG_LAG_INTERVAL),
+	od_keyword("watchdog_lag_poll_interval",
+		   OD_LWATCHDOG_LAG_POLL_INTERVAL),
 	od_keyword("catchup_timeout", OD_LCATCHUP_TIMEOUT),
 	od_keyword("catchup_checks", OD_LCATCHUP_CHECKS),
 
@@ -1352,6 +1396,62 @@ static int od_config_reader_storage(od_config_reader_t *reader,
 				goto error;
 			}
 			continue;
+		/* load_balance */
+		case OD_LLOAD_BALANCE: {
+			char *load_balance = NULL;
+			if (!od_config_reader_string(reader, &load_balance)) {
+				goto error;
+			}
+			if (strcmp(load_balance, "random") == 0) {
+				storage->load_balance =
+					OD_STORAGE_LOAD_BALANCE_RANDOM;
+			} else if (strcmp(load_balance, "latency") == 0) {
+				storage->load_balance =
+					OD_STORAGE_LOAD_BALANCE_LATENCY;
+			} else {
+				od_config_reader_error(
+					reader, &token,
+					"load_balance must be random or latency");
+				od_free(load_balance);
+				goto error;
+			}
+			od_free(load_balance);
+			continue;
+		}
+		/* shards */
+		case OD_LSHARDS:
+			if (!od_config_reader_string(reader,
+						     &storage->shards)) {
+				goto error;
+			}
+			continue;
+		/* shard_by */
+		case OD_LSHARD_BY: {
+			char *shard_by = NULL;
+			if (!od_config_reader_string(reader, &shard_by)) {
+				goto error;
+			}
+			if (strcmp(shard_by, "hash") == 0) {
+				storage->shard_by = OD_STORAGE_SHARD_BY_HASH;
+			} else if (strcmp(shard_by, "range") == 0) {
+				storage->shard_by = OD_STORAGE_SHARD_BY_RANGE;
+			} else {
+				od_config_reader_error(
+					reader, &token,
+					"shard_by must be hash or range");
+				od_free(shard_by);
+				goto error;
+			}
+			od_free(shard_by);
+			continue;
+		}
+		/* shard_ranges */
+		case OD_LSHARD_RANGES:
+			if (!od_config_reader_string(
+				    reader, &storage->shard_ranges_str)) {
+				goto error;
+			}
+			continue;
 		default: {
 			od_config_reader_error(reader, &token,
 					       "unexpected parameter");
@@ -1469,6 +1569,43 @@ error:
 	return NOT_OK_RESPONSE;
 }
 
+static inline int od_config_reader_shared_quota(od_config_reader_t *reader,
+						od_token_t *token,
+						od_rule_t *rule)
+{
+	od_rule_pool_t *pool = rule->pool;
+	if (pool->shared_min_size == 0 && pool->shared_max_size == 0) {
+		return OK_RESPONSE;
+	}
+
+	const char *db = rule->db_is_default ? "default" : rule->db_name;
+	const char *user = rule->user_is_default ? "default" : rule->user_name;
+
+	if (rule->shared_pool == NULL) {
+		od_config_reader_error(
+			reader, token,
+			"shared pool quota without shared pool for %s.%s "
+			"makes no sense",
+			db, user);
+		return NOT_OK_RESPONSE;
+	}
+
+	if (pool->shared_min_size < 0 || pool->shared_max_size < 0 ||
+	    (pool->shared_max_size > 0 &&
+	     pool->shared_min_size > pool->shared_max_size) ||
+	    pool->shared_min_size > rule->shared_pool->pool_size) {
+		od_config_reader_error(
+			reader, token,
+			"shared pool quota %d..%d of %s.%s does not fit "
+			"pool_size %d",
+			pool->shared_min_size, pool->shared_max_size, db, user,
+			rule->shared_pool->pool_size);
+		return NOT_OK_RESPONSE;
+	}
+
+	return OK_RESPONSE;
+}
+
 static inline int od_config_reader_pgoptions_kv_pair(
 	od_config_reader_t *reader, od_token_t *token, char **optarg,
 	size_t *optarg_len, char **optval, size_t *optval_len)
@@ -1803,6 +1940,11 @@ static int od_config_reader_rule_settings(od_config_reader_t *reader,
 							rule->user_name);
 					return NOT_OK_RESPONSE;
 				}
+				if (od_config_reader_shared_quota(
+					    reader, &token, rule) !=
+				    OK_RESPONSE) {
+					return NOT_OK_RESPONSE;
+				}
 
 				return 0;
 			}
@@ -2072,6 +2214,13 @@ static int od_config_reader_rule_settings(od_config_reader_t *reader,
 				return NOT_OK_RESPONSE;
 			}
 			continue;
+		/* pool_warmup */
+		case OD_LPOOL_WARMUP:
+			if (!od_config_reader_yes_no(reader,
+						     &rule->pool->warmup)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
 		/* pool_size */
 		case OD_LPOOL_SIZE:
 			if (!od_config_reader_number(reader,
@@ -2107,6 +2256,13 @@ static int od_config_reader_rule_settings(od_config_reader_t *reader,
 				return NOT_OK_RESPONSE;
 			}
 			continue;
+		/* pool_reset_tracking */
+		case OD_LPOOL_RESET_TRACKING:
+			if (!od_config_reader_yes_no(
+				    reader, &rule->pool->reset_tracking)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
 		/* pool_discard_query */
 		case OD_LPOOL_DISCARD_QUERY:
 			if (!od_config_reader_string(
@@ -2135,6 +2291,30 @@ static int od_config_reader_rule_settings(od_config_reader_t *reader,
 				return NOT_OK_RESPONSE;
 			}
 			continue;
+		/* pool_prepared_statements_max */
+		case OD_LPOOL_PREPARED_STATEMENTS_MAX:
+			if (!od_config_reader_number(
+				    reader,
+				    &rule->pool->prepared_statements_max)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
+		/* pool_prepared_statements_max_bytes */
+		case OD_LPOOL_PREPARED_STATEMENTS_MAX_BYTES:
+			if (!od_config_reader_number(
+				    reader,
+				    &rule->pool->prepared_statements_max_bytes)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
+		/* pool_prepared_statements_deploy */
+		case OD_LPOOL_PREPARED_STATEMENTS_DEPLOY:
+			if (!od_config_reader_number(
+				    reader,
+				    &rule->pool->prepared_statements_deploy)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
 		/* pool_pin_on_listen */
 		case OD_LPOOL_PIN_ON_LISTEN:
 			if (!od_config_reader_yes_no(
@@ -2142,6 +2322,34 @@ static int od_config_reader_rule_settings(od_config_reader_t *reader,
 				return NOT_OK_RESPONSE;
 			}
 			continue;
+		/* pool_weight */
+		case OD_LPOOL_WEIGHT:
+			if (!od_config_reader_number(reader,
+						     &rule->pool->weight)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
+		/* pool_priority */
+		case OD_LPOOL_PRIORITY:
+			if (!od_config_reader_number(reader,
+						     &rule->pool->priority)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
+		/* shared_pool_min_size */
+		case OD_LSHARED_POOL_MIN_SIZE:
+			if (!od_config_reader_number(
+				    reader, &rule->pool->shared_min_size)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
+		/* shared_pool_max_size */
+		case OD_LSHARED_POOL_MAX_SIZE:
+			if (!od_config_reader_number(
+				    reader, &rule->pool->shared_max_size)) {
+				return NOT_OK_RESPONSE;
+			}
+			continue;
 		/* pool_client_idle_timeout */
 		case OD_LPOOL_CLIENT_IDLE_TIMEOUT:
 			if (!od_config_reader_number64(
@@ -2323,6 +2531,24 @@ static int od_config_reader_rule_settings(od_config_reader_t *reader,
 				return NOT_OK_RESPONSE;
 			}
 			continue;
+		case OD_LWATCHDOG_LAG_POLL_INTERVAL:
+			if (watchdog == NULL) {
+				od_config_reader_error(
+					reader, NULL,
+					"watchdog settings specified for non-watchdog route");
+				return NOT_OK_RESPONSE;
+			}
+			if (!od_config_reader_number(
+				    reader, &watchdog->poll_interval_ms)) {
+				return NOT_OK_RESPONSE;
+			}
+			if (watchdog->poll_interval_ms <= 0) {
+				od_config_reader_error(
+					reader, NULL,
+					"watchdog_lag_poll_interval must be positive");
+				return NOT_OK_RESPONSE;
+			}
+			continue;
 		case OD_LCATCHUP_TIMEOUT:
 			if (!od_config_reader_number(reader,
 						     &rule->catchup_timeout)) {
@@ -2862,6 +3088,21 @@ od_config_reader_ldap_endpoint(od_config_reader_t *reader)
 				goto error;
 			}
 
+		} break;
+		case OD_LLDAP_CACHE_TTL: {
+			uint64_t ttl_sec;
+			if (!od_config_reader_number64(reader, &ttl_sec)) {
+				goto error;
+			}
+			ldap_current->cache.ttl_ms = ttl_sec * 1000;
+
+		} break;
+		case OD_LLDAP_CACHE_SIZE: {
+			if (!od_config_reader_number64(
+				    reader, &ldap_current->cache.size)) {
+				goto error;
+			}
+
 		} break;
 		}
 	}
@@ -3433,6 +3674,47 @@ static int od_config_reader_parse(od_config_reader_t *reader,
 				goto error;
 			}
 			continue;
+		/* dns_cache_ttl_ms */
+		case OD_LDNS_CACHE_TTL_MS:
+			if (!od_config_reader_number(
+				    reader, &config->dns_cache_ttl_ms)) {
+				goto error;
+			}
+			if (config->dns_cache_ttl_ms < 0) {
+				od_config_reader_error(reader, NULL,
+						       "dns_cache_ttl_ms must "
+						       "not be negative");
+				goto error;
+			}
+			continue;
+		/* dns_cache_negative_ttl_ms */
+		case OD_LDNS_CACHE_NEGATIVE_TTL_MS:
+			if (!od_config_reader_number(
+				    reader,
+				    &config->dns_cache_negative_ttl_ms)) {
+				goto error;
+			}
+			if (config->dns_cache_negative_ttl_ms < 0) {
+				od_config_reader_error(
+					reader, NULL,
+					"dns_cache_negative_ttl_ms must not be "
+					"negative");
+				goto error;
+			}
+			continue;
+		/* hostname_cache_ttl_ms */
+		case OD_LHOSTNAME_CACHE_TTL_MS:
+			if (!od_config_reader_number(
+				    reader, &config->hostname_cache_ttl_ms)) {
+				goto error;
+			}
+			if (config->hostname_cache_ttl_ms < 0) {
+				od_config_reader_error(reader, NULL,
+						       "hostname_cache_ttl_ms "
+						       "must not be negative");
+				goto error;
+			}
+			continue;
 
 		/* keepalive_usr_timeout */
 		case OD_LKEEPALIVE_USR_TIMEOUT:
@@ -3509,6 +3791,14 @@ static int od_config_reader_parse(od_config_reader_t *reader,
 				goto error;
 			}
 
+			continue;
+		/* offload_workers */
+		case OD_LOFFLOAD_WORKERS:
+			if (!od_config_reader_number(
+				    reader, &config->offload_workers)) {
+				goto error;
+			}
+
 			continue;
 		/* pipeline */
 		case OD_LPIPELINE:
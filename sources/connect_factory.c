@@ -0,0 +1,314 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <connect_factory.h>
+#include <global.h>
+#include <instance.h>
+#include <router.h>
+#include <route.h>
+#include <server.h>
+#include <backend.h>
+
+const uint32_t od_connect_factory_hgram_bounds_ms[] = {
+	1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500,
+};
+
+typedef struct {
+	char *name;
+	int in_progress;
+	od_list_t link;
+} od_connect_factory_storage_t;
+
+typedef struct {
+	od_connect_factory_t *factory;
+	od_connect_factory_storage_t *storage;
+	od_route_t *route;
+	od_server_t *server;
+	od_list_t link;
+} od_connect_request_t;
+
+void od_connect_factory_init(od_connect_factory_t *factory)
+{
+	factory->requests = NULL;
+	od_list_init(&factory->pending);
+	od_list_init(&factory->storages);
+	atomic_init(&factory->queued, 0);
+	atomic_init(&factory->in_progress, 0);
+	atomic_init(&factory->connected, 0);
+	atomic_init(&factory->failed, 0);
+	for (int i = 0; i < OD_CONNECT_FACTORY_HGRAM_BUCKETS; i++) {
+		atomic_init(&factory->latency_hgram[i], 0);
+	}
+	factory->global = NULL;
+	factory->stopped = NULL;
+	atomic_init(&factory->online, 0);
+}
+
+static inline void od_connect_factory_hgram_add(od_connect_factory_t *factory,
+						uint64_t time_us)
+{
+	int bucket = 0;
+	for (; bucket < OD_CONNECT_FACTORY_HGRAM_BUCKETS - 1; bucket++) {
+		if (time_us <= od_connect_factory_hgram_bounds_ms[bucket] *
+				       1000ULL) {
+			break;
+		}
+	}
+	atomic_fetch_add(&factory->latency_hgram[bucket], 1);
+}
+
+static inline void od_connect_factory_wakeup(od_connect_factory_t *factory)
+{
+	machine_msg_t *msg;
+	msg = machine_msg_create(sizeof(od_connect_request_t *));
+	if (msg == NULL) {
+		/* dispatcher will wake up by timeout */
+		return;
+	}
+	*(od_connect_request_t **)machine_msg_data(msg) = NULL;
+	machine_channel_write(factory->requests, msg);
+}
+
+static inline od_connect_factory_storage_t *
+od_connect_factory_storage(od_connect_factory_t *factory, const char *name)
+{
+	od_list_t *i;
+	od_list_foreach (&factory->storages, i) {
+		od_connect_factory_storage_t *storage;
+		storage = od_container_of(i, od_connect_factory_storage_t,
+					  link);
+		if (strcmp(storage->name, name) == 0) {
+			return storage;
+		}
+	}
+
+	od_connect_factory_storage_t *storage;
+	storage = od_malloc(sizeof(od_connect_factory_storage_t));
+	if (storage == NULL) {
+		return NULL;
+	}
+	storage->name = od_strdup(name);
+	if (storage->name == NULL) {
+		od_free(storage);
+		return NULL;
+	}
+	storage->in_progress = 0;
+	od_list_init(&storage->link);
+	od_list_append(&factory->storages, &storage->link);
+	return storage;
+}
+
+static void od_connect_factory_complete(od_connect_request_t *request, int rc,
+					uint64_t time_us)
+{
+	od_connect_factory_t *factory = request->factory;
+	od_route_t *route = request->route;
+	od_server_t *server = request->server;
+
+	if (request->storage != NULL) {
+		request->storage->in_progress--;
+		atomic_fetch_sub(&factory->in_progress, 1);
+	}
+
+	if (rc == OK_RESPONSE) {
+		atomic_fetch_add(&factory->connected, 1);
+		od_connect_factory_hgram_add(factory, time_us);
+	} else {
+		atomic_fetch_add(&factory->failed, 1);
+		od_backend_close_connection(server);
+	}
+
+	od_route_lock(route);
+	route->connects_queued--;
+	if (rc == OK_RESPONSE) {
+		/* startup will be done by the client, who takes the server */
+		od_server_set_pool_state(server, OD_SERVER_IDLE);
+	} else {
+		od_server_set_pool_state(server, OD_SERVER_UNDEF);
+		server->route = NULL;
+	}
+	od_route_unlock(route);
+
+	if (rc != OK_RESPONSE) {
+		od_backend_close(server);
+	}
+
+	/* wake up clients waiting for this connection or for a retry */
+	od_route_signal(route);
+	od_rules_unref(route->rule);
+	od_free(request);
+}
+
+static void od_connect_factory_connect(void *arg)
+{
+	od_connect_request_t *request = arg;
+	od_router_t *router = request->factory->global->router;
+	od_server_t *server = request->server;
+	od_rule_storage_t *storage = request->route->rule->storage;
+
+	/* seen by client side connection ramp */
+	od_atomic_u32_inc(&router->servers_routing);
+
+	uint64_t start_us = machine_time_us();
+	int rc = od_backend_connect_to(server, "connect-factory",
+				       od_server_pool_address(server),
+				       storage->tls_opts);
+	if (rc == OK_RESPONSE && od_io_detach(&server->io) == -1) {
+		rc = NOT_OK_RESPONSE;
+	}
+	uint64_t time_us = machine_time_us() - start_us;
+
+	od_atomic_u32_dec(&router->servers_routing);
+
+	od_connect_factory_t *factory = request->factory;
+	od_connect_factory_complete(request, rc, time_us);
+	od_connect_factory_wakeup(factory);
+}
+
+static inline void od_connect_factory_run(od_connect_factory_t *factory)
+{
+	od_list_t *i, *n;
+	od_list_foreach_safe (&factory->pending, i, n) {
+		od_connect_request_t *request;
+		request = od_container_of(i, od_connect_request_t, link);
+
+		od_rule_storage_t *storage = request->route->rule->storage;
+		od_connect_factory_storage_t *counter;
+		counter = od_connect_factory_storage(factory, storage->name);
+		if (counter == NULL) {
+			continue;
+		}
+		if (counter->in_progress >= storage->server_max_routing) {
+			continue;
+		}
+
+		od_list_unlink(&request->link);
+		atomic_fetch_sub(&factory->queued, 1);
+
+		counter->in_progress++;
+		atomic_fetch_add(&factory->in_progress, 1);
+		request->storage = counter;
+
+		int64_t coroutine_id;
+		coroutine_id = machine_coroutine_create(
+			od_connect_factory_connect, request);
+		if (coroutine_id == INVALID_COROUTINE_ID) {
+			od_connect_factory_complete(request, NOT_OK_RESPONSE,
+						    0);
+		}
+	}
+}
+
+static void od_connect_factory_dispatch(void *arg)
+{
+	od_connect_factory_t *factory = arg;
+
+	for (;;) {
+		if (!atomic_load(&factory->online)) {
+			break;
+		}
+
+		machine_msg_t *msg;
+		msg = machine_channel_read(factory->requests, 1000);
+		if (msg != NULL) {
+			od_connect_request_t *request;
+			request = *(od_connect_request_t **)machine_msg_data(
+				msg);
+			machine_msg_free(msg);
+			if (request != NULL) {
+				od_list_append(&factory->pending,
+					       &request->link);
+			}
+		}
+
+		od_connect_factory_run(factory);
+	}
+
+	machine_wait_flag_set(factory->stopped);
+}
+
+int od_connect_factory_start(od_connect_factory_t *factory,
+			     od_global_t *global)
+{
+	od_instance_t *instance = global->instance;
+	factory->global = global;
+
+	factory->requests = machine_channel_create();
+	if (factory->requests == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	factory->stopped = machine_wait_flag_create();
+	if (factory->stopped == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	atomic_store(&factory->online, 1);
+
+	int64_t coroutine_id;
+	coroutine_id = machine_coroutine_create(od_connect_factory_dispatch,
+						factory);
+	if (coroutine_id == INVALID_COROUTINE_ID) {
+		atomic_store(&factory->online, 0);
+		od_error(&instance->logger, "connect-factory", NULL, NULL,
+			 "failed to start connect factory coroutine");
+		return NOT_OK_RESPONSE;
+	}
+
+	return OK_RESPONSE;
+}
+
+void od_connect_factory_stop(od_connect_factory_t *factory)
+{
+	if (!atomic_exchange(&factory->online, 0)) {
+		return;
+	}
+
+	/*
+	 * queued requests keep their reserved servers,
+	 * which are freed together with the pools
+	 */
+	machine_wait_flag_wait(factory->stopped, UINT32_MAX);
+}
+
+int od_connect_factory_submit(od_connect_factory_t *factory,
+			      od_route_t *route, od_server_t *server)
+{
+	if (!atomic_load(&factory->online)) {
+		return NOT_OK_RESPONSE;
+	}
+
+	od_connect_request_t *request;
+	request = od_malloc(sizeof(od_connect_request_t));
+	if (request == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+	request->factory = factory;
+	request->storage = NULL;
+	request->route = route;
+	request->server = server;
+	od_list_init(&request->link);
+
+	machine_msg_t *msg;
+	msg = machine_msg_create(sizeof(od_connect_request_t *));
+	if (msg == NULL) {
+		od_free(request);
+		return NOT_OK_RESPONSE;
+	}
+	*(od_connect_request_t **)machine_msg_data(msg) = request;
+
+	/* the rule must survive until the connect is done */
+	od_rules_ref(route->rule);
+	route->connects_queued++;
+	atomic_fetch_add(&factory->queued, 1);
+
+	machine_channel_write(factory->requests, msg);
+	return OK_RESPONSE;
+}
@@ -17,6 +17,7 @@
 #include <status.h>
 #include <route_pool.h>
 #include <dns.h>
+#include <dns_cache.h>
 #include <client.h>
 #include <global.h>
 #include <router.h>
@@ -59,6 +60,10 @@ typedef enum {
 	OD_LIS_PAUSED,
 	OD_LHOST_UTILIZATION,
 	OD_LRULES,
+	OD_LCONNECTS,
+	OD_LWAITS,
+	OD_LDNS_CACHE,
+	OD_LLDAP_ENDPOINTS,
 } od_console_keywords_t;
 
 static od_keyword_t od_console_keywords[] = {
@@ -92,6 +97,10 @@ static od_keyword_t od_console_keywords[] = {
 	od_keyword("is_paused", OD_LIS_PAUSED),
 	od_keyword("host_utilization", OD_LHOST_UTILIZATION),
 	od_keyword("rules", OD_LRULES),
+	od_keyword("connects", OD_LCONNECTS),
+	od_keyword("waits", OD_LWAITS),
+	od_keyword("dns_cache", OD_LDNS_CACHE),
+	od_keyword("ldap_endpoints", OD_LLDAP_ENDPOINTS),
 	{ 0, 0, 0 }
 };
 
@@ -218,6 +227,34 @@ static inline int od_console_show_stats_add(machine_msg_t *stream,
 	if (rc == NOT_OK_RESPONSE) {
 		return NOT_OK_RESPONSE;
 	}
+	/* count of attaches which skipped parameters deploy */
+	data_len = od_snprintf(data, sizeof(data), "%" PRIu64,
+			       total->count_deploy_avoided);
+	rc = kiwi_be_write_data_row_add(stream, offset, data, data_len);
+	if (rc == NOT_OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
+	/* count of detaches which skipped session reset */
+	data_len = od_snprintf(data, sizeof(data), "%" PRIu64,
+			       total->count_reset_avoided);
+	rc = kiwi_be_write_data_row_add(stream, offset, data, data_len);
+	if (rc == NOT_OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
+	/* count of prepared statements evicted from servers */
+	data_len = od_snprintf(data, sizeof(data), "%" PRIu64,
+			       total->count_parse_evict);
+	rc = kiwi_be_write_data_row_add(stream, offset, data, data_len);
+	if (rc == NOT_OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
+	/* count of prepared statements deployed to idle servers */
+	data_len = od_snprintf(data, sizeof(data), "%" PRIu64,
+			       total->count_parse_deploy);
+	rc = kiwi_be_write_data_row_add(stream, offset, data, data_len);
+	if (rc == NOT_OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
 	return 0;
 }
 
@@ -335,7 +372,7 @@ static inline int od_console_show_help(machine_msg_t *stream)
 	char *message =
 		"\n"
 		"Console usage\n"
-		"\tSHOW STATS|HELP|POOLS|POOLS_EXTENDED|DATABASES|SERVER_PREP_STMTS|SERVERS|CLIENTS|HOST_UTILIZATION\n"
+		"\tSHOW STATS|HELP|POOLS|POOLS_EXTENDED|DATABASES|SERVER_PREP_STMTS|SERVERS|CLIENTS|HOST_UTILIZATION|CONNECTS\n"
 		"\tSHOW LISTS|ERRORS|ERRORS_PER_ROUTE|VERSION|LISTEN|STORAGES\n"
 		"\tKILL_CLIENT <client_id>\n"
 		"\tRELOAD\n"
@@ -356,12 +393,15 @@ static inline int od_console_show_stats(od_client_t *client,
 	od_cron_t *cron = client->global->cron;
 
 	if (kiwi_be_write_row_descriptionf(
-		    stream, "sllllllllllllllll", "database", "total_xact_count",
-		    "total_query_count", "total_received", "total_sent",
-		    "total_xact_time", "total_query_time", "total_wait_time",
-		    "avg_xact_count", "avg_query_count", "avg_recv", "avg_sent",
-		    "avg_xact_time", "avg_query_time", "avg_wait_time",
-		    "total_parse_count", "total_parse_count_reuse") == NULL) {
+		    stream, "sllllllllllllllllllll", "database",
+		    "total_xact_count", "total_query_count", "total_received",
+		    "total_sent", "total_xact_time", "total_query_time",
+		    "total_wait_time", "avg_xact_count", "avg_query_count",
+		    "avg_recv", "avg_sent", "avg_xact_time", "avg_query_time",
+		    "avg_wait_time", "total_parse_count",
+		    "total_parse_count_reuse", "total_deploy_avoided",
+		    "total_reset_avoided", "total_parse_count_evict",
+		    "total_parse_count_deploy") == NULL) {
 		return NOT_OK_RESPONSE;
 	}
 
@@ -1351,92 +1391,79 @@ static inline int od_console_show_server_prep_stmt_cb(od_server_t *server,
 						      void **argv)
 {
 	od_route_t *route = server->route;
-	od_hashmap_t *hm = server->prep_stmts;
-
-	for (size_t i = 0; i < hm->size; ++i) {
-		od_hashmap_bucket_t *bucket = &hm->buckets[i];
-		mm_mutex_lock(&bucket->mu, UINT32_MAX);
-
-		od_list_t *i;
-		od_list_foreach (&bucket->items, i) {
-			int offset;
-			machine_msg_t *stream = argv[0];
-			machine_msg_t *msg;
-			msg = kiwi_be_write_data_row(stream, &offset);
-			if (msg == NULL) {
-				goto error;
-			}
+	if (server->prep_stmts == NULL) {
+		return 0;
+	}
+	od_lhashmap_t *map = server->prep_stmts->index;
 
-			/* type */
-			char data[64];
-			size_t data_len;
-			data_len = od_snprintf(data, sizeof(data), "S");
+	od_lhashmap_entry_t *entry = NULL;
+	while ((entry = od_lhashmap_next(map, entry)) != NULL) {
+		int offset;
+		machine_msg_t *stream = argv[0];
+		machine_msg_t *msg;
+		msg = kiwi_be_write_data_row(stream, &offset);
+		if (msg == NULL) {
+			goto error;
+		}
 
-			int rc;
-			rc = kiwi_be_write_data_row_add(stream, offset, data,
-							data_len);
-			if (rc == NOT_OK_RESPONSE) {
-				goto error;
-			}
+		/* type */
+		char data[64];
+		size_t data_len;
+		data_len = od_snprintf(data, sizeof(data), "S");
 
-			/* user */
-			rc = kiwi_be_write_data_row_add(stream, offset,
-							route->id.user,
-							route->id.user_len - 1);
-			if (rc == NOT_OK_RESPONSE) {
-				goto error;
-			}
+		int rc;
+		rc = kiwi_be_write_data_row_add(stream, offset, data, data_len);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
 
-			/* database */
-			rc = kiwi_be_write_data_row_add(
-				stream, offset, route->id.database,
-				route->id.database_len - 1);
-			if (rc == NOT_OK_RESPONSE) {
-				goto error;
-			}
+		/* user */
+		rc = kiwi_be_write_data_row_add(stream, offset, route->id.user,
+						route->id.user_len - 1);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
 
-			/* sid */
-			data_len = od_snprintf(data, sizeof(data), "%s%.*s",
-					       server->id.id_prefix,
-					       (signed)sizeof(server->id.id),
-					       server->id.id);
-			rc = kiwi_be_write_data_row_add(msg, offset, data,
-							data_len);
-			if (rc == NOT_OK_RESPONSE) {
-				goto error;
-			}
+		/* database */
+		rc = kiwi_be_write_data_row_add(stream, offset,
+						route->id.database,
+						route->id.database_len - 1);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
 
-			od_hashmap_list_item_t *item;
-			item = od_container_of(i, od_hashmap_list_item_t, link);
-			od_hashmap_elt_t *prep_stmt = &item->key;
-			od_hashmap_elt_t *prep_stmt_desc = &item->value;
+		/* sid */
+		data_len = od_snprintf(data, sizeof(data), "%s%.*s",
+				       server->id.id_prefix,
+				       (signed)sizeof(server->id.id),
+				       server->id.id);
+		rc = kiwi_be_write_data_row_add(msg, offset, data, data_len);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
 
-			/* description */
-			rc = kiwi_be_write_data_row_add(stream, offset,
-							prep_stmt->data,
-							prep_stmt->len);
-			if (rc == NOT_OK_RESPONSE) {
-				goto error;
-			}
+		od_server_prep_stmt_t *prep_stmt_desc = entry->value.data;
+		od_prep_stmt_body_t *prep_stmt = prep_stmt_desc->body;
 
-			/*refcount */
-			data_len = od_snprintf(data, sizeof(data), "%d",
-					       prep_stmt_desc->data);
-			rc = kiwi_be_write_data_row_add(stream, offset, data,
-							data_len);
-			if (rc == NOT_OK_RESPONSE) {
-				goto error;
-			}
+		/* description */
+		rc = kiwi_be_write_data_row_add(stream, offset, prep_stmt->data,
+						prep_stmt->len);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
 		}
 
-		mm_mutex_unlock(&bucket->mu);
-		continue;
-	error:
-		mm_mutex_unlock(&bucket->mu);
-		return NOT_OK_RESPONSE;
+		/*refcount */
+		data_len = od_snprintf(data, sizeof(data), "%" PRIu32,
+				       od_atomic_u32_of(&prep_stmt->refcnt));
+		rc = kiwi_be_write_data_row_add(stream, offset, data, data_len);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
 	}
 
 	return 0;
+error:
+	return NOT_OK_RESPONSE;
 }
 
 static inline int od_console_show_servers_cb(od_route_t *route, void **argv)
@@ -1607,6 +1634,220 @@ static inline int od_console_show_host_utilization(od_client_t *client,
 				      sizeof("HOST_UTILIZATION"));
 }
 
+static inline int od_console_show_connects(od_client_t *client,
+					   machine_msg_t *stream)
+{
+	od_router_t *router = client->global->router;
+	od_connect_factory_t *factory = &router->connect_factory;
+
+	machine_msg_t *msg;
+	msg = kiwi_be_write_row_descriptionf(
+		stream, "llllllllllllllll", "queue_depth", "in_progress",
+		"connected", "failed", "latency_le_1ms", "latency_le_2ms",
+		"latency_le_5ms", "latency_le_10ms", "latency_le_25ms",
+		"latency_le_50ms", "latency_le_100ms", "latency_le_250ms",
+		"latency_le_500ms", "latency_le_1000ms", "latency_le_2500ms",
+		"latency_inf");
+	if (msg == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	int offset;
+	if (kiwi_be_write_data_row(stream, &offset) == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	uint64_t values[4 + OD_CONNECT_FACTORY_HGRAM_BUCKETS];
+	values[0] = (uint64_t)atomic_load(&factory->queued);
+	values[1] = (uint64_t)atomic_load(&factory->in_progress);
+	values[2] = atomic_load(&factory->connected);
+	values[3] = atomic_load(&factory->failed);
+	for (int i = 0; i < OD_CONNECT_FACTORY_HGRAM_BUCKETS; i++) {
+		values[4 + i] = atomic_load(&factory->latency_hgram[i]);
+	}
+
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		char data[32];
+		int data_len;
+		data_len = od_snprintf(data, sizeof(data), "%" PRIu64,
+				       values[i]);
+		int rc = kiwi_be_write_data_row_add(stream, offset, data,
+						    data_len);
+		if (rc != OK_RESPONSE) {
+			return rc;
+		}
+	}
+
+	return kiwi_be_write_complete(stream, "SHOW", 5);
+}
+
+static inline int od_console_show_waits_cb(od_route_t *route, void **argv)
+{
+	machine_msg_t *stream = argv[0];
+
+	int offset;
+	if (kiwi_be_write_data_row(stream, &offset) == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	int rc;
+	rc = kiwi_be_write_data_row_add(stream, offset, route->id.database,
+					route->id.database_len - 1);
+	if (rc != OK_RESPONSE) {
+		return rc;
+	}
+	rc = kiwi_be_write_data_row_add(stream, offset, route->id.user,
+					route->id.user_len - 1);
+	if (rc != OK_RESPONSE) {
+		return rc;
+	}
+
+	od_admission_queue_t *queue = &route->admission;
+	int64_t values[3 + OD_ADMISSION_HGRAM_BUCKETS];
+	values[0] = atomic_load(&queue->waiting);
+	values[1] = route->rule->pool->weight;
+	values[2] = route->rule->pool->priority;
+	for (int i = 0; i < OD_ADMISSION_HGRAM_BUCKETS; i++) {
+		values[3 + i] = (int64_t)atomic_load(&queue->wait_hgram[i]);
+	}
+
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		char data[32];
+		int data_len;
+		data_len = od_snprintf(data, sizeof(data), "%" PRIi64,
+				       values[i]);
+		rc = kiwi_be_write_data_row_add(stream, offset, data,
+						data_len);
+		if (rc != OK_RESPONSE) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+static inline int od_console_show_waits(od_client_t *client,
+					machine_msg_t *stream)
+{
+	od_router_t *router = client->global->router;
+
+	machine_msg_t *msg;
+	msg = kiwi_be_write_row_descriptionf(
+		stream, "sslllllllllllll", "database", "user", "waiting",
+		"weight", "priority", "wait_le_1ms", "wait_le_5ms",
+		"wait_le_10ms", "wait_le_50ms", "wait_le_100ms",
+		"wait_le_500ms", "wait_le_1000ms", "wait_le_5000ms",
+		"wait_le_10000ms", "wait_inf");
+	if (msg == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	void *argv[] = { stream };
+	int rc = od_router_foreach(router, od_console_show_waits_cb, argv);
+	if (rc == NOT_OK_RESPONSE) {
+		return rc;
+	}
+
+	return kiwi_be_write_complete(stream, "SHOW", 5);
+}
+
+#ifdef LDAP_FOUND
+static inline int od_console_show_ldap_endpoints(machine_msg_t *stream)
+{
+	machine_msg_t *msg;
+	msg = kiwi_be_write_row_descriptionf(
+		stream, "slllllllll", "name", "searches", "binds", "errors",
+		"avg_search_us", "avg_bind_us", "cache_entries", "cache_size",
+		"cache_hits", "cache_misses");
+	if (msg == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	od_global_t *global = od_global_get();
+	od_router_t *router = global->router;
+	od_rules_t *rules = &router->rules;
+
+	pthread_mutex_lock(&rules->mu);
+
+	/* endpoints of reloaded config are referenced by rules only */
+	od_list_t *i, *j;
+	od_list_foreach (&rules->rules, i) {
+		od_rule_t *rule = od_container_of(i, od_rule_t, link);
+		od_ldap_endpoint_t *le = rule->ldap_endpoint;
+		if (le == NULL) {
+			continue;
+		}
+
+		int shown = 0;
+		od_list_foreach (&rules->rules, j) {
+			if (j == i) {
+				break;
+			}
+			od_rule_t *prev = od_container_of(j, od_rule_t, link);
+			if (prev->ldap_endpoint == le) {
+				shown = 1;
+				break;
+			}
+		}
+		if (shown) {
+			continue;
+		}
+
+		int offset;
+		if (kiwi_be_write_data_row(stream, &offset) == NULL) {
+			goto error;
+		}
+
+		int rc;
+		rc = kiwi_be_write_data_row_add(stream, offset, le->name,
+						strlen(le->name));
+		if (rc != OK_RESPONSE) {
+			goto error;
+		}
+
+		uint64_t searches = atomic_load(&le->count_search);
+		uint64_t binds = atomic_load(&le->count_bind);
+		uint64_t values[9];
+		values[0] = searches;
+		values[1] = binds;
+		values[2] = atomic_load(&le->count_error);
+		values[3] = searches ? atomic_load(&le->search_time_us) /
+					       searches :
+				       0;
+		values[4] = binds ? atomic_load(&le->bind_time_us) / binds : 0;
+
+		od_ldap_cache_t *cache = &le->cache;
+		pthread_mutex_lock(&cache->lock);
+		values[5] = cache->count;
+		pthread_mutex_unlock(&cache->lock);
+		values[6] = cache->size;
+		values[7] = atomic_load(&cache->hits);
+		values[8] = atomic_load(&cache->misses);
+
+		for (size_t k = 0; k < sizeof(values) / sizeof(values[0]);
+		     k++) {
+			char data[32];
+			int data_len;
+			data_len = od_snprintf(data, sizeof(data), "%" PRIu64,
+					       values[k]);
+			rc = kiwi_be_write_data_row_add(stream, offset, data,
+							data_len);
+			if (rc != OK_RESPONSE) {
+				goto error;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&rules->mu);
+
+	return kiwi_be_write_complete(stream, "SHOW", sizeof("SHOW"));
+
+error:
+	pthread_mutex_unlock(&rules->mu);
+	return NOT_OK_RESPONSE;
+}
+#endif
+
 static inline int od_console_show_rules(machine_msg_t *stream)
 {
 	int offset;
@@ -1936,7 +2177,7 @@ static inline int od_console_show_lists(od_client_t *client,
 	   router_used_servers can be inconsistent here, since it depends on
 	   separate route locks.
 	*/
-	od_router_lock(router);
+	od_router_rdlock(router);
 
 	int router_used_servers = 0;
 	int router_free_servers = 0;
@@ -2146,6 +2387,55 @@ static inline int od_console_show_listen(od_client_t *client,
 	return kiwi_be_write_complete(stream, "SHOW", 5);
 }
 
+#define OD_CONSOLE_ENDPOINT_STATS_LEN 256
+
+/* address with EWMA query and connect time, error rate and score */
+static inline int od_console_show_storage_endpoints(od_rule_storage_t *storage,
+						    int offset,
+						    machine_msg_t *stream)
+{
+	size_t size = storage->endpoints_count * OD_CONSOLE_ENDPOINT_STATS_LEN;
+	if (size == 0) {
+		return kiwi_be_write_data_row_add(stream, offset, "", 0);
+	}
+
+	char *data = od_malloc(size);
+	if (data == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	int len = 0;
+	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+		od_storage_endpoint_t *endpoint = &storage->endpoints[i];
+		od_storage_endpoint_stats_t *stats = endpoint->stats;
+
+		char addr[OD_CONSOLE_ENDPOINT_STATS_LEN / 2];
+		od_address_to_str(&endpoint->address, addr, sizeof(addr) - 1);
+		len += od_snprintf(data + len, size - len, "%s%s",
+				   i == 0 ? "" : ", ", addr);
+		if (stats == NULL) {
+			continue;
+		}
+
+		uint64_t error_rate = od_atomic_u64_of(&stats->error_rate) >>
+				      OD_STORAGE_ENDPOINT_STATS_SHIFT;
+		len += od_snprintf(
+			data + len, size - len,
+			" (query %" PRIu64 "us, connect %" PRIu64
+			"us, errors %" PRIu64 "%%, score %" PRIu64 ")",
+			od_atomic_u64_of(&stats->query_time) >>
+				OD_STORAGE_ENDPOINT_STATS_SHIFT,
+			od_atomic_u64_of(&stats->connect_time) >>
+				OD_STORAGE_ENDPOINT_STATS_SHIFT,
+			error_rate * 100 / OD_STORAGE_ENDPOINT_STATS_ERROR,
+			od_storage_endpoint_stats_score(stats));
+	}
+
+	int rc = kiwi_be_write_data_row_add(stream, offset, data, len);
+	od_free(data);
+	return rc;
+}
+
 static inline int od_console_show_storages(od_client_t *client,
 					   machine_msg_t *stream)
 {
@@ -2153,10 +2443,10 @@ static inline int od_console_show_storages(od_client_t *client,
 	od_router_t *router = client->global->router;
 
 	machine_msg_t *msg;
-	msg = kiwi_be_write_row_descriptionf(stream, "ssdsssss", "type", "host",
-					     "port", "tls", "tls_cert_file",
-					     "tls_key_file", "tls_ca_file",
-					     "tls_protocols");
+	msg = kiwi_be_write_row_descriptionf(
+		stream, "ssdsssssss", "type", "host", "port", "tls",
+		"tls_cert_file", "tls_key_file", "tls_ca_file", "tls_protocols",
+		"load_balance", "endpoints");
 
 	if (msg == NULL) {
 		return NOT_OK_RESPONSE;
@@ -2220,6 +2510,20 @@ static inline int od_console_show_storages(od_client_t *client,
 		if (rc != OK_RESPONSE) {
 			goto error;
 		}
+
+		/* load_balance */
+		char *load_balance =
+			od_storage_load_balance_to_str(storage->load_balance);
+		rc = kiwi_be_write_data_row_add(stream, offset, load_balance,
+						strlen(load_balance));
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
+
+		rc = od_console_show_storage_endpoints(storage, offset, stream);
+		if (rc != OK_RESPONSE) {
+			goto error;
+		}
 	}
 
 	pthread_mutex_unlock(&rules->mu);
@@ -2287,6 +2591,14 @@ static inline int od_console_show(od_client_t *client, machine_msg_t *stream,
 		return od_console_show_host_utilization(client, stream);
 	case OD_LRULES:
 		return od_console_show_rules(stream);
+	case OD_LCONNECTS:
+		return od_console_show_connects(client, stream);
+	case OD_LWAITS:
+		return od_console_show_waits(client, stream);
+#ifdef LDAP_FOUND
+	case OD_LLDAP_ENDPOINTS:
+		return od_console_show_ldap_endpoints(stream);
+#endif
 	}
 	return NOT_OK_RESPONSE;
 }
@@ -2456,7 +2768,7 @@ static inline int od_console_create(od_client_t *client, machine_msg_t *stream,
 static inline int od_console_drop_server_cb(od_server_t *server,
 					    od_attribute_unused() void **argv)
 {
-	server->offline = 1;
+	od_server_set_offline(server);
 	return OK_RESPONSE;
 }
 
@@ -2499,6 +2811,24 @@ static inline od_retcode_t od_console_drop_servers(od_client_t *client,
 	return OK_RESPONSE;
 }
 
+static inline od_retcode_t od_console_drop_dns_cache(od_client_t *client,
+						     machine_msg_t *stream,
+						     od_parser_t *parser)
+{
+	od_instance_t *instance = client->global->instance;
+
+	od_token_t token;
+	if (od_parser_next(parser, &token) != OD_PARSER_EOF) {
+		return NOT_OK_RESPONSE;
+	}
+
+	int count = od_dns_cache_flush();
+	od_log(&instance->logger, "console", client, NULL,
+	       "dns cache is flushed, %d entries dropped", count);
+
+	return kiwi_be_write_complete(stream, "DROP", 5);
+}
+
 static inline od_retcode_t
 od_console_drop(od_client_t *client, machine_msg_t *stream, od_parser_t *parser)
 {
@@ -2522,6 +2852,8 @@ od_console_drop(od_client_t *client, machine_msg_t *stream, od_parser_t *parser)
 	switch (keyword->id) {
 	case OD_LSERVERS:
 		return od_console_drop_servers(client, stream, parser);
+	case OD_LDNS_CACHE:
+		return od_console_drop_dns_cache(client, stream, parser);
 	case OD_LMODULE:
 		return od_console_unload_module(client, stream, parser);
 	default:
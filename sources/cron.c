@@ -202,6 +202,32 @@ static inline void od_cron_keep_min_pool_sizes(od_cron_t *cron)
 	od_router_keep_min_pool_size_step(router);
 }
 
+static inline void od_cron_warmup(od_cron_t *cron)
+{
+	od_router_t *router = cron->global->router;
+	od_instance_t *instance = cron->global->instance;
+
+	int spawned = od_router_warmup_step(router);
+	if (spawned > 0) {
+		od_debug(&instance->logger, "warmup", NULL, NULL,
+			 "%d server connections requested ahead of demand",
+			 spawned);
+	}
+}
+
+static inline void od_cron_deploy_stmts(od_cron_t *cron)
+{
+	od_router_t *router = cron->global->router;
+	od_instance_t *instance = cron->global->instance;
+
+	int scheduled = od_router_deploy_stmts_step(router);
+	if (scheduled > 0) {
+		od_debug(&instance->logger, "deploy", NULL, NULL,
+			 "deploying hot prepared statements to %d servers",
+			 scheduled);
+	}
+}
+
 static void od_rules_gc(void)
 {
 	/* remove all obsolete rules that has no refs on it */
@@ -228,7 +254,7 @@ static void od_rules_gc(void)
 			continue;
 		}
 
-		if (rule->refs > 0) {
+		if (atomic_load(&rule->refs) > 0) {
 			continue;
 		}
 
@@ -268,9 +294,11 @@ static inline void od_cron_expire(od_cron_t *cron)
 		od_list_foreach_safe (&expire_list, i, n) {
 			od_server_t *server;
 			server = od_container_of(i, od_server_t, link);
+			uint64_t idle_us =
+				machine_time_us() - server->idle_since_us;
 			od_debug(&instance->logger, "expire", NULL, server,
 				 "closing idle server connection (%d secs)",
-				 server->idle_time);
+				 (int)(idle_us / 1000000));
 			server->route = NULL;
 			od_backend_close_connection(server);
 			od_backend_close(server);
@@ -335,6 +363,12 @@ static void od_cron(void *arg)
 		/* create server connections if pool size is less than min_pool_size */
 		od_cron_keep_min_pool_sizes(cron);
 
+		/* prespawn server connections for predicted demand */
+		od_cron_warmup(cron);
+
+		/* parse hot prepared statements on idle servers */
+		od_cron_deploy_stmts(cron);
+
 		/* update statistics */
 		if (++stats_tick >= instance->config.stats_interval) {
 			od_cron_stat(cron);
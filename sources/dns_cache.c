@@ -0,0 +1,390 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <netdb.h>
+
+#include <machinarium/machinarium.h>
+#include <machinarium/wait_list.h>
+
+#include <list.h>
+#include <od_memory.h>
+#include <util.h>
+#include <dns_cache.h>
+
+typedef struct od_dns_cache_entry od_dns_cache_entry_t;
+
+struct od_dns_cache_entry {
+	char *host;
+	int port;
+	int negative;
+	int refreshing;
+	int resolving;
+	uint64_t resolved_ms;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	od_list_t link;
+};
+
+static pthread_mutex_t od_dns_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static od_list_t od_dns_cache_list = { &od_dns_cache_list,
+				       &od_dns_cache_list };
+
+/* bumped each time a pending entry is done with, wakes up its waiters */
+static atomic_uint_fast64_t od_dns_cache_resolved;
+static mm_wait_list_t od_dns_cache_waiters = {
+	.sleepies = { &od_dns_cache_waiters.sleepies,
+		      &od_dns_cache_waiters.sleepies },
+	.word = &od_dns_cache_resolved,
+};
+
+static inline od_dns_cache_entry_t *od_dns_cache_find_locked(const char *host,
+							     int port)
+{
+	od_list_t *i;
+	od_list_foreach (&od_dns_cache_list, i) {
+		od_dns_cache_entry_t *entry;
+		entry = od_container_of(i, od_dns_cache_entry_t, link);
+		if (entry->port == port && strcmp(entry->host, host) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static inline od_dns_cache_entry_t *od_dns_cache_add_locked(const char *host,
+							    int port)
+{
+	od_dns_cache_entry_t *entry;
+	entry = od_malloc(sizeof(od_dns_cache_entry_t));
+	if (entry == NULL) {
+		return NULL;
+	}
+	memset(entry, 0, sizeof(od_dns_cache_entry_t));
+	entry->host = od_strdup(host);
+	if (entry->host == NULL) {
+		od_free(entry);
+		return NULL;
+	}
+	entry->port = port;
+	od_list_init(&entry->link);
+	od_list_append(&od_dns_cache_list, &entry->link);
+	return entry;
+}
+
+static inline void od_dns_cache_entry_free(od_dns_cache_entry_t *entry)
+{
+	od_free(entry->host);
+	od_free(entry);
+}
+
+static inline void od_dns_cache_notify(void)
+{
+	atomic_fetch_add(&od_dns_cache_resolved, 1);
+	mm_wait_list_notify_all(&od_dns_cache_waiters);
+}
+
+od_dns_cache_result_t od_dns_cache_lookup(const char *host, int port,
+					  uint64_t now_ms, uint64_t ttl_ms,
+					  uint64_t negative_ttl_ms,
+					  struct sockaddr_storage *addr,
+					  socklen_t *addrlen)
+{
+	od_dns_cache_result_t result = OD_DNS_CACHE_MISS;
+
+	pthread_mutex_lock(&od_dns_cache_lock);
+
+	od_dns_cache_entry_t *entry = od_dns_cache_find_locked(host, port);
+	if (entry == NULL) {
+		/* without the entry the caller still resolves the host */
+		entry = od_dns_cache_add_locked(host, port);
+		if (entry != NULL) {
+			entry->resolving = 1;
+		}
+		goto done;
+	}
+
+	if (entry->resolving) {
+		result = OD_DNS_CACHE_PENDING;
+		goto done;
+	}
+
+	uint64_t age_ms = now_ms - entry->resolved_ms;
+	if (now_ms < entry->resolved_ms) {
+		age_ms = 0;
+	}
+
+	if (entry->negative) {
+		if (age_ms < negative_ttl_ms) {
+			result = OD_DNS_CACHE_NEGATIVE;
+			goto done;
+		}
+		goto miss;
+	}
+
+	if (age_ms < ttl_ms) {
+		result = OD_DNS_CACHE_HIT;
+	} else if (age_ms < 2 * ttl_ms) {
+		result = OD_DNS_CACHE_STALE;
+		if (!entry->refreshing) {
+			entry->refreshing = 1;
+			result = OD_DNS_CACHE_REFRESH;
+		}
+	} else {
+		goto miss;
+	}
+
+	memcpy(addr, &entry->addr, entry->addrlen);
+	*addrlen = entry->addrlen;
+	goto done;
+
+miss:
+	entry->resolving = 1;
+done:
+	pthread_mutex_unlock(&od_dns_cache_lock);
+	return result;
+}
+
+int od_dns_cache_store(const char *host, int port, uint64_t now_ms,
+		       const struct sockaddr *addr, socklen_t addrlen)
+{
+	if (addr != NULL && addrlen > sizeof(struct sockaddr_storage)) {
+		return NOT_OK_RESPONSE;
+	}
+
+	pthread_mutex_lock(&od_dns_cache_lock);
+
+	od_dns_cache_entry_t *entry = od_dns_cache_find_locked(host, port);
+	if (entry == NULL) {
+		entry = od_dns_cache_add_locked(host, port);
+		if (entry == NULL) {
+			pthread_mutex_unlock(&od_dns_cache_lock);
+			return NOT_OK_RESPONSE;
+		}
+	}
+
+	int resolving = entry->resolving;
+	entry->resolving = 0;
+	entry->refreshing = 0;
+	entry->resolved_ms = now_ms;
+	entry->negative = addr == NULL;
+	entry->addrlen = 0;
+	if (addr != NULL) {
+		memcpy(&entry->addr, addr, addrlen);
+		entry->addrlen = addrlen;
+	}
+
+	pthread_mutex_unlock(&od_dns_cache_lock);
+
+	if (resolving) {
+		od_dns_cache_notify();
+	}
+	return OK_RESPONSE;
+}
+
+void od_dns_cache_refresh_failed(const char *host, int port)
+{
+	pthread_mutex_lock(&od_dns_cache_lock);
+	od_dns_cache_entry_t *entry = od_dns_cache_find_locked(host, port);
+	if (entry != NULL) {
+		entry->refreshing = 0;
+	}
+	pthread_mutex_unlock(&od_dns_cache_lock);
+}
+
+void od_dns_cache_resolve_failed(const char *host, int port)
+{
+	pthread_mutex_lock(&od_dns_cache_lock);
+	od_dns_cache_entry_t *entry = od_dns_cache_find_locked(host, port);
+	if (entry != NULL && entry->resolving) {
+		od_list_unlink(&entry->link);
+	} else {
+		entry = NULL;
+	}
+	pthread_mutex_unlock(&od_dns_cache_lock);
+
+	if (entry != NULL) {
+		od_dns_cache_entry_free(entry);
+		od_dns_cache_notify();
+	}
+}
+
+void od_dns_cache_invalidate(const char *host, int port)
+{
+	pthread_mutex_lock(&od_dns_cache_lock);
+	od_dns_cache_entry_t *entry = od_dns_cache_find_locked(host, port);
+	if (entry != NULL) {
+		od_list_unlink(&entry->link);
+	}
+	pthread_mutex_unlock(&od_dns_cache_lock);
+
+	if (entry != NULL) {
+		int resolving = entry->resolving;
+		od_dns_cache_entry_free(entry);
+		if (resolving) {
+			od_dns_cache_notify();
+		}
+	}
+}
+
+int od_dns_cache_flush(void)
+{
+	od_list_t entries;
+	od_list_init(&entries);
+
+	pthread_mutex_lock(&od_dns_cache_lock);
+	od_list_t *i, *n;
+	od_list_foreach_safe (&od_dns_cache_list, i, n) {
+		od_list_unlink(i);
+		od_list_append(&entries, i);
+	}
+	pthread_mutex_unlock(&od_dns_cache_lock);
+
+	int count = 0;
+	int resolving = 0;
+	od_list_foreach_safe (&entries, i, n) {
+		od_dns_cache_entry_t *entry;
+		entry = od_container_of(i, od_dns_cache_entry_t, link);
+		resolving |= entry->resolving;
+		od_dns_cache_entry_free(entry);
+		count++;
+	}
+
+	if (resolving) {
+		od_dns_cache_notify();
+	}
+	return count;
+}
+
+static inline int od_dns_cache_getaddrinfo(char *host, int port,
+					   struct sockaddr_storage *addr,
+					   socklen_t *addrlen)
+{
+	char rport[16];
+	od_snprintf(rport, sizeof(rport), "%d", port);
+
+	struct addrinfo *ai = NULL;
+	int rc = machine_getaddrinfo(host, rport, NULL, &ai, 0);
+	if (rc != 0) {
+		return NOT_OK_RESPONSE;
+	}
+	assert(ai != NULL);
+
+	rc = NOT_OK_RESPONSE;
+	if (ai->ai_addrlen <= sizeof(struct sockaddr_storage)) {
+		memcpy(addr, ai->ai_addr, ai->ai_addrlen);
+		*addrlen = ai->ai_addrlen;
+		rc = OK_RESPONSE;
+	}
+	freeaddrinfo(ai);
+	return rc;
+}
+
+typedef struct {
+	char *host;
+	int port;
+} od_dns_cache_refresh_arg_t;
+
+static void od_dns_cache_refresh(void *arg)
+{
+	od_dns_cache_refresh_arg_t *refresh = arg;
+
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	if (od_dns_cache_getaddrinfo(refresh->host, refresh->port, &addr,
+				     &addrlen) == OK_RESPONSE) {
+		od_dns_cache_store(refresh->host, refresh->port,
+				   machine_time_ms(), (struct sockaddr *)&addr,
+				   addrlen);
+	} else {
+		/* keep the stale address until it is resolved on connect */
+		od_dns_cache_refresh_failed(refresh->host, refresh->port);
+	}
+
+	od_free(refresh->host);
+	od_free(refresh);
+}
+
+static inline void od_dns_cache_refresh_start(char *host, int port)
+{
+	od_dns_cache_refresh_arg_t *refresh;
+	refresh = od_malloc(sizeof(od_dns_cache_refresh_arg_t));
+	if (refresh == NULL) {
+		goto error;
+	}
+	refresh->port = port;
+	refresh->host = od_strdup(host);
+	if (refresh->host == NULL) {
+		od_free(refresh);
+		goto error;
+	}
+
+	int64_t coroutine_id;
+	coroutine_id = machine_coroutine_create(od_dns_cache_refresh, refresh);
+	if (coroutine_id == INVALID_COROUTINE_ID) {
+		od_free(refresh->host);
+		od_free(refresh);
+		goto error;
+	}
+	return;
+
+error:
+	od_dns_cache_refresh_failed(host, port);
+}
+
+int od_dns_cache_resolve(char *host, int port, uint64_t ttl_ms,
+			 uint64_t negative_ttl_ms,
+			 struct sockaddr_storage *addr, socklen_t *addrlen)
+{
+	if (ttl_ms == 0 && negative_ttl_ms == 0) {
+		return od_dns_cache_getaddrinfo(host, port, addr, addrlen);
+	}
+
+	for (;;) {
+		/* read before the lookup, so the wake up is not missed */
+		uint64_t resolved = atomic_load(&od_dns_cache_resolved);
+
+		od_dns_cache_result_t result;
+		result = od_dns_cache_lookup(host, port, machine_time_ms(),
+					     ttl_ms, negative_ttl_ms, addr,
+					     addrlen);
+		switch (result) {
+		case OD_DNS_CACHE_HIT:
+		case OD_DNS_CACHE_STALE:
+			return OK_RESPONSE;
+		case OD_DNS_CACHE_REFRESH:
+			od_dns_cache_refresh_start(host, port);
+			return OK_RESPONSE;
+		case OD_DNS_CACHE_NEGATIVE:
+			return NOT_OK_RESPONSE;
+		case OD_DNS_CACHE_PENDING:
+			/* woken up by any finished resolve, look again */
+			mm_wait_list_compare_wait(&od_dns_cache_waiters,
+						  resolved, UINT32_MAX);
+			continue;
+		case OD_DNS_CACHE_MISS:
+			break;
+		}
+		break;
+	}
+
+	/* the pending entry has to be stored or dropped for the waiters */
+	int rc = od_dns_cache_getaddrinfo(host, port, addr, addrlen);
+	int stored = NOT_OK_RESPONSE;
+	if (rc == OK_RESPONSE) {
+		/* zero ttl makes the stored address expired at once */
+		stored = od_dns_cache_store(host, port, machine_time_ms(),
+					    (struct sockaddr *)addr, *addrlen);
+	} else if (negative_ttl_ms > 0) {
+		stored = od_dns_cache_store(host, port, machine_time_ms(), NULL,
+					    0);
+	}
+	if (stored != OK_RESPONSE) {
+		od_dns_cache_resolve_failed(host, port);
+	}
+	return rc;
+}
@@ -26,6 +26,7 @@
 #include <cancel.h>
 #include <auth.h>
 #include <reset.h>
+#include <session_state.h>
 #include <hba.h>
 #include <dns.h>
 #include <backend.h>
@@ -256,14 +257,15 @@ static inline int candidate_cmp_desc(const void *v1, const void *v2)
 }
 
 static inline int od_frontend_attach_candidate_get_priority(
-	od_instance_t *instance, od_rule_storage_t *storage,
-	od_endpoint_attach_candidate_t *candidate,
-	od_target_session_attrs_t tsa, int prefer_localhost)
+	od_rule_storage_t *storage, od_endpoint_attach_candidate_t *candidate,
+	od_target_session_attrs_t tsa, const char *availability_zone,
+	int prefer_localhost)
 {
 	/*
 	 * priority of endpoints is determined by (from highest to lowest):
 	 * - prefer_localhost: for serice accounts connections
-	 * - az: we should use same az as of odyssey instance if it is possible
+	 * - az: we should use same az as of odyssey instance (or of the
+	 *   attach hint) if it is possible
 	 * - tsa match: even if it is outdated, rw state of endpoint doesn't change frequently
 	 * - random number: to select host randomly between several suitable hosts
 	 * 
@@ -285,7 +287,8 @@ static inline int od_frontend_attach_candidate_get_priority(
 
 	od_storage_endpoint_status_t status;
 	od_storage_endpoint_status_init(&status);
-	od_storage_endpoint_status_get(&endpoint->status, &status);
+	od_storage_endpoint_status_get(od_storage_endpoint_status_of(endpoint),
+				       &status);
 
 	int status_is_recent = !od_storage_endpoint_status_is_outdated(
 		&status, storage->endpoints_status_poll_interval_ms);
@@ -303,7 +306,7 @@ static inline int od_frontend_attach_candidate_get_priority(
 		priority += 200;
 	}
 
-	if (strcmp(instance->config.availability_zone,
+	if (strcmp(availability_zone,
 		   candidate->endpoint->address.availability_zone) == 0) {
 		priority += 500;
 	}
@@ -315,31 +318,99 @@ static inline int od_frontend_attach_candidate_get_priority(
 	return priority;
 }
 
-void od_frontend_attach_init_candidates(
+/*
+ * power of two choices: among endpoints of the best priority class,
+ * the faster of two random ones is tried first
+ */
+static inline void
+od_frontend_attach_candidates_p2c(od_endpoint_attach_candidate_t *candidates,
+				  size_t count)
+{
+	if (candidates[0].priority < 0) {
+		return;
+	}
+
+	/* classes differ by at least 200, shuffle coeff is below 100 */
+	int class = candidates[0].priority / 100;
+	size_t group = 1;
+	while (group < count && candidates[group].priority / 100 == class) {
+		group++;
+	}
+	if (group == 1) {
+		return;
+	}
+
+	size_t a = machine_lrand48() % group;
+	size_t b = machine_lrand48() % (group - 1);
+	if (b >= a) {
+		b++;
+	}
+
+	od_storage_endpoint_stats_t *sa = candidates[a].endpoint->stats;
+	od_storage_endpoint_stats_t *sb = candidates[b].endpoint->stats;
+	size_t best = a;
+	if (sa != NULL && sb != NULL &&
+	    od_storage_endpoint_stats_score(sb) <
+		    od_storage_endpoint_stats_score(sa)) {
+		best = b;
+	}
+
+	od_endpoint_attach_candidate_t tmp = candidates[0];
+	candidates[0] = candidates[best];
+	candidates[best] = tmp;
+}
+
+size_t od_frontend_attach_init_candidates(
 	od_instance_t *instance, od_rule_storage_t *storage,
 	od_endpoint_attach_candidate_t *candidates,
-	od_target_session_attrs_t tsa, int prefer_localhost)
+	od_target_session_attrs_t tsa, const char *availability_zone,
+	int shard, int prefer_localhost)
 {
-	size_t count = storage->endpoints_count;
+	size_t count = 0;
 
-	for (size_t i = 0; i < count; ++i) {
-		candidates[i].endpoint = &storage->endpoints[i];
-		candidates[i].priority = 0;
+	if (availability_zone == NULL) {
+		availability_zone = instance->config.availability_zone;
 	}
 
-	if (count == 1) {
-		return;
+	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+		od_storage_endpoint_t *endpoint = &storage->endpoints[i];
+		if (shard >= 0 && endpoint->shard != shard) {
+			continue;
+		}
+		candidates[count].endpoint = endpoint;
+		candidates[count].priority = 0;
+		count++;
+	}
+
+	if (count <= 1) {
+		return count;
 	}
 
 	for (size_t i = 0; i < count; ++i) {
 		candidates[i].priority =
 			od_frontend_attach_candidate_get_priority(
-				instance, storage, &candidates[i], tsa,
+				storage, &candidates[i], tsa, availability_zone,
 				prefer_localhost);
 	}
 
 	qsort(candidates, count, sizeof(od_endpoint_attach_candidate_t),
 	      candidate_cmp_desc);
+
+	if (storage->load_balance == OD_STORAGE_LOAD_BALANCE_LATENCY) {
+		od_frontend_attach_candidates_p2c(candidates, count);
+	}
+
+	return count;
+}
+
+static inline void
+od_frontend_endpoint_stats_connect(od_storage_endpoint_t *endpoint,
+				   uint64_t time_us, int failed)
+{
+	if (endpoint->stats != NULL) {
+		od_storage_endpoint_stats_connect(endpoint->stats, time_us,
+						  failed);
+	}
 }
 
 static inline od_frontend_status_t od_frontend_attach_to_endpoint(
@@ -382,9 +453,13 @@ static inline od_frontend_status_t od_frontend_attach_to_endpoint(
 		assert(server->relay.iov == 0 ||
 		       !machine_iov_pending(server->relay.iov));
 
+		server->endpoint_stats = endpoint->stats;
+
 		/* connect to server, if necessary */
+		uint64_t connect_start_us = 0;
 		if (od_backend_not_connected(server)) {
 			int rc;
+			connect_start_us = machine_time_us();
 			od_atomic_u32_inc(&router->servers_routing);
 
 			assert(client->config_listen != NULL);
@@ -411,7 +486,10 @@ static inline od_frontend_status_t od_frontend_attach_to_endpoint(
 				}
 
 				od_storage_endpoint_status_set_dead(
-					&endpoint->status);
+					od_storage_endpoint_status_of(
+						endpoint));
+				od_frontend_endpoint_stats_connect(endpoint, 0,
+								   1);
 				return OD_ESERVER_CONNECT;
 			}
 		}
@@ -419,9 +497,16 @@ static inline od_frontend_status_t od_frontend_attach_to_endpoint(
 		int rc = od_backend_startup_preallocated(server, route_params,
 							 client);
 		if (rc != OK_RESPONSE) {
-			od_storage_endpoint_status_set_dead(&endpoint->status);
+			od_storage_endpoint_status_set_dead(
+				od_storage_endpoint_status_of(endpoint));
+			od_frontend_endpoint_stats_connect(endpoint, 0, 1);
 			return OD_ESERVER_CONNECT;
 		}
+		if (connect_start_us != 0) {
+			od_frontend_endpoint_stats_connect(
+				endpoint, machine_time_us() - connect_start_us,
+				0);
+		}
 
 		if (od_backend_check_tsa(endpoint, context, server, client,
 					 tsa) != OK_RESPONSE) {
@@ -443,6 +528,31 @@ static inline od_frontend_status_t od_frontend_attach_to_endpoint(
 	}
 }
 
+/* shard key of the transaction hint is preferred over the session one */
+static inline int od_frontend_attach_shard(od_client_t *client,
+					   od_rule_storage_t *storage)
+{
+	if (client->attach_hint.shard_key_len > 0) {
+		return od_rules_storage_shard_of(
+			storage, client->attach_hint.shard_key,
+			client->attach_hint.shard_key_len);
+	}
+
+	kiwi_var_t *var;
+	var = kiwi_vars_get(&client->vars, KIWI_VAR_ODYSSEY_SHARD_KEY);
+	if (var == NULL) {
+		return -1;
+	}
+	int len = var->value_len;
+	while (len > 0 && var->value[len - 1] == 0) {
+		len--;
+	}
+	if (len == 0) {
+		return -1;
+	}
+	return od_rules_storage_shard_of(storage, var->value, len);
+}
+
 static inline od_frontend_status_t
 od_frontend_attach(od_client_t *client, char *context,
 		   kiwi_params_t *route_params)
@@ -453,13 +563,28 @@ od_frontend_attach(od_client_t *client, char *context,
 
 	od_target_session_attrs_t tsa = od_tsa_get_effective(client);
 
+	/* az of the transaction hint is preferred over the instance one */
+	const char *availability_zone = NULL;
+	if (client->attach_hint.az[0] != 0) {
+		availability_zone = client->attach_hint.az;
+	}
+
+	int shard = -1;
+	if (storage->shards_count > 0) {
+		shard = od_frontend_attach_shard(client, storage);
+		if (shard == -1) {
+			return OD_EATTACH_SHARD_KEY;
+		}
+	}
+
 	od_endpoint_attach_candidate_t candidates[OD_STORAGE_MAX_ENDPOINTS];
-	od_frontend_attach_init_candidates(instance, storage, candidates, tsa,
-					   0 /* prefer localhost */);
+	size_t count = od_frontend_attach_init_candidates(
+		instance, storage, candidates, tsa, availability_zone, shard,
+		0 /* prefer localhost */);
 
 	od_frontend_status_t status = OD_EATTACH;
 
-	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+	for (size_t i = 0; i < count; ++i) {
 		od_storage_endpoint_t *endpoint = candidates[i].endpoint;
 
 		char addr[256];
@@ -1122,6 +1247,18 @@ static inline int od_frontend_handle_server_command_complete(
 	return OD_OK;
 }
 
+static inline void od_frontend_track_command_complete(od_server_t *server,
+						      const char *data)
+{
+	const char *command_tag = data + sizeof(kiwi_header_t);
+	int state = od_session_state_from_tag(command_tag);
+	if (state == -1) {
+		server->session_state = 0;
+	} else {
+		server->session_state |= state;
+	}
+}
+
 od_frontend_status_t
 od_frontend_remote_server_handle_packet(od_relay_t *relay, char *data, int size)
 {
@@ -1159,8 +1296,14 @@ od_frontend_remote_server_handle_packet(od_relay_t *relay, char *data, int size)
 		if (rc == -1) {
 			return od_relay_get_read_error(relay);
 		}
+		if (route->rule->pool->reset_tracking) {
+			server->session_state |= OD_SESSION_STATE_SET;
+		}
 		break;
 	case KIWI_BE_COMMAND_COMPLETE:
+		if (route->rule->pool->reset_tracking) {
+			od_frontend_track_command_complete(server, data);
+		}
 		/* pin on listen option is 1 only for non-session pooling */
 		if (route->rule->pool->pin_on_listen) {
 			retstatus = od_frontend_handle_server_command_complete(
@@ -1195,6 +1338,10 @@ od_frontend_remote_server_handle_packet(od_relay_t *relay, char *data, int size)
 			server->deploy_sync--;
 		}
 
+		if (od_server_synchronized(server)) {
+			od_parse_queue_clear(&server->parse_queue);
+		}
+
 		if (!server->synced_settings) {
 			server->synced_settings = true;
 			break;
@@ -1208,13 +1355,20 @@ od_frontend_remote_server_handle_packet(od_relay_t *relay, char *data, int size)
 				 server, "query time: %" PRIi64 " microseconds",
 				 query_time);
 		}
+		if (server->endpoint_stats != NULL && query_time > 0) {
+			od_storage_endpoint_stats_query(server->endpoint_stats,
+							query_time);
+		}
 
 		break;
 	}
 	case KIWI_BE_PARSE_COMPLETE:
 		if (route->rule->pool->reserve_prepared_statement) {
-			/* skip msg */
-			retstatus = OD_SKIP;
+			/* forward only replies to Parse of the client */
+			if (od_parse_queue_pop(&server->parse_queue,
+					       server->sync_reply) != 1) {
+				retstatus = OD_SKIP;
+			}
 		}
 	default:
 		break;
@@ -1235,7 +1389,7 @@ od_frontend_remote_server_handle_packet(od_relay_t *relay, char *data, int size)
 		}
 	} else {
 		if (is_ready_for_query && od_server_synchronized(server) &&
-		    !server->client_pinned && server->parse_msg == NULL) {
+		    !server->client_pinned) {
 			if (od_frontend_should_detach_on_ready_for_query(
 				    route, server)) {
 				return OD_DETACH;
@@ -1381,31 +1535,49 @@ od_frontend_rewrite_msg(char *data, int size, int opname_start_offset,
 	return msg;
 }
 
-static od_frontend_status_t od_frontend_deploy_prepared_stmt(
-	od_server_t *server, __attribute__((unused)) od_relay_t *relay,
-	char *ctx, char *data, int size /* to adcance or to write? */,
-	od_hash_t body_hash, char *opname, int opnamelen)
+/*
+ * queues Parse of the statement to the server if it has not seen it yet,
+ * its ParseComplete is forwarded to the client only for client's Parse
+ *
+ * Parse of the client always gets exactly one Parse to the server, so
+ * replies keep their order without waiting for a sync point: if the
+ * statement is already deployed, an empty unnamed statement is parsed
+ * instead, which is cheap and skipped after an error like the original.
+ */
+static od_frontend_status_t
+od_frontend_deploy_prepared_stmt(od_server_t *server, od_relay_t *relay,
+				 char *ctx, od_prep_stmt_body_t *body,
+				 char *opname, int opnamelen, int client_parse)
 {
 	od_route_t *route = server->route;
 	od_instance_t *instance = server->global->instance;
 	od_client_t *client = server->client;
 
 	od_hashmap_elt_t desc;
-	desc.data = data;
-	desc.len = size;
+	desc.data = body->data;
+	desc.len = body->len;
 
 	od_debug(&instance->logger, ctx, client, server,
-		 "statement: %.*s, hash: %08x", desc.len, desc.data, body_hash);
+		 "statement: %.*s, hash: %08x", desc.len, desc.data,
+		 body->hash);
+
+	int rc = od_server_prep_stmts_use(server->prep_stmts, body);
+	if (rc == -1) {
+		return OD_ESERVER_WRITE;
+	}
 
-	int refcnt = 0;
-	od_hashmap_elt_t value;
-	value.data = &refcnt;
-	value.len = sizeof(int);
-	od_hashmap_elt_t *value_ptr = &value;
+	if (route->rule->pool->prepared_statements_deploy > 0) {
+		/* hits are sampled to keep the hot set lock cold */
+		if (rc == 0) {
+			od_hot_stmts_record(&route->hot_stmts, body, 1);
+		} else if (machine_lrand48() % OD_HOT_STMTS_HIT_SAMPLE == 0) {
+			od_hot_stmts_record(&route->hot_stmts, body,
+					    OD_HOT_STMTS_HIT_SAMPLE);
+		}
+	}
 
-	/* send parse msg if needed */
-	if (od_hashmap_insert(server->prep_stmts, body_hash, &desc,
-			      &value_ptr) == 0) {
+	machine_msg_t *pmsg = NULL;
+	if (rc == 0) {
 		od_debug(&instance->logger, ctx, client, server,
 			 "deploy %.*s operator %.*s to server", desc.len,
 			 desc.data, opnamelen, opname);
@@ -1413,59 +1585,44 @@ static od_frontend_status_t od_frontend_deploy_prepared_stmt(
 		 * rewrite msg
 		 * allocate prepered statement under name equal to body hash
 		 */
-
-		od_stat_parse(&route->stats);
-
-		machine_msg_t *pmsg;
 		pmsg = kiwi_fe_write_parse_description(NULL, opname, opnamelen,
 						       desc.data, desc.len);
 		if (pmsg == NULL) {
 			return OD_ESERVER_WRITE;
 		}
-
-		if (instance->config.log_query || route->rule->log_query) {
-			od_frontend_log_parse(instance, client, "rewrite parse",
-					      machine_msg_data(pmsg),
-					      machine_msg_size(pmsg));
-		}
-
 		od_stat_parse(&route->stats);
-		/* msg deallocated here */
-		od_dbg_printf_on_dvl_lvl(1, "relay %p write msg %c\n", relay,
-					 *(char *)machine_msg_data(pmsg));
-
-		od_write(&server->io, pmsg);
-		/* advance? */
-		/* machine_iov_add(relay->iov, pmsg); */
-
-		return OD_OK;
 	} else {
-		int *refcnt;
-		refcnt = value_ptr->data;
-		*refcnt = 1 + *refcnt;
-
 		od_stat_parse_reuse(&route->stats);
-		return OD_OK;
+		if (!client_parse) {
+			return OD_OK;
+		}
+		/* empty query without parameter types */
+		pmsg = kiwi_fe_write_parse_description(NULL, "", 1, "\0\0\0",
+						       3);
+		if (pmsg == NULL) {
+			return OD_ESERVER_WRITE;
+		}
 	}
-}
 
-static inline od_frontend_status_t
-od_frontend_deploy_prepared_stmt_msg(od_server_t *server, od_relay_t *relay,
-				     char *ctx)
-{
-	od_frontend_status_t rc;
-	char *data = machine_msg_data(server->parse_msg);
-	int size = machine_msg_size(server->parse_msg);
-
-	od_hash_t body_hash = od_murmur_hash(data, size);
-	char opname[OD_HASH_LEN];
-	od_snprintf(opname, OD_HASH_LEN, "%08x", body_hash);
-	rc = od_frontend_deploy_prepared_stmt(server, relay, ctx, data, size,
-					      body_hash, opname, OD_HASH_LEN);
-
-	machine_msg_free(server->parse_msg);
-	server->parse_msg = NULL;
-	return rc;
+	if (instance->config.log_query || route->rule->log_query) {
+		od_frontend_log_parse(instance, client, "rewrite parse",
+				      machine_msg_data(pmsg),
+				      machine_msg_size(pmsg));
+	}
+
+	if (od_parse_queue_push(&server->parse_queue, server->sync_request,
+				client_parse) != OK_RESPONSE) {
+		machine_msg_free(pmsg);
+		return OD_ESERVER_WRITE;
+	}
+
+	/* queued before the message which refers to the statement */
+	od_dbg_printf_on_dvl_lvl(1, "relay %p advance msg %c\n", relay,
+				 *(char *)machine_msg_data(pmsg));
+	if (machine_iov_add(relay->iov, pmsg) == -1) {
+		return OD_ESERVER_WRITE;
+	}
+	return OD_OK;
 }
 
 static od_frontend_status_t od_process_virtual_set(od_client_t *client,
@@ -1494,7 +1651,8 @@ static od_frontend_status_t od_process_virtual_set(od_client_t *client,
 	case OD_PARSER_KEYWORD:
 		keyword = od_keyword_match(od_query_process_keywords, &token);
 		if (keyword == NULL ||
-		    keyword->id != OD_QUERY_PROCESSING_LTSA) {
+		    (keyword->id != OD_QUERY_PROCESSING_LTSA &&
+		     keyword->id != OD_QUERY_PROCESSING_LSHARD_KEY)) {
 			/* some other option, skip */
 			return OD_OK;
 		}
@@ -1510,15 +1668,28 @@ static od_frontend_status_t od_process_virtual_set(od_client_t *client,
 
 	rc = od_parser_next(parser, &token);
 
-	if (rc != OD_PARSER_STRING) {
+	char num[32];
+	if (rc == OD_PARSER_NUM &&
+	    keyword->id == OD_QUERY_PROCESSING_LSHARD_KEY) {
+		option_value = num;
+		option_value_len = od_snprintf(num, sizeof(num), "%" PRIi64,
+					       token.value.num);
+	} else if (rc == OD_PARSER_STRING) {
+		option_value = token.value.string.pointer;
+		option_value_len = token.value.string.size;
+	} else {
 		return OD_OK;
 	}
 
-	option_value = token.value.string.pointer;
-	option_value_len = token.value.string.size;
-
-	/* for now, very straightforward logic, as there is only one supported param */
-	if (strncasecmp(option_value, "read-only", option_value_len) == 0) {
+	if (keyword->id == OD_QUERY_PROCESSING_LSHARD_KEY) {
+		/* checked against shards on the next attach */
+		if (option_value_len >= KIWI_MAX_VAR_SIZE) {
+			return OD_OK;
+		}
+		kiwi_vars_set(&client->vars, KIWI_VAR_ODYSSEY_SHARD_KEY,
+			      option_value, option_value_len);
+	} else if (strncasecmp(option_value, "read-only", option_value_len) ==
+		   0) {
 		kiwi_vars_set(&client->vars,
 			      KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS,
 			      option_value, option_value_len);
@@ -1537,7 +1708,8 @@ static od_frontend_status_t od_process_virtual_set(od_client_t *client,
 	}
 
 	od_debug(&instance->logger, "virtual processing", client, server,
-		 "parsed tsa hint %.*s", option_value_len, option_value);
+		 "parsed %s hint %.*s", keyword->name, option_value_len,
+		 option_value);
 
 	/* skip this query */
 	server->sync_point_deploy_msg =
@@ -1765,7 +1937,6 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 	   configuration */
 	od_server_t *server = client->server;
 	assert(server != NULL);
-	assert(server->parse_msg == NULL);
 
 	/* XXX: reset query state on transaction block bound here.  */
 	switch (type) {
@@ -1801,14 +1972,16 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 			       query_len, query);
 		}
 
-		if (query_len >= 7 &&
-		    route->rule->pool->reserve_prepared_statement) {
-			if (strncmp(query, "DISCARD", 7) == 0) {
-				od_debug(&instance->logger, "simple query",
-					 client, server,
-					 "discard detected, invalidate caches");
-				od_hashmap_empty(server->prep_stmts);
-			}
+		if (route->rule->pool->reserve_prepared_statement &&
+		    od_server_prep_stmts_query_drops_all(query, query_len)) {
+			od_debug(&instance->logger, "simple query", client,
+				 server, "discard detected, invalidate caches");
+			od_server_prep_stmts_empty(server->prep_stmts);
+		}
+
+		if (route->rule->pool->reset_tracking) {
+			server->session_state |=
+				od_session_state_from_query(query, query_len);
 		}
 
 		retstatus = od_frontend_process_query(client, query, query_len);
@@ -1855,7 +2028,7 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 			key.data = operator_name;
 
 			od_hash_t keyhash = od_murmur_hash(key.data, key.len);
-			od_hashmap_elt_t *desc = od_hashmap_find(
+			od_hashmap_elt_t *desc = od_lhashmap_find(
 				client->prep_stmt_ids, keyhash, &key);
 
 			if (desc == NULL) {
@@ -1868,16 +2041,15 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 				return OD_ESERVER_WRITE;
 			}
 
-			od_hash_t body_hash =
-				od_murmur_hash(desc->data, desc->len);
+			od_prep_stmt_body_t *body =
+				*(od_prep_stmt_body_t **)desc->data;
 			char opname[OD_HASH_LEN];
-			od_snprintf(opname, OD_HASH_LEN, "%08x", body_hash);
+			od_snprintf(opname, OD_HASH_LEN, "%08x", body->hash);
 
 			/* fill internals structs in, send parse if needed */
 			if (od_frontend_deploy_prepared_stmt(
-				    server, &server->relay, "parse before bind",
-				    desc->data, desc->len, body_hash, opname,
-				    OD_HASH_LEN) != OD_OK) {
+				    server, relay, "parse before bind", body,
+				    opname, OD_HASH_LEN, 0) != OD_OK) {
 				return OD_ESERVER_WRITE;
 			}
 
@@ -1908,9 +2080,22 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 			od_frontend_log_parse(instance, client, "parse", data,
 					      size);
 		}
+		if (route->rule->pool->reset_tracking) {
+			char *name;
+			uint32_t name_len;
+			rc = kiwi_be_read_parse(data, size, &name, &name_len,
+						&query, &query_len);
+			if (rc == -1) {
+				return OD_ECLIENT_READ;
+			}
+			server->session_state |=
+				od_session_state_from_query(query, query_len);
+			server->session_state |=
+				od_session_state_from_name(name_len);
+		}
 		if (route->rule->pool->reserve_prepared_statement) {
 			/* skip client parse msg */
-			retstatus = OD_REQ_SYNC;
+			retstatus = OD_SKIP;
 			kiwi_prepared_statement_t desc;
 			int rc;
 			rc = kiwi_be_read_parse_dest(data, size, &desc);
@@ -1929,37 +2114,46 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 			key.len = desc.operator_name_len;
 			key.data = desc.operator_name;
 
-			od_hashmap_elt_t value;
-			value.len = desc.description_len;
-			value.data = desc.description;
-
-			od_hashmap_elt_t *value_ptr = &value;
-
-			server->parse_msg =
-				machine_msg_create(desc.description_len);
-			if (server->parse_msg == NULL) {
+			/* the only place where the body hash is computed */
+			od_prep_stmt_body_t *body;
+			body = od_prep_stmt_registry_intern(
+				client->global->prep_stmt_bodies,
+				od_murmur_hash(desc.description,
+					       desc.description_len),
+				desc.description, desc.description_len);
+			if (body == NULL) {
 				return OD_ESERVER_WRITE;
 			}
-			memcpy(machine_msg_data(server->parse_msg),
-			       desc.description, desc.description_len);
 
+			/* client map keeps the interned reference */
 			assert(client->prep_stmt_ids);
-			if (od_hashmap_insert(client->prep_stmt_ids, keyhash,
-					      &key, &value_ptr)) {
-				if (value_ptr->len != desc.description_len ||
-				    strncmp(desc.description, value_ptr->data,
-					    value_ptr->len) != 0) {
-					/*
-					* Raise error:
-					* client allocated prepared stmt with same name
-					*/
+			od_hashmap_elt_t *value_ptr = od_lhashmap_find(
+				client->prep_stmt_ids, keyhash, &key);
+			if (value_ptr != NULL) {
+				od_prep_stmt_body_t **prev = value_ptr->data;
+				/* unnamed or redefined statement */
+				od_prep_stmt_body_unref(*prev);
+				*prev = body;
+			} else {
+				od_hashmap_elt_t value;
+				value.len = sizeof(od_prep_stmt_body_t *);
+				value.data = &body;
+				value_ptr = &value;
+				if (od_lhashmap_insert(client->prep_stmt_ids,
+						       keyhash, &key,
+						       &value_ptr) == -1) {
+					od_prep_stmt_body_unref(body);
 					return OD_ESERVER_WRITE;
 				}
 			}
 
-			server->sync_point_deploy_msg =
-				kiwi_be_write_parse_complete(NULL);
-			if (server->sync_point_deploy_msg == NULL) {
+			char opname[OD_HASH_LEN];
+			od_snprintf(opname, OD_HASH_LEN, "%08x", body->hash);
+
+			/* its ParseComplete is forwarded to the client */
+			if (od_frontend_deploy_prepared_stmt(
+				    server, relay, "parse", body, opname,
+				    OD_HASH_LEN, 1) != OD_OK) {
 				return OD_ESERVER_WRITE;
 			}
 		}
@@ -1989,9 +2183,8 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 
 			od_hash_t keyhash = od_murmur_hash(key.data, key.len);
 
-			od_hashmap_elt_t *desc =
-				(od_hashmap_elt_t *)od_hashmap_find(
-					client->prep_stmt_ids, keyhash, &key);
+			od_hashmap_elt_t *desc = od_lhashmap_find(
+				client->prep_stmt_ids, keyhash, &key);
 			if (desc == NULL) {
 				char errbuf[OD_QRY_MAX_SZ];
 				int errlen;
@@ -2019,29 +2212,26 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 				return OD_REQ_SYNC;
 			}
 
-			od_hash_t body_hash =
-				od_murmur_hash(desc->data, desc->len);
+			od_prep_stmt_body_t *body =
+				*(od_prep_stmt_body_t **)desc->data;
 
 			int invalidate = 0;
 
-			if (desc->len >= 7) {
-				if (strncmp(desc->data, "DISCARD", 7) == 0) {
-					od_debug(
-						&instance->logger,
-						"rewrite bind", client, server,
-						"discard detected, invalidate caches");
-					invalidate = 1;
-				}
+			if (od_server_prep_stmts_query_drops_all(body->data,
+								 body->len)) {
+				od_debug(&instance->logger, "rewrite bind",
+					 client, server,
+					 "discard detected, invalidate caches");
+				invalidate = 1;
 			}
 
 			char opname[OD_HASH_LEN];
-			od_snprintf(opname, OD_HASH_LEN, "%08x", body_hash);
+			od_snprintf(opname, OD_HASH_LEN, "%08x", body->hash);
 
 			/* fill internals structs in, send parse if needed */
 			if (od_frontend_deploy_prepared_stmt(
-				    server, &server->relay, "parse before bind",
-				    desc->data, desc->len, body_hash, opname,
-				    OD_HASH_LEN) != OD_OK) {
+				    server, relay, "parse before bind", body,
+				    opname, OD_HASH_LEN, 0) != OD_OK) {
 				return OD_ESERVER_WRITE;
 			}
 
@@ -2053,7 +2243,7 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 
 			machine_msg_t *msg;
 			if (invalidate) {
-				od_hashmap_empty(server->prep_stmts);
+				od_server_prep_stmts_empty(server->prep_stmts);
 			}
 
 			msg = od_frontend_rewrite_msg(data, size,
@@ -2090,6 +2280,20 @@ od_frontend_remote_client_handle_packet(od_relay_t *relay, char *data, int size)
 		}
 		break;
 	case KIWI_FE_CLOSE:
+		if (route->rule->pool->reset_tracking) {
+			char *name;
+			uint32_t name_len;
+			kiwi_fe_close_type_t type;
+
+			if (od_frontend_parse_close(data, size, &name,
+						    &name_len,
+						    &type) != OK_RESPONSE) {
+				return OD_ESERVER_WRITE;
+			}
+
+			server->session_state |=
+				od_session_state_from_name(name_len);
+		}
 		if (route->rule->pool->reserve_prepared_statement) {
 			char *name;
 			uint32_t name_len;
@@ -2513,32 +2717,6 @@ static od_frontend_status_t od_frontend_remote(od_client_t *client)
 				break;
 			}
 
-			/* If we have pending parse message, do deploy */
-			if (server->parse_msg != NULL) {
-				/* fill internals structs in */
-				if (od_frontend_deploy_prepared_stmt_msg(
-					    server, &server->relay,
-					    "sync-point-deploy") != OD_OK) {
-					status = OD_ESERVER_WRITE;
-					break;
-				}
-
-				machine_msg_t *msg;
-				msg = kiwi_fe_write_sync(NULL);
-				if (msg == NULL) {
-					status = OD_ESERVER_WRITE;
-					break;
-				}
-				int rc;
-				rc = od_write(&server->io, msg);
-				if (rc == -1) {
-					status = OD_ESERVER_WRITE;
-					break;
-				}
-
-				od_server_sync_request(server, 1);
-			}
-
 			/* enter sync point mode */
 			server->sync_point = 1;
 
@@ -2702,6 +2880,15 @@ static void od_frontend_cleanup(od_client_t *client, char *context,
 			client->startup.user.value);
 		break;
 
+	case OD_EATTACH_SHARD_KEY:
+		assert(server == NULL);
+		assert(client->route != NULL);
+		od_frontend_fatal(client, KIWI_CONNECTION_FAILURE,
+				  "shard key is not set or matches no shard of "
+				  "storage '%s'",
+				  client->rule->storage->name);
+		break;
+
 	case OD_EGRACEFUL_SHUTDOWN:
 		if (od_global_get_instance()->pid.restart_new_pid != -1) {
 			od_frontend_fatal_detailed(
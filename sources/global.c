@@ -31,6 +31,12 @@ int od_global_init(od_global_t *global, od_instance_t *instance,
 		return 1;
 	}
 
+	global->prep_stmt_bodies = od_prep_stmt_registry_create();
+	if (global->prep_stmt_bodies == NULL) {
+		mm_wait_list_free(global->resume_waiters);
+		return 1;
+	}
+
 	memset(&global->soft_oom, 0, sizeof(global->soft_oom));
 
 	memset(&global->host_watcher, 0, sizeof(global->host_watcher));
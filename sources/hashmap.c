@@ -204,6 +204,30 @@ int od_hashmap_insert(od_hashmap_t *hm, od_hash_t keyhash,
 	return ret;
 }
 
+od_retcode_t od_hashmap_remove(od_hashmap_t *hm, od_hash_t keyhash,
+			       od_hashmap_elt_t *key)
+{
+	size_t bucket_index = keyhash % hm->size;
+	od_hashmap_bucket_t *bucket = &hm->buckets[bucket_index];
+	mm_mutex_lock(&bucket->mu, UINT32_MAX);
+
+	od_hashmap_elt_t *ptr = od_bucket_search(bucket, key->data, key->len);
+	if (ptr == NULL) {
+		mm_mutex_unlock(&bucket->mu);
+		return NOT_OK_RESPONSE;
+	}
+
+	od_hashmap_list_item_t *it;
+	it = od_container_of(ptr, od_hashmap_list_item_t, value);
+	if (hm->dtor != NULL) {
+		hm->dtor(it);
+	}
+	od_hashmap_list_item_free(it);
+
+	mm_mutex_unlock(&bucket->mu);
+	return OK_RESPONSE;
+}
+
 od_hashmap_elt_t *od_hashmap_find(od_hashmap_t *hm, od_hash_t keyhash,
 				  od_hashmap_elt_t *key)
 {
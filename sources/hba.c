@@ -104,6 +104,16 @@ int od_hba_process(od_client_t *client)
 	rules = &hba->rules;
 	od_hba_unlock(hba);
 
+	od_list_foreach (rules, i) {
+		rule = od_container_of(i, od_hba_rule_t, link);
+		if (rule->address_range.is_hostname) {
+			od_client_hostname_resolve(
+				client, &sa,
+				instance->config.hostname_cache_ttl_ms);
+			break;
+		}
+	}
+
 	od_list_foreach (rules, i) {
 		rule = od_container_of(i, od_hba_rule_t, link);
 		if (sa.ss_family == AF_UNIX) {
@@ -120,7 +130,8 @@ int od_hba_process(od_client_t *client)
 			continue;
 		} else if (sa.ss_family == AF_INET ||
 			   sa.ss_family == AF_INET6) {
-			if (!od_address_validate(&rule->address_range, &sa)) {
+			if (!od_address_validate(&rule->address_range, &sa,
+						 client->hostname)) {
 				continue;
 			}
 		}
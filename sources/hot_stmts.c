@@ -0,0 +1,126 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <hot_stmts.h>
+
+void od_hot_stmts_init(od_hot_stmts_t *hot)
+{
+	pthread_mutex_init(&hot->lock, NULL);
+	memset(hot->slots, 0, sizeof(hot->slots));
+	hot->count = 0;
+	hot->ticks = 0;
+}
+
+void od_hot_stmts_free(od_hot_stmts_t *hot)
+{
+	for (int i = 0; i < hot->count; i++) {
+		od_prep_stmt_body_unref(hot->slots[i].body);
+	}
+	hot->count = 0;
+	pthread_mutex_destroy(&hot->lock);
+}
+
+void od_hot_stmts_record(od_hot_stmts_t *hot, od_prep_stmt_body_t *body,
+			 uint64_t uses)
+{
+	od_prep_stmt_body_t *evicted = NULL;
+
+	pthread_mutex_lock(&hot->lock);
+
+	int min = -1;
+	for (int i = 0; i < hot->count; i++) {
+		od_hot_stmt_t *slot = &hot->slots[i];
+		if (slot->body == body) {
+			slot->uses += uses;
+			pthread_mutex_unlock(&hot->lock);
+			return;
+		}
+		if (min == -1 || slot->uses < hot->slots[min].uses) {
+			min = i;
+		}
+	}
+
+	od_hot_stmt_t *slot;
+	if (hot->count < OD_HOT_STMTS_SLOTS) {
+		slot = &hot->slots[hot->count++];
+		slot->uses = uses;
+	} else {
+		slot = &hot->slots[min];
+		evicted = slot->body;
+		slot->uses += uses;
+	}
+	slot->body = od_prep_stmt_body_ref(body);
+
+	pthread_mutex_unlock(&hot->lock);
+
+	if (evicted != NULL) {
+		od_prep_stmt_body_unref(evicted);
+	}
+}
+
+void od_hot_stmts_tick(od_hot_stmts_t *hot)
+{
+	pthread_mutex_lock(&hot->lock);
+	if (++hot->ticks < OD_HOT_STMTS_DECAY_TICKS) {
+		pthread_mutex_unlock(&hot->lock);
+		return;
+	}
+	hot->ticks = 0;
+
+	od_prep_stmt_body_t *unused[OD_HOT_STMTS_SLOTS];
+	int unused_count = 0;
+	int count = 0;
+	for (int i = 0; i < hot->count; i++) {
+		od_hot_stmt_t *slot = &hot->slots[i];
+		slot->uses /= 2;
+		if (slot->uses == 0) {
+			unused[unused_count++] = slot->body;
+			continue;
+		}
+		hot->slots[count++] = *slot;
+	}
+	hot->count = count;
+	pthread_mutex_unlock(&hot->lock);
+
+	for (int i = 0; i < unused_count; i++) {
+		od_prep_stmt_body_unref(unused[i]);
+	}
+}
+
+int od_hot_stmts_top(od_hot_stmts_t *hot, od_prep_stmt_body_t **bodies,
+		     int max)
+{
+	od_hot_stmt_t top[OD_HOT_STMTS_SLOTS];
+	int count = 0;
+	if (max > OD_HOT_STMTS_SLOTS) {
+		max = OD_HOT_STMTS_SLOTS;
+	}
+
+	pthread_mutex_lock(&hot->lock);
+	for (int i = 0; i < hot->count; i++) {
+		/* insertion sort by uses, descending */
+		int pos = count < max ? count++ : max;
+		while (pos > 0 && top[pos - 1].uses < hot->slots[i].uses) {
+			if (pos < max) {
+				top[pos] = top[pos - 1];
+			}
+			pos--;
+		}
+		if (pos < max) {
+			top[pos] = hot->slots[i];
+		}
+	}
+	for (int i = 0; i < count; i++) {
+		bodies[i] = od_prep_stmt_body_ref(top[i].body);
+	}
+	pthread_mutex_unlock(&hot->lock);
+
+	return count;
+}
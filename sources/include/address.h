@@ -67,6 +67,17 @@ bool od_address_equals(struct sockaddr *, struct sockaddr *);
 bool od_address_range_equals(const od_address_range_t *,
 			     const od_address_range_t *);
 
-bool od_address_validate(const od_address_range_t *, struct sockaddr_storage *);
+#define OD_ADDRESS_HOSTNAME_CACHE_SLOTS 1024
+
+/*
+ * resolves forward-confirmed host name of the client address, empty if
+ * the address has no confirmed name, results are cached for ttl
+ */
+void od_address_hostname_resolve(struct sockaddr_storage *, uint64_t ttl_ms,
+				 char *hostname, size_t hostname_len);
+
+/* hostname is the resolved name of the address, NULL if unknown */
+bool od_address_validate(const od_address_range_t *, struct sockaddr_storage *,
+			 const char *hostname);
 
 int od_address_hostname_validate(od_config_reader_t *, char *);
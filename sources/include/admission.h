@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Admission of clients waiting for a server of a shared pool.
+ *
+ * Once a client had to wait, it takes a ticket in the queue of its
+ * route, and so do all clients coming while someone waits. Only the
+ * ticket chosen by the scheduler may try to attach, others sleep on
+ * their own wait list until chosen. A ticket may be chosen many times
+ * (see yield below), so it waits for the next choose, not for a flag.
+ *
+ * Queues of the highest priority are served first. Among queues of the
+ * same priority deficit round robin is used: a queue gets weight tickets
+ * per round, so a route with thousands of waiting clients cannot starve
+ * the others.
+ *
+ * Capacity is limited per route and per address, so a chosen ticket
+ * which cannot attach yields: its queue is skipped until a server of its
+ * route is released, and other queues are served meanwhile. A ticket is
+ * chosen for at most OD_ADMISSION_HEAD_TIMEOUT_MS, a stuck one cannot
+ * hold the others.
+ */
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <machinarium/machinarium.h>
+#include <machinarium/wait_list.h>
+
+#include <list.h>
+
+#define OD_ADMISSION_HGRAM_BUCKETS 10
+#define OD_ADMISSION_HEAD_TIMEOUT_MS 1000
+
+/* upper bounds of wait time histogram buckets, last one is +inf */
+extern const uint32_t od_admission_hgram_bounds_ms[];
+
+typedef struct od_admission_ticket od_admission_ticket_t;
+typedef struct od_admission_queue od_admission_queue_t;
+typedef struct od_admission od_admission_t;
+
+struct od_admission_ticket {
+	od_admission_queue_t *queue;
+	/* incremented on every choose of the ticket */
+	atomic_uint_fast64_t chosen_count;
+	mm_wait_list_t chosen;
+	/* yielded, waits for a server of its route */
+	int blocked;
+	od_list_t link;
+};
+
+struct od_admission_queue {
+	od_list_t tickets;
+	int weight;
+	int priority;
+	int deficit;
+	int active;
+	int blocked;
+	atomic_int_fast64_t waiting;
+	atomic_uint_fast64_t wait_hgram[OD_ADMISSION_HGRAM_BUCKETS];
+	od_list_t link;
+};
+
+struct od_admission {
+	pthread_mutex_t lock;
+	od_list_t queues;
+	od_admission_ticket_t *current;
+	uint64_t chosen_ms;
+	atomic_int_fast64_t waiting;
+};
+
+void od_admission_init(od_admission_t *);
+void od_admission_free(od_admission_t *);
+
+void od_admission_queue_init(od_admission_queue_t *);
+
+static inline int od_admission_has_waiting(od_admission_t *admission)
+{
+	return atomic_load(&admission->waiting) > 0;
+}
+
+/* weight and priority are taken from the rule of the queue route */
+int od_admission_enqueue(od_admission_t *, od_admission_queue_t *,
+			 od_admission_ticket_t *, int weight, int priority);
+void od_admission_dequeue(od_admission_t *, od_admission_ticket_t *);
+
+/* returns 1 if the ticket may try to attach */
+int od_admission_turn(od_admission_t *, od_admission_ticket_t *);
+
+/* chosen ticket cannot attach, let other queues be served */
+void od_admission_yield(od_admission_t *, od_admission_ticket_t *);
+
+/* returns 1 if the ticket has yielded and waits for its route */
+int od_admission_blocked(od_admission_t *, od_admission_ticket_t *);
+
+/* a server of the ticket route is released, its queue is served again */
+void od_admission_unblock(od_admission_t *, od_admission_ticket_t *);
+
+/* returns 0 if the ticket is chosen or may be, -1 on timeout */
+int od_admission_wait(od_admission_t *, od_admission_ticket_t *,
+		      uint32_t timeout_ms);
+
+void od_admission_queue_wait_time(od_admission_queue_t *, uint64_t time_ms);
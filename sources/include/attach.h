@@ -7,6 +7,12 @@
  */
 
 #include <types.h>
+#include <storage.h>
 
 int od_attach_extended(od_instance_t *instance, char *context,
 		       od_router_t *router, od_client_t *client);
+
+/* attach to a server of the endpoint, even if it is considered dead */
+int od_attach_extended_endpoint(od_instance_t *instance, char *context,
+				od_router_t *router, od_client_t *client,
+				od_storage_endpoint_t *endpoint);
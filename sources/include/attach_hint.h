@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Attach-time routing hints.
+ *
+ * The first Query or Parse of a transaction may start with a block
+ * comment with key=value pairs after "odyssey:" prefix, like
+ *
+ *   odyssey: tsa=read-only az=zone-a shard=42
+ *
+ * which select the endpoint for this attach only: target session attrs
+ * override the ones of the session, availability zone is preferred
+ * instead of the one of the instance, shard key selects the shard of
+ * a sharded storage.
+ */
+
+#include <common_const.h>
+#include <tsa.h>
+
+#define OD_ATTACH_HINT_SHARD_KEY_LEN 64
+
+typedef struct od_attach_hint od_attach_hint_t;
+
+struct od_attach_hint {
+	od_target_session_attrs_t tsa;
+	/* empty if not set */
+	char az[OD_MAX_AVAILABILITY_ZONE_LENGTH];
+	/* not zero-terminated, 0 if not set */
+	char shard_key[OD_ATTACH_HINT_SHARD_KEY_LEN];
+	int shard_key_len;
+};
+
+static inline void od_attach_hint_init(od_attach_hint_t *hint)
+{
+	hint->tsa = OD_TARGET_SESSION_ATTRS_UNDEF;
+	hint->az[0] = 0;
+	hint->shard_key_len = 0;
+}
+
+/*
+ * parses hint of Query or Parse message, data may be truncated,
+ * returns 1 if hint is found, 0 otherwise
+ */
+int od_attach_hint_parse(od_attach_hint_t *, const char *data, size_t size);
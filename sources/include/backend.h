@@ -17,6 +17,11 @@ int od_backend_connect(od_server_t *, char *, kiwi_params_t *, od_client_t *);
 int od_backend_check_tsa(od_storage_endpoint_t *, char *, od_server_t *,
 			 od_client_t *, od_target_session_attrs_t);
 
+/* runs pg_is_in_recovery on the server of the endpoint */
+od_retcode_t od_backend_update_endpoint_status(od_instance_t *, od_client_t *,
+					       od_server_t *, char *,
+					       od_storage_endpoint_t *);
+
 int od_backend_connect_cancel(od_server_t *, od_rule_storage_t *,
 			      const od_address_t *, kiwi_key_t *);
 
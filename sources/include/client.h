@@ -16,8 +16,10 @@
 #include <relay.h>
 #include <rules.h>
 #include <list.h>
-#include <hashmap.h>
+#include <lhashmap.h>
+#include <prep_stmt_registry.h>
 #include <od_ldap.h>
+#include <attach_hint.h>
 
 typedef enum {
 	OD_CLIENT_UNDEF,
@@ -49,14 +51,18 @@ struct od_client {
 	kiwi_be_startup_t startup;
 	kiwi_vars_t vars;
 	kiwi_key_t key;
+	/* routing hint of the current transaction */
+	od_attach_hint_t attach_hint;
 
 	/* do not set this field directly, use od_server_attach_client */
 	od_server_t *server;
 	od_route_t *route;
 	char peer[OD_CLIENT_MAX_PEERLEN];
+	/* forward-confirmed name of the peer, NULL until resolved */
+	char *hostname;
 
 	/* desc preparet statements ids */
-	od_hashmap_t *prep_stmt_ids;
+	od_lhashmap_t *prep_stmt_ids;
 
 	/* passwd from config rule */
 	kiwi_password_t password;
@@ -76,6 +82,7 @@ struct od_client {
 	int ldap_storage_username_len;
 	char *ldap_storage_password;
 	int ldap_storage_password_len;
+	char *ldap_storage_credentials_name;
 	char *ldap_auth_dn;
 #endif
 
@@ -85,11 +92,19 @@ struct od_client {
 	char *external_id;
 };
 
-static const size_t OD_CLIENT_DEFAULT_HASHMAP_SZ = 420;
+/* initial capacity, grows on demand */
+static const size_t OD_CLIENT_DEFAULT_HASHMAP_SZ = 16;
+
+/* prep_stmt_ids values are referenced interned bodies */
+static inline void od_client_prep_stmt_dtor(od_lhashmap_entry_t *entry)
+{
+	od_prep_stmt_body_unref(*(od_prep_stmt_body_t **)entry->value.data);
+}
 
 static inline od_retcode_t od_client_init_hm(od_client_t *client)
 {
-	client->prep_stmt_ids = od_hashmap_create(OD_CLIENT_DEFAULT_HASHMAP_SZ);
+	client->prep_stmt_ids = od_lhashmap_create(OD_CLIENT_DEFAULT_HASHMAP_SZ,
+						   od_client_prep_stmt_dtor);
 	if (client->prep_stmt_ids == NULL) {
 		return NOT_OK_RESPONSE;
 	}
@@ -130,3 +145,7 @@ static inline void od_client_kill(od_client_t *client)
 machine_cond_t *od_client_get_io_cond(od_client_t *client);
 
 uint32_t od_client_login_timeout(const od_client_t *client);
+
+/* resolves the peer name once per client, for hostname address ranges */
+void od_client_hostname_resolve(od_client_t *client,
+				struct sockaddr_storage *sa, uint64_t ttl_ms);
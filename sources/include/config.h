@@ -100,6 +100,7 @@ struct od_config {
 	/*                                */
 	int workers;
 	int resolvers;
+	int offload_workers;
 	/*         client                 */
 	int client_max_set;
 	int client_max;
@@ -118,6 +119,12 @@ struct od_config {
 	int backend_connect_timeout_ms;
 	int cancel_timeout_ms;
 
+	/* resolved storage hosts, 0 disables caching */
+	int dns_cache_ttl_ms;
+	int dns_cache_negative_ttl_ms;
+	/* names of client addresses for hostname rules */
+	int hostname_cache_ttl_ms;
+
 	int virtual_processing; /* enables some cases for full-virtual query processing */
 
 	char availability_zone[OD_MAX_AVAILABILITY_ZONE_LENGTH];
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Background backend connections.
+ *
+ * When too many server connections are being opened concurrently, the
+ * router does not make the client coroutine wait for its turn. Instead
+ * it reserves a slot in the pool and hands the server to the factory,
+ * which connects it on the system machine with per-storage bounded
+ * concurrency and returns it to the pool as IDLE. Startup is done later
+ * by the client that takes the server, like for preallocated servers.
+ */
+
+#include <stdatomic.h>
+
+#include <machinarium/machinarium.h>
+
+#include <types.h>
+#include <list.h>
+
+typedef struct od_connect_factory od_connect_factory_t;
+
+#define OD_CONNECT_FACTORY_HGRAM_BUCKETS 12
+
+/* upper bounds of connect latency histogram buckets, last one is +inf */
+extern const uint32_t od_connect_factory_hgram_bounds_ms[];
+
+struct od_connect_factory {
+	machine_channel_t *requests;
+
+	/* dispatcher state, used on the system machine only */
+	od_list_t pending;
+	od_list_t storages;
+
+	atomic_int_fast64_t queued;
+	atomic_int_fast64_t in_progress;
+	atomic_uint_fast64_t connected;
+	atomic_uint_fast64_t failed;
+	atomic_uint_fast64_t latency_hgram[OD_CONNECT_FACTORY_HGRAM_BUCKETS];
+
+	od_global_t *global;
+	machine_wait_flag_t *stopped;
+	atomic_int online;
+};
+
+void od_connect_factory_init(od_connect_factory_t *);
+int od_connect_factory_start(od_connect_factory_t *, od_global_t *);
+void od_connect_factory_stop(od_connect_factory_t *);
+
+/*
+ * server must be allocated for the route's pool element and
+ * be in ACTIVE state without client, route lock must be held
+ */
+int od_connect_factory_submit(od_connect_factory_t *, od_route_t *,
+			      od_server_t *);
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Resolved addresses of storage hosts.
+ *
+ * Kept per host and port in a process-wide list. A fresh entry is used
+ * as is. An expired one is still used for another ttl while a single
+ * coroutine resolves the host again in background, later the host is
+ * resolved on connect. Failed resolves are remembered for negative ttl,
+ * so an unresolvable host does not hit the resolver on every connect.
+ *
+ * A missing host is resolved by one coroutine too: the first miss leaves
+ * a pending entry and the others wait for its result.
+ *
+ * A connect failure drops the entry of the host, so a changed address
+ * is picked up by the next connect.
+ */
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+typedef enum {
+	/* the caller has to resolve the host, others wait for it */
+	OD_DNS_CACHE_MISS,
+	/* someone else resolves the host, wait for the result */
+	OD_DNS_CACHE_PENDING,
+	OD_DNS_CACHE_HIT,
+	/* expired address, the caller has to resolve the host again */
+	OD_DNS_CACHE_REFRESH,
+	/* expired address, someone else resolves the host again */
+	OD_DNS_CACHE_STALE,
+	OD_DNS_CACHE_NEGATIVE,
+} od_dns_cache_result_t;
+
+od_dns_cache_result_t od_dns_cache_lookup(const char *host, int port,
+					  uint64_t now_ms, uint64_t ttl_ms,
+					  uint64_t negative_ttl_ms,
+					  struct sockaddr_storage *addr,
+					  socklen_t *addrlen);
+
+/* addr is NULL if the host was not resolved */
+int od_dns_cache_store(const char *host, int port, uint64_t now_ms,
+		       const struct sockaddr *addr, socklen_t addrlen);
+
+/* forgets a failed refresh, so another one may be started */
+void od_dns_cache_refresh_failed(const char *host, int port);
+
+/* drops the pending entry of a failed resolve, the waiters retry */
+void od_dns_cache_resolve_failed(const char *host, int port);
+
+void od_dns_cache_invalidate(const char *host, int port);
+
+/* returns count of dropped entries */
+int od_dns_cache_flush(void);
+
+/*
+ * resolves the host through the cache, the first returned address is
+ * used, returns NOT_OK_RESPONSE if the host is not resolved
+ */
+int od_dns_cache_resolve(char *host, int port, uint64_t ttl_ms,
+			 uint64_t negative_ttl_ms,
+			 struct sockaddr_storage *addr, socklen_t *addrlen);
@@ -100,10 +100,16 @@ typedef struct {
 	int priority;
 } od_endpoint_attach_candidate_t;
 
-void od_frontend_attach_init_candidates(
+/*
+ * availability_zone is NULL for the one of the instance,
+ * shard is -1 for endpoints of any shard,
+ * returns number of candidates
+ */
+size_t od_frontend_attach_init_candidates(
 	od_instance_t *instance, od_rule_storage_t *storage,
 	od_endpoint_attach_candidate_t *candidates,
-	od_target_session_attrs_t tsa, int prefer_localhost);
+	od_target_session_attrs_t tsa, const char *availability_zone,
+	int shard, int prefer_localhost);
 
 od_frontend_status_t od_frontend_remote_client_handle_packet(od_relay_t *relay,
 							     char *data,
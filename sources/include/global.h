@@ -14,6 +14,7 @@
 #include <host_watcher.h>
 #include <logger.h>
 #include <od_memory.h>
+#include <prep_stmt_registry.h>
 
 struct od_global {
 	od_instance_t *instance;
@@ -30,6 +31,9 @@ struct od_global {
 
 	od_atomic_u64_t pause;
 	mm_wait_list_t *resume_waiters;
+
+	/* prepared statement bodies shared by clients and servers */
+	od_prep_stmt_registry_t *prep_stmt_bodies;
 };
 
 od_global_t *od_global_create(od_instance_t *instance, od_system_t *system,
@@ -53,6 +57,7 @@ od_instance_t *od_global_get_instance(void);
 static inline void od_global_destroy(od_global_t *global)
 {
 	mm_wait_list_free(global->resume_waiters);
+	od_prep_stmt_registry_free(global->prep_stmt_bodies);
 	od_free(global);
 	od_global_set(NULL);
 }
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Popular prepared statements of a route.
+ *
+ * Statement uses are counted by a Space-Saving sketch over a fixed
+ * number of slots: an unknown statement replaces the least used one
+ * and inherits its count, so frequent statements cannot be missed.
+ * Counts are halved periodically to follow the working set.
+ *
+ * Top statements are deployed to idle servers ahead of clients.
+ */
+
+#include <pthread.h>
+
+#include <prep_stmt_registry.h>
+
+#define OD_HOT_STMTS_SLOTS 64
+/* hits are sampled, misses always counted */
+#define OD_HOT_STMTS_HIT_SAMPLE 16
+#define OD_HOT_STMTS_DECAY_TICKS 30
+
+typedef struct od_hot_stmt od_hot_stmt_t;
+typedef struct od_hot_stmts od_hot_stmts_t;
+
+struct od_hot_stmt {
+	/* referenced */
+	od_prep_stmt_body_t *body;
+	uint64_t uses;
+};
+
+struct od_hot_stmts {
+	pthread_mutex_t lock;
+	od_hot_stmt_t slots[OD_HOT_STMTS_SLOTS];
+	int count;
+	int ticks;
+};
+
+void od_hot_stmts_init(od_hot_stmts_t *);
+void od_hot_stmts_free(od_hot_stmts_t *);
+
+void od_hot_stmts_record(od_hot_stmts_t *, od_prep_stmt_body_t *,
+			 uint64_t uses);
+
+/* halves counts every OD_HOT_STMTS_DECAY_TICKS calls */
+void od_hot_stmts_tick(od_hot_stmts_t *);
+
+/*
+ * writes up to max most used statements into bodies, most used first,
+ * each referenced, returns their count
+ */
+int od_hot_stmts_top(od_hot_stmts_t *, od_prep_stmt_body_t **bodies, int max);
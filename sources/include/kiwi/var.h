@@ -42,6 +42,7 @@ typedef enum {
 	/* odyssey own params */
 	KIWI_VAR_ODYSSEY_CATCHUP_TIMEOUT,
 	KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS,
+	KIWI_VAR_ODYSSEY_SHARD_KEY,
 
 	/* always keep this at end */
 	KIWI_VAR_MAX,
@@ -174,6 +175,8 @@ static inline void kiwi_vars_init(kiwi_vars_t *vars)
 	/* XXX: todo - also accept aliases */
 	kiwi_var_init(&vars->vars[KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS],
 		      "target_session_attrs", sizeof("target_session_attrs"));
+	kiwi_var_init(&vars->vars[KIWI_VAR_ODYSSEY_SHARD_KEY], "shard_key",
+		      sizeof("shard_key"));
 	kiwi_var_init(&vars->vars[KIWI_VAR_ROLE], "role", sizeof("role"));
 }
 
@@ -274,5 +277,34 @@ static inline int kiwi_enquote(char *src, char *dst, int dst_len)
 	return (int)(pos - dst);
 }
 
+/*
+ * cheap summary of the vars kiwi_vars_cas() would compare,
+ * equal fingerprints mean there is most likely nothing to deploy
+ */
+static inline uint64_t kiwi_vars_fingerprint(kiwi_vars_t *vars)
+{
+	/* FNV-1a */
+	uint64_t hash = 14695981039346656037ULL;
+	kiwi_var_type_t type = KIWI_VAR_CLIENT_ENCODING;
+	for (; type < KIWI_VAR_MAX; type++) {
+		kiwi_var_t *var = kiwi_vars_of(vars, type);
+		/* never deployed or never cached for server */
+		if (var->type == KIWI_VAR_UNDEF ||
+		    var->type == KIWI_VAR_COMPRESSION ||
+		    var->type == KIWI_VAR_IS_HOT_STANDBY ||
+		    var->type == KIWI_VAR_ODYSSEY_CATCHUP_TIMEOUT ||
+		    var->type == KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS ||
+		    var->type == KIWI_VAR_ODYSSEY_SHARD_KEY) {
+			continue;
+		}
+		hash = (hash ^ (uint64_t)type) * 1099511628211ULL;
+		for (int i = 0; i < var->value_len; i++) {
+			hash = (hash ^ (uint8_t)var->value[i]) *
+			       1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
 int kiwi_vars_cas(kiwi_vars_t *client, kiwi_vars_t *server, char *query,
 		  int query_len, int smart_enquoting);
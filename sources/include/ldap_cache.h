@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Successful ldap authentications of an ldap_endpoint.
+ *
+ * An entry is keyed by rule, user and database, and keeps auth dn and
+ * name of the storage credentials found by ldap search. The password is
+ * kept as HMAC-SHA256 with a random salt of the cache, so a client with
+ * the same password is authenticated without search and bind.
+ *
+ * Entries live for ttl, least recently used one is evicted when the
+ * cache is full. A changed password in the directory is not noticed
+ * until the entry expires.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <list.h>
+
+#define OD_LDAP_CACHE_HASH_LEN 32
+#define OD_LDAP_CACHE_SALT_LEN 16
+
+typedef struct od_ldap_cache od_ldap_cache_t;
+
+struct od_ldap_cache {
+	pthread_mutex_t lock;
+	/* 0 disables the cache */
+	uint64_t ttl_ms;
+	uint64_t size;
+	uint64_t count;
+	unsigned char salt[OD_LDAP_CACHE_SALT_LEN];
+	/* most recently used first */
+	od_list_t entries;
+	atomic_uint_fast64_t hits;
+	atomic_uint_fast64_t misses;
+};
+
+void od_ldap_cache_init(od_ldap_cache_t *);
+void od_ldap_cache_free(od_ldap_cache_t *);
+
+static inline int od_ldap_cache_enabled(od_ldap_cache_t *cache)
+{
+	return cache->ttl_ms > 0 && cache->size > 0;
+}
+
+/*
+ * finds an entry without password check, returns 1 and copies of auth
+ * dn and storage credentials name (may be NULL) if found
+ */
+int od_ldap_cache_find(od_ldap_cache_t *, void *rule, const char *user,
+		       const char *database, uint64_t now_ms,
+		       char **auth_dn, char **lsc_name);
+
+/* returns 1 if the password matches a cached authentication */
+int od_ldap_cache_check(od_ldap_cache_t *, void *rule, const char *user,
+			const char *database, const char *password,
+			uint64_t now_ms);
+
+int od_ldap_cache_store(od_ldap_cache_t *, void *rule, const char *user,
+			const char *database, const char *password,
+			uint64_t now_ms, const char *auth_dn,
+			const char *lsc_name);
+
+/* returns count of dropped entries */
+uint64_t od_ldap_cache_flush(od_ldap_cache_t *);
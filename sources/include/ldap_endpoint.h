@@ -6,6 +6,7 @@
 #include <machinarium/machinarium.h>
 
 #include <list.h>
+#include <ldap_cache.h>
 
 typedef struct {
 	pthread_mutex_t lock;
@@ -36,6 +37,16 @@ typedef struct {
 
 	machine_channel_t *wait_bus;
 
+	/* requests done on the offload thread pool */
+	atomic_uint_fast64_t count_search;
+	atomic_uint_fast64_t count_bind;
+	atomic_uint_fast64_t count_error;
+	atomic_uint_fast64_t search_time_us;
+	atomic_uint_fast64_t bind_time_us;
+
+	/* successful authentications */
+	od_ldap_cache_t cache;
+
 	od_list_t link;
 
 	atomic_int_fast64_t refs;
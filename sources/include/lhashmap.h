@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Connection-local hashmap.
+ *
+ * Open addressing with Robin Hood probing and backward shift deletion,
+ * grows twice when 3/4 full. There is no locking: the map must be used
+ * only by the coroutine which owns the connection. Use od_hashmap_t for
+ * maps shared between workers.
+ *
+ * Key and value are copied into a single allocation per entry, so their
+ * data pointers stay valid until the entry is removed or replaced.
+ * Entry and od_hashmap_elt_t pointers returned by the map are valid only
+ * until the next insert or remove.
+ */
+
+#include <types.h>
+#include <hashmap.h>
+
+typedef struct od_lhashmap_entry od_lhashmap_entry_t;
+typedef struct od_lhashmap od_lhashmap_t;
+
+typedef void (*od_lhashmap_dtor_t)(od_lhashmap_entry_t *entry);
+
+struct od_lhashmap_entry {
+	od_hash_t hash;
+	/* probe sequence length + 1, 0 for an empty slot */
+	uint32_t psl;
+	od_hashmap_elt_t key;
+	od_hashmap_elt_t value;
+};
+
+struct od_lhashmap {
+	od_lhashmap_entry_t *entries;
+	/* power of two */
+	size_t capacity;
+	size_t count;
+	od_lhashmap_dtor_t dtor;
+};
+
+od_lhashmap_t *od_lhashmap_create(size_t capacity, od_lhashmap_dtor_t dtor);
+void od_lhashmap_free(od_lhashmap_t *);
+void od_lhashmap_empty(od_lhashmap_t *);
+
+od_hashmap_elt_t *od_lhashmap_find(od_lhashmap_t *, od_hash_t keyhash,
+				   od_hashmap_elt_t *key);
+
+/*
+ * inserts copy of the key and the value, replacing the value if key
+ * exists, *value is set to the stored value
+ *
+ * returns 0 if inserted, 1 if replaced, -1 on error
+ */
+int od_lhashmap_insert(od_lhashmap_t *, od_hash_t keyhash,
+		       od_hashmap_elt_t *key, od_hashmap_elt_t **value);
+
+/* returns NOT_OK_RESPONSE if there is no such key */
+od_retcode_t od_lhashmap_remove(od_lhashmap_t *, od_hash_t keyhash,
+				od_hashmap_elt_t *key);
+
+/* returns next entry after the given one (or first for NULL), or NULL */
+static inline od_lhashmap_entry_t *od_lhashmap_next(od_lhashmap_t *map,
+						    od_lhashmap_entry_t *entry)
+{
+	size_t pos = entry == NULL ? 0 : (size_t)(entry - map->entries) + 1;
+	for (; pos < map->capacity; pos++) {
+		if (map->entries[pos].psl != 0) {
+			return &map->entries[pos];
+		}
+	}
+	return NULL;
+}
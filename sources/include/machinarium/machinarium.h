@@ -65,6 +65,8 @@ MACHINE_API void machinarium_set_stack_size(int size);
 
 MACHINE_API void machinarium_set_pool_size(int size);
 
+MACHINE_API void machinarium_set_offload_pool_size(int size);
+
 MACHINE_API void machinarium_set_coroutine_cache_size(int size);
 
 MACHINE_API void machinarium_set_msg_cache_gc_size(int size);
@@ -239,6 +241,12 @@ MACHINE_API int machine_io_verify(machine_io_t *, char *common_name);
 MACHINE_API int machine_io_format_socket_addr(machine_io_t *io, char *buf,
 					      size_t buflen);
 
+/*
+ * runs blocking function on the offload thread pool,
+ * current coroutine waits for it to complete
+ */
+MACHINE_API int machine_offload(void (*function)(void *), void *arg);
+
 /* dns */
 
 MACHINE_API int machine_getsockname(machine_io_t *, struct sockaddr *, int *);
@@ -249,6 +257,11 @@ MACHINE_API int machine_getaddrinfo(char *addr, char *service,
 				    struct addrinfo *hints,
 				    struct addrinfo **res, uint32_t time_ms);
 
+MACHINE_API int machine_getnameinfo(const struct sockaddr *sa,
+				    socklen_t salen, char *host,
+				    size_t hostlen, int flags,
+				    uint32_t time_ms);
+
 /* io */
 
 MACHINE_API int machine_connect(machine_io_t *, struct sockaddr *,
@@ -16,6 +16,7 @@ struct mm_config {
 	int page_size;
 	int stack_size;
 	int pool_size;
+	int offload_pool_size;
 	int coroutine_cache_size;
 	int msg_cache_gc_size;
 };
@@ -24,6 +25,7 @@ struct mm {
 	mm_config_t config;
 	mm_machinemgr_t machine_mgr;
 	mm_taskmgr_t task_mgr;
+	mm_taskmgr_t offload_mgr;
 };
 
 extern mm_t machinarium;
@@ -33,4 +33,6 @@ int mm_socket_getsockname(int, struct sockaddr *, socklen_t *);
 int mm_socket_getpeername(int, struct sockaddr *, socklen_t *);
 int mm_socket_getaddrinfo(char *, char *, struct addrinfo *,
 			  struct addrinfo **);
+int mm_socket_getnameinfo(const struct sockaddr *, socklen_t, char *, size_t,
+			  int);
 int mm_socket_read_pending(int fd);
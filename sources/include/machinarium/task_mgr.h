@@ -20,6 +20,6 @@ struct mm_taskmgr {
 };
 
 void mm_taskmgr_init(mm_taskmgr_t *);
-int mm_taskmgr_start(mm_taskmgr_t *, int);
+int mm_taskmgr_start(mm_taskmgr_t *, const char *, int);
 void mm_taskmgr_stop(mm_taskmgr_t *);
 int mm_taskmgr_new(mm_taskmgr_t *, mm_task_function_t, void *, uint32_t);
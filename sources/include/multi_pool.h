@@ -17,6 +17,7 @@
 #include <types.h>
 #include <address.h>
 #include <list.h>
+#include <murmurhash.h>
 #include <server_pool.h>
 #include <server.h>
 
@@ -29,23 +30,85 @@ struct od_multi_pool_key {
 };
 
 struct od_multi_pool_element {
+	/* db and user are borrowed from the names group */
 	od_multi_pool_key_t key;
+	/* interned db and user, NULL for exclusive pools */
+	od_multi_pool_group_t *names;
+	od_hash_t hash;
 	od_server_pool_t pool;
+	/*
+	 * shared pool servers of the key which are not lent to others,
+	 * set by the rule of the route taking servers of the element
+	 */
+	int min_size;
+	od_list_t hash_link;
+	/* in elements of the address group */
+	od_list_t group_link;
 	od_list_t link;
 };
 
 typedef int (*od_multi_pool_element_cb_t)(od_multi_pool_element_t *, void **);
 
+/* element pool parents, see od_server_pool_t */
+typedef enum {
+	OD_MULTI_POOL_PARENT_TOTALS,
+	OD_MULTI_POOL_PARENT_NAMES,
+	OD_MULTI_POOL_PARENT_ADDRESS,
+} od_multi_pool_parent_t;
+
+/*
+ * aggregated counters of the elements with the same
+ * db and user or with the same address
+ */
+struct od_multi_pool_group {
+	od_multi_pool_key_t key;
+	od_server_pool_counters_t counters;
+	/* of the address group only */
+	od_list_t elements;
+	od_hash_t hash;
+	od_list_t hash_link;
+	od_list_t link;
+};
+
+/* groups are indexed by hash like the elements */
+struct od_multi_pool_groups {
+	od_list_t list;
+	size_t count;
+	od_list_t *buckets;
+	size_t buckets_count;
+};
+
 struct od_multi_pool {
+	/* used for iteration only, lookups go through buckets */
 	od_list_t pools;
+	size_t count;
+	od_list_t *buckets;
+	size_t buckets_count;
 	od_server_pool_free_fn_t pool_free_fn;
 	pthread_spinlock_t lock;
 
+	/* kept in sync by server state transitions */
+	od_server_pool_counters_t totals;
+	od_multi_pool_groups_t groups_by_names;
+	od_multi_pool_groups_t groups_by_address;
+
 	mm_wait_list_t *wait_bus;
 	/* should increase every time servers in the route's pool are changed */
 	atomic_uint_fast64_t version;
 };
 
+/* NULL for elements of exclusive pools */
+static inline od_multi_pool_group_t *
+od_multi_pool_element_address_group(od_multi_pool_element_t *el)
+{
+	od_server_pool_counters_t *counters;
+	counters = el->pool.parents[OD_MULTI_POOL_PARENT_ADDRESS];
+	if (counters == NULL) {
+		return NULL;
+	}
+	return od_container_of(counters, od_multi_pool_group_t, counters);
+}
+
 static inline void od_multi_pool_lock(od_multi_pool_t *mpool)
 {
 	pthread_spin_lock(&mpool->lock);
@@ -83,6 +146,28 @@ od_multi_pool_element_t *
 od_multi_pool_get_or_create_locked(od_multi_pool_t *mpool,
 				   const od_multi_pool_key_t *key);
 
+/*
+ * same, with db and user interned by od_multi_pool_names_locked(), so
+ * only the pointer and the address are hashed and compared
+ */
+od_multi_pool_element_t *
+od_multi_pool_get_or_create_names_locked(od_multi_pool_t *mpool,
+					 od_multi_pool_group_t *names,
+					 const od_address_t *address);
+
+/*
+ * interned db and user: the group of their counters, created if there
+ * is no element with them yet; returns NULL only on no memory
+ */
+od_multi_pool_group_t *od_multi_pool_names_locked(od_multi_pool_t *mpool,
+						  const char *dbname,
+						  const char *username);
+
+/* counters of od_multi_pool_names_locked() group */
+od_server_pool_counters_t *
+od_multi_pool_names_counters_locked(od_multi_pool_t *mpool,
+				    const char *dbname, const char *username);
+
 /* return 1 if key fits, 0 otherwise */
 typedef int (*od_multi_pool_key_filter_t)(void *, const od_multi_pool_key_t *);
 
@@ -91,6 +176,9 @@ od_multi_pool_foreach_locked(od_multi_pool_t *mpool,
 			     const od_multi_pool_key_filter_t filter,
 			     void *farg, od_server_state_t state,
 			     od_server_pool_cb_t callback, void **argv);
+int od_multi_pool_foreach_element_locked(
+	od_multi_pool_t *mpool, const od_multi_pool_key_filter_t filter,
+	void *farg, od_multi_pool_element_cb_t callback, void **argv);
 int od_multi_pool_count_active_locked(od_multi_pool_t *mpool,
 				      const od_multi_pool_key_filter_t filter,
 				      void *farg);
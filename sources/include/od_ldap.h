@@ -45,4 +45,12 @@ extern od_retcode_t od_ldap_server_prepare(od_logger_t *logger,
 extern od_ldap_server_t *od_ldap_server_pull(od_logger_t *logger,
 					     od_rule_t *rule, bool auth_pool);
 
+/*
+ * searches the client in the directory of the rule ldap endpoint,
+ * returns LDAP_INSUFFICIENT_ACCESS if the client is not found
+ */
+extern od_retcode_t od_ldap_server_search(od_logger_t *logger,
+					  od_rule_t *rule,
+					  od_client_t *client);
+
 #endif /* LDAP_FOUND */
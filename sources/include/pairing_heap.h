@@ -0,0 +1,149 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Intrusive min pairing heap keyed by uint64.
+ *
+ * Insert is O(1), removal of the minimum or of an arbitrary node
+ * is amortized O(log n), nothing is allocated.
+ */
+
+typedef struct od_pairing_heap_node od_pairing_heap_node_t;
+typedef struct od_pairing_heap od_pairing_heap_t;
+
+struct od_pairing_heap_node {
+	uint64_t key;
+	od_pairing_heap_node_t *child;
+	od_pairing_heap_node_t *next;
+	/* parent for the leftmost child, left sibling otherwise */
+	od_pairing_heap_node_t *prev;
+};
+
+struct od_pairing_heap {
+	od_pairing_heap_node_t *root;
+	int count;
+};
+
+static inline void od_pairing_heap_init(od_pairing_heap_t *heap)
+{
+	heap->root = NULL;
+	heap->count = 0;
+}
+
+static inline od_pairing_heap_node_t *
+od_pairing_heap_peek(od_pairing_heap_t *heap)
+{
+	return heap->root;
+}
+
+static inline od_pairing_heap_node_t *
+od_pairing_heap_meld(od_pairing_heap_node_t *a, od_pairing_heap_node_t *b)
+{
+	if (a == NULL) {
+		return b;
+	}
+	if (b == NULL) {
+		return a;
+	}
+	if (b->key < a->key) {
+		od_pairing_heap_node_t *tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL) {
+		a->child->prev = b;
+	}
+	a->child = b;
+	a->next = NULL;
+	a->prev = NULL;
+	return a;
+}
+
+static inline od_pairing_heap_node_t *
+od_pairing_heap_merge_pairs(od_pairing_heap_node_t *first)
+{
+	/* meld siblings in pairs left to right, stacking the results */
+	od_pairing_heap_node_t *pairs = NULL;
+	while (first != NULL) {
+		od_pairing_heap_node_t *a = first;
+		od_pairing_heap_node_t *b = a->next;
+		first = b != NULL ? b->next : NULL;
+
+		a->next = NULL;
+		a->prev = NULL;
+		if (b != NULL) {
+			b->next = NULL;
+			b->prev = NULL;
+		}
+
+		od_pairing_heap_node_t *pair = od_pairing_heap_meld(a, b);
+		pair->next = pairs;
+		pairs = pair;
+	}
+
+	/* then meld the pairs right to left */
+	od_pairing_heap_node_t *root = NULL;
+	while (pairs != NULL) {
+		od_pairing_heap_node_t *next = pairs->next;
+		pairs->next = NULL;
+		root = od_pairing_heap_meld(root, pairs);
+		pairs = next;
+	}
+	return root;
+}
+
+static inline void od_pairing_heap_insert(od_pairing_heap_t *heap,
+					  od_pairing_heap_node_t *node,
+					  uint64_t key)
+{
+	node->key = key;
+	node->child = NULL;
+	node->next = NULL;
+	node->prev = NULL;
+	heap->root = od_pairing_heap_meld(heap->root, node);
+	heap->count++;
+}
+
+static inline void od_pairing_heap_remove(od_pairing_heap_t *heap,
+					  od_pairing_heap_node_t *node)
+{
+	if (node == heap->root) {
+		heap->root = od_pairing_heap_merge_pairs(node->child);
+	} else {
+		if (node->prev->child == node) {
+			node->prev->child = node->next;
+		} else {
+			node->prev->next = node->next;
+		}
+		if (node->next != NULL) {
+			node->next->prev = node->prev;
+		}
+
+		od_pairing_heap_node_t *sub;
+		sub = od_pairing_heap_merge_pairs(node->child);
+		heap->root = od_pairing_heap_meld(heap->root, sub);
+	}
+
+	node->child = NULL;
+	node->next = NULL;
+	node->prev = NULL;
+	heap->count--;
+}
+
+static inline od_pairing_heap_node_t *
+od_pairing_heap_pop(od_pairing_heap_t *heap)
+{
+	od_pairing_heap_node_t *root = heap->root;
+	if (root != NULL) {
+		od_pairing_heap_remove(heap, root);
+	}
+	return root;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Parse messages in flight to a server.
+ *
+ * With prepared statements reserved, odyssey sends its own Parse before
+ * Bind or Describe of a statement the server has not seen yet. Their
+ * ParseComplete must be hidden from the client, while ParseComplete of
+ * Parse sent on behalf of the client must be forwarded. Replies come in
+ * order, so each Parse is queued with a flag and ParseComplete is
+ * matched by queue position.
+ *
+ * After an error the server skips messages up to Sync, so Parse
+ * messages of that sync epoch may never be answered: each entry
+ * remembers the number of Sync requested before it, and entries of
+ * already finished epochs are dropped.
+ */
+
+#include <od_c.h>
+#include <od_memory.h>
+
+#define OD_PARSE_QUEUE_MIN_CAPACITY 8
+
+typedef struct od_parse_queue_entry od_parse_queue_entry_t;
+typedef struct od_parse_queue od_parse_queue_t;
+
+struct od_parse_queue_entry {
+	uint64_t epoch;
+	int forward;
+};
+
+struct od_parse_queue {
+	od_parse_queue_entry_t *entries;
+	size_t capacity;
+	size_t head;
+	size_t count;
+};
+
+static inline void od_parse_queue_init(od_parse_queue_t *queue)
+{
+	queue->entries = NULL;
+	queue->capacity = 0;
+	queue->head = 0;
+	queue->count = 0;
+}
+
+static inline void od_parse_queue_free(od_parse_queue_t *queue)
+{
+	od_free(queue->entries);
+	od_parse_queue_init(queue);
+}
+
+static inline void od_parse_queue_clear(od_parse_queue_t *queue)
+{
+	queue->head = 0;
+	queue->count = 0;
+}
+
+/* epoch is the number of Sync requested before this Parse */
+static inline int od_parse_queue_push(od_parse_queue_t *queue, uint64_t epoch,
+				      int forward)
+{
+	if (queue->count == queue->capacity) {
+		size_t capacity = queue->capacity * 2;
+		if (capacity == 0) {
+			capacity = OD_PARSE_QUEUE_MIN_CAPACITY;
+		}
+		od_parse_queue_entry_t *entries;
+		entries = od_malloc(capacity * sizeof(od_parse_queue_entry_t));
+		if (entries == NULL) {
+			return NOT_OK_RESPONSE;
+		}
+		for (size_t i = 0; i < queue->count; i++) {
+			entries[i] = queue->entries[(queue->head + i) %
+						    queue->capacity];
+		}
+		od_free(queue->entries);
+		queue->entries = entries;
+		queue->capacity = capacity;
+		queue->head = 0;
+	}
+
+	od_parse_queue_entry_t *entry;
+	entry = &queue->entries[(queue->head + queue->count) % queue->capacity];
+	entry->epoch = epoch;
+	entry->forward = forward;
+	queue->count++;
+	return OK_RESPONSE;
+}
+
+/*
+ * epoch is the number of ReadyForQuery received,
+ * returns forward flag of the answered Parse, -1 if none is expected
+ */
+static inline int od_parse_queue_pop(od_parse_queue_t *queue, uint64_t epoch)
+{
+	while (queue->count > 0) {
+		od_parse_queue_entry_t *entry = &queue->entries[queue->head];
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->count--;
+		if (entry->epoch >= epoch) {
+			return entry->forward;
+		}
+	}
+	return -1;
+}
@@ -34,17 +34,31 @@ struct od_rule_pool {
 	char *discard_query;
 
 	int min_size;
+	int warmup;
 	int size;
 	int timeout;
 	int ttl;
 	int discard;
 	int smart_discard;
+	int reset_tracking;
 	int cancel;
 	int rollback;
 	int pin_on_listen;
 
+	/* admission of clients waiting for a shared pool server */
+	int weight;
+	int priority;
+
+	/* quota of the route in a shared pool, per address, 0 - not set */
+	int shared_min_size;
+	int shared_max_size;
+
 	/* --------  makes sense only for transaction pooling --------------------------- */
 	int reserve_prepared_statement;
+	/* per server, 0 means unlimited */
+	int prepared_statements_max;
+	int prepared_statements_max_bytes;
+	int prepared_statements_deploy;
 	/* ------------------------------------------------------------------------------ */
 
 	/* --------  makes sense only for session pooling ------------------------------- */
@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Adaptive pool warmup.
+ *
+ * Route demand (servers used by clients plus clients waiting for one)
+ * is sampled once a second. The target pool size is the largest of the
+ * demand peak over the window and the EWMA extrapolated by its trend,
+ * so servers are opened while the ramp is still going up, before
+ * clients have to wait for connect and auth.
+ *
+ * The window is pool_ttl, so prespawned servers decay by the regular
+ * idle expiry once the peak leaves the window.
+ */
+
+#define OD_POOL_WARMUP_SLOTS 16
+/* window in seconds, if pool_ttl is disabled */
+#define OD_POOL_WARMUP_WINDOW_DEFAULT 60
+/* fixed point scale of ewma and trend */
+#define OD_POOL_WARMUP_SCALE 1000
+#define OD_POOL_WARMUP_ALPHA 250
+/* samples of trend to look ahead */
+#define OD_POOL_WARMUP_HORIZON 5
+
+typedef struct od_pool_warmup od_pool_warmup_t;
+
+struct od_pool_warmup {
+	int64_t ewma;
+	int64_t trend;
+	/* demand peaks, each slot covers window / OD_POOL_WARMUP_SLOTS */
+	int peaks[OD_POOL_WARMUP_SLOTS];
+	int slot;
+	int slot_samples;
+	uint64_t samples;
+};
+
+static inline void od_pool_warmup_init(od_pool_warmup_t *warmup)
+{
+	memset(warmup, 0, sizeof(od_pool_warmup_t));
+}
+
+static inline void od_pool_warmup_sample(od_pool_warmup_t *warmup, int demand,
+					 int window)
+{
+	int slot_len = window / OD_POOL_WARMUP_SLOTS;
+	if (slot_len < 1) {
+		slot_len = 1;
+	}
+
+	if (warmup->slot_samples >= slot_len) {
+		warmup->slot = (warmup->slot + 1) % OD_POOL_WARMUP_SLOTS;
+		warmup->peaks[warmup->slot] = 0;
+		warmup->slot_samples = 0;
+	}
+	warmup->slot_samples++;
+	if (demand > warmup->peaks[warmup->slot]) {
+		warmup->peaks[warmup->slot] = demand;
+	}
+
+	int64_t value = (int64_t)demand * OD_POOL_WARMUP_SCALE;
+	if (warmup->samples == 0) {
+		warmup->ewma = value;
+		warmup->trend = 0;
+	} else {
+		int64_t prev = warmup->ewma;
+		warmup->ewma += (value - warmup->ewma) * OD_POOL_WARMUP_ALPHA /
+				OD_POOL_WARMUP_SCALE;
+		warmup->trend += ((warmup->ewma - prev) - warmup->trend) *
+				 OD_POOL_WARMUP_ALPHA / OD_POOL_WARMUP_SCALE;
+	}
+	warmup->samples++;
+}
+
+/* pool_size of 0 means unlimited */
+static inline int od_pool_warmup_target(const od_pool_warmup_t *warmup,
+					int pool_size)
+{
+	int target = 0;
+	for (int i = 0; i < OD_POOL_WARMUP_SLOTS; i++) {
+		if (warmup->peaks[i] > target) {
+			target = warmup->peaks[i];
+		}
+	}
+
+	int64_t predicted =
+		warmup->ewma + warmup->trend * OD_POOL_WARMUP_HORIZON;
+	if (predicted > 0) {
+		int64_t value = (predicted + OD_POOL_WARMUP_SCALE - 1) /
+				OD_POOL_WARMUP_SCALE;
+		if (value > target) {
+			target = (int)value;
+		}
+	}
+
+	if (pool_size > 0 && target > pool_size) {
+		target = pool_size;
+	}
+	return target;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Process-wide registry of prepared statement bodies.
+ *
+ * Bodies are interned by od_murmur_hash of their text: clients and
+ * servers preparing the same statement share a single refcounted copy,
+ * and the hash is computed once, on Parse.
+ *
+ * The registry is split into shards, each guarded by its own mutex and
+ * chaining bodies in a table which grows with the shard.
+ */
+
+#include <machinarium/mutex.h>
+
+#include <types.h>
+#include <atomic.h>
+#include <murmurhash.h>
+
+#define OD_PREP_STMT_REGISTRY_SHARDS 64
+
+typedef struct od_prep_stmt_body od_prep_stmt_body_t;
+typedef struct od_prep_stmt_registry_shard od_prep_stmt_registry_shard_t;
+typedef struct od_prep_stmt_registry od_prep_stmt_registry_t;
+
+struct od_prep_stmt_body {
+	od_prep_stmt_registry_t *registry;
+	od_prep_stmt_body_t *next;
+	od_hash_t hash;
+	od_atomic_u32_t refcnt;
+	size_t len;
+	char data[];
+};
+
+struct od_prep_stmt_registry_shard {
+	mm_mutex_t mu;
+	od_prep_stmt_body_t **buckets;
+	/* power of two */
+	size_t size;
+	size_t count;
+};
+
+struct od_prep_stmt_registry {
+	od_prep_stmt_registry_shard_t shards[OD_PREP_STMT_REGISTRY_SHARDS];
+	od_atomic_u64_t count;
+	od_atomic_u64_t bytes;
+};
+
+od_prep_stmt_registry_t *od_prep_stmt_registry_create(void);
+void od_prep_stmt_registry_free(od_prep_stmt_registry_t *);
+
+/* returns referenced body, NULL on error */
+od_prep_stmt_body_t *od_prep_stmt_registry_intern(od_prep_stmt_registry_t *,
+						  od_hash_t hash,
+						  const char *data,
+						  size_t len);
+
+void od_prep_stmt_body_unref(od_prep_stmt_body_t *);
+
+/* caller must already hold a reference */
+static inline od_prep_stmt_body_t *
+od_prep_stmt_body_ref(od_prep_stmt_body_t *body)
+{
+	od_atomic_u32_inc(&body->refcnt);
+	return body;
+}
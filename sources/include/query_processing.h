@@ -16,6 +16,7 @@ typedef enum {
 	OD_QUERY_PROCESSING_LSHOW,
 	OD_QUERY_PROCESSING_LODYSSEY,
 	OD_QUERY_PROCESSING_LTSA,
+	OD_QUERY_PROCESSING_LSHARD_KEY,
 	OD_QUERY_PROCESSING_LAPPNAME,
 } od_query_processing_keywords_t;
 
@@ -12,11 +12,15 @@
 #include <stat.h>
 #include <rules.h>
 #include <route_id.h>
+#include <murmurhash.h>
 #include <client_pool.h>
 #include <multi_pool.h>
 #include <err_logger.h>
 #include <id.h>
 #include <shared_pool.h>
+#include <pool_warmup.h>
+#include <hot_stmts.h>
+#include <admission.h>
 #include <od_memory.h>
 
 struct od_route {
@@ -32,17 +36,30 @@ struct od_route {
 	 */
 	od_multi_pool_t *exclusive_pool;
 	od_shared_pool_t *shared_pool;
+	/* route's interned db.user in the shared pool, set lazily */
+	od_multi_pool_group_t *shared_names;
 
 	od_client_pool_t client_pool;
+	/* waiting clients of the route, wait time is tracked for all */
+	od_admission_queue_t admission;
 
 	kiwi_params_lock_t params;
 	int64_t tcp_connections;
+	/* servers handed to the connect factory */
+	int connects_queued;
+	od_pool_warmup_t warmup;
+	/* deployed to idle servers in background */
+	od_hot_stmts_t hot_stmts;
 	int last_heartbeat;
 	pthread_mutex_t lock;
 
 	od_error_logger_t *err_logger;
 	bool extra_logging_enabled;
 
+	/* route pool hash index */
+	od_hash_t hash;
+	od_list_t hash_link;
+
 	od_list_t link;
 };
 
@@ -102,6 +119,40 @@ od_route_server_pool_foreach_locked(od_route_t *route, od_server_state_t state,
 					    route, state, callback, argv);
 }
 
+static inline int
+od_route_server_pool_foreach_element_locked(od_route_t *route,
+					    od_multi_pool_element_cb_t callback,
+					    void **argv)
+{
+	if (route->shared_pool == NULL) {
+		return od_multi_pool_foreach_element_locked(
+			route->exclusive_pool, NULL, NULL, callback, argv);
+	}
+
+	return od_multi_pool_foreach_element_locked(
+		route->shared_pool->mpool, od_multi_pool_filter_by_route, route,
+		callback, argv);
+}
+
+static inline od_multi_pool_group_t *
+od_route_shared_names_locked(od_route_t *route)
+{
+	if (route->shared_names == NULL) {
+		route->shared_names = od_multi_pool_names_locked(
+			route->shared_pool->mpool, route->id.database,
+			route->id.user);
+	}
+
+	return route->shared_names;
+}
+
+static inline od_server_pool_counters_t *
+od_route_shared_counters_locked(od_route_t *route)
+{
+	od_multi_pool_group_t *names = od_route_shared_names_locked(route);
+	return names != NULL ? &names->counters : NULL;
+}
+
 static inline int od_route_server_pool_count_active_locked(od_route_t *route,
 							   int force_id)
 {
@@ -111,9 +162,9 @@ static inline int od_route_server_pool_count_active_locked(od_route_t *route,
 	}
 
 	if (force_id) {
-		return od_multi_pool_count_active_locked(
-			route->shared_pool->mpool,
-			od_multi_pool_filter_by_route, route);
+		od_server_pool_counters_t *counters;
+		counters = od_route_shared_counters_locked(route);
+		return counters != NULL ? counters->count_active : 0;
 	}
 
 	return od_multi_pool_count_active_locked(route->shared_pool->mpool,
@@ -129,9 +180,9 @@ static inline int od_route_server_pool_count_idle_locked(od_route_t *route,
 	}
 
 	if (force_id) {
-		return od_multi_pool_count_idle_locked(
-			route->shared_pool->mpool,
-			od_multi_pool_filter_by_route, route);
+		od_server_pool_counters_t *counters;
+		counters = od_route_shared_counters_locked(route);
+		return counters != NULL ? counters->count_idle : 0;
 	}
 
 	return od_multi_pool_count_idle_locked(route->shared_pool->mpool, NULL,
@@ -147,9 +198,12 @@ static inline int od_route_server_pool_count_total_locked(od_route_t *route,
 	}
 
 	if (force_id) {
-		return od_multi_pool_total_locked(route->shared_pool->mpool,
-						  od_multi_pool_filter_by_route,
-						  route);
+		od_server_pool_counters_t *counters;
+		counters = od_route_shared_counters_locked(route);
+		if (counters == NULL) {
+			return 0;
+		}
+		return counters->count_active + counters->count_idle;
 	}
 
 	return od_multi_pool_total_locked(route->shared_pool->mpool, NULL,
@@ -162,11 +216,15 @@ static inline int od_route_init(od_route_t *route,
 {
 	route->rule = NULL;
 	route->tcp_connections = 0;
+	route->connects_queued = 0;
+	od_pool_warmup_init(&route->warmup);
+	od_hot_stmts_init(&route->hot_stmts);
 	route->last_heartbeat = 0;
 
 	od_route_id_init(&route->id);
 
 	route->shared_pool = NULL;
+	route->shared_names = NULL;
 	route->exclusive_pool = NULL;
 
 	if (shared_pool == NULL) {
@@ -180,6 +238,7 @@ static inline int od_route_init(od_route_t *route,
 	}
 
 	od_client_pool_init(&route->client_pool);
+	od_admission_queue_init(&route->admission);
 
 	/* stat init */
 	route->stats_mark_db = false;
@@ -194,6 +253,8 @@ static inline int od_route_init(od_route_t *route,
 	od_stat_init(&route->stats);
 	od_stat_init(&route->stats_prev);
 	kiwi_params_lock_init(&route->params);
+	route->hash = 0;
+	od_list_init(&route->hash_link);
 	od_list_init(&route->link);
 	pthread_mutex_init(&route->lock, NULL);
 
@@ -211,6 +272,7 @@ static inline void od_route_free(od_route_t *route)
 	}
 
 	kiwi_params_lock_free(&route->params);
+	od_hot_stmts_free(&route->hot_stmts);
 
 	if (route->stats.enable_quantiles) {
 		od_stat_free(&route->stats);
@@ -338,10 +400,17 @@ static inline int od_route_signal(od_route_t *route)
 int od_route_server_pool_can_add_locked(od_route_t *route,
 					od_multi_pool_element_t *el);
 
+/*
+ * idle server of the key most over its reserved minimum at the
+ * borrower address, NULL if all keys are within their minimum
+ */
+od_server_t *od_route_shared_lender_locked(od_multi_pool_element_t *borrower);
+
 int od_route_server_pool_total(od_route_t *route, od_multi_pool_element_t *el);
 
 int od_route_server_pool_next_idle_locked(od_route_t *route,
 					  const od_address_t *address,
+					  uint64_t vars_fingerprint,
 					  od_server_t **server);
 
 od_multi_pool_element_t *
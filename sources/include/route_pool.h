@@ -14,6 +14,7 @@
 #include <list.h>
 #include <err_logger.h>
 #include <route_id.h>
+#include <murmurhash.h>
 #include <rules.h>
 #include <tdigest.h>
 
@@ -49,8 +50,18 @@ struct od_route_pool {
 	pthread_mutex_t lock;
 
 	od_list_t list;
+
+	/*
+	 * routes indexed by rule and route id,
+	 * lazily allocated and grown in od_route_pool_new
+	 */
+	od_list_t *buckets;
+	size_t buckets_count;
 };
 
+#define OD_ROUTE_POOL_BUCKETS_MIN 64
+#define OD_ROUTE_POOL_LOAD_FACTOR 2
+
 #define od_route_pool_lock(route_pool) pthread_mutex_lock(&route_pool.lock);
 #define od_route_pool_unlock(route_pool) pthread_mutex_unlock(&route_pool.lock);
 
@@ -62,6 +73,8 @@ static inline void od_route_pool_init(od_route_pool_t *pool)
 	od_list_init(&pool->list);
 	pool->err_logger = od_err_logger_create_default();
 	pool->count = 0;
+	pool->buckets = NULL;
+	pool->buckets_count = 0;
 	pthread_mutex_init(&pool->lock, NULL);
 }
 
@@ -80,11 +93,81 @@ static inline void od_route_pool_free(od_route_pool_t *pool)
 		route = od_container_of(i, od_route_t, link);
 		od_route_free(route);
 	}
+
+	if (pool->buckets != NULL) {
+		od_free(pool->buckets);
+	}
+}
+
+static inline od_hash_t od_route_pool_hash(const od_route_id_t *id,
+					   const od_rule_t *rule)
+{
+	od_hash_t hash = od_murmur_hash(id->database, id->database_len);
+	hash = hash * 31 + od_murmur_hash(id->user, id->user_len);
+	hash = hash * 31 + od_murmur_hash(&rule, sizeof(rule));
+	hash = hash * 31 + (id->physical_rep << 1 | id->logical_rep);
+	return hash;
+}
+
+static inline od_list_t *od_route_pool_bucket(od_route_pool_t *pool,
+					      od_hash_t hash)
+{
+	return &pool->buckets[hash & (pool->buckets_count - 1)];
+}
+
+static inline int od_route_pool_rehash(od_route_pool_t *pool,
+				       size_t buckets_count)
+{
+	od_list_t *buckets = od_malloc(sizeof(od_list_t) * buckets_count);
+	if (buckets == NULL) {
+		return -1;
+	}
+	for (size_t i = 0; i < buckets_count; ++i) {
+		od_list_init(&buckets[i]);
+	}
+
+	if (pool->buckets != NULL) {
+		od_free(pool->buckets);
+	}
+	pool->buckets = buckets;
+	pool->buckets_count = buckets_count;
+
+	od_list_t *i;
+	od_list_foreach (&pool->list, i) {
+		od_route_t *route;
+		route = od_container_of(i, od_route_t, link);
+		od_list_init(&route->hash_link);
+		od_list_append(od_route_pool_bucket(pool, route->hash),
+			       &route->hash_link);
+	}
+	return 0;
+}
+
+static inline void od_route_pool_remove(od_route_pool_t *pool,
+					od_route_t *route)
+{
+	assert(pool->count > 0);
+	pool->count--;
+	od_list_unlink(&route->link);
+	od_list_unlink(&route->hash_link);
 }
 
 static inline od_route_t *od_route_pool_new(od_route_pool_t *pool,
 					    od_route_id_t *id, od_rule_t *rule)
 {
+	size_t need = (size_t)pool->count + 1;
+	if (need > pool->buckets_count * OD_ROUTE_POOL_LOAD_FACTOR) {
+		size_t buckets_count = pool->buckets_count * 2;
+		if (buckets_count < OD_ROUTE_POOL_BUCKETS_MIN) {
+			buckets_count = OD_ROUTE_POOL_BUCKETS_MIN;
+		}
+		/* keep the old index on failure, unless there is none */
+		if (od_route_pool_rehash(pool, buckets_count) == -1 &&
+		    pool->buckets == NULL) {
+			return NULL;
+		}
+	}
+
 	od_route_t *route = od_route_allocate(rule->shared_pool);
 	if (route == NULL) {
 		return NULL;
@@ -105,7 +188,10 @@ static inline od_route_t *od_route_pool_new(od_route_pool_t *pool,
 				td_new(QUANTILES_COMPRESSION);
 		}
 	}
+	route->hash = od_route_pool_hash(id, rule);
 	od_list_append(&pool->list, &route->link);
+	od_list_append(od_route_pool_bucket(pool, route->hash),
+		       &route->hash_link);
 	pool->count++;
 	return route;
 }
@@ -133,11 +219,17 @@ static inline int od_route_pool_foreach(od_route_pool_t *pool,
 static inline od_route_t *
 od_route_pool_match(od_route_pool_t *pool, od_route_id_t *key, od_rule_t *rule)
 {
+	if (pool->buckets == NULL) {
+		return NULL;
+	}
+
+	od_hash_t hash = od_route_pool_hash(key, rule);
+
 	od_list_t *i;
-	od_list_foreach (&pool->list, i) {
+	od_list_foreach (od_route_pool_bucket(pool, hash), i) {
 		od_route_t *route;
-		route = od_container_of(i, od_route_t, link);
-		if (route->rule == rule &&
+		route = od_container_of(i, od_route_t, hash_link);
+		if (route->hash == hash && route->rule == rule &&
 		    od_route_id_compare(&route->id, key)) {
 			return route;
 		}
@@ -11,9 +11,14 @@
 #include <rules.h>
 #include <route_pool.h>
 #include <router_cancel.h>
+#include <connect_factory.h>
 
 struct od_router {
-	pthread_mutex_t lock;
+	/*
+	 * routing lookups and iteration over routes take the lock shared,
+	 * only rules reload and route creation or removal take it exclusively
+	 */
+	pthread_rwlock_t lock;
 
 	od_rules_t rules;
 	od_route_pool_t route_pool;
@@ -22,6 +27,7 @@ struct od_router {
 	od_atomic_u32_t clients_routing;
 	/* servers */
 	od_atomic_u32_t servers_routing;
+	od_connect_factory_t connect_factory;
 	/* error logging */
 	od_error_logger_t *router_err_logger;
 
@@ -32,8 +38,9 @@ struct od_router {
 	od_list_t servers;
 };
 
-#define od_router_lock(router) pthread_mutex_lock(&router->lock);
-#define od_router_unlock(router) pthread_mutex_unlock(&router->lock);
+#define od_router_lock(router) pthread_rwlock_wrlock(&router->lock);
+#define od_router_rdlock(router) pthread_rwlock_rdlock(&router->lock);
+#define od_router_unlock(router) pthread_rwlock_unlock(&router->lock);
 
 void od_router_init(od_router_t *, od_global_t *);
 void od_router_free(od_router_t *);
@@ -41,6 +48,8 @@ void od_router_free(od_router_t *);
 int od_router_reconfigure(od_router_t *, od_rules_t *);
 int od_router_expire(od_router_t *, od_list_t *);
 void od_router_keep_min_pool_size_step(od_router_t *);
+int od_router_warmup_step(od_router_t *);
+int od_router_deploy_stmts_step(od_router_t *);
 void od_router_gc(od_router_t *);
 void od_router_stat(od_router_t *, uint64_t,
 #ifdef PROM_FOUND
@@ -6,6 +6,8 @@
  * Scalable PostgreSQL connection pooler.
  */
 
+#include <stdatomic.h>
+
 #include <address.h>
 #include <pam.h>
 #include <group.h>
@@ -103,7 +105,8 @@ struct od_rule {
 	/* versioning */
 	int mark;
 	int obsolete;
-	int refs;
+	/* taken under shared router lock, so must be atomic */
+	atomic_int_fast64_t refs;
 	int order;
 
 	/* id */
@@ -214,6 +217,10 @@ struct od_rules {
 #endif
 	od_list_t rules;
 	int next_order;
+	/* compiled from rules on every sort, NULL if compilation failed */
+	od_rules_matcher_t *matcher;
+	/* some rule matches client host name, set on every sort */
+	int has_hostnames;
 
 	machine_wait_flag_t *destroy_flag;
 };
@@ -245,8 +252,13 @@ void od_rules_ref(od_rule_t *);
 void od_rules_unref(od_rule_t *);
 int od_rules_compare(od_rule_t *, od_rule_t *);
 
+/* user_hostname is the resolved name of user_addr, NULL if unknown */
 od_rule_t *od_rules_forward(od_rules_t *, const kiwi_be_startup_t *startup,
-			    struct sockaddr_storage *, int);
+			    struct sockaddr_storage *,
+			    const char *user_hostname, int);
+int od_rule_matches(const od_rule_t *rule, const kiwi_be_startup_t *startup,
+		    struct sockaddr_storage *user_addr,
+		    const char *user_hostname, int pool_internal);
 
 /* search rule with desored characteristik */
 od_rule_t *od_rules_match(od_rules_t *rules, const char *db_name,
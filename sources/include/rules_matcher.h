@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <types.h>
+#include <list.h>
+#include <murmurhash.h>
+
+/*
+ * Compiled form of the sorted rules list.
+ *
+ * Rules are grouped into buckets by exact db and user names
+ * (default and group rules go to the wildcard buckets) and inside the bucket
+ * by address range: ipv4 and ipv6 prefixes are kept in binary radix trees,
+ * everything else is scanned linearly.
+ *
+ * Every rule remembers its position in the rules list, so lookup returns
+ * the same first matching rule as the linear scan would.
+ */
+
+typedef struct {
+	od_rule_t *rule;
+	int index;
+} od_rules_matcher_entry_t;
+
+typedef struct {
+	od_rules_matcher_entry_t *items;
+	size_t count;
+	size_t capacity;
+} od_rules_matcher_entries_t;
+
+typedef struct od_rules_matcher_node od_rules_matcher_node_t;
+
+struct od_rules_matcher_node {
+	od_rules_matcher_node_t *child[2];
+	od_rules_matcher_entries_t entries;
+};
+
+typedef struct od_rules_matcher_bucket od_rules_matcher_bucket_t;
+
+struct od_rules_matcher_bucket {
+	/* NULL means any */
+	const char *db_name;
+	const char *user_name;
+	od_hash_t hash;
+
+	od_rules_matcher_entries_t linear;
+	od_rules_matcher_node_t *inet;
+	od_rules_matcher_node_t *inet6;
+
+	od_rules_matcher_bucket_t *next;
+};
+
+struct od_rules_matcher {
+	od_rules_matcher_bucket_t **buckets;
+	size_t buckets_count;
+	size_t rules_count;
+};
+
+od_rules_matcher_t *od_rules_matcher_create(od_list_t *rules);
+void od_rules_matcher_free(od_rules_matcher_t *matcher);
+
+od_rule_t *od_rules_matcher_find(od_rules_matcher_t *matcher,
+				 const kiwi_be_startup_t *startup,
+				 struct sockaddr_storage *user_addr,
+				 const char *user_hostname, int pool_internal);
@@ -14,9 +14,13 @@
 #include <id.h>
 #include <stat.h>
 #include <hashmap.h>
+#include <server_prep_stmts.h>
+#include <parse_queue.h>
+#include <pairing_heap.h>
 #include <od_memory.h>
 #include <build.h>
 #include <scram.h>
+#include <storage.h>
 
 typedef enum {
 	OD_SERVER_UNDEF,
@@ -59,17 +63,25 @@ struct od_server {
 	od_stat_state_t stats_state;
 
 	od_multi_pool_element_t *pool_element;
+	/*
+	 * stats of the endpoint server is connected to, not referenced:
+	 * kept by the storage of the route rule
+	 */
+	od_storage_endpoint_stats_t *endpoint_stats;
 
 	uint64_t sync_request;
 	uint64_t sync_reply;
 
-	/* to swallow some internal msgs */
-	machine_msg_t *parse_msg;
-	int idle_time;
+	/* to swallow ParseComplete of internal Parse */
+	od_parse_queue_t parse_queue;
 
 	kiwi_key_t key;
 	kiwi_key_t key_client;
 	kiwi_vars_t vars;
+	/* kiwi_vars_fingerprint of vars, updated when server becomes idle */
+	uint64_t vars_fingerprint;
+	/* od_session_state_t flags since the last reset */
+	int session_state;
 
 	machine_msg_t *error_connect;
 	/* do not set this field directly, use od_server_attach_client */
@@ -78,7 +90,7 @@ struct od_server {
 	od_route_t *route;
 
 	/* allocated prepared statements ids */
-	od_hashmap_t *prep_stmts;
+	od_server_prep_stmts_t *prep_stmts;
 	int sync_point;
 	machine_msg_t *sync_point_deploy_msg;
 
@@ -87,6 +99,11 @@ struct od_server {
 	od_global_t *global;
 	int offline;
 	uint64_t init_time_us;
+	/* init_time_us + jittered server_lifetime, 0 if disabled */
+	uint64_t lifetime_deadline_us;
+	uint64_t idle_since_us;
+	/* in the pool expire heap while idle */
+	od_pairing_heap_node_t expire_node;
 	bool synced_settings;
 
 	od_list_t link;
@@ -94,7 +111,8 @@ struct od_server {
 	int need_startup;
 };
 
-static const size_t OD_SERVER_DEFAULT_HASHMAP_SZ = 420;
+/* initial capacity, grows on demand */
+static const size_t OD_SERVER_DEFAULT_HASHMAP_SZ = 16;
 
 static inline void od_server_init(od_server_t *server, int reserve_prep_stmts)
 {
@@ -105,7 +123,6 @@ static inline void od_server_init(od_server_t *server, int reserve_prep_stmts)
 	server->client = NULL;
 	server->global = NULL;
 	server->tls = NULL;
-	server->idle_time = 0;
 	server->is_transaction = 0;
 	server->done_fail_response_received = 0;
 	server->in_out_response_received = 0;
@@ -114,7 +131,7 @@ static inline void od_server_init(od_server_t *server, int reserve_prep_stmts)
 	server->sync_reply = 0;
 	server->sync_point = 0;
 	server->sync_point_deploy_msg = NULL;
-	server->parse_msg = NULL;
+	od_parse_queue_init(&server->parse_queue);
 	server->init_time_us = machine_time_us();
 	server->error_connect = NULL;
 	server->offline = 0;
@@ -130,6 +147,7 @@ static inline void od_server_init(od_server_t *server, int reserve_prep_stmts)
 	kiwi_key_init(&server->key);
 	kiwi_key_init(&server->key_client);
 	kiwi_vars_init(&server->vars);
+	server->vars_fingerprint = kiwi_vars_fingerprint(&server->vars);
 
 	od_io_init(&server->io);
 	od_relay_init(&server->relay, &server->io);
@@ -137,8 +155,8 @@ static inline void od_server_init(od_server_t *server, int reserve_prep_stmts)
 	memset(&server->id, 0, sizeof(server->id));
 
 	if (reserve_prep_stmts) {
-		server->prep_stmts =
-			od_hashmap_create(OD_SERVER_DEFAULT_HASHMAP_SZ);
+		server->prep_stmts = od_server_prep_stmts_create(
+			OD_SERVER_DEFAULT_HASHMAP_SZ);
 	} else {
 		server->prep_stmts = NULL;
 	}
@@ -188,5 +206,9 @@ static inline int od_server_synchronized(od_server_t *server)
 od_server_pool_t *od_server_pool(od_server_t *server);
 const od_address_t *od_server_pool_address(od_server_t *server);
 void od_server_set_pool_state(od_server_t *server, od_server_state_t state);
+/* keeps idle time of a server reserved for a while, for pool_ttl */
+void od_server_set_idle_since(od_server_t *server, uint64_t idle_since_us);
+/* route lock must be held */
+void od_server_set_offline(od_server_t *server);
 void od_server_cancel_begin(od_server_t *server);
 void od_server_cancel_end(od_server_t *server);
@@ -13,17 +13,37 @@
 
 typedef int (*od_server_pool_cb_t)(od_server_t *, void **);
 
+struct od_server_pool_counters {
+	int count_active;
+	int count_idle;
+};
+
+#define OD_SERVER_POOL_PARENTS_MAX 3
+
 struct od_server_pool {
 	od_list_t active;
 	od_list_t idle;
 	int count_active;
 	int count_idle;
+
+	/* idle servers by expire deadline, see od_server_set_pool_state */
+	od_pairing_heap_t expire;
+
+	/*
+	 * counters of the groups this pool belongs to,
+	 * updated together with the pool own counters
+	 */
+	od_server_pool_counters_t *parents[OD_SERVER_POOL_PARENTS_MAX];
 };
 
 static inline void od_server_pool_init(od_server_pool_t *pool)
 {
 	pool->count_active = 0;
 	pool->count_idle = 0;
+	od_pairing_heap_init(&pool->expire);
+	for (int i = 0; i < OD_SERVER_POOL_PARENTS_MAX; i++) {
+		pool->parents[i] = NULL;
+	}
 	od_list_init(&pool->idle);
 	od_list_init(&pool->active);
 }
@@ -52,22 +72,51 @@ OD_SERVER_POOL_FREE_DECLARE(pg, od_server_t, od_server_free)
 OD_SERVER_POOL_FREE_DECLARE(ldap, od_ldap_server_t, od_ldap_server_free)
 #endif
 
+static inline void
+od_server_pool_counters_add(od_server_pool_counters_t *counters,
+			    od_server_state_t state, int delta)
+{
+	switch (state) {
+	case OD_SERVER_IDLE:
+		counters->count_idle += delta;
+		break;
+	case OD_SERVER_ACTIVE:
+		counters->count_active += delta;
+		break;
+	case OD_SERVER_UNDEF:
+		break;
+	}
+}
+
+static inline void od_server_pool_count(od_server_pool_t *pool,
+					od_server_state_t state, int delta)
+{
+	switch (state) {
+	case OD_SERVER_IDLE:
+		pool->count_idle += delta;
+		break;
+	case OD_SERVER_ACTIVE:
+		pool->count_active += delta;
+		break;
+	case OD_SERVER_UNDEF:
+		return;
+	}
+
+	for (int i = 0; i < OD_SERVER_POOL_PARENTS_MAX; i++) {
+		if (pool->parents[i] != NULL) {
+			od_server_pool_counters_add(pool->parents[i], state,
+						    delta);
+		}
+	}
+}
+
 #define OD_SERVER_POOL_SET_DECLARE(name, type)                                 \
 	static inline void od_##name##_server_pool_set(                        \
 		od_server_pool_t *pool, type *server, od_server_state_t state) \
 	{                                                                      \
 		if (server->state == state)                                    \
 			return;                                                \
-		switch (server->state) {                                       \
-		case OD_SERVER_UNDEF:                                          \
-			break;                                                 \
-		case OD_SERVER_IDLE:                                           \
-			pool->count_idle--;                                    \
-			break;                                                 \
-		case OD_SERVER_ACTIVE:                                         \
-			pool->count_active--;                                  \
-			break;                                                 \
-		}                                                              \
+		od_server_pool_count(pool, server->state, -1);                 \
                                                                                \
 		od_list_t *target = NULL;                                      \
 		switch (state) {                                               \
@@ -75,13 +124,12 @@ OD_SERVER_POOL_FREE_DECLARE(ldap, od_ldap_server_t, od_ldap_server_free)
 			break;                                                 \
 		case OD_SERVER_IDLE:                                           \
 			target = &pool->idle;                                  \
-			pool->count_idle++;                                    \
 			break;                                                 \
 		case OD_SERVER_ACTIVE:                                         \
 			target = &pool->active;                                \
-			pool->count_active++;                                  \
 			break;                                                 \
 		}                                                              \
+		od_server_pool_count(pool, state, 1);                          \
                                                                                \
 		od_list_unlink(&server->link);                                 \
 		od_list_init(&server->link);                                   \
@@ -129,6 +177,30 @@ OD_SERVER_POOL_NEXT_DECLARE(pg, od_server_t)
 OD_SERVER_POOL_NEXT_DECLARE(ldap, od_ldap_server_t)
 #endif
 
+#define OD_SERVER_POOL_MATCH_SCAN_MAX 16
+
+/*
+ * look for an idle server with the same parameters fingerprint
+ * among the most recently used ones
+ */
+static inline od_server_t *
+od_server_pool_next_idle_matching(od_server_pool_t *pool,
+				  uint64_t vars_fingerprint)
+{
+	int scanned = 0;
+	od_list_t *i;
+	od_list_foreach (&pool->idle, i) {
+		if (scanned++ == OD_SERVER_POOL_MATCH_SCAN_MAX) {
+			break;
+		}
+		od_server_t *server = od_container_of(i, od_server_t, link);
+		if (server->vars_fingerprint == vars_fingerprint) {
+			return server;
+		}
+	}
+	return NULL;
+}
+
 static inline od_server_t *od_server_pool_foreach(od_server_pool_t *pool,
 						  od_server_state_t state,
 						  od_server_pool_cb_t callback,
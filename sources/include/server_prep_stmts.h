@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+/*
+ * Prepared statements deployed to a server connection.
+ *
+ * Statements are indexed by interned body and kept in LRU order.
+ * When the configured count or bytes limit is exceeded, least recently
+ * used statements are deallocated on the server on reset, while no
+ * client is attached, so no pipelined Bind can refer to them.
+ */
+
+#include <util.h>
+#include <hashmap.h>
+#include <lhashmap.h>
+#include <list.h>
+#include <prep_stmt_registry.h>
+
+typedef struct od_server_prep_stmts od_server_prep_stmts_t;
+typedef struct od_server_prep_stmt od_server_prep_stmt_t;
+
+/* server side statement name is the body hash in hex */
+#define OD_SERVER_PREP_STMT_NAME_LEN 9
+
+struct od_server_prep_stmt {
+	od_server_prep_stmts_t *owner;
+	/* referenced, the pointer is the index key */
+	od_prep_stmt_body_t *body;
+	od_list_t link;
+};
+
+struct od_server_prep_stmts {
+	od_lhashmap_t *index;
+	/* most recently used first */
+	od_list_t lru;
+	size_t count;
+	size_t bytes;
+};
+
+od_server_prep_stmts_t *od_server_prep_stmts_create(size_t capacity);
+void od_server_prep_stmts_free(od_server_prep_stmts_t *);
+void od_server_prep_stmts_empty(od_server_prep_stmts_t *);
+
+/* does not change the LRU order */
+int od_server_prep_stmts_contains(od_server_prep_stmts_t *,
+				  od_prep_stmt_body_t *);
+
+/* returns 1 if statement is already deployed, 0 if added, -1 on error */
+int od_server_prep_stmts_use(od_server_prep_stmts_t *, od_prep_stmt_body_t *);
+
+/*
+ * writes DEALLOCATE of the least recently used statements, enough to go
+ * down to 3/4 of the limits (0 means unlimited), but no more than max
+ *
+ * returns number of statements in query, 0 if nothing to evict
+ */
+int od_server_prep_stmts_evict_query(od_server_prep_stmts_t *,
+				     size_t max_count, size_t max_bytes,
+				     int max, char *query, size_t size);
+
+/* removes n least recently used statements */
+void od_server_prep_stmts_evict(od_server_prep_stmts_t *, int n);
+
+/*
+ * DISCARD ALL and DEALLOCATE ALL drop all prepared statements,
+ * DISCARD PLANS, TEMP and SEQUENCES keep them
+ */
+static inline int od_server_prep_stmts_query_drops_all(const char *query,
+						       size_t len)
+{
+	size_t pos = 0;
+	const char *words[2];
+	size_t words_len[2];
+	int count = 0;
+
+	while (count < 2) {
+		while (pos < len && isspace((unsigned char)query[pos])) {
+			pos++;
+		}
+		size_t start = pos;
+		while (pos < len && isalpha((unsigned char)query[pos])) {
+			pos++;
+		}
+		if (pos == start) {
+			break;
+		}
+		words[count] = query + start;
+		words_len[count] = pos - start;
+		count++;
+	}
+
+	if (count < 2 || words_len[1] != 3 ||
+	    strncasecmp(words[1], "ALL", 3) != 0) {
+		return 0;
+	}
+	if (words_len[0] == 7 && strncasecmp(words[0], "DISCARD", 7) == 0) {
+		return 1;
+	}
+	if (words_len[0] == 10 &&
+	    strncasecmp(words[0], "DEALLOCATE", 10) == 0) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <ctype.h>
+
+#include <util.h>
+
+/*
+ * Server session state created by clients.
+ *
+ * Tracked from CommandComplete tags, ParameterStatus messages and
+ * a scan of client query texts for state without a distinct tag, like
+ * advisory locks, set_config() or CREATE TEMP TABLE AS and SELECT INTO
+ * TEMP (both are tagged SELECT), so reset can run only the statements
+ * needed to clean the session.
+ */
+
+typedef enum {
+	OD_SESSION_STATE_SET = 1 << 0,
+	OD_SESSION_STATE_LISTEN = 1 << 1,
+	OD_SESSION_STATE_CURSOR = 1 << 2,
+	OD_SESSION_STATE_TEMP = 1 << 3,
+	OD_SESSION_STATE_PREPARE = 1 << 4,
+	OD_SESSION_STATE_ADVISORY = 1 << 5,
+	/* cannot be reset partially, DISCARD ALL is required */
+	OD_SESSION_STATE_UNKNOWN = 1 << 6,
+} od_session_state_t;
+
+static inline int od_session_state_tag_is(const char *tag, const char *name)
+{
+	size_t len = strlen(name);
+	return strncmp(tag, name, len) == 0 &&
+	       (tag[len] == '\0' || tag[len] == ' ');
+}
+
+/* returns -1 if the tag resets all session state */
+static inline int od_session_state_from_tag(const char *tag)
+{
+	if (od_session_state_tag_is(tag, "DISCARD ALL")) {
+		return -1;
+	}
+	if (od_session_state_tag_is(tag, "SET") ||
+	    od_session_state_tag_is(tag, "RESET")) {
+		return OD_SESSION_STATE_SET;
+	}
+	if (od_session_state_tag_is(tag, "LISTEN")) {
+		return OD_SESSION_STATE_LISTEN;
+	}
+	if (od_session_state_tag_is(tag, "DECLARE CURSOR")) {
+		return OD_SESSION_STATE_CURSOR;
+	}
+	if (od_session_state_tag_is(tag, "CREATE TABLE") ||
+	    od_session_state_tag_is(tag, "CREATE VIEW") ||
+	    od_session_state_tag_is(tag, "CREATE SEQUENCE")) {
+		return OD_SESSION_STATE_TEMP;
+	}
+	if (od_session_state_tag_is(tag, "PREPARE")) {
+		return OD_SESSION_STATE_PREPARE;
+	}
+	if (od_session_state_tag_is(tag, "LOAD")) {
+		return OD_SESSION_STATE_UNKNOWN;
+	}
+	return 0;
+}
+
+static inline int od_session_state_ident_char(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+/* returns position after the literal, comment or quoted name at pos */
+static inline size_t od_session_state_skip(const char *query, size_t len,
+					   size_t pos)
+{
+	if (query[pos] == '\'' || query[pos] == '"') {
+		/* doubled quote is a part of it, scanned as two */
+		char quote = query[pos++];
+		while (pos < len && query[pos] != quote) {
+			pos++;
+		}
+		return pos + 1;
+	}
+	if (query[pos] == '-' && pos + 1 < len && query[pos + 1] == '-') {
+		while (pos < len && query[pos] != '\n') {
+			pos++;
+		}
+		return pos;
+	}
+	if (query[pos] == '/' && pos + 1 < len && query[pos + 1] == '*') {
+		for (pos += 2; pos + 1 < len; pos++) {
+			if (query[pos] == '*' && query[pos + 1] == '/') {
+				return pos + 2;
+			}
+		}
+		return len;
+	}
+	if (query[pos] == '$') {
+		/* $tag$ ... $tag$ */
+		size_t tag = pos++;
+		while (pos < len && od_session_state_ident_char(query[pos]) &&
+		       query[pos] != '$') {
+			pos++;
+		}
+		if (pos >= len || query[pos] != '$') {
+			return pos;
+		}
+		size_t tag_len = pos - tag + 1;
+		for (pos++; pos + tag_len <= len; pos++) {
+			if (memcmp(query + pos, query + tag, tag_len) == 0) {
+				return pos + tag_len;
+			}
+		}
+		return len;
+	}
+	return pos + 1;
+}
+
+static inline int od_session_state_word_is(const char *word, size_t len,
+					   const char *name)
+{
+	return strlen(name) == len && strncasecmp(word, name, len) == 0;
+}
+
+static inline int od_session_state_from_word(const char *word, size_t len,
+					     int call)
+{
+	if (od_session_state_word_is(word, len, "temp") ||
+	    od_session_state_word_is(word, len, "temporary") ||
+	    od_session_state_word_is(word, len, "pg_temp")) {
+		return OD_SESSION_STATE_TEMP;
+	}
+	if (!call) {
+		return 0;
+	}
+	if (len > 12 && strncasecmp(word, "pg_advisory_", 12) == 0) {
+		return OD_SESSION_STATE_ADVISORY;
+	}
+	if (od_session_state_word_is(word, len, "set_config")) {
+		return OD_SESSION_STATE_SET;
+	}
+	return 0;
+}
+
+/*
+ * TEMP, TEMPORARY and pg_temp are matched as keywords, advisory lock
+ * functions and set_config() as called function names; literals,
+ * comments and quoted names are skipped
+ */
+static inline int od_session_state_from_query(const char *query, size_t len)
+{
+	int state = 0;
+	size_t pos = 0;
+	while (pos < len) {
+		char c = query[pos];
+		if (!isalpha((unsigned char)c) && c != '_') {
+			pos = od_session_state_skip(query, len, pos);
+			continue;
+		}
+
+		size_t word = pos;
+		while (pos < len && od_session_state_ident_char(query[pos])) {
+			pos++;
+		}
+		size_t next = pos;
+		while (next < len && isspace((unsigned char)query[next])) {
+			next++;
+		}
+		int call = next < len && query[next] == '(';
+		state |= od_session_state_from_word(query + word, pos - word,
+						    call);
+	}
+	return state;
+}
+
+/*
+ * named statements and portals of the extended protocol outlive the
+ * message, name_len includes 0-byte
+ */
+static inline int od_session_state_from_name(uint32_t name_len)
+{
+	if (name_len > 1) {
+		return OD_SESSION_STATE_PREPARE;
+	}
+	return 0;
+}
+
+/*
+ * writes statements which reset the state into buf,
+ * returns query length including 0-byte, 0 if nothing to reset
+ */
+static inline size_t od_session_state_reset_query(int state, int keep_prepared,
+						  char *buf, size_t size)
+{
+	if (state == 0) {
+		return 0;
+	}
+
+	if (state & OD_SESSION_STATE_UNKNOWN) {
+		if (keep_prepared) {
+			return od_snprintf(
+				       buf, size,
+				       "SET SESSION AUTHORIZATION DEFAULT;"
+				       "RESET ALL;CLOSE ALL;UNLISTEN *;"
+				       "SELECT pg_advisory_unlock_all();"
+				       "DISCARD PLANS;DISCARD SEQUENCES;"
+				       "DISCARD TEMP;") +
+			       1;
+		}
+		return od_snprintf(buf, size, "DISCARD ALL") + 1;
+	}
+
+	size_t pos = 0;
+	buf[0] = '\0';
+	if (state & OD_SESSION_STATE_SET) {
+		pos += od_snprintf(buf + pos, size - pos,
+				   "SET SESSION AUTHORIZATION DEFAULT;"
+				   "RESET ALL;");
+	}
+	if (state & OD_SESSION_STATE_CURSOR) {
+		pos += od_snprintf(buf + pos, size - pos, "CLOSE ALL;");
+	}
+	if (state & OD_SESSION_STATE_LISTEN) {
+		pos += od_snprintf(buf + pos, size - pos, "UNLISTEN *;");
+	}
+	if (state & OD_SESSION_STATE_ADVISORY) {
+		pos += od_snprintf(buf + pos, size - pos,
+				   "SELECT pg_advisory_unlock_all();");
+	}
+	if (state & OD_SESSION_STATE_TEMP) {
+		pos += od_snprintf(buf + pos, size - pos, "DISCARD TEMP;");
+	}
+	if ((state & OD_SESSION_STATE_PREPARE) && !keep_prepared) {
+		pos += od_snprintf(buf + pos, size - pos, "DEALLOCATE ALL;");
+	}
+	if (pos == 0) {
+		return 0;
+	}
+	return pos + 1;
+}
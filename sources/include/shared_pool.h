@@ -10,13 +10,18 @@
 
 #include <types.h>
 #include <list.h>
+#include <admission.h>
 
 struct od_shared_pool {
 	od_multi_pool_t *mpool;
+	/* clients of all routes waiting for a server */
+	od_admission_t admission;
 	pthread_spinlock_t lock;
 	char *name;
 	od_list_t link;
 	int pool_size; /* TODO: use full od_rule_pool_t here? */
+	/* sum of shared_pool_min_size of the rules, for validation */
+	int reserved;
 	int refs;
 };
 
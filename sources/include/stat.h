@@ -34,6 +34,10 @@ struct od_stat {
 	od_atomic_u64_t recv_client;
 	od_atomic_u64_t count_parse;
 	od_atomic_u64_t count_parse_reuse;
+	od_atomic_u64_t count_deploy_avoided;
+	od_atomic_u64_t count_reset_avoided;
+	od_atomic_u64_t count_parse_evict;
+	od_atomic_u64_t count_parse_deploy;
 
 	td_histogram_t *transaction_hgram[QUANTILES_WINDOW];
 	td_histogram_t *query_hgram[QUANTILES_WINDOW];
@@ -78,6 +82,26 @@ static inline void od_stat_parse_reuse(od_stat_t *stat)
 	od_atomic_u64_inc(&stat->count_parse_reuse);
 }
 
+static inline void od_stat_parse_evict(od_stat_t *stat, uint64_t count)
+{
+	od_atomic_u64_add(&stat->count_parse_evict, count);
+}
+
+static inline void od_stat_parse_deploy(od_stat_t *stat, uint64_t count)
+{
+	od_atomic_u64_add(&stat->count_parse_deploy, count);
+}
+
+static inline void od_stat_deploy_avoided(od_stat_t *stat)
+{
+	od_atomic_u64_inc(&stat->count_deploy_avoided);
+}
+
+static inline void od_stat_reset_avoided(od_stat_t *stat)
+{
+	od_atomic_u64_inc(&stat->count_reset_avoided);
+}
+
 static inline void od_stat_query_end(od_stat_t *stat, od_stat_state_t *state,
 				     int in_transaction, int64_t *query_time)
 {
@@ -135,6 +159,11 @@ static inline void od_stat_copy(od_stat_t *dst, od_stat_t *src)
 	dst->recv_server = od_atomic_u64_of(&src->recv_server);
 	dst->count_parse = od_atomic_u64_of(&src->count_parse);
 	dst->count_parse_reuse = od_atomic_u64_of(&src->count_parse_reuse);
+	dst->count_deploy_avoided =
+		od_atomic_u64_of(&src->count_deploy_avoided);
+	dst->count_reset_avoided = od_atomic_u64_of(&src->count_reset_avoided);
+	dst->count_parse_evict = od_atomic_u64_of(&src->count_parse_evict);
+	dst->count_parse_deploy = od_atomic_u64_of(&src->count_parse_deploy);
 }
 
 static inline void od_stat_sum(od_stat_t *sum, od_stat_t *stat)
@@ -147,6 +176,12 @@ static inline void od_stat_sum(od_stat_t *sum, od_stat_t *stat)
 	sum->recv_server += od_atomic_u64_of(&stat->recv_server);
 	sum->count_parse += od_atomic_u64_of(&stat->count_parse);
 	sum->count_parse_reuse += od_atomic_u64_of(&stat->count_parse_reuse);
+	sum->count_deploy_avoided +=
+		od_atomic_u64_of(&stat->count_deploy_avoided);
+	sum->count_reset_avoided +=
+		od_atomic_u64_of(&stat->count_reset_avoided);
+	sum->count_parse_evict += od_atomic_u64_of(&stat->count_parse_evict);
+	sum->count_parse_deploy += od_atomic_u64_of(&stat->count_parse_deploy);
 }
 
 static inline void od_stat_update_of(od_atomic_u64_t *prev,
@@ -167,6 +202,12 @@ static inline void od_stat_update(od_stat_t *dst, od_stat_t *stat)
 	od_stat_update_of(&dst->recv_server, &stat->recv_server);
 	od_stat_update_of(&dst->count_parse, &stat->count_parse);
 	od_stat_update_of(&dst->count_parse_reuse, &stat->count_parse_reuse);
+	od_stat_update_of(&dst->count_deploy_avoided,
+			  &stat->count_deploy_avoided);
+	od_stat_update_of(&dst->count_reset_avoided,
+			  &stat->count_reset_avoided);
+	od_stat_update_of(&dst->count_parse_evict, &stat->count_parse_evict);
+	od_stat_update_of(&dst->count_parse_deploy, &stat->count_parse_deploy);
 }
 
 static inline void od_stat_average(od_stat_t *avg, od_stat_t *current,
@@ -21,6 +21,7 @@ typedef enum {
 	OD_EATTACH,
 	OD_EATTACH_TOO_MANY_CONNECTIONS,
 	OD_EATTACH_TARGET_SESSION_ATTRS_MISMATCH,
+	OD_EATTACH_SHARD_KEY,
 	OD_ESERVER_CONNECT,
 	OD_ESERVER_READ,
 	OD_ESERVER_WRITE,
@@ -61,6 +62,8 @@ static inline char *od_frontend_status_to_str(od_frontend_status_t status)
 		return "OD_EATTACH_TOO_MANY_CONNECTIONS";
 	case OD_EATTACH_TARGET_SESSION_ATTRS_MISMATCH:
 		return "OD_EATTACH_TARGET_SESSION_ATTRS_MISMATCH";
+	case OD_EATTACH_SHARD_KEY:
+		return "OD_EATTACH_SHARD_KEY";
 	case OD_ESERVER_CONNECT:
 		return "OD_ESERVER_CONNECT";
 	case OD_ESERVER_READ:
@@ -90,6 +93,7 @@ static const od_frontend_status_t od_frontend_status_errs[] = {
 	OD_EATTACH,
 	OD_EATTACH_TOO_MANY_CONNECTIONS,
 	OD_EATTACH_TARGET_SESSION_ATTRS_MISMATCH,
+	OD_EATTACH_SHARD_KEY,
 	OD_ESERVER_CONNECT,
 	OD_ESERVER_READ,
 	OD_ESERVER_WRITE,
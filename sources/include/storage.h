@@ -15,6 +15,8 @@
 #include <pool.h>
 #include <od_memory.h>
 #include <address.h>
+#include <atomic.h>
+#include <list.h>
 
 typedef struct od_rule_storage od_rule_storage_t;
 typedef struct od_storage_watchdog od_storage_watchdog_t;
@@ -33,7 +35,9 @@ struct od_storage_watchdog {
 	char *storage_db;
 
 	char *query;
+	/* not used, kept for config compatibility */
 	int interval;
+	int poll_interval_ms;
 
 	/* soft shutdown on reload */
 	pthread_mutex_t mu;
@@ -44,6 +48,7 @@ struct od_storage_watchdog {
 	od_rule_storage_t *storage;
 
 	machine_wait_flag_t *is_finished;
+	machine_wait_flag_t *monitor_is_finished;
 };
 
 od_storage_watchdog_t *od_storage_watchdog_allocate(od_global_t *);
@@ -69,12 +74,111 @@ void od_storage_endpoint_status_set(od_storage_endpoint_status_t *status,
 				    const od_storage_endpoint_status_t *value);
 void od_storage_endpoint_status_set_dead(od_storage_endpoint_status_t *status);
 
+/*
+ * Endpoint latency and error rate.
+ *
+ * Kept per address in a process-wide list, so copies of the storage in
+ * every rule and in the configs before and after reload share them.
+ * Values are EWMA of samples in fixed point.
+ */
+typedef struct od_storage_endpoint_stats od_storage_endpoint_stats_t;
+
+#define OD_STORAGE_ENDPOINT_STATS_SHIFT 4
+/* error rate of 1 */
+#define OD_STORAGE_ENDPOINT_STATS_ERROR 1024
+/* score penalty of an endpoint which only fails */
+#define OD_STORAGE_ENDPOINT_STATS_ERROR_PENALTY_US 1000000
+
+struct od_storage_endpoint_stats {
+	od_address_t address;
+	/* guarded by the list lock */
+	int refs;
+
+	/* microseconds */
+	od_atomic_u64_t query_time;
+	od_atomic_u64_t connect_time;
+	/* failed connects share */
+	od_atomic_u64_t error_rate;
+
+	od_atomic_u64_t count_query;
+	od_atomic_u64_t count_connect;
+	od_atomic_u64_t count_error;
+
+	/* read-write status, refreshed by one coroutine at a time */
+	od_storage_endpoint_status_t status;
+	od_atomic_u64_t status_refreshing;
+
+	od_list_t link;
+};
+
+/* returns referenced stats of the address, NULL on error */
+od_storage_endpoint_stats_t *
+od_storage_endpoint_stats_get(const od_address_t *address);
+void od_storage_endpoint_stats_unref(od_storage_endpoint_stats_t *stats);
+
+void od_storage_endpoint_stats_query(od_storage_endpoint_stats_t *stats,
+				     uint64_t time_us);
+void od_storage_endpoint_stats_connect(od_storage_endpoint_stats_t *stats,
+				       uint64_t time_us, int failed);
+
+/* estimated cost of the endpoint in microseconds, lower is better */
+uint64_t od_storage_endpoint_stats_score(od_storage_endpoint_stats_t *stats);
+
 struct od_storage_endpoint {
 	od_address_t address;
 
+	/* used until the stats are set */
 	od_storage_endpoint_status_t status;
+
+	/* referenced, set on rules validation */
+	od_storage_endpoint_stats_t *stats;
+
+	/* index of the shard storage for sharded storage, 0 otherwise */
+	int shard;
 };
 
+/* status shared by all storages with the endpoint address */
+static inline od_storage_endpoint_status_t *
+od_storage_endpoint_status_of(od_storage_endpoint_t *endpoint)
+{
+	if (endpoint->stats != NULL) {
+		return &endpoint->stats->status;
+	}
+	return &endpoint->status;
+}
+
+/*
+ * returns 1 if the caller has to refresh the status and then call
+ * od_storage_endpoint_status_refresh_end, 0 if it is being refreshed
+ */
+int od_storage_endpoint_status_refresh_begin(od_storage_endpoint_t *);
+void od_storage_endpoint_status_refresh_end(od_storage_endpoint_t *);
+
+typedef enum {
+	OD_STORAGE_LOAD_BALANCE_RANDOM,
+	/* power of two choices by od_storage_endpoint_stats_score */
+	OD_STORAGE_LOAD_BALANCE_LATENCY,
+} od_storage_load_balance_t;
+
+static inline char *
+od_storage_load_balance_to_str(od_storage_load_balance_t load_balance)
+{
+	switch (load_balance) {
+	case OD_STORAGE_LOAD_BALANCE_RANDOM:
+		return "random";
+	case OD_STORAGE_LOAD_BALANCE_LATENCY:
+		return "latency";
+	}
+
+	return "<unknown>";
+}
+
+typedef enum {
+	OD_STORAGE_SHARD_BY_HASH,
+	/* shard_ranges are upper bounds of integer keys */
+	OD_STORAGE_SHARD_BY_RANGE,
+} od_storage_shard_by_t;
+
 int od_storage_parse_endpoints(const char *host_str,
 			       od_storage_endpoint_t **out, size_t *count);
 
@@ -108,6 +212,19 @@ struct od_rule_storage {
 	od_list_t link;
 
 	int endpoints_status_poll_interval_ms;
+
+	od_storage_load_balance_t load_balance;
+
+	/*
+	 * sharded storage: endpoints of the shard storages listed in
+	 * shards, each shard is selected by the key of the client
+	 */
+	char *shards;
+	size_t shards_count;
+	od_storage_shard_by_t shard_by;
+	char *shard_ranges_str;
+	/* shards_count - 1 increasing bounds */
+	int64_t *shard_ranges;
 };
 
 /* storage API */
@@ -120,5 +237,10 @@ od_rules_storage_localhost_or_next_endpoint(od_rule_storage_t *);
 
 void od_rules_storage_free(od_rule_storage_t *);
 
+/* returns shard index of the key, -1 if it matches no shard */
+int od_rules_storage_shard_of(od_rule_storage_t *, const char *key,
+			      int key_len);
+
 /* watchdog */
 void od_storage_watchdog_watch(void *arg);
+void od_storage_endpoints_monitor(void *arg);
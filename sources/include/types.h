@@ -26,9 +26,12 @@ typedef struct od_error_logger od_error_logger_t;
 typedef struct od_server od_server_t;
 typedef struct od_route od_route_t;
 typedef struct od_server_pool od_server_pool_t;
+typedef struct od_server_pool_counters od_server_pool_counters_t;
 typedef struct od_multi_pool_key od_multi_pool_key_t;
 typedef struct od_multi_pool_element od_multi_pool_element_t;
 typedef struct od_multi_pool od_multi_pool_t;
+typedef struct od_multi_pool_group od_multi_pool_group_t;
+typedef struct od_multi_pool_groups od_multi_pool_groups_t;
 typedef struct od_shared_pool od_shared_pool_t;
 typedef struct od_soft_oom_checker od_soft_oom_checker_t;
 typedef struct od_config_listen od_config_listen_t;
@@ -41,3 +44,4 @@ typedef struct od_relay od_relay_t;
 typedef struct od_rule_auth od_rule_auth_t;
 typedef struct od_rule od_rule_t;
 typedef struct od_rules od_rules_t;
+typedef struct od_rules_matcher od_rules_matcher_t;
@@ -500,6 +500,7 @@ int od_instance_main(od_instance_t *instance, int argc, char **argv,
 	/* initialize machinarium */
 	machinarium_set_stack_size(instance->config.coroutine_stack_size);
 	machinarium_set_pool_size(instance->config.resolvers);
+	machinarium_set_offload_pool_size(instance->config.offload_workers);
 	machinarium_set_coroutine_cache_size(instance->config.cache_coroutine);
 	machinarium_set_msg_cache_gc_size(instance->config.cache_msg_gc_size);
 	rc = machinarium_init();
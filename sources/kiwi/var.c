@@ -102,11 +102,14 @@ int kiwi_vars_cas(kiwi_vars_t *client, kiwi_vars_t *server, char *query,
 	for (; type < KIWI_VAR_MAX; type++) {
 		kiwi_var_t *var;
 		var = kiwi_vars_of(client, type);
-		/* we do not support odyssey-to-backend compression yet */
+		/*
+		 * we do not support odyssey-to-backend compression yet,
+		 * odyssey own routing vars are never deployed
+		 */
 		if (var->type == KIWI_VAR_UNDEF ||
 		    var->type == KIWI_VAR_COMPRESSION ||
-		    var->type ==
-			    KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS /* never deploy this one */) {
+		    var->type == KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS ||
+		    var->type == KIWI_VAR_ODYSSEY_SHARD_KEY) {
 			continue;
 		}
 		kiwi_var_t *server_var;
@@ -68,6 +68,78 @@ static inline int od_init_ldap_conn(LDAP **l, char *uri)
 	return OK_RESPONSE;
 }
 
+/*
+ * libldap calls block until the directory answers, they are done on the
+ * offload thread pool, so coroutines of the worker keep running
+ */
+typedef struct {
+	LDAP *conn;
+	char *basedn;
+	char *filter;
+	char **attributes;
+	LDAPMessage **result;
+	char *dn;
+	char *password;
+	int rc;
+} od_ldap_call_t;
+
+static void od_ldap_search_cb(void *arg)
+{
+	od_ldap_call_t *call = arg;
+	call->rc = ldap_search_s(call->conn, call->basedn, LDAP_SCOPE_SUBTREE,
+				 call->filter, call->attributes, 0,
+				 call->result);
+}
+
+static void od_ldap_bind_cb(void *arg)
+{
+	od_ldap_call_t *call = arg;
+	call->rc = ldap_simple_bind_s(call->conn, call->dn, call->password);
+}
+
+static inline int od_ldap_call(od_ldap_endpoint_t *le, od_ldap_call_t *call,
+			       void (*function)(void *),
+			       atomic_uint_fast64_t *count,
+			       atomic_uint_fast64_t *time_us)
+{
+	uint64_t start = machine_time_us();
+	if (machine_offload(function, call) == -1) {
+		call->rc = LDAP_OTHER;
+	}
+	atomic_fetch_add(count, 1);
+	atomic_fetch_add(time_us, machine_time_us() - start);
+	if (call->rc != LDAP_SUCCESS) {
+		atomic_fetch_add(&le->count_error, 1);
+	}
+	return call->rc;
+}
+
+static inline int od_ldap_search(od_ldap_server_t *serv, char *filter,
+				 char **attributes, LDAPMessage **result)
+{
+	od_ldap_endpoint_t *le = serv->endpoint;
+	od_ldap_call_t call = { .conn = serv->conn,
+				.basedn = le->ldapbasedn,
+				.filter = filter,
+				.attributes = attributes,
+				.result = result,
+				.rc = LDAP_SUCCESS };
+	return od_ldap_call(le, &call, od_ldap_search_cb, &le->count_search,
+			    &le->search_time_us);
+}
+
+static inline int od_ldap_bind(od_ldap_server_t *serv, char *dn,
+			       char *password)
+{
+	od_ldap_endpoint_t *le = serv->endpoint;
+	od_ldap_call_t call = { .conn = serv->conn,
+				.dn = dn,
+				.password = password,
+				.rc = LDAP_SUCCESS };
+	return od_ldap_call(le, &call, od_ldap_bind_cb, &le->count_bind,
+			    &le->bind_time_us);
+}
+
 od_retcode_t od_ldap_endpoint_prepare(od_ldap_endpoint_t *le)
 {
 	const char *scheme;
@@ -99,6 +171,7 @@ od_ldap_change_storage_credentials(od_logger_t *logger,
 	client->ldap_storage_username_len = strlen(lsc->lsc_username);
 	client->ldap_storage_password = lsc->lsc_password;
 	client->ldap_storage_password_len = strlen(lsc->lsc_password);
+	client->ldap_storage_credentials_name = lsc->name;
 	od_debug(logger, "auth_ldap", client, NULL,
 		 "storage_user changed to %s", lsc->lsc_username);
 	return OK_RESPONSE;
@@ -182,9 +255,7 @@ od_retcode_t od_ldap_server_prepare(od_logger_t *logger, od_ldap_server_t *serv,
 			od_free(prev_filter);
 		}
 
-		rc = ldap_search_s(serv->conn, serv->endpoint->ldapbasedn,
-				   LDAP_SCOPE_SUBTREE, filter, attributes, 0,
-				   &search_message);
+		rc = od_ldap_search(serv, filter, attributes, &search_message);
 
 		od_debug(logger, "auth_ldap", client, NULL,
 			 "basedn search entries with filter: %s and attrib %s ",
@@ -270,6 +341,9 @@ od_retcode_t od_ldap_server_prepare(od_logger_t *logger, od_ldap_server_t *serv,
 od_ldap_server_t *od_ldap_server_allocate(void)
 {
 	od_ldap_server_t *serv = od_malloc(sizeof(od_ldap_server_t));
+	if (serv == NULL) {
+		return NULL;
+	}
 	serv->conn = NULL;
 	serv->endpoint = NULL;
 
@@ -292,13 +366,9 @@ od_retcode_t od_ldap_server_init(od_logger_t *logger, od_ldap_server_t *server,
 		return NOT_OK_RESPONSE;
 	}
 
-	rc = ldap_simple_bind_s(server->conn,
-				server->endpoint->ldapbinddn ?
-					server->endpoint->ldapbinddn :
-					"",
-				server->endpoint->ldapbindpasswd ?
-					server->endpoint->ldapbindpasswd :
-					"");
+	rc = od_ldap_bind(server,
+			 le->ldapbinddn ? le->ldapbinddn : "",
+			 le->ldapbindpasswd ? le->ldapbindpasswd : "");
 
 	if (rc) {
 		od_error(logger, "auth_ldap", NULL, NULL,
@@ -312,7 +382,7 @@ static inline int od_ldap_server_auth(od_ldap_server_t *serv, od_client_t *cl,
 				      kiwi_password_t *tok)
 {
 	int rc;
-	rc = ldap_simple_bind_s(serv->conn, cl->ldap_auth_dn, tok->password);
+	rc = od_ldap_bind(serv, cl->ldap_auth_dn, tok->password);
 
 	od_route_t *route = cl->route;
 	if (route->rule->client_fwd_error) {
@@ -365,7 +435,6 @@ od_ldap_server_t *od_ldap_server_pull(od_logger_t *logger, od_rule_t *rule,
 						OD_SERVER_UNDEF);
 					od_ldap_server_free(ldap_server);
 					ldap_server = NULL;
-					od_ldap_endpoint_unlock(le);
 					break;
 				}
 			}
@@ -425,8 +494,14 @@ od_ldap_server_t *od_ldap_server_pull(od_logger_t *logger, od_rule_t *rule,
 #endif
 
 	if (ldap_server == NULL) {
+		/* connect and bind without the endpoint lock held */
+		od_ldap_endpoint_unlock(le);
+
 		/* create new server object */
 		ldap_server = od_ldap_server_allocate();
+		if (ldap_server == NULL) {
+			return NULL;
+		}
 
 		int ldap_rc = od_ldap_server_init(logger, ldap_server, rule);
 
@@ -435,19 +510,103 @@ od_ldap_server_t *od_ldap_server_pull(od_logger_t *logger, od_rule_t *rule,
 				 "ldap server initialsize failed (rc=%d)",
 				 ldap_rc);
 			od_ldap_server_free(ldap_server);
-			od_ldap_endpoint_unlock(le);
 			return NULL;
 		}
 #if USE_POOL
+		od_ldap_endpoint_lock(le);
 		od_ldap_server_pool_set(ldap_server_pool, ldap_server,
 					OD_SERVER_ACTIVE);
-#endif
 		od_ldap_endpoint_unlock(le);
+#endif
 	}
 
 	return ldap_server;
 }
 
+static inline void od_ldap_server_release(od_logger_t *logger,
+					  od_ldap_server_t *server,
+					  od_rule_t *rule, od_retcode_t rc)
+{
+	od_ldap_endpoint_t *le = rule->ldap_endpoint;
+	od_ldap_endpoint_lock(le);
+	if (rc == NOT_OK_RESPONSE) {
+		od_debug(logger, "auth_ldap", NULL, NULL,
+			 "closing bad ldap connection, need relogin");
+#if USE_POOL
+		od_ldap_server_pool_set(le->ldap_search_pool, server,
+					OD_SERVER_UNDEF);
+#endif
+		od_ldap_server_free(server);
+	} else {
+		server->idle_timestamp = (int)time(NULL);
+#if USE_POOL
+		od_ldap_server_pool_set(le->ldap_search_pool, server,
+					OD_SERVER_IDLE);
+#else
+		od_ldap_server_free(server);
+#endif
+	}
+	od_ldap_endpoint_unlock(le);
+}
+
+/*
+ * search results of a cached authentication of the client,
+ * the password is checked against the cache on auth
+ */
+static inline int od_ldap_server_search_cached(od_logger_t *logger,
+					       od_rule_t *rule,
+					       od_client_t *client)
+{
+	char *auth_dn;
+	char *lsc_name;
+	if (!od_ldap_cache_find(&rule->ldap_endpoint->cache, rule,
+				client->startup.user.value,
+				client->startup.database.value,
+				machine_time_ms(), &auth_dn, &lsc_name)) {
+		return 0;
+	}
+
+	od_ldap_storage_credentials_t *lsc = NULL;
+	if (lsc_name != NULL) {
+		lsc = od_ldap_storage_credentials_find(
+			&rule->ldap_storage_creds_list, lsc_name);
+		od_free(lsc_name);
+	}
+	if (rule->ldap_storage_credentials_attr && lsc == NULL) {
+		od_free(auth_dn);
+		return 0;
+	}
+	if (lsc != NULL) {
+		od_ldap_change_storage_credentials(logger, lsc, client);
+	}
+
+	od_free(client->ldap_auth_dn);
+	client->ldap_auth_dn = auth_dn;
+	return 1;
+}
+
+od_retcode_t od_ldap_server_search(od_logger_t *logger, od_rule_t *rule,
+				   od_client_t *client)
+{
+	if (od_ldap_server_search_cached(logger, rule, client)) {
+		od_debug(logger, "auth_ldap", client, NULL,
+			 "search result is taken from ldap cache");
+		return OK_RESPONSE;
+	}
+
+	od_ldap_server_t *server = od_ldap_server_pull(logger, rule, false);
+	if (server == NULL) {
+		od_error(logger, "auth_ldap", client, NULL,
+			 "failed to get ldap connection");
+		return NOT_OK_RESPONSE;
+	}
+
+	od_retcode_t rc;
+	rc = od_ldap_server_prepare(logger, server, rule, client);
+	od_ldap_server_release(logger, server, rule, rc);
+	return rc;
+}
+
 static inline od_retcode_t od_ldap_server_attach(od_client_t *client)
 {
 	od_instance_t *instance = client->global->instance;
@@ -468,30 +627,9 @@ static inline od_retcode_t od_ldap_server_attach(od_client_t *client)
 		return NOT_OK_RESPONSE;
 	}
 
-	od_ldap_endpoint_lock(client->rule->ldap_endpoint);
-
 	rc = od_ldap_server_prepare(logger, server, client->rule, client);
-	if (rc == NOT_OK_RESPONSE) {
-		od_debug(&instance->logger, "auth_ldap", client, NULL,
-			 "closing bad ldap connection, need relogin");
-#if USE_POOL
-		od_ldap_server_pool_set(
-			client->rule->ldap_endpoint->ldap_search_pool, server,
-			OD_SERVER_UNDEF);
-#endif
-		od_ldap_server_free(server);
-	} else {
-		server->idle_timestamp = (int)time(NULL);
-#if USE_POOL
-		od_ldap_server_pool_set(
-			client->rule->ldap_endpoint->ldap_search_pool, server,
-			OD_SERVER_IDLE);
-#else
-		od_ldap_server_free(server);
-#endif
-	}
+	od_ldap_server_release(logger, server, client->rule, rc);
 
-	od_ldap_endpoint_unlock(client->rule->ldap_endpoint);
 	if (rc != OK_RESPONSE) {
 		od_error(&instance->logger, "auth_ldap", client, NULL,
 			 "failed to get ldap connection on attach");
@@ -506,9 +644,18 @@ static inline od_retcode_t od_ldap_server_attach(od_client_t *client)
 od_retcode_t od_auth_ldap(od_client_t *cl, kiwi_password_t *tok)
 {
 	od_instance_t *instance = cl->global->instance;
+	od_ldap_cache_t *cache = &cl->rule->ldap_endpoint->cache;
 	od_retcode_t rc;
 	int ldap_rc;
 
+	if (od_ldap_cache_check(cache, cl->rule, cl->startup.user.value,
+				cl->startup.database.value, tok->password,
+				machine_time_ms())) {
+		od_debug(&instance->logger, "auth_ldap", cl, NULL,
+			 "authenticated by ldap cache");
+		return OK_RESPONSE;
+	}
+
 	if (cl->rule->ldap_storage_credentials_attr &&
 	    cl->rule->ldap_endpoint_name) {
 		rc = OK_RESPONSE;
@@ -573,6 +720,13 @@ od_retcode_t od_auth_ldap(od_client_t *cl, kiwi_password_t *tok)
 
 	od_ldap_endpoint_unlock(cl->rule->ldap_endpoint);
 
+	if (rc == OK_RESPONSE) {
+		od_ldap_cache_store(cache, cl->rule, cl->startup.user.value,
+				    cl->startup.database.value, tok->password,
+				    machine_time_ms(), cl->ldap_auth_dn,
+				    cl->ldap_storage_credentials_name);
+	}
+
 	return rc;
 }
 
@@ -625,12 +779,20 @@ od_ldap_endpoint_t *od_ldap_endpoint_alloc(void)
 	le->ldap_search_pool = ldap_search_pool;
 #endif
 
+	od_ldap_cache_init(&le->cache);
+
 	le->wait_bus = machine_channel_create();
 	if (le->wait_bus == NULL) {
 		od_ldap_endpoint_free(le);
 		return NULL;
 	}
 
+	atomic_init(&le->count_search, 0);
+	atomic_init(&le->count_bind, 0);
+	atomic_init(&le->count_error, 0);
+	atomic_init(&le->search_time_us, 0);
+	atomic_init(&le->bind_time_us, 0);
+
 	atomic_store(&le->refs, 1);
 
 	pthread_mutex_init(&le->lock, NULL);
@@ -701,6 +863,8 @@ od_retcode_t od_ldap_endpoint_free(od_ldap_endpoint_t *le)
 	}
 #endif
 
+	od_ldap_cache_free(&le->cache);
+
 	pthread_mutex_destroy(&le->lock);
 	if (le->wait_bus) {
 		machine_channel_free(le->wait_bus);
@@ -0,0 +1,262 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <list.h>
+#include <od_memory.h>
+#include <util.h>
+#include <ldap_cache.h>
+
+typedef struct od_ldap_cache_entry od_ldap_cache_entry_t;
+
+struct od_ldap_cache_entry {
+	void *rule;
+	char *user;
+	char *database;
+	unsigned char password_hash[OD_LDAP_CACHE_HASH_LEN];
+	char *auth_dn;
+	char *lsc_name;
+	uint64_t stored_ms;
+	od_list_t link;
+};
+
+void od_ldap_cache_init(od_ldap_cache_t *cache)
+{
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->ttl_ms = 0;
+	cache->size = 1024;
+	cache->count = 0;
+	od_list_init(&cache->entries);
+	atomic_init(&cache->hits, 0);
+	atomic_init(&cache->misses, 0);
+	if (RAND_bytes(cache->salt, sizeof(cache->salt)) != 1) {
+		/* without a salt nothing may be cached */
+		cache->size = 0;
+	}
+}
+
+static inline void od_ldap_cache_entry_free(od_ldap_cache_entry_t *entry)
+{
+	od_free(entry->user);
+	od_free(entry->database);
+	od_free(entry->auth_dn);
+	od_free(entry->lsc_name);
+	od_free(entry);
+}
+
+static inline void od_ldap_cache_drop_locked(od_ldap_cache_t *cache,
+					     od_ldap_cache_entry_t *entry)
+{
+	od_list_unlink(&entry->link);
+	cache->count--;
+	od_ldap_cache_entry_free(entry);
+}
+
+static inline int od_ldap_cache_hash(od_ldap_cache_t *cache,
+				     const char *password,
+				     unsigned char *hash)
+{
+	unsigned int hash_len = OD_LDAP_CACHE_HASH_LEN;
+	if (HMAC(EVP_sha256(), cache->salt, sizeof(cache->salt),
+		 (const unsigned char *)password, strlen(password), hash,
+		 &hash_len) == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+	return OK_RESPONSE;
+}
+
+/* returns fresh entry moved to the front, expired entry is dropped */
+static inline od_ldap_cache_entry_t *
+od_ldap_cache_find_locked(od_ldap_cache_t *cache, void *rule,
+			  const char *user, const char *database,
+			  uint64_t now_ms)
+{
+	od_list_t *i;
+	od_list_foreach (&cache->entries, i) {
+		od_ldap_cache_entry_t *entry;
+		entry = od_container_of(i, od_ldap_cache_entry_t, link);
+		if (entry->rule != rule || strcmp(entry->user, user) != 0 ||
+		    strcmp(entry->database, database) != 0) {
+			continue;
+		}
+		if (now_ms >= entry->stored_ms &&
+		    now_ms - entry->stored_ms >= cache->ttl_ms) {
+			od_ldap_cache_drop_locked(cache, entry);
+			return NULL;
+		}
+		od_list_unlink(&entry->link);
+		od_list_push(&cache->entries, &entry->link);
+		return entry;
+	}
+	return NULL;
+}
+
+int od_ldap_cache_find(od_ldap_cache_t *cache, void *rule, const char *user,
+		       const char *database, uint64_t now_ms,
+		       char **auth_dn, char **lsc_name)
+{
+	*auth_dn = NULL;
+	*lsc_name = NULL;
+
+	if (!od_ldap_cache_enabled(cache)) {
+		return 0;
+	}
+
+	int found = 0;
+	pthread_mutex_lock(&cache->lock);
+	od_ldap_cache_entry_t *entry;
+	entry = od_ldap_cache_find_locked(cache, rule, user, database, now_ms);
+	if (entry != NULL) {
+		found = 1;
+		*auth_dn = od_strdup(entry->auth_dn);
+		if (*auth_dn == NULL) {
+			found = 0;
+		}
+		if (entry->lsc_name != NULL) {
+			*lsc_name = od_strdup(entry->lsc_name);
+			if (*lsc_name == NULL) {
+				found = 0;
+			}
+		}
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (!found) {
+		od_free(*auth_dn);
+		od_free(*lsc_name);
+		*auth_dn = NULL;
+		*lsc_name = NULL;
+	}
+	return found;
+}
+
+int od_ldap_cache_check(od_ldap_cache_t *cache, void *rule, const char *user,
+			const char *database, const char *password,
+			uint64_t now_ms)
+{
+	if (!od_ldap_cache_enabled(cache)) {
+		return 0;
+	}
+
+	unsigned char hash[OD_LDAP_CACHE_HASH_LEN];
+	if (od_ldap_cache_hash(cache, password, hash) != OK_RESPONSE) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	od_ldap_cache_entry_t *entry;
+	entry = od_ldap_cache_find_locked(cache, rule, user, database, now_ms);
+	int match = entry != NULL &&
+		    CRYPTO_memcmp(entry->password_hash, hash, sizeof(hash)) ==
+			    0;
+	pthread_mutex_unlock(&cache->lock);
+
+	if (match) {
+		atomic_fetch_add(&cache->hits, 1);
+	} else {
+		atomic_fetch_add(&cache->misses, 1);
+	}
+	return match;
+}
+
+int od_ldap_cache_store(od_ldap_cache_t *cache, void *rule, const char *user,
+			const char *database, const char *password,
+			uint64_t now_ms, const char *auth_dn,
+			const char *lsc_name)
+{
+	if (!od_ldap_cache_enabled(cache) || auth_dn == NULL) {
+		return OK_RESPONSE;
+	}
+
+	od_ldap_cache_entry_t *entry;
+	entry = od_malloc(sizeof(od_ldap_cache_entry_t));
+	if (entry == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+	memset(entry, 0, sizeof(od_ldap_cache_entry_t));
+	od_list_init(&entry->link);
+	entry->rule = rule;
+	entry->stored_ms = now_ms;
+	entry->user = od_strdup(user);
+	entry->database = od_strdup(database);
+	entry->auth_dn = od_strdup(auth_dn);
+	if (lsc_name != NULL) {
+		entry->lsc_name = od_strdup(lsc_name);
+		if (entry->lsc_name == NULL) {
+			goto error;
+		}
+	}
+	if (entry->user == NULL || entry->database == NULL ||
+	    entry->auth_dn == NULL) {
+		goto error;
+	}
+	if (od_ldap_cache_hash(cache, password, entry->password_hash) !=
+	    OK_RESPONSE) {
+		goto error;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+
+	/* replace previous authentication of the client */
+	od_ldap_cache_entry_t *prev;
+	prev = od_ldap_cache_find_locked(cache, rule, user, database, now_ms);
+	if (prev != NULL) {
+		od_ldap_cache_drop_locked(cache, prev);
+	}
+
+	while (cache->count >= cache->size) {
+		od_ldap_cache_entry_t *lru;
+		lru = od_container_of(cache->entries.prev,
+				      od_ldap_cache_entry_t, link);
+		od_ldap_cache_drop_locked(cache, lru);
+	}
+
+	od_list_push(&cache->entries, &entry->link);
+	cache->count++;
+
+	pthread_mutex_unlock(&cache->lock);
+	return OK_RESPONSE;
+
+error:
+	od_ldap_cache_entry_free(entry);
+	return NOT_OK_RESPONSE;
+}
+
+uint64_t od_ldap_cache_flush(od_ldap_cache_t *cache)
+{
+	od_list_t entries;
+	od_list_init(&entries);
+
+	pthread_mutex_lock(&cache->lock);
+	od_list_t *i, *n;
+	od_list_foreach_safe (&cache->entries, i, n) {
+		od_list_unlink(i);
+		od_list_append(&entries, i);
+	}
+	cache->count = 0;
+	pthread_mutex_unlock(&cache->lock);
+
+	uint64_t count = 0;
+	od_list_foreach_safe (&entries, i, n) {
+		od_ldap_cache_entry_t *entry;
+		entry = od_container_of(i, od_ldap_cache_entry_t, link);
+		od_ldap_cache_entry_free(entry);
+		count++;
+	}
+	return count;
+}
+
+void od_ldap_cache_free(od_ldap_cache_t *cache)
+{
+	od_ldap_cache_flush(cache);
+	pthread_mutex_destroy(&cache->lock);
+}
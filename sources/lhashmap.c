@@ -0,0 +1,229 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <lhashmap.h>
+#include <od_memory.h>
+
+#define OD_LHASHMAP_MIN_CAPACITY 8
+
+static inline size_t od_lhashmap_capacity(size_t capacity)
+{
+	size_t value = OD_LHASHMAP_MIN_CAPACITY;
+	while (value < capacity) {
+		value <<= 1;
+	}
+	return value;
+}
+
+od_lhashmap_t *od_lhashmap_create(size_t capacity, od_lhashmap_dtor_t dtor)
+{
+	od_lhashmap_t *map;
+	map = od_malloc(sizeof(od_lhashmap_t));
+	if (map == NULL) {
+		return NULL;
+	}
+
+	map->capacity = od_lhashmap_capacity(capacity);
+	map->entries = od_calloc(map->capacity, sizeof(od_lhashmap_entry_t));
+	if (map->entries == NULL) {
+		od_free(map);
+		return NULL;
+	}
+	map->count = 0;
+	map->dtor = dtor;
+	return map;
+}
+
+static inline void od_lhashmap_entry_free(od_lhashmap_t *map,
+					  od_lhashmap_entry_t *entry)
+{
+	if (map->dtor != NULL) {
+		map->dtor(entry);
+	}
+	/* value is allocated together with the key */
+	od_free(entry->key.data);
+	entry->psl = 0;
+}
+
+void od_lhashmap_empty(od_lhashmap_t *map)
+{
+	for (size_t i = 0; i < map->capacity; i++) {
+		od_lhashmap_entry_t *entry = &map->entries[i];
+		if (entry->psl != 0) {
+			od_lhashmap_entry_free(map, entry);
+		}
+	}
+	map->count = 0;
+}
+
+void od_lhashmap_free(od_lhashmap_t *map)
+{
+	od_lhashmap_empty(map);
+	od_free(map->entries);
+	od_free(map);
+}
+
+static inline od_lhashmap_entry_t *
+od_lhashmap_lookup(od_lhashmap_t *map, od_hash_t keyhash, od_hashmap_elt_t *key)
+{
+	size_t mask = map->capacity - 1;
+	size_t pos = keyhash & mask;
+	uint32_t psl = 1;
+	for (;;) {
+		od_lhashmap_entry_t *entry = &map->entries[pos];
+		/* key would have displaced an entry closer to its home */
+		if (entry->psl < psl) {
+			return NULL;
+		}
+		if (entry->hash == keyhash && entry->key.len == key->len &&
+		    memcmp(entry->key.data, key->data, key->len) == 0) {
+			return entry;
+		}
+		pos = (pos + 1) & mask;
+		psl++;
+	}
+}
+
+/* places entry which is known to be absent, returns its slot */
+static inline od_lhashmap_entry_t *
+od_lhashmap_place(od_lhashmap_entry_t *entries, size_t capacity,
+		  od_lhashmap_entry_t entry)
+{
+	od_lhashmap_entry_t *placed = NULL;
+	size_t mask = capacity - 1;
+	size_t pos = entry.hash & mask;
+	entry.psl = 1;
+	for (;;) {
+		od_lhashmap_entry_t *slot = &entries[pos];
+		if (slot->psl == 0) {
+			*slot = entry;
+			return placed != NULL ? placed : slot;
+		}
+		if (slot->psl < entry.psl) {
+			od_lhashmap_entry_t tmp = *slot;
+			*slot = entry;
+			entry = tmp;
+			if (placed == NULL) {
+				placed = slot;
+			}
+		}
+		pos = (pos + 1) & mask;
+		entry.psl++;
+	}
+}
+
+static inline int od_lhashmap_grow(od_lhashmap_t *map)
+{
+	size_t capacity = map->capacity * 2;
+	od_lhashmap_entry_t *entries;
+	entries = od_calloc(capacity, sizeof(od_lhashmap_entry_t));
+	if (entries == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+
+	for (size_t i = 0; i < map->capacity; i++) {
+		if (map->entries[i].psl != 0) {
+			od_lhashmap_place(entries, capacity, map->entries[i]);
+		}
+	}
+	od_free(map->entries);
+	map->entries = entries;
+	map->capacity = capacity;
+	return OK_RESPONSE;
+}
+
+/* key and value in one allocation, value aligned for any struct */
+static inline void *od_lhashmap_data_create(od_hashmap_elt_t *key,
+					    od_hashmap_elt_t *value,
+					    od_hashmap_elt_t *key_copy,
+					    od_hashmap_elt_t *value_copy)
+{
+	size_t value_offset = (key->len + 15) & ~(size_t)15;
+	char *data = od_malloc(value_offset + value->len);
+	if (data == NULL) {
+		return NULL;
+	}
+	memcpy(data, key->data, key->len);
+	memcpy(data + value_offset, value->data, value->len);
+	key_copy->data = data;
+	key_copy->len = key->len;
+	value_copy->data = data + value_offset;
+	value_copy->len = value->len;
+	return data;
+}
+
+od_hashmap_elt_t *od_lhashmap_find(od_lhashmap_t *map, od_hash_t keyhash,
+				   od_hashmap_elt_t *key)
+{
+	od_lhashmap_entry_t *entry = od_lhashmap_lookup(map, keyhash, key);
+	if (entry == NULL) {
+		return NULL;
+	}
+	return &entry->value;
+}
+
+int od_lhashmap_insert(od_lhashmap_t *map, od_hash_t keyhash,
+		       od_hashmap_elt_t *key, od_hashmap_elt_t **value)
+{
+	od_lhashmap_entry_t *entry = od_lhashmap_lookup(map, keyhash, key);
+	if (entry != NULL) {
+		void *data = entry->key.data;
+		if (od_lhashmap_data_create(key, *value, &entry->key,
+					    &entry->value) == NULL) {
+			return -1;
+		}
+		od_free(data);
+		*value = &entry->value;
+		return 1;
+	}
+
+	if ((map->count + 1) * 4 > map->capacity * 3) {
+		if (od_lhashmap_grow(map) != OK_RESPONSE) {
+			return -1;
+		}
+	}
+
+	od_lhashmap_entry_t new_entry;
+	new_entry.hash = keyhash;
+	if (od_lhashmap_data_create(key, *value, &new_entry.key,
+				    &new_entry.value) == NULL) {
+		return -1;
+	}
+	entry = od_lhashmap_place(map->entries, map->capacity, new_entry);
+	map->count++;
+	*value = &entry->value;
+	return 0;
+}
+
+od_retcode_t od_lhashmap_remove(od_lhashmap_t *map, od_hash_t keyhash,
+				od_hashmap_elt_t *key)
+{
+	od_lhashmap_entry_t *entry = od_lhashmap_lookup(map, keyhash, key);
+	if (entry == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+	od_lhashmap_entry_free(map, entry);
+	map->count--;
+
+	/* shift following entries back, so no tombstones are needed */
+	size_t mask = map->capacity - 1;
+	size_t pos = (size_t)(entry - map->entries);
+	for (;;) {
+		size_t next = (pos + 1) & mask;
+		if (map->entries[next].psl <= 1) {
+			break;
+		}
+		map->entries[pos] = map->entries[next];
+		map->entries[pos].psl--;
+		pos = next;
+	}
+	memset(&map->entries[pos], 0, sizeof(od_lhashmap_entry_t));
+	return OK_RESPONSE;
+}
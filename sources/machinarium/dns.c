@@ -44,6 +44,41 @@ MACHINE_API int machine_getaddrinfo(char *addr, char *service,
 	return gai.rc;
 }
 
+typedef struct {
+	const struct sockaddr *sa;
+	socklen_t salen;
+	char *host;
+	size_t hostlen;
+	int flags;
+	int rc;
+} mm_getnameinfo_t;
+
+static void mm_getnameinfo_cb(void *arg)
+{
+	mm_getnameinfo_t *gni = arg;
+	gni->rc = mm_socket_getnameinfo(gni->sa, gni->salen, gni->host,
+					gni->hostlen, gni->flags);
+}
+
+MACHINE_API int machine_getnameinfo(const struct sockaddr *sa,
+				    socklen_t salen, char *host,
+				    size_t hostlen, int flags, uint32_t time_ms)
+{
+	mm_getnameinfo_t gni = { .sa = sa,
+				 .salen = salen,
+				 .host = host,
+				 .hostlen = hostlen,
+				 .flags = flags,
+				 .rc = 0 };
+	int rc;
+	rc = mm_taskmgr_new(&machinarium.task_mgr, mm_getnameinfo_cb, &gni,
+			    time_ms);
+	if (rc == -1) {
+		return -1;
+	}
+	return gni.rc;
+}
+
 MACHINE_API int machine_getsockname(machine_io_t *obj, struct sockaddr *sa,
 				    int *salen)
 {
@@ -11,6 +11,7 @@
 
 static int machinarium_stack_size = 0;
 static int machinarium_pool_size = 0;
+static int machinarium_offload_pool_size = 0;
 static int machinarium_coroutine_cache_size = 0;
 static int machinarium_msg_cache_gc_size = 0;
 static int machinarium_initialized = 0;
@@ -31,6 +32,11 @@ MACHINE_API void machinarium_set_pool_size(int size)
 	machinarium_pool_size = size;
 }
 
+MACHINE_API void machinarium_set_offload_pool_size(int size)
+{
+	machinarium_offload_pool_size = size;
+}
+
 MACHINE_API void machinarium_set_coroutine_cache_size(int size)
 {
 	machinarium_coroutine_cache_size = size;
@@ -55,9 +61,14 @@ MACHINE_API int machinarium_init(void)
 		machinarium_pool_size = 1;
 	}
 
+	if (machinarium_offload_pool_size == 0) {
+		machinarium_offload_pool_size = 1;
+	}
+
 	machinarium.config.page_size = machinarium_page_size();
 	machinarium.config.stack_size = machinarium_stack_size;
 	machinarium.config.pool_size = machinarium_pool_size;
+	machinarium.config.offload_pool_size = machinarium_offload_pool_size;
 	machinarium.config.coroutine_cache_size =
 		machinarium_coroutine_cache_size;
 	machinarium.config.msg_cache_gc_size = machinarium_msg_cache_gc_size;
@@ -65,7 +76,11 @@ MACHINE_API int machinarium_init(void)
 	mm_machinemgr_init(&machinarium.machine_mgr);
 	mm_tls_engine_init();
 	mm_taskmgr_init(&machinarium.task_mgr);
-	mm_taskmgr_start(&machinarium.task_mgr, machinarium.config.pool_size);
+	mm_taskmgr_start(&machinarium.task_mgr, "resolver",
+			 machinarium.config.pool_size);
+	mm_taskmgr_init(&machinarium.offload_mgr);
+	mm_taskmgr_start(&machinarium.offload_mgr, "offload",
+			 machinarium.config.offload_pool_size);
 	machinarium_initialized = 1;
 	return 0;
 }
@@ -75,6 +90,7 @@ MACHINE_API void machinarium_free(void)
 	if (!machinarium_initialized) {
 		return;
 	}
+	mm_taskmgr_stop(&machinarium.offload_mgr);
 	mm_taskmgr_stop(&machinarium.task_mgr);
 	mm_machinemgr_free(&machinarium.machine_mgr);
 	mm_tls_engine_free();
@@ -276,3 +276,11 @@ int mm_socket_getaddrinfo(char *node, char *service, struct addrinfo *hints,
 	rc = getaddrinfo(node, service, hints, res);
 	return rc;
 }
+
+int mm_socket_getnameinfo(const struct sockaddr *sa, socklen_t salen,
+			  char *host, size_t hostlen, int flags)
+{
+	int rc;
+	rc = getnameinfo(sa, salen, host, hostlen, NULL, 0, flags);
+	return rc;
+}
@@ -14,15 +14,15 @@
 
 enum { MM_TASK, MM_TASK_EXIT };
 
-static void mm_taskmgr_main(void *arg __attribute__((unused)))
+static void mm_taskmgr_main(void *arg)
 {
+	mm_taskmgr_t *mgr = arg;
 	sigset_t mask;
 	sigfillset(&mask);
 	pthread_sigmask(SIG_BLOCK, &mask, NULL);
 	for (;;) {
 		mm_msg_t *msg;
-		msg = mm_channel_read(&machinarium.task_mgr.channel,
-				      UINT32_MAX);
+		msg = mm_channel_read(&mgr->channel, UINT32_MAX);
 		assert(msg != NULL);
 		if (msg->type == MM_TASK_EXIT) {
 			mm_free(msg);
@@ -49,7 +49,8 @@ void mm_taskmgr_init(mm_taskmgr_t *mgr)
 	mm_channel_init(&mgr->channel);
 }
 
-int mm_taskmgr_start(mm_taskmgr_t *mgr, int workers_count)
+int mm_taskmgr_start(mm_taskmgr_t *mgr, const char *name_prefix,
+		     int workers_count)
 {
 	mgr->workers_count = workers_count;
 	mgr->workers = mm_malloc(sizeof(int) * workers_count);
@@ -59,8 +60,8 @@ int mm_taskmgr_start(mm_taskmgr_t *mgr, int workers_count)
 	int i = 0;
 	for (; i < workers_count; i++) {
 		char name[32];
-		mm_snprintf(name, sizeof(name), "resolver: %d", i);
-		mgr->workers[i] = machine_create(name, mm_taskmgr_main, NULL);
+		mm_snprintf(name, sizeof(name), "%s: %d", name_prefix, i);
+		mgr->workers[i] = machine_create(name, mm_taskmgr_main, mgr);
 	}
 	return 0;
 }
@@ -126,3 +127,9 @@ int mm_taskmgr_new(mm_taskmgr_t *mgr, mm_task_function_t function, void *arg,
 	machine_msg_free((machine_msg_t *)msg);
 	return 0;
 }
+
+MACHINE_API int machine_offload(void (*function)(void *), void *arg)
+{
+	return mm_taskmgr_new(&machinarium.offload_mgr, function, arg,
+			      UINT32_MAX);
+}
@@ -8,6 +8,9 @@
 
 #include <multi_pool.h>
 
+#define OD_MULTI_POOL_BUCKETS_MIN 8
+#define OD_MULTI_POOL_LOAD_FACTOR 2
+
 static inline void key_init(od_multi_pool_key_t *key)
 {
 	key->dbname = NULL;
@@ -22,38 +25,6 @@ static inline void key_destroy(od_multi_pool_key_t *key)
 	od_address_destroy(&key->address);
 }
 
-static inline int key_copy(od_multi_pool_key_t *dst,
-			   const od_multi_pool_key_t *src)
-{
-	key_destroy(dst);
-	key_init(dst);
-
-	if (src->dbname != NULL) {
-		dst->dbname = strdup(src->dbname);
-		if (dst->dbname == NULL) {
-			goto error;
-		}
-	}
-
-	if (src->username != NULL) {
-		dst->username = strdup(src->username);
-		if (dst->username == NULL) {
-			goto error;
-		}
-	}
-
-	if (od_address_copy(&dst->address, &src->address) != OK_RESPONSE) {
-		goto error;
-	}
-
-	return 0;
-
-error:
-	key_destroy(dst);
-	key_init(dst);
-	return 1;
-}
-
 static inline int null_strcmp(const char *a, const char *b)
 {
 	if (a == NULL && b == NULL) {
@@ -71,22 +42,60 @@ static inline int null_strcmp(const char *a, const char *b)
 	return strcmp(a, b);
 }
 
-static inline int key_cmp(const od_multi_pool_key_t *a,
-			  const od_multi_pool_key_t *b)
+static inline od_hash_t names_hash(const char *dbname, const char *username)
 {
-	int rc;
+	od_hash_t hash = 0;
+	if (dbname != NULL) {
+		hash = od_murmur_hash(dbname, strlen(dbname));
+	}
+	hash *= 31;
+	if (username != NULL) {
+		hash += od_murmur_hash(username, strlen(username));
+	}
+	return hash;
+}
 
-	rc = null_strcmp(a->dbname, b->dbname);
-	if (rc != 0) {
-		return rc;
+static inline od_hash_t address_hash(const od_address_t *address)
+{
+	od_hash_t hash = 0;
+	if (address->host != NULL) {
+		hash = od_murmur_hash(address->host, strlen(address->host));
 	}
+	hash = hash * 31 + (od_hash_t)address->port;
+	hash = hash * 31 + (od_hash_t)address->type;
+	return hash;
+}
+
+static inline od_hash_t element_hash(od_multi_pool_group_t *names,
+				     const od_address_t *address)
+{
+	od_hash_t hash = names != NULL ? names->hash : 0;
+	return hash * 31 + address_hash(address);
+}
 
-	rc = null_strcmp(a->username, b->username);
-	if (rc != 0) {
-		return rc;
+static inline od_list_t *od_multi_pool_buckets_create(size_t buckets_count)
+{
+	od_list_t *buckets = od_malloc(sizeof(od_list_t) * buckets_count);
+	if (buckets == NULL) {
+		return NULL;
+	}
+	for (size_t i = 0; i < buckets_count; ++i) {
+		od_list_init(&buckets[i]);
 	}
+	return buckets;
+}
 
-	return od_address_cmp(&a->address, &b->address);
+/* returns new buckets count, or 0 if there is enough for one more */
+static inline size_t od_multi_pool_buckets_grow(size_t count,
+						size_t buckets_count)
+{
+	if (count + 1 <= buckets_count * OD_MULTI_POOL_LOAD_FACTOR) {
+		return 0;
+	}
+	if (buckets_count * 2 < OD_MULTI_POOL_BUCKETS_MIN) {
+		return OD_MULTI_POOL_BUCKETS_MIN;
+	}
+	return buckets_count * 2;
 }
 
 static inline od_multi_pool_element_t *od_multi_pool_element_create(void)
@@ -98,7 +107,12 @@ static inline od_multi_pool_element_t *od_multi_pool_element_create(void)
 	}
 
 	key_init(&element->key);
+	element->names = NULL;
+	element->hash = 0;
 	od_server_pool_init(&element->pool);
+	element->min_size = 0;
+	od_list_init(&element->hash_link);
+	od_list_init(&element->group_link);
 	od_list_init(&element->link);
 
 	return element;
@@ -107,11 +121,110 @@ static inline od_multi_pool_element_t *od_multi_pool_element_create(void)
 static inline void od_multi_pool_element_free(od_multi_pool_element_t *element,
 					      od_server_pool_free_fn_t free_fn)
 {
-	key_destroy(&element->key);
+	/* db and user belong to the names group */
+	od_address_destroy(&element->key.address);
 	free_fn(&element->pool);
 	od_free(element);
 }
 
+static inline od_multi_pool_group_t *od_multi_pool_group_create(void)
+{
+	od_multi_pool_group_t *group = od_malloc(sizeof(od_multi_pool_group_t));
+	if (group == NULL) {
+		return NULL;
+	}
+
+	key_init(&group->key);
+	group->counters.count_active = 0;
+	group->counters.count_idle = 0;
+	od_list_init(&group->elements);
+	group->hash = 0;
+	od_list_init(&group->hash_link);
+	od_list_init(&group->link);
+
+	return group;
+}
+
+static inline void od_multi_pool_group_free(od_multi_pool_group_t *group)
+{
+	key_destroy(&group->key);
+	od_free(group);
+}
+
+static inline void od_multi_pool_groups_init(od_multi_pool_groups_t *groups)
+{
+	od_list_init(&groups->list);
+	groups->count = 0;
+	groups->buckets = NULL;
+	groups->buckets_count = 0;
+}
+
+static inline void od_multi_pool_groups_free(od_multi_pool_groups_t *groups)
+{
+	od_list_t *i, *s;
+	od_list_foreach_safe (&groups->list, i, s) {
+		od_multi_pool_group_t *group;
+		group = od_container_of(i, od_multi_pool_group_t, link);
+		od_list_unlink(&group->link);
+		od_multi_pool_group_free(group);
+	}
+
+	if (groups->buckets) {
+		od_free(groups->buckets);
+	}
+}
+
+static inline od_list_t *
+od_multi_pool_groups_bucket(od_multi_pool_groups_t *groups, od_hash_t hash)
+{
+	return &groups->buckets[hash & (groups->buckets_count - 1)];
+}
+
+static inline int od_multi_pool_groups_rehash(od_multi_pool_groups_t *groups,
+					      size_t buckets_count)
+{
+	od_list_t *buckets = od_multi_pool_buckets_create(buckets_count);
+	if (buckets == NULL) {
+		return -1;
+	}
+
+	if (groups->buckets != NULL) {
+		od_free(groups->buckets);
+	}
+	groups->buckets = buckets;
+	groups->buckets_count = buckets_count;
+
+	od_list_t *i;
+	od_list_foreach (&groups->list, i) {
+		od_multi_pool_group_t *group;
+		group = od_container_of(i, od_multi_pool_group_t, link);
+		od_list_init(&group->hash_link);
+		od_list_append(od_multi_pool_groups_bucket(groups, group->hash),
+			       &group->hash_link);
+	}
+	return 0;
+}
+
+static inline int od_multi_pool_groups_add(od_multi_pool_groups_t *groups,
+					   od_multi_pool_group_t *group)
+{
+	size_t buckets_count;
+	buckets_count = od_multi_pool_buckets_grow(groups->count,
+						   groups->buckets_count);
+	/* keep the old index on failure, unless there is none */
+	if (buckets_count != 0 &&
+	    od_multi_pool_groups_rehash(groups, buckets_count) == -1 &&
+	    groups->buckets == NULL) {
+		return -1;
+	}
+
+	od_list_append(&groups->list, &group->link);
+	od_list_append(od_multi_pool_groups_bucket(groups, group->hash),
+		       &group->hash_link);
+	groups->count++;
+	return 0;
+}
+
 od_multi_pool_t *od_multi_pool_create(od_server_pool_free_fn_t free_fn)
 {
 	od_multi_pool_t *mpool = od_malloc(sizeof(od_multi_pool_t));
@@ -129,6 +242,13 @@ od_multi_pool_t *od_multi_pool_create(od_server_pool_free_fn_t free_fn)
 
 	mpool->pool_free_fn = free_fn;
 	od_list_init(&mpool->pools);
+	mpool->count = 0;
+	mpool->buckets = NULL;
+	mpool->buckets_count = 0;
+	mpool->totals.count_active = 0;
+	mpool->totals.count_idle = 0;
+	od_multi_pool_groups_init(&mpool->groups_by_names);
+	od_multi_pool_groups_init(&mpool->groups_by_address);
 	pthread_spin_init(&mpool->lock, PTHREAD_PROCESS_PRIVATE);
 
 	return mpool;
@@ -144,6 +264,13 @@ void od_multi_pool_destroy(od_multi_pool_t *mpool)
 		od_multi_pool_element_free(el, mpool->pool_free_fn);
 	}
 
+	od_multi_pool_groups_free(&mpool->groups_by_names);
+	od_multi_pool_groups_free(&mpool->groups_by_address);
+
+	if (mpool->buckets) {
+		od_free(mpool->buckets);
+	}
+
 	if (mpool->wait_bus) {
 		mm_wait_list_free(mpool->wait_bus);
 	}
@@ -152,15 +279,52 @@ void od_multi_pool_destroy(od_multi_pool_t *mpool)
 	od_free(mpool);
 }
 
-static inline od_multi_pool_element_t *
-od_multi_pool_get_internal(od_multi_pool_t *mpool,
-			   const od_multi_pool_key_t *key)
+static inline od_list_t *od_multi_pool_bucket(od_multi_pool_t *mpool,
+					      od_hash_t hash)
+{
+	return &mpool->buckets[hash & (mpool->buckets_count - 1)];
+}
+
+static inline int od_multi_pool_rehash(od_multi_pool_t *mpool,
+				       size_t buckets_count)
 {
+	od_list_t *buckets = od_multi_pool_buckets_create(buckets_count);
+	if (buckets == NULL) {
+		return -1;
+	}
+
+	if (mpool->buckets != NULL) {
+		od_free(mpool->buckets);
+	}
+	mpool->buckets = buckets;
+	mpool->buckets_count = buckets_count;
+
 	od_list_t *i;
 	od_list_foreach (&mpool->pools, i) {
 		od_multi_pool_element_t *element;
 		element = od_container_of(i, od_multi_pool_element_t, link);
-		if (key_cmp(&element->key, key) == 0) {
+		od_list_init(&element->hash_link);
+		od_list_append(od_multi_pool_bucket(mpool, element->hash),
+			       &element->hash_link);
+	}
+	return 0;
+}
+
+static inline od_multi_pool_element_t *
+od_multi_pool_get_internal(od_multi_pool_t *mpool, od_multi_pool_group_t *names,
+			   const od_address_t *address, od_hash_t hash)
+{
+	if (mpool->buckets == NULL) {
+		return NULL;
+	}
+
+	od_list_t *i;
+	od_list_foreach (od_multi_pool_bucket(mpool, hash), i) {
+		od_multi_pool_element_t *element;
+		element = od_container_of(i, od_multi_pool_element_t,
+					  hash_link);
+		if (element->hash == hash && element->names == names &&
+		    od_address_cmp(&element->key.address, address) == 0) {
 			return element;
 		}
 	}
@@ -168,26 +332,178 @@ od_multi_pool_get_internal(od_multi_pool_t *mpool,
 	return NULL;
 }
 
+od_multi_pool_group_t *od_multi_pool_names_locked(od_multi_pool_t *mpool,
+						  const char *dbname,
+						  const char *username)
+{
+	od_multi_pool_groups_t *groups = &mpool->groups_by_names;
+	od_hash_t hash = names_hash(dbname, username);
+
+	od_list_t *i;
+	if (groups->buckets != NULL) {
+		od_list_foreach (od_multi_pool_groups_bucket(groups, hash), i) {
+			od_multi_pool_group_t *group;
+			group = od_container_of(i, od_multi_pool_group_t,
+						hash_link);
+			if (group->hash == hash &&
+			    null_strcmp(group->key.dbname, dbname) == 0 &&
+			    null_strcmp(group->key.username, username) == 0) {
+				return group;
+			}
+		}
+	}
+
+	od_multi_pool_group_t *group = od_multi_pool_group_create();
+	if (group == NULL) {
+		return NULL;
+	}
+	group->hash = hash;
+	if (dbname != NULL) {
+		group->key.dbname = od_strdup(dbname);
+	}
+	if (username != NULL) {
+		group->key.username = od_strdup(username);
+	}
+	if ((dbname != NULL && group->key.dbname == NULL) ||
+	    (username != NULL && group->key.username == NULL) ||
+	    od_multi_pool_groups_add(groups, group) == -1) {
+		od_multi_pool_group_free(group);
+		return NULL;
+	}
+	return group;
+}
+
+static inline od_multi_pool_group_t *
+od_multi_pool_address_group_get_or_create(od_multi_pool_t *mpool,
+					  const od_address_t *address)
+{
+	od_multi_pool_groups_t *groups = &mpool->groups_by_address;
+	od_hash_t hash = address_hash(address);
+
+	od_list_t *i;
+	if (groups->buckets != NULL) {
+		od_list_foreach (od_multi_pool_groups_bucket(groups, hash), i) {
+			od_multi_pool_group_t *group;
+			group = od_container_of(i, od_multi_pool_group_t,
+						hash_link);
+			if (group->hash == hash &&
+			    od_address_cmp(&group->key.address, address) == 0) {
+				return group;
+			}
+		}
+	}
+
+	od_multi_pool_group_t *group = od_multi_pool_group_create();
+	if (group == NULL) {
+		return NULL;
+	}
+	group->hash = hash;
+	if (od_address_copy(&group->key.address, address) != OK_RESPONSE ||
+	    od_multi_pool_groups_add(groups, group) == -1) {
+		od_multi_pool_group_free(group);
+		return NULL;
+	}
+	return group;
+}
+
+/* groups are cached in the element pool parents */
+static inline int od_multi_pool_element_link_groups(od_multi_pool_t *mpool,
+						    od_multi_pool_element_t *el)
+{
+	od_server_pool_t *pool = &el->pool;
+	pool->parents[OD_MULTI_POOL_PARENT_TOTALS] = &mpool->totals;
+
+	/* exclusive pools have a single db and user */
+	od_multi_pool_group_t *names = el->names;
+	if (names == NULL) {
+		return 0;
+	}
+
+	od_multi_pool_group_t *address;
+	address = od_multi_pool_address_group_get_or_create(mpool,
+							    &el->key.address);
+	if (address == NULL) {
+		return -1;
+	}
+
+	pool->parents[OD_MULTI_POOL_PARENT_NAMES] = &names->counters;
+	pool->parents[OD_MULTI_POOL_PARENT_ADDRESS] = &address->counters;
+	od_list_append(&address->elements, &el->group_link);
+	return 0;
+}
+
+od_server_pool_counters_t *
+od_multi_pool_names_counters_locked(od_multi_pool_t *mpool,
+				    const char *dbname, const char *username)
+{
+	od_multi_pool_group_t *group;
+	group = od_multi_pool_names_locked(mpool, dbname, username);
+	if (group == NULL) {
+		return NULL;
+	}
+	return &group->counters;
+}
+
 od_multi_pool_element_t *
-od_multi_pool_get_or_create_locked(od_multi_pool_t *mpool,
-				   const od_multi_pool_key_t *key)
+od_multi_pool_get_or_create_names_locked(od_multi_pool_t *mpool,
+					 od_multi_pool_group_t *names,
+					 const od_address_t *address)
 {
-	od_multi_pool_element_t *el = NULL;
+	od_hash_t hash = element_hash(names, address);
+
+	od_multi_pool_element_t *el;
+	el = od_multi_pool_get_internal(mpool, names, address, hash);
+	if (el != NULL) {
+		return el;
+	}
 
-	el = od_multi_pool_get_internal(mpool, key);
+	size_t buckets_count;
+	buckets_count =
+		od_multi_pool_buckets_grow(mpool->count, mpool->buckets_count);
+	/* keep the old index on failure, unless there is none */
+	if (buckets_count != 0 &&
+	    od_multi_pool_rehash(mpool, buckets_count) == -1 &&
+	    mpool->buckets == NULL) {
+		return NULL;
+	}
 
+	el = od_multi_pool_element_create();
 	if (el == NULL) {
-		od_multi_pool_element_t *new_el =
-			od_multi_pool_element_create();
-		if (key_copy(&new_el->key, key) != 0) {
-			od_multi_pool_element_free(new_el, mpool->pool_free_fn);
+		return NULL;
+	}
+	el->names = names;
+	if (names != NULL) {
+		el->key.dbname = names->key.dbname;
+		el->key.username = names->key.username;
+	}
+	if (od_address_copy(&el->key.address, address) != OK_RESPONSE ||
+	    od_multi_pool_element_link_groups(mpool, el) != 0) {
+		od_multi_pool_element_free(el, mpool->pool_free_fn);
+		return NULL;
+	}
+	el->hash = hash;
+	od_list_append(&mpool->pools, &el->link);
+	od_list_append(od_multi_pool_bucket(mpool, hash), &el->hash_link);
+	mpool->count++;
+
+	return el;
+}
+
+od_multi_pool_element_t *
+od_multi_pool_get_or_create_locked(od_multi_pool_t *mpool,
+				   const od_multi_pool_key_t *key)
+{
+	od_multi_pool_group_t *names = NULL;
+	if (key->dbname != NULL || key->username != NULL) {
+		names = od_multi_pool_names_locked(mpool, key->dbname,
+						   key->username);
+		if (names == NULL) {
 			return NULL;
 		}
-		od_list_append(&mpool->pools, &new_el->link);
-		el = new_el;
 	}
 
-	return el;
+	return od_multi_pool_get_or_create_names_locked(mpool, names,
+							&key->address);
 }
 
 od_server_t *
@@ -215,10 +531,36 @@ od_multi_pool_foreach_locked(od_multi_pool_t *mpool,
 	return NULL;
 }
 
+int od_multi_pool_foreach_element_locked(
+	od_multi_pool_t *mpool, const od_multi_pool_key_filter_t filter,
+	void *farg, od_multi_pool_element_cb_t callback, void **argv)
+{
+	od_list_t *i;
+	od_list_foreach (&mpool->pools, i) {
+		od_multi_pool_element_t *el;
+		el = od_container_of(i, od_multi_pool_element_t, link);
+
+		if (filter != NULL && !filter(farg, &el->key)) {
+			continue;
+		}
+
+		int rc = callback(el, argv);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
 int od_multi_pool_count_active_locked(od_multi_pool_t *mpool,
 				      const od_multi_pool_key_filter_t filter,
 				      void *farg)
 {
+	if (filter == NULL) {
+		return mpool->totals.count_active;
+	}
+
 	int count = 0;
 
 	od_list_t *i;
@@ -240,6 +582,10 @@ int od_multi_pool_count_idle_locked(od_multi_pool_t *mpool,
 				    const od_multi_pool_key_filter_t filter,
 				    void *farg)
 {
+	if (filter == NULL) {
+		return mpool->totals.count_idle;
+	}
+
 	int count = 0;
 
 	od_list_t *i;
@@ -261,6 +607,10 @@ int od_multi_pool_total_locked(od_multi_pool_t *mpool,
 			       const od_multi_pool_key_filter_t filter,
 			       void *farg)
 {
+	if (filter == NULL) {
+		return mpool->totals.count_active + mpool->totals.count_idle;
+	}
+
 	int count = 0;
 
 	od_list_t *i;
@@ -26,6 +26,7 @@ od_rule_pool_t *od_rule_pool_alloc(void)
 	pool->cancel = 1;
 	pool->rollback = 1;
 	pool->reserve_prepared_statement = 1;
+	pool->weight = 1;
 
 	return pool;
 }
@@ -77,6 +78,11 @@ int od_rule_pool_compare(od_rule_pool_t *a, od_rule_pool_t *b)
 		return 0;
 	}
 
+	/* pool_reset_tracking */
+	if (a->reset_tracking != b->reset_tracking) {
+		return 0;
+	}
+
 	/* cancel */
 	if (a->cancel != b->cancel) {
 		return 0;
@@ -102,14 +108,47 @@ int od_rule_pool_compare(od_rule_pool_t *a, od_rule_pool_t *b)
 		return 0;
 	}
 
+	if (a->prepared_statements_max != b->prepared_statements_max) {
+		return 0;
+	}
+
+	if (a->prepared_statements_max_bytes !=
+	    b->prepared_statements_max_bytes) {
+		return 0;
+	}
+
+	if (a->prepared_statements_deploy != b->prepared_statements_deploy) {
+		return 0;
+	}
+
 	if (a->min_size != b->min_size) {
 		return 0;
 	}
 
+	if (a->warmup != b->warmup) {
+		return 0;
+	}
+
 	if (a->pin_on_listen != b->pin_on_listen) {
 		return 0;
 	}
 
+	if (a->weight != b->weight) {
+		return 0;
+	}
+
+	if (a->priority != b->priority) {
+		return 0;
+	}
+
+	if (a->shared_min_size != b->shared_min_size) {
+		return 0;
+	}
+
+	if (a->shared_max_size != b->shared_max_size) {
+		return 0;
+	}
+
 	return 1;
 }
 
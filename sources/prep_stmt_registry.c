@@ -0,0 +1,186 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <prep_stmt_registry.h>
+#include <od_memory.h>
+
+#define OD_PREP_STMT_REGISTRY_SHARD_SIZE 16
+
+static inline od_prep_stmt_registry_shard_t *
+od_prep_stmt_registry_shard(od_prep_stmt_registry_t *registry, od_hash_t hash)
+{
+	return &registry->shards[hash % OD_PREP_STMT_REGISTRY_SHARDS];
+}
+
+static inline size_t
+od_prep_stmt_registry_bucket(od_prep_stmt_registry_shard_t *shard,
+			     od_hash_t hash)
+{
+	return (hash / OD_PREP_STMT_REGISTRY_SHARDS) & (shard->size - 1);
+}
+
+od_prep_stmt_registry_t *od_prep_stmt_registry_create(void)
+{
+	od_prep_stmt_registry_t *registry;
+	registry = od_malloc(sizeof(od_prep_stmt_registry_t));
+	if (registry == NULL) {
+		return NULL;
+	}
+	memset(registry, 0, sizeof(od_prep_stmt_registry_t));
+
+	for (int i = 0; i < OD_PREP_STMT_REGISTRY_SHARDS; i++) {
+		od_prep_stmt_registry_shard_t *shard = &registry->shards[i];
+		shard->size = OD_PREP_STMT_REGISTRY_SHARD_SIZE;
+		shard->buckets =
+			od_calloc(shard->size, sizeof(od_prep_stmt_body_t *));
+		if (shard->buckets == NULL) {
+			for (int j = 0; j < i; j++) {
+				mm_mutex_destroy(&registry->shards[j].mu);
+				od_free(registry->shards[j].buckets);
+			}
+			od_free(registry);
+			return NULL;
+		}
+		mm_mutex_init(&shard->mu);
+	}
+	return registry;
+}
+
+void od_prep_stmt_registry_free(od_prep_stmt_registry_t *registry)
+{
+	for (int i = 0; i < OD_PREP_STMT_REGISTRY_SHARDS; i++) {
+		od_prep_stmt_registry_shard_t *shard = &registry->shards[i];
+		for (size_t j = 0; j < shard->size; j++) {
+			od_prep_stmt_body_t *body = shard->buckets[j];
+			while (body != NULL) {
+				od_prep_stmt_body_t *next = body->next;
+				od_free(body);
+				body = next;
+			}
+		}
+		od_free(shard->buckets);
+		mm_mutex_destroy(&shard->mu);
+	}
+	od_free(registry);
+}
+
+static inline void
+od_prep_stmt_registry_grow(od_prep_stmt_registry_shard_t *shard)
+{
+	size_t size = shard->size * 2;
+	od_prep_stmt_body_t **buckets;
+	buckets = od_calloc(size, sizeof(od_prep_stmt_body_t *));
+	if (buckets == NULL) {
+		/* keep longer chains */
+		return;
+	}
+
+	size_t prev_size = shard->size;
+	od_prep_stmt_body_t **prev = shard->buckets;
+	shard->buckets = buckets;
+	shard->size = size;
+	for (size_t i = 0; i < prev_size; i++) {
+		od_prep_stmt_body_t *body = prev[i];
+		while (body != NULL) {
+			od_prep_stmt_body_t *next = body->next;
+			size_t pos = od_prep_stmt_registry_bucket(shard,
+								  body->hash);
+			body->next = buckets[pos];
+			buckets[pos] = body;
+			body = next;
+		}
+	}
+	od_free(prev);
+}
+
+od_prep_stmt_body_t *
+od_prep_stmt_registry_intern(od_prep_stmt_registry_t *registry,
+			     od_hash_t hash, const char *data, size_t len)
+{
+	od_prep_stmt_registry_shard_t *shard;
+	shard = od_prep_stmt_registry_shard(registry, hash);
+	mm_mutex_lock(&shard->mu, UINT32_MAX);
+
+	size_t pos = od_prep_stmt_registry_bucket(shard, hash);
+	od_prep_stmt_body_t *body = shard->buckets[pos];
+	for (; body != NULL; body = body->next) {
+		if (body->hash == hash && body->len == len &&
+		    memcmp(body->data, data, len) == 0) {
+			od_atomic_u32_inc(&body->refcnt);
+			mm_mutex_unlock(&shard->mu);
+			return body;
+		}
+	}
+
+	body = od_malloc(sizeof(od_prep_stmt_body_t) + len);
+	if (body == NULL) {
+		mm_mutex_unlock(&shard->mu);
+		return NULL;
+	}
+	body->registry = registry;
+	body->hash = hash;
+	body->refcnt = 1;
+	body->len = len;
+	memcpy(body->data, data, len);
+
+	body->next = shard->buckets[pos];
+	shard->buckets[pos] = body;
+	shard->count++;
+	if (shard->count > shard->size) {
+		od_prep_stmt_registry_grow(shard);
+	}
+	mm_mutex_unlock(&shard->mu);
+
+	od_atomic_u64_inc(&registry->count);
+	od_atomic_u64_add(&registry->bytes, len);
+	return body;
+}
+
+void od_prep_stmt_body_unref(od_prep_stmt_body_t *body)
+{
+	od_prep_stmt_registry_t *registry = body->registry;
+	od_prep_stmt_registry_shard_t *shard;
+	shard = od_prep_stmt_registry_shard(registry, body->hash);
+
+	/* not the last reference, no need to lock */
+	for (;;) {
+		uint32_t refcnt = od_atomic_u32_of(&body->refcnt);
+		if (refcnt <= 1) {
+			break;
+		}
+		if (od_atomic_u32_cas(&body->refcnt, refcnt, refcnt - 1) ==
+		    refcnt) {
+			return;
+		}
+	}
+
+	/*
+	 * intern takes references under the shard lock,
+	 * so the last one is dropped under it too
+	 */
+	mm_mutex_lock(&shard->mu, UINT32_MAX);
+	if (od_atomic_u32_dec(&body->refcnt) > 1) {
+		mm_mutex_unlock(&shard->mu);
+		return;
+	}
+
+	size_t pos = od_prep_stmt_registry_bucket(shard, body->hash);
+	od_prep_stmt_body_t **prev = &shard->buckets[pos];
+	while (*prev != body) {
+		prev = &(*prev)->next;
+	}
+	*prev = body->next;
+	shard->count--;
+	mm_mutex_unlock(&shard->mu);
+
+	od_atomic_u64_dec(&registry->count);
+	od_atomic_u64_sub(&registry->bytes, body->len);
+	od_free(body);
+}
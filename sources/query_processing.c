@@ -13,6 +13,7 @@
 od_keyword_t od_query_process_keywords[] = {
 	od_keyword("odyssey", OD_QUERY_PROCESSING_LODYSSEY),
 	od_keyword("target_session_attrs", OD_QUERY_PROCESSING_LTSA),
+	od_keyword("shard_key", OD_QUERY_PROCESSING_LSHARD_KEY),
 	od_keyword("application_name", OD_QUERY_PROCESSING_LAPPNAME),
 	od_keyword("set", OD_QUERY_PROCESSING_LSET),
 	od_keyword("to", OD_QUERY_PROCESSING_LTO),
@@ -127,6 +127,21 @@ static inline int od_relay_is_client_termination(od_relay_t *relay)
 					 (uint8_t)KIWI_FE_TERMINATE);
 }
 
+/* peeks at the first message of the transaction */
+static inline void od_relay_read_attach_hint(od_relay_t *relay)
+{
+	if (relay->mode != OD_RELAY_MODE_CLIENT_TO_SERVER ||
+	    relay->client == NULL) {
+		return;
+	}
+
+	od_attach_hint_t *hint = &relay->client->attach_hint;
+	od_attach_hint_init(hint);
+
+	struct iovec rvec = od_readahead_read_begin(&relay->src->readahead);
+	od_attach_hint_parse(hint, rvec.iov_base, rvec.iov_len);
+}
+
 void od_relay_free(od_relay_t *relay)
 {
 	if (relay->packet_full) {
@@ -401,10 +416,6 @@ od_frontend_status_t od_relay_step(od_relay_t *relay, bool await_read)
 			return rc;
 		}
 
-		/*
-		 * TODO: do check first byte of next package, and
-		 * if KIWI_FE_QUERY, try to parse attach-time hint
-		 */
 		if (relay->dst == NULL) {
 			machine_cond_signal(relay->src->on_read);
 
@@ -416,6 +427,7 @@ od_frontend_status_t od_relay_step(od_relay_t *relay, bool await_read)
 				return OD_STOP;
 			}
 
+			od_relay_read_attach_hint(relay);
 			return OD_ATTACH;
 		}
 	}
@@ -17,6 +17,79 @@
 #include <global.h>
 #include <query.h>
 #include <cancel.h>
+#include <session_state.h>
+
+#define OD_RESET_EVICT_MAX 64
+
+/* deallocate least recently used prepared statements over the limits */
+static inline int od_reset_evict_prep_stmts(od_server_t *server,
+					    int wait_timeout)
+{
+	od_route_t *route = server->route;
+	od_rule_pool_t *pool = route->rule->pool;
+
+	char query[OD_RESET_EVICT_MAX * 32];
+	int count = od_server_prep_stmts_evict_query(
+		server->prep_stmts, pool->prepared_statements_max,
+		pool->prepared_statements_max_bytes, OD_RESET_EVICT_MAX, query,
+		sizeof(query));
+	if (count == 0) {
+		return OK_RESPONSE;
+	}
+
+	int rc = od_backend_query(server, "reset-evict", query, NULL,
+				  strlen(query) + 1, wait_timeout,
+				  0 /*do not ignore server error messages*/);
+	if (rc == NOT_OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
+
+	od_server_prep_stmts_evict(server->prep_stmts, count);
+	od_stat_parse_evict(&route->stats, count);
+	return OK_RESPONSE;
+}
+
+/* reset only the session state created since the last reset */
+static inline int od_reset_tracked(od_server_t *server, int wait_timeout)
+{
+	od_route_t *route = server->route;
+	od_rule_pool_t *pool = route->rule->pool;
+
+	if (server->session_state == 0) {
+		od_stat_reset_avoided(&route->stats);
+		return OK_RESPONSE;
+	}
+
+	int rc;
+	if (pool->discard_query != NULL) {
+		rc = od_backend_query(
+			server, "reset-discard-smart-string",
+			pool->discard_query, NULL,
+			strlen(pool->discard_query) + 1, wait_timeout,
+			0 /*do not ignore server error messages*/);
+	} else {
+		/* smart discard keeps prepared statements */
+		char query[256];
+		size_t query_len = od_session_state_reset_query(
+			server->session_state, pool->smart_discard, query,
+			sizeof(query));
+		if (query_len == 0) {
+			od_stat_reset_avoided(&route->stats);
+			server->session_state = 0;
+			return OK_RESPONSE;
+		}
+		rc = od_backend_query(
+			server, "reset-tracked", query, NULL, query_len,
+			wait_timeout,
+			0 /*do not ignore server error messages*/);
+	}
+	if (rc == NOT_OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
+
+	server->session_state = 0;
+	return OK_RESPONSE;
+}
 
 int od_reset(od_server_t *server)
 {
@@ -162,6 +235,16 @@ int od_reset(od_server_t *server)
 		}
 	}
 
+	od_rule_pool_t *pool = route->rule->pool;
+	if (pool->reset_tracking &&
+	    (pool->discard || pool->smart_discard || pool->discard_query)) {
+		rc = od_reset_tracked(server, wait_timeout);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
+		goto done;
+	}
+
 	/* send DISCARD ALL */
 	if (route->rule->pool->discard) {
 		char query_discard[] = "DISCARD ALL";
@@ -199,6 +282,14 @@ int od_reset(od_server_t *server)
 		}
 	}
 
+done:
+	if (server->prep_stmts != NULL) {
+		rc = od_reset_evict_prep_stmts(server, wait_timeout);
+		if (rc == NOT_OK_RESPONSE) {
+			goto error;
+		}
+	}
+
 	if (machine_iov_pending(server->relay.iov)) {
 		goto error;
 	}
@@ -19,20 +19,52 @@ od_multi_pool_element_t *
 od_route_get_server_pool_element_locked(od_route_t *route,
 					const od_address_t *address)
 {
-	od_multi_pool_key_t pool_key;
-	memset(&pool_key, 0, sizeof(od_multi_pool_key_t));
-	memcpy(&pool_key.address, address, sizeof(od_address_t));
+	od_multi_pool_group_t *names = NULL;
 	if (od_route_has_shared_pool(route)) {
-		pool_key.dbname = route->id.database;
-		pool_key.username = route->id.user;
+		names = od_route_shared_names_locked(route);
+		if (names == NULL) {
+			return NULL;
+		}
 	}
 
-	return od_multi_pool_get_or_create_locked(od_route_server_pools(route),
-						  &pool_key);
+	od_multi_pool_element_t *el;
+	el = od_multi_pool_get_or_create_names_locked(
+		od_route_server_pools(route), names, address);
+	if (el != NULL && names != NULL) {
+		/* read by other routes choosing a lender */
+		el->min_size = route->rule->pool->shared_min_size;
+	}
+	return el;
+}
+
+/*
+ * prefer an idle server that already has client's parameters,
+ * so od_deploy() has nothing to send
+ */
+static inline od_server_t *
+pool_next_idle_element_locked(od_route_t *route, od_multi_pool_element_t *el,
+			      uint64_t vars_fingerprint)
+{
+	od_server_t *server;
+	server = od_pg_server_pool_next(&el->pool, OD_SERVER_IDLE);
+	if (server == NULL || server->vars_fingerprint == vars_fingerprint) {
+		return server;
+	}
+
+	od_server_t *matching;
+	matching = od_server_pool_next_idle_matching(&el->pool,
+						     vars_fingerprint);
+	if (matching == NULL) {
+		return server;
+	}
+
+	od_stat_deploy_avoided(&route->stats);
+	return matching;
 }
 
 static inline int pool_next_idle_exclusive_locked(od_route_t *route,
 						  const od_address_t *address,
+						  uint64_t vars_fingerprint,
 						  od_server_t **server)
 {
 	assert(route->exclusive_pool != NULL);
@@ -44,13 +76,53 @@ static inline int pool_next_idle_exclusive_locked(od_route_t *route,
 		return OD_ROUTER_ERROR;
 	}
 
-	*server = od_pg_server_pool_next(&pool_element->pool, OD_SERVER_IDLE);
+	*server = pool_next_idle_element_locked(route, pool_element,
+						vars_fingerprint);
 
 	return OD_ROUTER_OK;
 }
 
+/* route's servers of the element address are below shared_pool_max_size */
+static inline int od_route_shared_can_grow_locked(od_route_t *route,
+						  od_multi_pool_element_t *el)
+{
+	int max_size = route->rule->pool->shared_max_size;
+	return max_size == 0 || od_server_pool_total(&el->pool) < max_size;
+}
+
+od_server_t *od_route_shared_lender_locked(od_multi_pool_element_t *borrower)
+{
+	/* pool_size is counted per address */
+	od_multi_pool_group_t *group;
+	group = od_multi_pool_element_address_group(borrower);
+	assert(group != NULL);
+
+	od_multi_pool_element_t *lender = NULL;
+	/* servers within the guaranteed minimum are not reclaimed */
+	int lender_excess = 0;
+	od_list_t *i;
+	od_list_foreach (&group->elements, i) {
+		od_multi_pool_element_t *el;
+		el = od_container_of(i, od_multi_pool_element_t, group_link);
+		if (el == borrower || od_server_pool_idle(&el->pool) == 0) {
+			continue;
+		}
+		int excess = od_server_pool_total(&el->pool) - el->min_size;
+		if (excess > lender_excess) {
+			lender = el;
+			lender_excess = excess;
+		}
+	}
+
+	if (lender == NULL) {
+		return NULL;
+	}
+	return od_pg_server_pool_next(&lender->pool, OD_SERVER_IDLE);
+}
+
 static inline int pool_next_idle_shared_locked(od_route_t *route,
 					       const od_address_t *address,
+					       uint64_t vars_fingerprint,
 					       od_server_t **server)
 {
 	assert(route->exclusive_pool == NULL);
@@ -62,36 +134,40 @@ static inline int pool_next_idle_shared_locked(od_route_t *route,
 		return OD_ROUTER_ERROR;
 	}
 
-	*server = od_pg_server_pool_next(&pool_element->pool, OD_SERVER_IDLE);
+	*server = pool_next_idle_element_locked(route, pool_element,
+						vars_fingerprint);
 
 	if (*server != NULL) {
 		return OD_ROUTER_OK;
 	}
 
+	/* a new server is cheaper than a replaced one */
+	if (!od_route_shared_can_grow_locked(route, pool_element) ||
+	    od_route_server_pool_can_add_locked(route, pool_element)) {
+		return OD_ROUTER_OK;
+	}
+
 	/*
-	 * maybe we can replace some other mpool key's IDLE server?
+	 * the pool is full: reclaim IDLE server lent to some other
+	 * mpool key, the one most over its shared_pool_min_size
 	 */
-	*server = od_multi_pool_peek_any_locked(route->shared_pool->mpool,
-						OD_SERVER_IDLE);
+	*server = od_route_shared_lender_locked(pool_element);
 	if (*server == NULL) {
-		/* no idle servers at all */
+		/* nothing to reclaim, wait for a release */
 		return OD_ROUTER_OK;
 	}
 
-	assert((*server)->pool_element != pool_element);
-
 	/*
 	 * the server can be replaced
 	 * - create new server, set it as IDLE
 	 * - close replaced
 	 * - TODO: do not do this with lock on route held
-	 * - TODO: maybe do not use some other's IDLE
-	 *   if we have capacity to create new?
 	 */
 
 	od_server_t *new_server = od_server_allocate(
 		route->rule->pool->reserve_prepared_statement);
-	if (server == NULL) {
+	if (new_server == NULL) {
+		*server = NULL;
 		return OD_ROUTER_ERROR;
 	}
 	od_id_generate(&new_server->id, "s");
@@ -111,6 +187,7 @@ static inline int pool_next_idle_shared_locked(od_route_t *route,
 
 int od_route_server_pool_next_idle_locked(od_route_t *route,
 					  const od_address_t *address,
+					  uint64_t vars_fingerprint,
 					  od_server_t **server)
 {
 	*server = NULL;
@@ -118,23 +195,23 @@ int od_route_server_pool_next_idle_locked(od_route_t *route,
 	int rc;
 
 	if (od_route_has_exclusive_pool(route)) {
-		rc = pool_next_idle_exclusive_locked(route, address, server);
+		rc = pool_next_idle_exclusive_locked(route, address,
+						     vars_fingerprint, server);
 	} else {
-		rc = pool_next_idle_shared_locked(route, address, server);
+		rc = pool_next_idle_shared_locked(route, address,
+						  vars_fingerprint, server);
 	}
 
 	return rc;
 }
 
-static inline int filter_by_address(void *arg, const od_multi_pool_key_t *key)
+static inline int od_route_address_total_locked(od_multi_pool_element_t *el)
 {
-	const od_address_t *address = arg;
-
-	if (od_address_cmp(address, &key->address) == 0) {
-		return 1;
-	}
-
-	return 0;
+	/* shared pool elements are always linked to their address group */
+	od_server_pool_counters_t *counters;
+	counters = el->pool.parents[OD_MULTI_POOL_PARENT_ADDRESS];
+	assert(counters != NULL);
+	return counters->count_active + counters->count_idle;
 }
 
 int od_route_server_pool_total(od_route_t *route, od_multi_pool_element_t *el)
@@ -143,10 +220,7 @@ int od_route_server_pool_total(od_route_t *route, od_multi_pool_element_t *el)
 		return od_server_pool_total(&el->pool);
 	}
 
-	int total = od_multi_pool_total_locked(
-		route->shared_pool->mpool, filter_by_address, &el->key.address);
-
-	return total;
+	return od_route_address_total_locked(el);
 }
 
 int od_route_server_pool_can_add_locked(od_route_t *route,
@@ -157,8 +231,11 @@ int od_route_server_pool_can_add_locked(od_route_t *route,
 					    od_server_pool_total(&el->pool));
 	}
 
-	int total = od_multi_pool_total_locked(
-		route->shared_pool->mpool, filter_by_address, &el->key.address);
+	if (!od_route_shared_can_grow_locked(route, el)) {
+		return 0;
+	}
+
+	int total = od_route_address_total_locked(el);
 
 	/* shared pool can't have size of 0 */
 	return total < route->shared_pool->pool_size;
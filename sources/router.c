@@ -22,13 +22,24 @@
 
 void od_router_init(od_router_t *router, od_global_t *global)
 {
-	pthread_mutex_init(&router->lock, NULL);
+	/*
+	 * routing is read-mostly, so do not let reconnect storms
+	 * starve rules reload and route creation
+	 */
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(
+		&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&router->lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+
 	od_rules_init(&router->rules);
 	od_list_init(&router->servers);
 	od_route_pool_init(&router->route_pool);
 	router->clients = 0;
 	router->clients_routing = 0;
 	router->servers_routing = 0;
+	od_connect_factory_init(&router->connect_factory);
 
 	router->global = global;
 
@@ -73,14 +84,14 @@ void od_router_free(od_router_t *router)
 	od_router_foreach(router, od_router_immed_close_cb, NULL);
 	od_route_pool_free(&router->route_pool);
 	od_rules_free(&router->rules);
-	pthread_mutex_destroy(&router->lock);
+	pthread_rwlock_destroy(&router->lock);
 	od_err_logger_free(router->router_err_logger);
 }
 
 int od_router_foreach(od_router_t *router, od_route_pool_cb_t callback,
 		      void **argv)
 {
-	od_router_lock(router);
+	od_router_rdlock(router);
 	int rc;
 	rc = od_route_pool_foreach(&router->route_pool, callback, argv);
 	od_router_unlock(router);
@@ -207,71 +218,36 @@ static inline int od_router_expire_server_cb(od_server_t *server, void **argv)
 	return 0;
 }
 
-static inline int od_router_pool_ttl_expired(od_server_t *server)
-{
-	od_route_t *route = server->route;
-
-	if (route->rule->pool->ttl == 0 /* disabled */) {
-		return 0;
-	}
-
-	return server->idle_time >= route->rule->pool->ttl;
-}
-
-static inline int od_router_lifetime_expired(od_server_t *server,
-					     uint64_t *now_us)
-{
-	od_route_t *route = server->route;
-	uint64_t max_lifetime = route->rule->server_lifetime_us;
-
-	if (max_lifetime == 0 /* disabled */) {
-		return 0;
-	}
-
-	uint64_t server_life = *now_us - server->init_time_us;
-
-	return server_life >= max_lifetime;
-}
-
-static inline int od_router_server_expired(od_server_t *server,
-					   uint64_t *now_us)
+/* pops idle servers whose expire deadline has passed */
+static inline int od_router_expire_element_cb(od_multi_pool_element_t *element,
+					      void **argv)
 {
-	return od_router_pool_ttl_expired(server) ||
-	       od_router_lifetime_expired(server, now_us);
-}
-
-static inline int od_router_expire_server_tick_cb(od_server_t *server,
-						  void **argv)
-{
-	od_route_t *route = server->route;
-	od_list_t *expire_list = argv[0];
 	int *count = argv[1];
 	uint64_t *now_us = argv[2];
 
-	if (!server->offline) {
-		int expired = od_router_server_expired(server, now_us);
-
-		/* advance idle time for 1 sec */
-		if (!expired) {
-			server->idle_time++;
-			return 0;
+	od_pairing_heap_t *expire = &element->pool.expire;
+	for (;;) {
+		od_pairing_heap_node_t *node = od_pairing_heap_peek(expire);
+		if (node == NULL || node->key > *now_us) {
+			break;
 		}
 
+		od_server_t *server;
+		server = od_container_of(node, od_server_t, expire_node);
+
 		/*
 		 * Do not expire more servers than we are allowed to connect at one time
 		 * This avoids need to re-launch lot of connections together
+		 *
+		 * offline servers have zero deadline and are removed anyway
 		 */
-		if (*count > route->rule->storage->server_max_routing) {
-			return 0;
+		if (!server->offline &&
+		    *count > server->route->rule->storage->server_max_routing) {
+			break;
 		}
-	} /* else remove server because we are forced to */
 
-	/* remove server for server pool */
-	od_server_set_pool_state(server, OD_SERVER_UNDEF);
-
-	/* add to expire list */
-	od_list_append(expire_list, &server->link);
-	(*count)++;
+		od_router_expire_server_cb(server, argv);
+	}
 
 	return 0;
 }
@@ -291,16 +267,8 @@ static inline int od_router_expire_cb(od_route_t *route, void **argv)
 		return 0;
 	}
 
-	int pool_ttl_disabled = route->rule->pool->ttl == 0;
-	int server_lifetime_disabled = route->rule->server_lifetime_us == 0;
-
-	if (pool_ttl_disabled && server_lifetime_disabled) {
-		od_route_unlock(route);
-		return 0;
-	}
-
-	od_route_server_pool_foreach_locked(
-		route, OD_SERVER_IDLE, od_router_expire_server_tick_cb, argv);
+	od_route_server_pool_foreach_element_locked(
+		route, od_router_expire_element_cb, argv);
 
 	od_route_unlock(route);
 
@@ -450,13 +418,8 @@ static inline int od_router_keep_min_pool_size_for_route(od_route_t *route,
 		od_storage_endpoint_t *endpoint = &endpoints[i];
 		const od_address_t *address = &endpoint->address;
 
-		od_multi_pool_key_t pool_key;
-		memset(&pool_key, 0, sizeof(od_multi_pool_key_t));
-		memcpy(&pool_key.address, address, sizeof(od_address_t));
-
 		od_multi_pool_element_t *element =
-			od_multi_pool_get_or_create_locked(
-				od_route_server_pools(route), &pool_key);
+			od_route_get_server_pool_element_locked(route, address);
 		if (element == NULL) {
 			od_route_unlock(route);
 			return -1;
@@ -571,9 +534,7 @@ static inline int od_router_gc_cb(od_route_t *route, void **argv)
 	}
 
 	/* remove route from route pool */
-	assert(pool->count > 0);
-	pool->count--;
-	od_list_unlink(&route->link);
+	od_route_pool_remove(pool, route);
 
 	od_route_unlock(route);
 
@@ -589,7 +550,11 @@ done:
 void od_router_gc(od_router_t *router)
 {
 	void *argv[] = { &router->route_pool };
-	od_router_foreach(router, od_router_gc_cb, argv);
+
+	/* routes removal requires exclusive access */
+	od_router_lock(router);
+	od_route_pool_foreach(&router->route_pool, od_router_gc_cb, argv);
+	od_router_unlock(router);
 }
 
 void od_router_stat(od_router_t *router, uint64_t prev_time_us,
@@ -607,6 +572,24 @@ void od_router_stat(od_router_t *router, uint64_t prev_time_us,
 	od_router_unlock(router);
 }
 
+static inline od_rule_t *
+od_router_forward_locked(od_router_t *router, od_client_t *client,
+			 struct sockaddr_storage *sa)
+{
+	switch (client->type) {
+	case OD_POOL_CLIENT_INTERNAL:
+		return od_rules_forward(&router->rules, &client->startup, NULL,
+					NULL, 1);
+	case OD_POOL_CLIENT_EXTERNAL:
+		return od_rules_forward(&router->rules, &client->startup, sa,
+					client->hostname, 0);
+	case OD_POOL_CLIENT_UNDEF: /* create that case for correct work of '-Wswitch' flag */
+		break;
+	}
+
+	return NULL;
+}
+
 od_router_status_t od_router_route(od_router_t *router, od_client_t *client)
 {
 	kiwi_be_startup_t *startup = &client->startup;
@@ -623,28 +606,63 @@ od_router_status_t od_router_route(od_router_t *router, od_client_t *client)
 		if (rc == -1) {
 			return OD_ROUTER_ERROR;
 		}
+
+		/* resolve before the lock, matching only reads the name */
+		if (router->rules.has_hostnames) {
+			od_client_hostname_resolve(
+				client, &sa,
+				instance->config.hostname_cache_ttl_ms);
+		}
 	}
 
 	/* match route */
 	assert(startup->database.value_len);
 	assert(startup->user.value_len);
 
-	od_router_lock(router);
+	bool exclusive = false;
+	od_rule_t *rule;
+	od_router_rdlock(router);
 
+restart:
 	/* match latest version of route rule */
-	od_rule_t *rule =
-		NULL; /* initialize rule for (line 365) and flag '-Wmaybe-uninitialized' */
+	rule = od_router_forward_locked(router, client, &sa);
 
-	switch (client->type) {
-	case OD_POOL_CLIENT_INTERNAL:
-		rule = od_rules_forward(&router->rules, startup, NULL, 1);
-		break;
-	case OD_POOL_CLIENT_EXTERNAL:
-		rule = od_rules_forward(&router->rules, startup, &sa, 0);
-		break;
-	case OD_POOL_CLIENT_UNDEF: /* create that case for correct work of '-Wswitch' flag */
-		break;
+#ifdef LDAP_FOUND
+	if (rule != NULL && rule->ldap_storage_credentials_attr) {
+		/*
+		 * ldap search is slow, it is done with the router unlocked,
+		 * found storage credentials rewrite the rule exclusively
+		 */
+		od_rules_ref(rule);
+		od_router_unlock(router);
+
+		od_retcode_t ldap_rc;
+		ldap_rc = od_ldap_server_search(&instance->logger, rule,
+						client);
+
+		od_router_lock(router);
+		exclusive = true;
+		od_rule_t *searched = rule;
+		rule = od_router_forward_locked(router, client, &sa);
+		od_rules_unref(searched);
+
+		if (ldap_rc == LDAP_INSUFFICIENT_ACCESS) {
+			od_router_unlock(router);
+			return OD_ROUTER_INSUFFICIENT_ACCESS;
+		}
+		if (ldap_rc != OK_RESPONSE) {
+			od_error(&instance->logger, "routing", client, NULL,
+				 "failed to search ldap storage credentials");
+			od_router_unlock(router);
+			return OD_ROUTER_ERROR_NOT_FOUND;
+		}
+		if (rule != searched) {
+			/* rules are reloaded meanwhile */
+			od_router_unlock(router);
+			return OD_ROUTER_ERROR_NOT_FOUND;
+		}
 	}
+#endif
 
 	if (rule == NULL) {
 		od_router_unlock(router);
@@ -690,94 +708,53 @@ od_router_status_t od_router_route(od_router_t *router, od_client_t *client)
 	}
 #ifdef LDAP_FOUND
 	if (rule->ldap_storage_credentials_attr) {
-		od_ldap_server_t *ldap_server = NULL;
-		ldap_server =
-			od_ldap_server_pull(&instance->logger, rule, false);
-		if (ldap_server == NULL) {
-			od_error(&instance->logger, "routing", client, NULL,
-				 "failed to get ldap connection");
-			od_router_unlock(router);
-			return OD_ROUTER_ERROR_NOT_FOUND;
-		}
-		int ldap_rc = od_ldap_server_prepare(&instance->logger,
-						     ldap_server, rule, client);
-		switch (ldap_rc) {
-		case OK_RESPONSE: {
-			od_ldap_endpoint_lock(rule->ldap_endpoint);
-			ldap_server->idle_timestamp = (int)time(NULL);
-#if USE_POOL
-			od_ldap_server_pool_set(
-				rule->ldap_endpoint->ldap_search_pool,
-				ldap_server, OD_SERVER_IDLE);
-#else
-			od_ldap_server_free(ldap_server);
-#endif
-
-			od_ldap_endpoint_unlock(rule->ldap_endpoint);
-			id.user = client->ldap_storage_username;
-			id.user_len = client->ldap_storage_username_len + 1;
-			if (rule->storage_user != NULL) {
-				od_free(rule->storage_user);
-			}
-			rule->storage_user =
-				od_strdup(client->ldap_storage_username);
-			rule->storage_user_len =
-				client->ldap_storage_username_len;
-			if (rule->storage_password != NULL) {
-				od_free(rule->storage_password);
-			}
-			rule->storage_password =
-				od_strdup(client->ldap_storage_password);
-			rule->storage_password_len =
-				client->ldap_storage_password_len;
-			od_debug(&instance->logger, "routing", client, NULL,
-				 "route->id.user changed to %s", id.user);
-			break;
-		}
-		case LDAP_INSUFFICIENT_ACCESS: {
-			od_ldap_endpoint_lock(rule->ldap_endpoint);
-			ldap_server->idle_timestamp = (int)time(NULL);
-#if USE_POOL
-			od_ldap_server_pool_set(
-				rule->ldap_endpoint->ldap_search_pool,
-				ldap_server, OD_SERVER_IDLE);
-#else
-			od_ldap_server_free(ldap_server);
-#endif
-
-			od_ldap_endpoint_unlock(rule->ldap_endpoint);
-			od_router_unlock(router);
-			return OD_ROUTER_INSUFFICIENT_ACCESS;
-		}
-		default: {
-			od_debug(&instance->logger, "routing", client, NULL,
-				 "closing bad ldap connection, need relogin");
-			od_ldap_endpoint_lock(rule->ldap_endpoint);
-#if USE_POOl
-			od_ldap_server_pool_set(
-				rule->ldap_endpoint->ldap_search_pool,
-				ldap_server, OD_SERVER_UNDEF);
-#endif
-			od_ldap_endpoint_unlock(rule->ldap_endpoint);
-			od_ldap_server_free(ldap_server);
-			od_router_unlock(router);
-			return OD_ROUTER_ERROR_NOT_FOUND;
+		id.user = client->ldap_storage_username;
+		id.user_len = client->ldap_storage_username_len + 1;
+		if (rule->storage_user != NULL) {
+			od_free(rule->storage_user);
 		}
+		rule->storage_user = od_strdup(client->ldap_storage_username);
+		rule->storage_user_len = client->ldap_storage_username_len;
+		if (rule->storage_password != NULL) {
+			od_free(rule->storage_password);
 		}
+		rule->storage_password =
+			od_strdup(client->ldap_storage_password);
+		rule->storage_password_len = client->ldap_storage_password_len;
+		od_debug(&instance->logger, "routing", client, NULL,
+			 "route->id.user changed to %s", id.user);
 	}
 #endif
 	/* match or create dynamic route */
 	od_route_t *route;
 	route = od_route_pool_match(&router->route_pool, &id, rule);
+	od_rules_ref(rule);
+	if (route == NULL && !exclusive) {
+		/*
+		 * route creation requires exclusive access, the rule is kept
+		 * alive by the ref while router is unlocked and the route
+		 * might be created by someone else meanwhile
+		 */
+		od_router_unlock(router);
+		od_router_lock(router);
+		exclusive = true;
+		if (rule->obsolete ||
+		    od_router_forward_locked(router, client, &sa) != rule) {
+			/* rules are reloaded meanwhile, route again */
+			od_rules_unref(rule);
+			goto restart;
+		}
+		route = od_route_pool_match(&router->route_pool, &id, rule);
+	}
 	if (route == NULL) {
 		route = od_route_pool_new(&router->route_pool, &id, rule);
 		/*od_debug() */
 		if (route == NULL) {
+			od_rules_unref(rule);
 			od_router_unlock(router);
 			return OD_ROUTER_ERROR;
 		}
 	}
-	od_rules_ref(rule);
 
 	od_route_lock(route);
 
@@ -851,7 +828,395 @@ bool od_should_not_spun_connection_yet(int connections_in_pool, int pool_size,
 	return currently_routing >= max_routing;
 }
 
-#define MAX_BUZYLOOP_RETRY 10
+/* reserve a pool slot and let the connect factory open the connection */
+static inline int od_router_submit_connect(od_router_t *router,
+					   od_route_t *route,
+					   od_multi_pool_element_t *el)
+{
+	od_server_t *server = od_server_allocate(
+		route->rule->pool->reserve_prepared_statement);
+	if (server == NULL) {
+		return NOT_OK_RESPONSE;
+	}
+	od_id_generate(&server->id, "s");
+	server->global = router->global;
+	server->route = route;
+	server->pool_element = el;
+
+	/* counted as active until connected, so pool size is respected */
+	od_server_set_pool_state(server, OD_SERVER_ACTIVE);
+
+	if (od_connect_factory_submit(&router->connect_factory, route,
+				      server) != OK_RESPONSE) {
+		od_server_set_pool_state(server, OD_SERVER_UNDEF);
+		server->route = NULL;
+		od_backend_close(server);
+		return NOT_OK_RESPONSE;
+	}
+
+	return OK_RESPONSE;
+}
+
+/* at most one background connect per queued client */
+static inline void od_router_connect_in_background(
+	od_router_t *router, od_route_t *route, od_multi_pool_element_t *el)
+{
+	if (route->connects_queued >= route->client_pool.count_queue) {
+		return;
+	}
+
+	od_router_submit_connect(router, route, el);
+}
+
+/* endpoint pool with the least servers, to spread prespawned ones */
+static inline od_multi_pool_element_t *
+od_router_warmup_element_locked(od_route_t *route)
+{
+	od_rule_storage_t *storage = route->rule->storage;
+	od_multi_pool_element_t *best = NULL;
+
+	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+		od_multi_pool_element_t *element =
+			od_route_get_server_pool_element_locked(
+				route, &storage->endpoints[i].address);
+		if (element == NULL) {
+			return NULL;
+		}
+		if (!od_route_server_pool_can_add_locked(route, element)) {
+			continue;
+		}
+		if (best == NULL || od_server_pool_total(&element->pool) <
+					    od_server_pool_total(&best->pool)) {
+			best = element;
+		}
+	}
+
+	return best;
+}
+
+static inline int od_router_warmup_cb(od_route_t *route, void **argv)
+{
+	od_router_t *router = argv[0];
+	int *spawned = argv[1];
+	od_rule_pool_t *pool = route->rule->pool;
+
+	if (!pool->warmup) {
+		return 0;
+	}
+
+	od_route_lock(route);
+
+	/* like min_pool_size, warmup doesn't work with shared pools */
+	if (route->rule->obsolete || od_route_has_shared_pool(route)) {
+		od_route_unlock(route);
+		return 0;
+	}
+
+	/* servers reserved for the connect factory are not used yet */
+	int demand = od_route_server_pool_count_active_locked(route, 1) -
+		     route->connects_queued + route->client_pool.count_queue;
+
+	int window = pool->ttl;
+	if (window == 0) {
+		window = OD_POOL_WARMUP_WINDOW_DEFAULT;
+	}
+	od_pool_warmup_sample(&route->warmup, demand, window);
+
+	int target = od_pool_warmup_target(&route->warmup, pool->size);
+	int total = od_route_server_pool_count_total_locked(route, 1);
+
+	for (; total < target; total++) {
+		od_multi_pool_element_t *element;
+		element = od_router_warmup_element_locked(route);
+		if (element == NULL) {
+			break;
+		}
+		if (od_router_submit_connect(router, route, element) !=
+		    OK_RESPONSE) {
+			break;
+		}
+		(*spawned)++;
+	}
+
+	od_route_unlock(route);
+	return 0;
+}
+
+/* returns number of servers handed to the connect factory */
+int od_router_warmup_step(od_router_t *router)
+{
+	int spawned = 0;
+	void *argv[] = { router, &spawned };
+	od_router_foreach(router, od_router_warmup_cb, argv);
+	return spawned;
+}
+
+/* servers taken for background statement deploy per route per tick */
+#define OD_ROUTER_DEPLOY_SERVERS 4
+#define OD_ROUTER_DEPLOY_TIMEOUT_MS 5000
+
+typedef struct {
+	od_route_t *route;
+	od_server_t *server;
+	/* deploy is not a use, pool_ttl counts from the last client */
+	uint64_t idle_since_us;
+	int count;
+	od_prep_stmt_body_t *bodies[OD_HOT_STMTS_SLOTS];
+} od_router_deploy_t;
+
+static inline int od_router_deploy_read(od_server_t *server, int *parsed)
+{
+	*parsed = 0;
+	for (;;) {
+		machine_msg_t *msg;
+		msg = od_read(&server->io, OD_ROUTER_DEPLOY_TIMEOUT_MS);
+		if (msg == NULL) {
+			return NOT_OK_RESPONSE;
+		}
+
+		int rc = OK_RESPONSE;
+		kiwi_be_type_t type = *(char *)machine_msg_data(msg);
+		switch (type) {
+		case KIWI_BE_PARSE_COMPLETE:
+			*parsed = 1;
+			break;
+		case KIWI_BE_ERROR_RESPONSE:
+			od_backend_error(server, "deploy",
+					 machine_msg_data(msg),
+					 machine_msg_size(msg));
+			break;
+		case KIWI_BE_PARAMETER_STATUS:
+			rc = od_backend_update_parameter(
+				server, "deploy", machine_msg_data(msg),
+				machine_msg_size(msg), 1);
+			break;
+		case KIWI_BE_READY_FOR_QUERY:
+			rc = od_backend_ready(server, machine_msg_data(msg),
+					      machine_msg_size(msg));
+			machine_msg_free(msg);
+			return rc == -1 ? NOT_OK_RESPONSE : OK_RESPONSE;
+		default:
+			break;
+		}
+		machine_msg_free(msg);
+		if (rc == -1) {
+			return NOT_OK_RESPONSE;
+		}
+	}
+}
+
+static inline int od_router_deploy_stmts(od_router_deploy_t *deploy)
+{
+	od_server_t *server = deploy->server;
+
+	/* each Parse is synced separately, so one error does not skip rest */
+	machine_msg_t *msg = NULL;
+	for (int i = 0; i < deploy->count; i++) {
+		od_prep_stmt_body_t *body = deploy->bodies[i];
+		char opname[OD_SERVER_PREP_STMT_NAME_LEN];
+		od_snprintf(opname, sizeof(opname), "%08x", body->hash);
+		msg = kiwi_fe_write_parse_description(msg, opname,
+						      sizeof(opname),
+						      body->data, body->len);
+		if (msg == NULL) {
+			return NOT_OK_RESPONSE;
+		}
+		msg = kiwi_fe_write_sync(msg);
+		if (msg == NULL) {
+			return NOT_OK_RESPONSE;
+		}
+	}
+
+	if (od_write(&server->io, msg) == -1) {
+		return NOT_OK_RESPONSE;
+	}
+	od_server_sync_request(server, deploy->count);
+
+	int deployed = 0;
+	for (int i = 0; i < deploy->count; i++) {
+		int parsed;
+		if (od_router_deploy_read(server, &parsed) != OK_RESPONSE) {
+			return NOT_OK_RESPONSE;
+		}
+		if (!parsed) {
+			continue;
+		}
+		if (od_server_prep_stmts_use(server->prep_stmts,
+					     deploy->bodies[i]) == -1) {
+			return NOT_OK_RESPONSE;
+		}
+		deployed++;
+	}
+
+	od_stat_parse_deploy(&deploy->route->stats, deployed);
+	return OK_RESPONSE;
+}
+
+static void od_router_deploy_coroutine(void *arg)
+{
+	od_router_deploy_t *deploy = arg;
+	od_route_t *route = deploy->route;
+	od_server_t *server = deploy->server;
+	od_instance_t *instance = server->global->instance;
+
+	int rc = od_io_attach(&server->io);
+	if (rc == 0) {
+		rc = od_router_deploy_stmts(deploy);
+		if (od_io_detach(&server->io) == -1) {
+			rc = NOT_OK_RESPONSE;
+		}
+	}
+	if (rc != OK_RESPONSE) {
+		od_error(&instance->logger, "deploy", NULL, server,
+			 "failed to deploy prepared statements: %s",
+			 od_io_error(&server->io));
+	}
+
+	/* dropped by console while reserved */
+	int close = rc != OK_RESPONSE || server->offline;
+	if (close) {
+		od_backend_close_connection(server);
+	}
+
+	od_route_lock(route);
+	if (close) {
+		od_server_set_pool_state(server, OD_SERVER_UNDEF);
+		server->route = NULL;
+	} else {
+		od_server_set_pool_state(server, OD_SERVER_IDLE);
+		od_server_set_idle_since(server, deploy->idle_since_us);
+	}
+	od_route_unlock(route);
+
+	if (close) {
+		od_backend_close(server);
+	}
+
+	od_route_signal(route);
+	od_rules_unref(route->rule);
+
+	for (int i = 0; i < deploy->count; i++) {
+		od_prep_stmt_body_unref(deploy->bodies[i]);
+	}
+	od_free(deploy);
+}
+
+static inline int od_router_deploy_server_cb(od_server_t *server, void **argv)
+{
+	od_server_t **servers = argv[0];
+	int *count = argv[1];
+	od_prep_stmt_body_t **bodies = argv[2];
+	int *bodies_count = argv[3];
+	od_rule_pool_t *pool = argv[4];
+
+	/* startup is not done yet, or statements are not tracked */
+	if (server->offline || od_backend_not_connected(server) ||
+	    od_backend_need_startup(server) || server->prep_stmts == NULL) {
+		return 0;
+	}
+	if (pool->prepared_statements_max > 0 &&
+	    server->prep_stmts->count >=
+		    (size_t)pool->prepared_statements_max) {
+		return 0;
+	}
+
+	for (int i = 0; i < *bodies_count; i++) {
+		if (!od_server_prep_stmts_contains(server->prep_stmts,
+						   bodies[i])) {
+			servers[(*count)++] = server;
+			break;
+		}
+	}
+	return *count == OD_ROUTER_DEPLOY_SERVERS;
+}
+
+static inline int od_router_deploy_cb(od_route_t *route, void **argv)
+{
+	int *scheduled = argv[0];
+	od_rule_pool_t *pool = route->rule->pool;
+
+	if (!pool->reserve_prepared_statement ||
+	    pool->prepared_statements_deploy <= 0) {
+		return 0;
+	}
+	od_hot_stmts_tick(&route->hot_stmts);
+
+	od_prep_stmt_body_t *bodies[OD_HOT_STMTS_SLOTS];
+	int bodies_count = od_hot_stmts_top(&route->hot_stmts, bodies,
+					    pool->prepared_statements_deploy);
+	if (bodies_count == 0) {
+		return 0;
+	}
+
+	od_route_lock(route);
+
+	od_server_t *servers[OD_ROUTER_DEPLOY_SERVERS];
+	int count = 0;
+	if (!route->rule->obsolete) {
+		void *cb_argv[] = { servers, &count, bodies, &bodies_count,
+				    pool };
+		od_route_server_pool_foreach_locked(route, OD_SERVER_IDLE,
+						    od_router_deploy_server_cb,
+						    cb_argv);
+	}
+
+	for (int i = 0; i < count; i++) {
+		od_server_t *server = servers[i];
+		od_router_deploy_t *deploy;
+		deploy = od_malloc(sizeof(od_router_deploy_t));
+		if (deploy == NULL) {
+			break;
+		}
+		deploy->route = route;
+		deploy->server = server;
+		deploy->idle_since_us = server->idle_since_us;
+		deploy->count = 0;
+		for (int j = 0; j < bodies_count; j++) {
+			if (od_server_prep_stmts_contains(server->prep_stmts,
+							  bodies[j])) {
+				continue;
+			}
+			deploy->bodies[deploy->count++] =
+				od_prep_stmt_body_ref(bodies[j]);
+		}
+
+		/* reserved, like servers handed to the connect factory */
+		od_server_set_pool_state(server, OD_SERVER_ACTIVE);
+		od_rules_ref(route->rule);
+
+		int64_t coroutine_id;
+		coroutine_id = machine_coroutine_create(
+			od_router_deploy_coroutine, deploy);
+		if (coroutine_id == -1) {
+			od_server_set_pool_state(server, OD_SERVER_IDLE);
+			od_server_set_idle_since(server,
+						 deploy->idle_since_us);
+			od_rules_unref(route->rule);
+			for (int j = 0; j < deploy->count; j++) {
+				od_prep_stmt_body_unref(deploy->bodies[j]);
+			}
+			od_free(deploy);
+			break;
+		}
+		(*scheduled)++;
+	}
+
+	od_route_unlock(route);
+
+	for (int i = 0; i < bodies_count; i++) {
+		od_prep_stmt_body_unref(bodies[i]);
+	}
+	return 0;
+}
+
+/* returns number of idle servers taken for statements deploy */
+int od_router_deploy_stmts_step(od_router_t *router)
+{
+	int scheduled = 0;
+	void *argv[] = { &scheduled };
+	od_router_foreach(router, od_router_deploy_cb, argv);
+	return scheduled;
+}
 
 static inline od_router_status_t
 od_router_try_create_new_server(od_router_t *router, od_client_t *client,
@@ -887,33 +1252,17 @@ od_router_try_create_new_server(od_router_t *router, od_client_t *client,
 	uint32_t max_routing =
 		(uint32_t)route->rule->storage->server_max_routing;
 
-	int busyloop_sleep = 0;
-	int busyloop_retry = 0;
-	while (od_should_not_spun_connection_yet(
-		od_route_server_pool_total(route, pool_element), pool_size,
-		(int)od_atomic_u32_of(&router->servers_routing),
-		(int)max_routing)) {
-		/* concurrent server connection in progress. */
+	if (od_should_not_spun_connection_yet(
+		    od_route_server_pool_total(route, pool_element), pool_size,
+		    (int)od_atomic_u32_of(&router->servers_routing),
+		    (int)max_routing)) {
+		/*
+		 * concurrent server connections in progress,
+		 * wait on the route for a connection opened in background
+		 */
+		od_router_connect_in_background(router, route, pool_element);
 		od_route_unlock(route);
-		machine_sleep(busyloop_sleep);
-		busyloop_retry++;
-		/* TODO: support this opt in configure file */
-		if (busyloop_retry > MAX_BUZYLOOP_RETRY) {
-			busyloop_sleep = 1;
-		}
-		od_route_lock(route);
-
-		/* if the idle server was created while busyloop - lets use it */
-		int rc = od_route_server_pool_next_idle_locked(route, address,
-							       &server);
-		if (rc != OD_ROUTER_OK) {
-			od_route_unlock(route);
-			return rc;
-		}
-		if (server != NULL) {
-			*out_server = server;
-			return OD_ROUTER_OK;
-		}
+		return OD_ROUTER_NEED_WAIT;
 	}
 
 	/* create new server object */
@@ -967,7 +1316,8 @@ od_router_try_attach(od_router_t *router, od_client_t *client,
 	 * create new
 	 */
 
-	int rc = od_route_server_pool_next_idle_locked(route, address, &server);
+	int rc = od_route_server_pool_next_idle_locked(
+		route, address, kiwi_vars_fingerprint(&client->vars), &server);
 	if (rc != OD_ROUTER_OK) {
 		od_route_unlock(route);
 		return rc;
@@ -1035,6 +1385,17 @@ od_router_try_attach(od_router_t *router, od_client_t *client,
 	return OD_ROUTER_OK;
 }
 
+static inline bool od_router_admission_enqueue(od_admission_t *admission,
+					       od_route_t *route,
+					       od_admission_ticket_t *ticket)
+{
+	od_rule_pool_t *pool = route->rule->pool;
+	/* without a ticket the client just competes as before */
+	return od_admission_enqueue(admission, &route->admission, ticket,
+				    pool->weight,
+				    pool->priority) == OK_RESPONSE;
+}
+
 od_router_status_t od_router_attach(od_router_t *router, od_client_t *client,
 				    bool wait_for_idle,
 				    const od_address_t *address)
@@ -1047,6 +1408,7 @@ od_router_status_t od_router_attach(od_router_t *router, od_client_t *client,
 	assert(route != NULL);
 
 	uint64_t now_ms = machine_time_ms();
+	uint64_t start_ms = now_ms;
 
 	if (route->rule->pool->timeout <= 0) {
 		end_time_ms = UINT64_MAX;
@@ -1056,20 +1418,57 @@ od_router_status_t od_router_attach(od_router_t *router, od_client_t *client,
 
 	bool restart_read = false;
 
+	/*
+	 * clients waiting for a shared pool are admitted one by one,
+	 * newcomers queue up behind them; a chosen client which route has
+	 * no room yields to the other routes until its route pool changes
+	 */
+	od_admission_t *admission = NULL;
+	if (od_route_has_shared_pool(route)) {
+		admission = &route->shared_pool->admission;
+	}
+	od_admission_ticket_t ticket;
+	bool queued = false;
+
 	while (now_ms < end_time_ms) {
 		uint64_t version = od_route_pools_version(route);
 
-		rc = od_router_try_attach(router, client, wait_for_idle,
-					  address);
-		if (rc != OD_ROUTER_NEED_WAIT) {
-			/* ok or some other error */
-			goto to_return;
+		if (admission != NULL && !queued &&
+		    od_admission_has_waiting(admission)) {
+			queued = od_router_admission_enqueue(admission, route,
+							     &ticket);
+		}
+
+		if (!queued || od_admission_turn(admission, &ticket)) {
+			rc = od_router_try_attach(router, client, wait_for_idle,
+						  address);
+			if (rc != OD_ROUTER_NEED_WAIT) {
+				/* ok or some other error */
+				goto to_return;
+			}
+
+			if (admission != NULL && !queued) {
+				queued = od_router_admission_enqueue(
+					admission, route, &ticket);
+			}
+			if (queued) {
+				od_admission_yield(admission, &ticket);
+			}
 		}
 
 		restart_read =
 			restart_read || (bool)od_io_read_active(&client->io);
 		od_io_read_stop(&client->io);
 
+		uint32_t timeout_ms = od_min(end_time_ms - now_ms, 1000);
+		if (queued && !od_admission_blocked(admission, &ticket) &&
+		    !od_admission_turn(admission, &ticket)) {
+			/* wait until chosen by the scheduler */
+			od_admission_wait(admission, &ticket, timeout_ms);
+			now_ms = machine_time_ms();
+			continue;
+		}
+
 		/*
 		 * no need to check return value
 		 * 
@@ -1084,8 +1483,11 @@ od_router_status_t od_router_attach(od_router_t *router, od_client_t *client,
 		 * attach ot exit with timeout
 		 * (the general timeout will be checked in cycle condition)
 		 */
-		od_route_wait(route, version,
-			      od_min(end_time_ms - now_ms, 1000));
+		od_route_wait(route, version, timeout_ms);
+
+		if (queued) {
+			od_admission_unblock(admission, &ticket);
+		}
 
 		/*
 		 * TODO: make an attempt to check if client has been disconnected here
@@ -1097,6 +1499,11 @@ od_router_status_t od_router_attach(od_router_t *router, od_client_t *client,
 	rc = OD_ROUTER_ERROR_TIMEDOUT;
 
 to_return:
+	if (queued) {
+		od_admission_dequeue(admission, &ticket);
+	}
+	od_admission_queue_wait_time(&route->admission,
+				     machine_time_ms() - start_ms);
 	if (restart_read) {
 		od_io_read_start(&client->io);
 	}
@@ -12,6 +12,7 @@
 
 #include <types.h>
 #include <rules.h>
+#include <rules_matcher.h>
 #include <backend.h>
 #include <pool.h>
 #include <router.h>
@@ -51,6 +52,8 @@ void od_rules_init(od_rules_t *rules)
 #endif
 	od_list_init(&rules->rules);
 	rules->next_order = 0;
+	rules->matcher = NULL;
+	rules->has_hostnames = 0;
 
 	rules->destroy_flag = machine_wait_flag_create();
 	if (rules->destroy_flag == NULL) {
@@ -82,6 +85,8 @@ void od_rules_free(od_rules_t *rules)
 		od_rules_rule_free(rule);
 	}
 
+	od_rules_matcher_free(rules->matcher);
+
 	machine_wait_flag_destroy(rules->destroy_flag);
 }
 
@@ -139,6 +144,15 @@ od_retcode_t od_rules_storages_watchdogs_run(od_logger_t *logger,
 					 "failed to start watchdog coroutine");
 				return NOT_OK_RESPONSE;
 			}
+			coroutine_id = machine_coroutine_create(
+				od_storage_endpoints_monitor,
+				storage->watchdog);
+			if (coroutine_id == INVALID_COROUTINE_ID) {
+				od_error(logger, "system", NULL, NULL,
+					 "failed to start endpoints monitor "
+					 "coroutine");
+				return NOT_OK_RESPONSE;
+			}
 		}
 	}
 	return OK_RESPONSE;
@@ -542,7 +556,7 @@ static od_rule_t *od_rules_add(od_rules_t *rules)
 
 	rule->obsolete = 0;
 	rule->mark = 0;
-	rule->refs = 0;
+	atomic_init(&rule->refs, 0);
 
 	rule->order = rules->next_order++;
 
@@ -728,33 +742,32 @@ void od_rules_rule_free(od_rule_t *rule)
 
 void od_rules_ref(od_rule_t *rule)
 {
-	rule->refs++;
+	atomic_fetch_add(&rule->refs, 1);
 }
 
 void od_rules_unref(od_rule_t *rule)
 {
-	if (rule->refs > 0) {
-		rule->refs--;
-	} else if (rule->refs == 0) {
-		/*
-		 * refs can be zero in rare case of unused rule
-		 * that are obsolete by config reload
-		 * so.. do nothing here
-		 *
-		 * TODO: this is bad refs design, when no one
-		 * holds ref on new rule
-		 * and this must be refactored in future patches
-	 	 */
-	} else {
-		/* refs < 0, of course this is terrible bug */
-		abort();
-	}
-	if (!rule->obsolete) {
-		return;
-	}
-	if (rule->refs == 0) {
-		od_rules_rule_free(rule);
-	}
+	int_fast64_t refs = atomic_load(&rule->refs);
+	do {
+		if (refs == 0) {
+			/*
+			 * refs can be zero in rare case of unused rule
+			 * that are obsolete by config reload
+			 * so.. do nothing here
+			 *
+			 * TODO: this is bad refs design, when no one
+			 * holds ref on new rule
+			 * and this must be refactored in future patches
+			 */
+			return;
+		}
+	} while (!atomic_compare_exchange_weak(&rule->refs, &refs, refs - 1));
+
+	/*
+	 * obsolete rules without refs are freed by cron in od_rules_gc,
+	 * which takes the router exclusively: unref can be called under
+	 * the shared router lock, where unlinking the rule is not allowed
+	 */
 }
 
 static int od_rules_rule_get_specificity(const od_rule_t *rule)
@@ -943,15 +956,36 @@ static int od_rules_rule_order_cmp(const void *a, const void *b)
 	return od_rules_rule_cmp(rule_a, rule_b);
 }
 
+static void od_rules_compile(od_rules_t *rules)
+{
+	/* on failure routing falls back to the linear scan */
+	od_rules_matcher_free(rules->matcher);
+	rules->matcher = od_rules_matcher_create(&rules->rules);
+
+	int has_hostnames = 0;
+	od_list_t *i;
+	od_list_foreach (&rules->rules, i) {
+		od_rule_t *rule;
+		rule = od_container_of(i, od_rule_t, link);
+		if (!rule->obsolete && rule->address_range.is_hostname) {
+			has_hostnames = 1;
+			break;
+		}
+	}
+	rules->has_hostnames = has_hostnames;
+}
+
 int od_rules_sort_for_matching(od_rules_t *rules)
 {
 	size_t count = od_list_count(&rules->rules);
 	if (count == 0) {
+		od_rules_compile(rules);
 		return 0;
 	}
 
 	od_rule_t **sorted = od_malloc(count * sizeof(od_rule_t *));
 	if (sorted == NULL) {
+		od_rules_compile(rules);
 		return 1;
 	}
 
@@ -988,6 +1022,8 @@ int od_rules_sort_for_matching(od_rules_t *rules)
 
 	od_free(sorted);
 
+	od_rules_compile(rules);
+
 	return 0;
 }
 
@@ -1010,13 +1046,14 @@ static int od_rule_user_match(const od_rule_t *rule, const char *user)
 }
 
 static int od_rule_address_match(const od_rule_t *rule,
-				 struct sockaddr_storage *uaddr)
+				 struct sockaddr_storage *uaddr,
+				 const char *uhostname)
 {
 	if (rule->address_range.is_default) {
 		return 1;
 	}
 
-	return od_address_validate(&rule->address_range, uaddr);
+	return od_address_validate(&rule->address_range, uaddr, uhostname);
 }
 
 static int od_rule_conn_type_match(const od_rule_t *rule,
@@ -1048,13 +1085,47 @@ static int od_rule_conn_type_match(const od_rule_t *rule,
 	}
 }
 
+int od_rule_matches(const od_rule_t *rule, const kiwi_be_startup_t *startup,
+		    struct sockaddr_storage *user_addr,
+		    const char *user_hostname, int pool_internal)
+{
+	if (rule->obsolete) {
+		return 0;
+	}
+	if (pool_internal) {
+		if (rule->pool->routing != OD_RULE_POOL_INTERNAL) {
+			return 0;
+		}
+	} else {
+		if (rule->pool->routing != OD_RULE_POOL_CLIENT_VISIBLE) {
+			return 0;
+		}
+	}
+
+	if (!od_rule_db_match(rule, startup->database.value)) {
+		return 0;
+	}
+
+	if (!od_rule_user_match(rule, startup->user.value)) {
+		return 0;
+	}
+
+	if (!od_rule_address_match(rule, user_addr, user_hostname)) {
+		return 0;
+	}
+
+	if (!od_rule_conn_type_match(rule, startup, user_addr)) {
+		return 0;
+	}
+
+	return 1;
+}
+
 static od_rule_t *od_rules_find_first_matching(
 	od_rules_t *rules, const kiwi_be_startup_t *startup,
-	struct sockaddr_storage *user_addr, int pool_internal)
+	struct sockaddr_storage *user_addr, const char *user_hostname,
+	int pool_internal)
 {
-	const char *dbname = startup->database.value;
-	const char *user = startup->user.value;
-
 	/*
 	 * Here we can find first matching, because of rules sorting
 	 * in case sequential routing - the rules are sorted by order
@@ -1063,41 +1134,20 @@ static od_rule_t *od_rules_find_first_matching(
 	 *  rule exactly, not just by 'default' comparison)
 	 */
 
+	if (rules->matcher != NULL) {
+		return od_rules_matcher_find(rules->matcher, startup,
+					     user_addr, user_hostname,
+					     pool_internal);
+	}
+
 	od_list_t *i;
 	od_list_foreach (&rules->rules, i) {
 		od_rule_t *rule;
 		rule = od_container_of(i, od_rule_t, link);
-		if (rule->obsolete) {
-			continue;
-		}
-		if (pool_internal) {
-			if (rule->pool->routing != OD_RULE_POOL_INTERNAL) {
-				continue;
-			}
-		} else {
-			if (rule->pool->routing !=
-			    OD_RULE_POOL_CLIENT_VISIBLE) {
-				continue;
-			}
-		}
-
-		if (!od_rule_db_match(rule, dbname)) {
-			continue;
-		}
-
-		if (!od_rule_user_match(rule, user)) {
-			continue;
-		}
-
-		if (!od_rule_address_match(rule, user_addr)) {
-			continue;
-		}
-
-		if (!od_rule_conn_type_match(rule, startup, user_addr)) {
-			continue;
+		if (od_rule_matches(rule, startup, user_addr, user_hostname,
+				    pool_internal)) {
+			return rule;
 		}
-
-		return rule;
 	}
 
 	return NULL;
@@ -1105,10 +1155,10 @@ static od_rule_t *od_rules_find_first_matching(
 
 od_rule_t *od_rules_forward(od_rules_t *rules, const kiwi_be_startup_t *startup,
 			    struct sockaddr_storage *user_addr,
-			    int pool_internal)
+			    const char *user_hostname, int pool_internal)
 {
 	return od_rules_find_first_matching(rules, startup, user_addr,
-					    pool_internal);
+					    user_hostname, pool_internal);
 }
 
 static inline int od_rule_match(od_rule_t *rule, const char *dbname,
@@ -1215,6 +1265,11 @@ static inline int od_rules_storage_compare(od_rule_storage_t *a,
 		return 0;
 	}
 
+	/* load_balance */
+	if (a->load_balance != b->load_balance) {
+		return 0;
+	}
+
 	/* host */
 	if (a->host && b->host) {
 		if (strcmp(a->host, b->host) != 0) {
@@ -1229,6 +1284,40 @@ static inline int od_rules_storage_compare(od_rule_storage_t *a,
 		return 0;
 	}
 
+	/* shards */
+	if (a->shards && b->shards) {
+		if (strcmp(a->shards, b->shards) != 0) {
+			return 0;
+		}
+		/* shard endpoints follow shard storages */
+		if (a->endpoints_count != b->endpoints_count) {
+			return 0;
+		}
+		for (size_t i = 0; i < a->endpoints_count; ++i) {
+			if (a->endpoints[i].shard != b->endpoints[i].shard ||
+			    od_address_cmp(&a->endpoints[i].address,
+					   &b->endpoints[i].address) != 0) {
+				return 0;
+			}
+		}
+	} else if (a->shards || b->shards) {
+		return 0;
+	}
+
+	/* shard_by */
+	if (a->shard_by != b->shard_by) {
+		return 0;
+	}
+
+	/* shard_ranges */
+	if (a->shard_ranges_str && b->shard_ranges_str) {
+		if (strcmp(a->shard_ranges_str, b->shard_ranges_str) != 0) {
+			return 0;
+		}
+	} else if (a->shard_ranges_str || b->shard_ranges_str) {
+		return 0;
+	}
+
 	/* tls_opts->tls_mode */
 	if (a->tls_opts->tls_mode != b->tls_opts->tls_mode) {
 		return 0;
@@ -1478,6 +1567,11 @@ int od_rules_merge(od_rules_t *rules, od_rules_t *src, od_list_t *added,
 		rule->mark = 1;
 		count_mark++;
 		od_hashmap_empty(rule->storage->acache);
+#ifdef LDAP_FOUND
+		if (rule->ldap_endpoint != NULL) {
+			od_ldap_cache_flush(&rule->ldap_endpoint->cache);
+		}
+#endif
 	}
 
 	/* select dropped rules */
@@ -1708,6 +1802,13 @@ int od_pool_validate(od_logger_t *logger, od_rule_pool_t *pool, char *db_name,
 		return NOT_OK_RESPONSE;
 	}
 
+	if (pool->weight <= 0) {
+		od_error(logger, "rules", NULL, NULL,
+			 "rule '%s.%s %s': pool_weight must be positive",
+			 db_name, user_name, address_range->string_value);
+		return NOT_OK_RESPONSE;
+	}
+
 	if (pool->pool_type == OD_RULE_POOL_SESSION && pool->pin_on_listen) {
 		od_error(
 			logger, "rules", NULL, NULL,
@@ -1879,6 +1980,11 @@ static inline int od_rules_validate_endpoints(od_logger_t *logger,
 					      od_config_t *config,
 					      od_rule_storage_t *storage)
 {
+	if (storage->shards != NULL) {
+		/* endpoints are taken from shards */
+		return 0;
+	}
+
 	if (storage->host == NULL) {
 		if (config->unix_socket_dir == NULL) {
 			od_error(logger, "rules", NULL, NULL,
@@ -1905,6 +2011,7 @@ static inline int od_rules_validate_endpoints(od_logger_t *logger,
 
 		od_storage_endpoint_status_init(&endpoint->status);
 		od_address_init(&endpoint->address);
+		endpoint->stats = NULL;
 
 		endpoint->address.type = OD_ADDRESS_TYPE_UNIX;
 		endpoint->address.host = od_strdup(buff);
@@ -1924,9 +2031,193 @@ static inline int od_rules_validate_endpoints(od_logger_t *logger,
 		}
 	}
 
+	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+		od_storage_endpoint_t *endpoint = &storage->endpoints[i];
+		if (endpoint->stats != NULL) {
+			continue;
+		}
+		endpoint->stats =
+			od_storage_endpoint_stats_get(&endpoint->address);
+		if (endpoint->stats == NULL) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static inline int od_rules_validate_shard_ranges(od_logger_t *logger,
+						 od_rule_storage_t *storage)
+{
+	if (storage->shard_by != OD_STORAGE_SHARD_BY_RANGE) {
+		return 0;
+	}
+	if (storage->shard_ranges_str == NULL) {
+		od_error(logger, "rules", NULL, NULL,
+			 "storage '%s': shard_ranges are not set",
+			 storage->name);
+		return -1;
+	}
+
+	size_t count = storage->shards_count - 1;
+	storage->shard_ranges = od_malloc(sizeof(int64_t) * (count + 1));
+	if (storage->shard_ranges == NULL) {
+		return -1;
+	}
+
+	char *pos = storage->shard_ranges_str;
+	size_t parsed = 0;
+	while (*pos != 0) {
+		char *end;
+		errno = 0;
+		long long bound = strtoll(pos, &end, 10);
+		int64_t *ranges = storage->shard_ranges;
+		if (errno != 0 || end == pos || parsed == count ||
+		    (parsed > 0 && bound <= ranges[parsed - 1])) {
+			parsed = 0;
+			break;
+		}
+		storage->shard_ranges[parsed++] = bound;
+
+		while (isspace((unsigned char)*end)) {
+			end++;
+		}
+		if (*end == ',') {
+			end++;
+		} else if (*end != 0) {
+			parsed = 0;
+			break;
+		}
+		pos = end;
+	}
+
+	if (parsed != count) {
+		od_error(logger, "rules", NULL, NULL,
+			 "storage '%s': shard_ranges must be %zu increasing "
+			 "integer bounds",
+			 storage->name, count);
+		return -1;
+	}
 	return 0;
 }
 
+/*
+ * sharded storage gets endpoints of its shard storages,
+ * shard storages must be validated already
+ */
+static inline int od_rules_validate_shards(od_logger_t *logger,
+					   od_rules_t *rules,
+					   od_rule_storage_t *storage)
+{
+	od_storage_endpoint_t endpoints[OD_STORAGE_MAX_ENDPOINTS];
+	size_t count = 0;
+	int rc = -1;
+
+	char *shards = od_strdup(storage->shards);
+	if (shards == NULL) {
+		return -1;
+	}
+
+	char *saveptr = NULL;
+	char *name = strtok_r(shards, ", ", &saveptr);
+	for (; name != NULL; name = strtok_r(NULL, ", ", &saveptr)) {
+		od_rule_storage_t *shard = od_rules_storage_match(rules, name);
+		if (shard == NULL || shard == storage ||
+		    shard->storage_type != OD_RULE_STORAGE_REMOTE ||
+		    shard->shards != NULL) {
+			od_error(logger, "rules", NULL, NULL,
+				 "storage '%s': shard '%s' is not a remote "
+				 "storage",
+				 storage->name, name);
+			goto done;
+		}
+
+		for (size_t i = 0; i < shard->endpoints_count; ++i) {
+			if (count == OD_STORAGE_MAX_ENDPOINTS) {
+				od_error(logger, "rules", NULL, NULL,
+					 "storage '%s': too many endpoints",
+					 storage->name);
+				goto done;
+			}
+			od_storage_endpoint_t *endpoint = &endpoints[count];
+			od_storage_endpoint_status_init(&endpoint->status);
+			od_address_init(&endpoint->address);
+			endpoint->shard = storage->shards_count;
+			endpoint->stats = od_storage_endpoint_stats_get(
+				&shard->endpoints[i].address);
+			count++;
+			if (endpoint->stats == NULL ||
+			    od_address_copy(&endpoint->address,
+					    &shard->endpoints[i].address) !=
+				    OK_RESPONSE) {
+				goto done;
+			}
+		}
+		storage->shards_count++;
+	}
+
+	if (storage->shards_count == 0) {
+		od_error(logger, "rules", NULL, NULL,
+			 "storage '%s': no shards specified", storage->name);
+		goto done;
+	}
+
+	storage->endpoints = od_malloc(sizeof(od_storage_endpoint_t) * count);
+	if (storage->endpoints == NULL) {
+		goto done;
+	}
+	memcpy(storage->endpoints, endpoints,
+	       sizeof(od_storage_endpoint_t) * count);
+	storage->endpoints_count = count;
+	count = 0;
+
+	rc = od_rules_validate_shard_ranges(logger, storage);
+done:
+	for (size_t i = 0; i < count; ++i) {
+		od_storage_endpoint_status_destroy(&endpoints[i].status);
+		if (endpoints[i].stats != NULL) {
+			od_storage_endpoint_stats_unref(endpoints[i].stats);
+		}
+		od_address_destroy(&endpoints[i].address);
+	}
+	od_free(shards);
+	return rc;
+}
+
+/* guaranteed minimums must fit into the shared pool together */
+static inline int od_rules_validate_shared_quota(od_logger_t *logger,
+						 od_rules_t *rules)
+{
+	od_list_t *i;
+	od_list_foreach (&rules->rules, i) {
+		od_rule_t *rule = od_container_of(i, od_rule_t, link);
+		if (rule->shared_pool != NULL) {
+			rule->shared_pool->reserved = 0;
+		}
+	}
+
+	od_list_foreach (&rules->rules, i) {
+		od_rule_t *rule = od_container_of(i, od_rule_t, link);
+		if (rule->shared_pool != NULL) {
+			rule->shared_pool->reserved +=
+				rule->pool->shared_min_size;
+		}
+	}
+
+	od_list_foreach (&rules->rules, i) {
+		od_rule_t *rule = od_container_of(i, od_rule_t, link);
+		od_shared_pool_t *sp = rule->shared_pool;
+		if (sp != NULL && sp->reserved > sp->pool_size) {
+			od_error(logger, "rules", NULL, NULL,
+				 "shared pool '%s': sum of "
+				 "shared_pool_min_size %d exceeds pool_size %d",
+				 sp->name, sp->reserved, sp->pool_size);
+			return NOT_OK_RESPONSE;
+		}
+	}
+	return OK_RESPONSE;
+}
+
 int od_rules_validate(od_rules_t *rules, od_config_t *config,
 		      od_logger_t *logger)
 {
@@ -1992,6 +2283,24 @@ int od_rules_validate(od_rules_t *rules, od_config_t *config,
 		}
 	}
 
+	/* sharded storages */
+	od_list_foreach (&rules->storages, i) {
+		od_rule_storage_t *storage;
+		storage = od_container_of(i, od_rule_storage_t, link);
+		if (storage->shards == NULL) {
+			continue;
+		}
+		if (storage->storage_type != OD_RULE_STORAGE_REMOTE) {
+			od_error(logger, "rules", NULL, NULL,
+				 "storage '%s': shards require remote type",
+				 storage->name);
+			return -1;
+		}
+		if (od_rules_validate_shards(logger, rules, storage) != 0) {
+			return -1;
+		}
+	}
+
 	/* rules */
 	if (od_list_empty(&rules->rules)) {
 		od_error(logger, "rules", NULL, NULL, "no rules defined");
@@ -2196,6 +2505,10 @@ int od_rules_validate(od_rules_t *rules, od_config_t *config,
 #endif
 	}
 
+	if (od_rules_validate_shared_quota(logger, rules) != OK_RESPONSE) {
+		return NOT_OK_RESPONSE;
+	}
+
 	return 0;
 }
 
@@ -2251,6 +2564,23 @@ void od_rules_print(od_rules_t *rules, od_logger_t *logger)
 		od_log(logger, "storage", NULL, NULL, "  port          %d",
 		       storage->port);
 
+		od_log(logger, "storage", NULL, NULL, "  load_balance  %s",
+		       od_storage_load_balance_to_str(storage->load_balance));
+
+		if (storage->shards) {
+			od_log(logger, "storage", NULL, NULL,
+			       "  shards        %s", storage->shards);
+			od_log(logger, "storage", NULL, NULL,
+			       "  shard_by      %s",
+			       storage->shard_by == OD_STORAGE_SHARD_BY_RANGE ?
+				       "range" :
+				       "hash");
+		}
+		if (storage->shard_ranges_str) {
+			od_log(logger, "storage", NULL, NULL,
+			       "  shard_ranges  %s", storage->shard_ranges_str);
+		}
+
 		if (storage->tls_opts->tls) {
 			od_log(logger, "storage", NULL, NULL,
 			       "  tls             %s", storage->tls_opts->tls);
@@ -2286,6 +2616,9 @@ void od_rules_print(od_rules_t *rules, od_logger_t *logger)
 				       "  watchdog interval   %d",
 				       storage->watchdog->interval);
 			}
+			od_log(logger, "storage", NULL, NULL,
+			       "  watchdog poll interval   %d",
+			       storage->watchdog->poll_interval_ms);
 		}
 		od_log(logger, "storage", NULL, NULL, "");
 	}
@@ -2344,18 +2677,41 @@ void od_rules_print(od_rules_t *rules, od_logger_t *logger)
 		od_log(logger, "rules", NULL, NULL,
 		       "  min pool size                     %d",
 		       rule->pool->min_size);
+		od_log(logger, "rules", NULL, NULL,
+		       "  pool warmup                       %s",
+		       rule->pool->warmup ? "yes" : "no");
 		od_log(logger, "rules", NULL, NULL,
 		       "  pool timeout                      %d",
 		       rule->pool->timeout);
 		od_log(logger, "rules", NULL, NULL,
 		       "  pool ttl                          %d",
 		       rule->pool->ttl);
+		od_log(logger, "rules", NULL, NULL,
+		       "  pool weight                       %d",
+		       rule->pool->weight);
+		od_log(logger, "rules", NULL, NULL,
+		       "  pool priority                     %d",
+		       rule->pool->priority);
+		if (rule->shared_pool != NULL) {
+			od_log(logger, "rules", NULL, NULL,
+			       "  shared pool                       %s",
+			       rule->shared_pool->name);
+			od_log(logger, "rules", NULL, NULL,
+			       "  shared pool min size              %d",
+			       rule->pool->shared_min_size);
+			od_log(logger, "rules", NULL, NULL,
+			       "  shared pool max size              %d",
+			       rule->pool->shared_max_size);
+		}
 		od_log(logger, "rules", NULL, NULL,
 		       "  pool discard                      %s",
 		       rule->pool->discard ? "yes" : "no");
 		od_log(logger, "rules", NULL, NULL,
 		       "  pool smart discard                %s",
 		       rule->pool->smart_discard ? "yes" : "no");
+		od_log(logger, "rules", NULL, NULL,
+		       "  pool reset tracking               %s",
+		       rule->pool->reset_tracking ? "yes" : "no");
 		od_log(logger, "rules", NULL, NULL,
 		       "  pool cancel                       %s",
 		       rule->pool->cancel ? "yes" : "no");
@@ -2373,6 +2729,15 @@ void od_rules_print(od_rules_t *rules, od_logger_t *logger)
 			       "  pool prepared statement support   %s",
 			       rule->pool->reserve_prepared_statement ? "yes" :
 									"no");
+			od_log(logger, "rules", NULL, NULL,
+			       "  pool prepared statements max      %d",
+			       rule->pool->prepared_statements_max);
+			od_log(logger, "rules", NULL, NULL,
+			       "  pool prepared statements bytes    %d",
+			       rule->pool->prepared_statements_max_bytes);
+			od_log(logger, "rules", NULL, NULL,
+			       "  pool prepared statements deploy   %d",
+			       rule->pool->prepared_statements_deploy);
 		}
 
 		if (rule->client_max_set) {
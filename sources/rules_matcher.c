@@ -0,0 +1,383 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+#include <kiwi/kiwi.h>
+
+#include <types.h>
+#include <rules.h>
+#include <rules_matcher.h>
+#include <od_memory.h>
+
+#define OD_RULES_MATCHER_BUCKETS_MIN 64
+
+static inline od_hash_t od_rules_matcher_hash(const char *db_name,
+					      const char *user_name)
+{
+	od_hash_t hash = 0;
+	if (db_name != NULL) {
+		hash = od_murmur_hash(db_name, strlen(db_name));
+	}
+	hash *= 31;
+	if (user_name != NULL) {
+		hash += od_murmur_hash(user_name, strlen(user_name));
+	}
+	return hash;
+}
+
+static inline int od_rules_matcher_name_eq(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+	return strcmp(a, b) == 0;
+}
+
+static inline int
+od_rules_matcher_entries_add(od_rules_matcher_entries_t *entries,
+			     od_rule_t *rule, int index)
+{
+	if (entries->count == entries->capacity) {
+		size_t capacity = entries->capacity * 2;
+		if (capacity == 0) {
+			capacity = 4;
+		}
+		od_rules_matcher_entry_t *items = od_realloc(
+			entries->items,
+			capacity * sizeof(od_rules_matcher_entry_t));
+		if (items == NULL) {
+			return -1;
+		}
+		entries->items = items;
+		entries->capacity = capacity;
+	}
+
+	/* rules are added in list order, so entries stay sorted by index */
+	entries->items[entries->count].rule = rule;
+	entries->items[entries->count].index = index;
+	entries->count++;
+	return 0;
+}
+
+static inline void
+od_rules_matcher_entries_free(od_rules_matcher_entries_t *entries)
+{
+	if (entries->items != NULL) {
+		od_free(entries->items);
+	}
+}
+
+static void od_rules_matcher_node_free(od_rules_matcher_node_t *node)
+{
+	if (node == NULL) {
+		return;
+	}
+	od_rules_matcher_node_free(node->child[0]);
+	od_rules_matcher_node_free(node->child[1]);
+	od_rules_matcher_entries_free(&node->entries);
+	od_free(node);
+}
+
+static inline int od_rules_matcher_bit(const uint8_t *bytes, int bit)
+{
+	return (bytes[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+/* returns prefix length or -1 if mask is not a prefix */
+static inline int od_rules_matcher_prefix_len(const uint8_t *mask, int bits)
+{
+	int len = 0;
+	while (len < bits && od_rules_matcher_bit(mask, len)) {
+		len++;
+	}
+	for (int bit = len; bit < bits; bit++) {
+		if (od_rules_matcher_bit(mask, bit)) {
+			return -1;
+		}
+	}
+	return len;
+}
+
+static inline const uint8_t *
+od_rules_matcher_addr_bytes(const struct sockaddr_storage *sa, int *bits)
+{
+	if (sa->ss_family == AF_INET) {
+		*bits = 32;
+		return (const uint8_t *)&((const struct sockaddr_in *)sa)
+			->sin_addr.s_addr;
+	}
+	if (sa->ss_family == AF_INET6) {
+		*bits = 128;
+		return ((const struct sockaddr_in6 *)sa)->sin6_addr.s6_addr;
+	}
+	return NULL;
+}
+
+static int od_rules_matcher_node_add(od_rules_matcher_node_t **root,
+				     const uint8_t *addr, int prefix_len,
+				     od_rule_t *rule, int index)
+{
+	od_rules_matcher_node_t **node = root;
+	for (int bit = 0;; bit++) {
+		if (*node == NULL) {
+			*node = od_malloc(sizeof(od_rules_matcher_node_t));
+			if (*node == NULL) {
+				return -1;
+			}
+			memset(*node, 0, sizeof(od_rules_matcher_node_t));
+		}
+		if (bit == prefix_len) {
+			break;
+		}
+		node = &(*node)->child[od_rules_matcher_bit(addr, bit)];
+	}
+
+	return od_rules_matcher_entries_add(&(*node)->entries, rule, index);
+}
+
+static int od_rules_matcher_bucket_add(od_rules_matcher_bucket_t *bucket,
+				       od_rule_t *rule, int index)
+{
+	const od_address_range_t *range = &rule->address_range;
+	if (range->is_default || range->is_hostname) {
+		return od_rules_matcher_entries_add(&bucket->linear, rule,
+						    index);
+	}
+
+	int bits;
+	const uint8_t *addr = od_rules_matcher_addr_bytes(&range->addr, &bits);
+	int mask_bits;
+	const uint8_t *mask =
+		od_rules_matcher_addr_bytes(&range->mask, &mask_bits);
+	if (addr == NULL || mask == NULL || bits != mask_bits) {
+		return od_rules_matcher_entries_add(&bucket->linear, rule,
+						    index);
+	}
+
+	int prefix_len = od_rules_matcher_prefix_len(mask, bits);
+	if (prefix_len == -1) {
+		return od_rules_matcher_entries_add(&bucket->linear, rule,
+						    index);
+	}
+
+	od_rules_matcher_node_t **root = &bucket->inet;
+	if (range->addr.ss_family == AF_INET6) {
+		root = &bucket->inet6;
+	}
+	return od_rules_matcher_node_add(root, addr, prefix_len, rule, index);
+}
+
+static od_rules_matcher_bucket_t *
+od_rules_matcher_bucket_get(od_rules_matcher_t *matcher, const char *db_name,
+			    const char *user_name)
+{
+	od_hash_t hash = od_rules_matcher_hash(db_name, user_name);
+	od_rules_matcher_bucket_t *bucket;
+	bucket = matcher->buckets[hash & (matcher->buckets_count - 1)];
+	for (; bucket != NULL; bucket = bucket->next) {
+		if (bucket->hash == hash &&
+		    od_rules_matcher_name_eq(bucket->db_name, db_name) &&
+		    od_rules_matcher_name_eq(bucket->user_name, user_name)) {
+			return bucket;
+		}
+	}
+	return NULL;
+}
+
+static od_rules_matcher_bucket_t *
+od_rules_matcher_bucket_get_or_create(od_rules_matcher_t *matcher,
+				      const char *db_name,
+				      const char *user_name)
+{
+	od_rules_matcher_bucket_t *bucket;
+	bucket = od_rules_matcher_bucket_get(matcher, db_name, user_name);
+	if (bucket != NULL) {
+		return bucket;
+	}
+
+	bucket = od_malloc(sizeof(od_rules_matcher_bucket_t));
+	if (bucket == NULL) {
+		return NULL;
+	}
+	memset(bucket, 0, sizeof(od_rules_matcher_bucket_t));
+	bucket->db_name = db_name;
+	bucket->user_name = user_name;
+	bucket->hash = od_rules_matcher_hash(db_name, user_name);
+
+	od_rules_matcher_bucket_t **head;
+	head = &matcher->buckets[bucket->hash & (matcher->buckets_count - 1)];
+	bucket->next = *head;
+	*head = bucket;
+	return bucket;
+}
+
+void od_rules_matcher_free(od_rules_matcher_t *matcher)
+{
+	if (matcher == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < matcher->buckets_count; i++) {
+		od_rules_matcher_bucket_t *bucket = matcher->buckets[i];
+		while (bucket != NULL) {
+			od_rules_matcher_bucket_t *next = bucket->next;
+			od_rules_matcher_entries_free(&bucket->linear);
+			od_rules_matcher_node_free(bucket->inet);
+			od_rules_matcher_node_free(bucket->inet6);
+			od_free(bucket);
+			bucket = next;
+		}
+	}
+
+	od_free(matcher->buckets);
+	od_free(matcher);
+}
+
+od_rules_matcher_t *od_rules_matcher_create(od_list_t *rules)
+{
+	od_rules_matcher_t *matcher = od_malloc(sizeof(od_rules_matcher_t));
+	if (matcher == NULL) {
+		return NULL;
+	}
+
+	size_t count = od_list_count(rules);
+	size_t buckets_count = OD_RULES_MATCHER_BUCKETS_MIN;
+	while (buckets_count < count) {
+		buckets_count *= 2;
+	}
+
+	matcher->rules_count = 0;
+	matcher->buckets_count = buckets_count;
+	matcher->buckets =
+		od_calloc(buckets_count, sizeof(od_rules_matcher_bucket_t *));
+	if (matcher->buckets == NULL) {
+		od_free(matcher);
+		return NULL;
+	}
+
+	int index = 0;
+	od_list_t *i;
+	od_list_foreach (rules, i) {
+		od_rule_t *rule = od_container_of(i, od_rule_t, link);
+		index++;
+
+		/* obsolete rules are never matched and can be freed by gc */
+		if (rule->obsolete) {
+			continue;
+		}
+
+		const char *db_name = rule->db_is_default ? NULL :
+							    rule->db_name;
+		/* group members can be changed by group checker */
+		const char *user_name = NULL;
+		if (!rule->user_is_default && rule->group == NULL) {
+			user_name = rule->user_name;
+		}
+
+		od_rules_matcher_bucket_t *bucket;
+		bucket = od_rules_matcher_bucket_get_or_create(matcher, db_name,
+							       user_name);
+		if (bucket == NULL) {
+			goto error;
+		}
+
+		if (od_rules_matcher_bucket_add(bucket, rule, index) == -1) {
+			goto error;
+		}
+		matcher->rules_count++;
+	}
+
+	return matcher;
+
+error:
+	od_rules_matcher_free(matcher);
+	return NULL;
+}
+
+static inline void
+od_rules_matcher_entries_find(od_rules_matcher_entries_t *entries,
+			      const kiwi_be_startup_t *startup,
+			      struct sockaddr_storage *user_addr,
+			      const char *user_hostname, int pool_internal,
+			      od_rules_matcher_entry_t *best)
+{
+	for (size_t i = 0; i < entries->count; i++) {
+		od_rules_matcher_entry_t *entry = &entries->items[i];
+		if (entry->index >= best->index) {
+			return;
+		}
+		if (od_rule_matches(entry->rule, startup, user_addr,
+				    user_hostname, pool_internal)) {
+			*best = *entry;
+			return;
+		}
+	}
+}
+
+static inline void
+od_rules_matcher_bucket_find(od_rules_matcher_bucket_t *bucket,
+			     const kiwi_be_startup_t *startup,
+			     struct sockaddr_storage *user_addr,
+			     const char *user_hostname, int pool_internal,
+			     od_rules_matcher_entry_t *best)
+{
+	od_rules_matcher_entries_find(&bucket->linear, startup, user_addr,
+				      user_hostname, pool_internal, best);
+
+	if (user_addr == NULL) {
+		return;
+	}
+
+	int bits;
+	const uint8_t *addr = od_rules_matcher_addr_bytes(user_addr, &bits);
+	if (addr == NULL) {
+		return;
+	}
+
+	/* every node on the path holds a prefix covering the address */
+	od_rules_matcher_node_t *node = bucket->inet;
+	if (user_addr->ss_family == AF_INET6) {
+		node = bucket->inet6;
+	}
+	for (int bit = 0; node != NULL; bit++) {
+		od_rules_matcher_entries_find(&node->entries, startup,
+					      user_addr, user_hostname,
+					      pool_internal, best);
+		if (bit == bits) {
+			break;
+		}
+		node = node->child[od_rules_matcher_bit(addr, bit)];
+	}
+}
+
+od_rule_t *od_rules_matcher_find(od_rules_matcher_t *matcher,
+				 const kiwi_be_startup_t *startup,
+				 struct sockaddr_storage *user_addr,
+				 const char *user_hostname, int pool_internal)
+{
+	const char *db_names[] = { startup->database.value, NULL };
+	const char *user_names[] = { startup->user.value, NULL };
+
+	od_rules_matcher_entry_t best = { .rule = NULL, .index = INT_MAX };
+
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			od_rules_matcher_bucket_t *bucket;
+			bucket = od_rules_matcher_bucket_get(
+				matcher, db_names[i], user_names[j]);
+			if (bucket == NULL) {
+				continue;
+			}
+			od_rules_matcher_bucket_find(bucket, startup, user_addr,
+						     user_hostname,
+						     pool_internal, &best);
+		}
+	}
+
+	return best.rule;
+}
@@ -11,6 +11,7 @@
 #include <client.h>
 #include <server.h>
 #include <multi_pool.h>
+#include <route.h>
 
 static inline void od_server_free_now(od_server_t *server)
 {
@@ -21,8 +22,9 @@ static inline void od_server_free_now(od_server_t *server)
 		machine_tls_free(server->tls);
 		server->tls = NULL;
 	}
+	od_parse_queue_free(&server->parse_queue);
 	if (server->prep_stmts) {
-		od_hashmap_free(server->prep_stmts);
+		od_server_prep_stmts_free(server->prep_stmts);
 	}
 	od_scram_state_free(&server->scram_state);
 	od_free(server);
@@ -103,7 +105,6 @@ void od_server_attach_client(od_server_t *server, od_client_t *client)
 	server->client = client;
 	client->server = server;
 	server->key_client = client->key;
-	server->idle_time = 0;
 	od_server_set_pool_state(server, OD_SERVER_ACTIVE);
 	od_server_ref(server);
 }
@@ -142,14 +143,96 @@ const od_address_t *od_server_pool_address(od_server_t *server)
 	return &server->pool_element->key.address;
 }
 
+static inline void od_server_set_lifetime_deadline(od_server_t *server)
+{
+	uint64_t lifetime = server->route->rule->server_lifetime_us;
+	if (lifetime == 0) {
+		return;
+	}
+
+	/*
+	 * up to 10% jitter, so connections created together
+	 * are not reconnected together, the setting stays an upper bound
+	 */
+	uint64_t jitter = (uint64_t)machine_lrand48() % (lifetime / 10 + 1);
+	server->lifetime_deadline_us = server->init_time_us + lifetime - jitter;
+}
+
+static inline uint64_t od_server_expire_deadline(od_server_t *server)
+{
+	if (server->offline) {
+		return 0;
+	}
+
+	uint64_t deadline = UINT64_MAX;
+	int ttl = server->route->rule->pool->ttl;
+	if (ttl > 0) {
+		deadline = server->idle_since_us + (uint64_t)ttl * 1000000;
+	}
+	if (server->lifetime_deadline_us != 0 &&
+	    server->lifetime_deadline_us < deadline) {
+		deadline = server->lifetime_deadline_us;
+	}
+	return deadline;
+}
+
 void od_server_set_pool_state(od_server_t *server, od_server_state_t state)
 {
 	od_server_pool_t *pool;
 	pool = od_server_pool(server);
 
+	od_server_state_t prev_state = server->state;
+	if (prev_state == state) {
+		return;
+	}
+
+	if (prev_state == OD_SERVER_UNDEF && server->route != NULL &&
+	    server->lifetime_deadline_us == 0) {
+		od_server_set_lifetime_deadline(server);
+	}
+
+	if (prev_state == OD_SERVER_IDLE) {
+		od_pairing_heap_remove(&pool->expire, &server->expire_node);
+	}
+
+	if (state == OD_SERVER_IDLE) {
+		server->vars_fingerprint = kiwi_vars_fingerprint(&server->vars);
+	}
+
 	od_pg_server_pool_set(pool, server, state);
 
+	if (state == OD_SERVER_IDLE) {
+		server->idle_since_us = machine_time_us();
+		od_pairing_heap_insert(&pool->expire, &server->expire_node,
+				       od_server_expire_deadline(server));
+	}
+
 	if (state == OD_SERVER_UNDEF) {
 		server->pool_element = NULL;
 	}
 }
+
+void od_server_set_idle_since(od_server_t *server, uint64_t idle_since_us)
+{
+	assert(server->state == OD_SERVER_IDLE);
+
+	od_server_pool_t *pool;
+	pool = od_server_pool(server);
+
+	server->idle_since_us = idle_since_us;
+	od_pairing_heap_remove(&pool->expire, &server->expire_node);
+	od_pairing_heap_insert(&pool->expire, &server->expire_node,
+			       od_server_expire_deadline(server));
+}
+
+void od_server_set_offline(od_server_t *server)
+{
+	server->offline = 1;
+
+	/* idle server must be closed by the next expire */
+	if (server->state == OD_SERVER_IDLE) {
+		od_server_pool_t *pool = od_server_pool(server);
+		od_pairing_heap_remove(&pool->expire, &server->expire_node);
+		od_pairing_heap_insert(&pool->expire, &server->expire_node, 0);
+	}
+}
@@ -0,0 +1,162 @@
+/*
+ * Odyssey.
+ *
+ * Scalable PostgreSQL connection pooler.
+ */
+
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <server_prep_stmts.h>
+#include <od_memory.h>
+
+static void od_server_prep_stmt_dtor(od_lhashmap_entry_t *entry)
+{
+	od_server_prep_stmt_t *stmt = entry->value.data;
+	od_server_prep_stmts_t *stmts = stmt->owner;
+
+	od_list_unlink(&stmt->link);
+	stmts->count--;
+	stmts->bytes -= stmt->body->len;
+	od_prep_stmt_body_unref(stmt->body);
+}
+
+od_server_prep_stmts_t *od_server_prep_stmts_create(size_t capacity)
+{
+	od_server_prep_stmts_t *stmts;
+	stmts = od_malloc(sizeof(od_server_prep_stmts_t));
+	if (stmts == NULL) {
+		return NULL;
+	}
+
+	stmts->index = od_lhashmap_create(capacity, od_server_prep_stmt_dtor);
+	if (stmts->index == NULL) {
+		od_free(stmts);
+		return NULL;
+	}
+	od_list_init(&stmts->lru);
+	stmts->count = 0;
+	stmts->bytes = 0;
+	return stmts;
+}
+
+void od_server_prep_stmts_free(od_server_prep_stmts_t *stmts)
+{
+	od_lhashmap_free(stmts->index);
+	od_free(stmts);
+}
+
+void od_server_prep_stmts_empty(od_server_prep_stmts_t *stmts)
+{
+	od_lhashmap_empty(stmts->index);
+	assert(stmts->count == 0);
+}
+
+static inline void od_server_prep_stmts_key(od_prep_stmt_body_t **body,
+					    od_hashmap_elt_t *key)
+{
+	/* bodies are interned, so the pointer identifies the text */
+	key->data = body;
+	key->len = sizeof(od_prep_stmt_body_t *);
+}
+
+int od_server_prep_stmts_contains(od_server_prep_stmts_t *stmts,
+				  od_prep_stmt_body_t *body)
+{
+	od_hashmap_elt_t key;
+	od_server_prep_stmts_key(&body, &key);
+	return od_lhashmap_find(stmts->index, body->hash, &key) != NULL;
+}
+
+int od_server_prep_stmts_use(od_server_prep_stmts_t *stmts,
+			     od_prep_stmt_body_t *body)
+{
+	od_hashmap_elt_t key;
+	od_server_prep_stmts_key(&body, &key);
+
+	od_hashmap_elt_t *value;
+	value = od_lhashmap_find(stmts->index, body->hash, &key);
+	if (value != NULL) {
+		od_server_prep_stmt_t *stmt = value->data;
+		od_list_unlink(&stmt->link);
+		od_list_push(&stmts->lru, &stmt->link);
+		return 1;
+	}
+
+	od_server_prep_stmt_t stmt;
+	memset(&stmt, 0, sizeof(stmt));
+	od_hashmap_elt_t stmt_value;
+	stmt_value.data = &stmt;
+	stmt_value.len = sizeof(stmt);
+	value = &stmt_value;
+	if (od_lhashmap_insert(stmts->index, body->hash, &key, &value) != 0) {
+		return -1;
+	}
+
+	/* the index keeps its own copy of the value */
+	od_server_prep_stmt_t *added = value->data;
+	added->owner = stmts;
+	added->body = od_prep_stmt_body_ref(body);
+	od_list_init(&added->link);
+	od_list_push(&stmts->lru, &added->link);
+	stmts->count++;
+	stmts->bytes += body->len;
+	return 0;
+}
+
+static inline int od_server_prep_stmts_over(size_t value, size_t limit)
+{
+	return limit != 0 && value > limit;
+}
+
+int od_server_prep_stmts_evict_query(od_server_prep_stmts_t *stmts,
+				     size_t max_count, size_t max_bytes,
+				     int max, char *query, size_t size)
+{
+	if (!od_server_prep_stmts_over(stmts->count, max_count) &&
+	    !od_server_prep_stmts_over(stmts->bytes, max_bytes)) {
+		return 0;
+	}
+
+	/* evict a batch to not deallocate on every reset */
+	size_t count = stmts->count;
+	size_t bytes = stmts->bytes;
+	size_t pos = 0;
+	int n = 0;
+
+	od_list_t *i;
+	for (i = stmts->lru.prev; i != &stmts->lru && n < max; i = i->prev) {
+		if (!od_server_prep_stmts_over(count, max_count / 4 * 3) &&
+		    !od_server_prep_stmts_over(bytes, max_bytes / 4 * 3)) {
+			break;
+		}
+		od_server_prep_stmt_t *stmt;
+		stmt = od_container_of(i, od_server_prep_stmt_t, link);
+
+		int len = od_snprintf(query + pos, size - pos,
+				      "DEALLOCATE \"%08x\";", stmt->body->hash);
+		if (pos + len + 1 >= size) {
+			break;
+		}
+		pos += len;
+		count--;
+		bytes -= stmt->body->len;
+		n++;
+	}
+
+	return n;
+}
+
+void od_server_prep_stmts_evict(od_server_prep_stmts_t *stmts, int n)
+{
+	for (int i = 0; i < n && !od_list_empty(&stmts->lru); i++) {
+		od_server_prep_stmt_t *stmt;
+		stmt = od_container_of(stmts->lru.prev, od_server_prep_stmt_t,
+				       link);
+		od_prep_stmt_body_t *body = stmt->body;
+		od_hashmap_elt_t key;
+		od_server_prep_stmts_key(&body, &key);
+		od_lhashmap_remove(stmts->index, body->hash, &key);
+	}
+}
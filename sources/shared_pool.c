@@ -17,6 +17,8 @@ static inline void od_shared_pool_free(od_shared_pool_t *sp)
 
 	od_multi_pool_destroy(sp->mpool);
 
+	od_admission_free(&sp->admission);
+
 	od_free(sp->name);
 
 	pthread_spin_destroy(&sp->lock);
@@ -48,6 +50,8 @@ od_shared_pool_t *od_shared_pool_create(const char *name)
 
 	od_list_init(&sp->link);
 
+	od_admission_init(&sp->admission);
+
 	pthread_spin_init(&sp->lock, PTHREAD_PROCESS_PRIVATE);
 
 	return sp;
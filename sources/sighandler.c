@@ -101,6 +101,7 @@ void od_system_shutdown(od_system_t *system, od_instance_t *instance)
 
 	/* lock here */
 	od_cron_stop(system->global->cron);
+	od_connect_factory_stop(&system->global->router->connect_factory);
 
 	/* Prevent OpenSSL usage during deinitialization */
 	od_worker_pool_wait();
@@ -15,8 +15,10 @@
 #include <route.h>
 #include <query.h>
 #include <attach.h>
+#include <backend.h>
 #include <router.h>
 #include <auth_query.h>
+#include <misc.h>
 #include <internal_client.h>
 
 void od_storage_endpoint_status_init(od_storage_endpoint_status_t *status)
@@ -79,6 +81,139 @@ void od_storage_endpoint_status_set_dead(od_storage_endpoint_status_t *status)
 	od_storage_endpoint_status_set(status, &endp_status);
 }
 
+static pthread_mutex_t od_storage_endpoint_stats_lock =
+	PTHREAD_MUTEX_INITIALIZER;
+static od_list_t od_storage_endpoint_stats_list = {
+	&od_storage_endpoint_stats_list, &od_storage_endpoint_stats_list
+};
+
+od_storage_endpoint_stats_t *
+od_storage_endpoint_stats_get(const od_address_t *address)
+{
+	od_storage_endpoint_stats_t *stats;
+
+	pthread_mutex_lock(&od_storage_endpoint_stats_lock);
+
+	od_list_t *i;
+	od_list_foreach (&od_storage_endpoint_stats_list, i) {
+		stats = od_container_of(i, od_storage_endpoint_stats_t, link);
+		if (od_address_cmp(&stats->address, address) == 0) {
+			stats->refs++;
+			pthread_mutex_unlock(&od_storage_endpoint_stats_lock);
+			return stats;
+		}
+	}
+
+	stats = od_malloc(sizeof(od_storage_endpoint_stats_t));
+	if (stats == NULL) {
+		pthread_mutex_unlock(&od_storage_endpoint_stats_lock);
+		return NULL;
+	}
+	memset(stats, 0, sizeof(od_storage_endpoint_stats_t));
+	od_address_init(&stats->address);
+	if (od_address_copy(&stats->address, address) != OK_RESPONSE) {
+		pthread_mutex_unlock(&od_storage_endpoint_stats_lock);
+		od_free(stats);
+		return NULL;
+	}
+	stats->refs = 1;
+	od_storage_endpoint_status_init(&stats->status);
+	od_list_init(&stats->link);
+	od_list_append(&od_storage_endpoint_stats_list, &stats->link);
+
+	pthread_mutex_unlock(&od_storage_endpoint_stats_lock);
+	return stats;
+}
+
+void od_storage_endpoint_stats_unref(od_storage_endpoint_stats_t *stats)
+{
+	pthread_mutex_lock(&od_storage_endpoint_stats_lock);
+	if (--stats->refs > 0) {
+		pthread_mutex_unlock(&od_storage_endpoint_stats_lock);
+		return;
+	}
+	od_list_unlink(&stats->link);
+	pthread_mutex_unlock(&od_storage_endpoint_stats_lock);
+
+	od_storage_endpoint_status_destroy(&stats->status);
+	od_address_destroy(&stats->address);
+	od_free(stats);
+}
+
+int od_storage_endpoint_status_refresh_begin(od_storage_endpoint_t *endpoint)
+{
+	if (endpoint->stats == NULL) {
+		return 1;
+	}
+	return od_atomic_u64_cas(&endpoint->stats->status_refreshing, 0, 1) ==
+	       0;
+}
+
+void od_storage_endpoint_status_refresh_end(od_storage_endpoint_t *endpoint)
+{
+	if (endpoint->stats == NULL) {
+		return;
+	}
+	od_atomic_u64_set(&endpoint->stats->status_refreshing, 0);
+}
+
+/* alpha is 1/8, the first sample is taken as is */
+static inline void od_storage_endpoint_stats_ewma(od_atomic_u64_t *value,
+						  uint64_t sample, int first)
+{
+	sample <<= OD_STORAGE_ENDPOINT_STATS_SHIFT;
+	for (;;) {
+		uint64_t prev = od_atomic_u64_of(value);
+		uint64_t next = sample;
+		if (!first) {
+			next = prev - prev / 8 + sample / 8;
+		}
+		if (od_atomic_u64_cas(value, prev, next) == prev) {
+			return;
+		}
+	}
+}
+
+void od_storage_endpoint_stats_query(od_storage_endpoint_stats_t *stats,
+				     uint64_t time_us)
+{
+	int first = od_atomic_u64_inc(&stats->count_query) == 0;
+	od_storage_endpoint_stats_ewma(&stats->query_time, time_us, first);
+}
+
+void od_storage_endpoint_stats_connect(od_storage_endpoint_stats_t *stats,
+				       uint64_t time_us, int failed)
+{
+	od_atomic_u64_inc(&stats->count_connect);
+	if (failed) {
+		od_atomic_u64_inc(&stats->count_error);
+		od_storage_endpoint_stats_ewma(&stats->error_rate,
+					       OD_STORAGE_ENDPOINT_STATS_ERROR,
+					       0);
+		return;
+	}
+	od_storage_endpoint_stats_ewma(&stats->error_rate, 0, 0);
+
+	/* connect time of failed attempts says nothing */
+	int first = od_atomic_u64_of(&stats->connect_time) == 0;
+	od_storage_endpoint_stats_ewma(&stats->connect_time, time_us, first);
+}
+
+uint64_t od_storage_endpoint_stats_score(od_storage_endpoint_stats_t *stats)
+{
+	uint64_t time = od_atomic_u64_of(&stats->query_time) +
+			od_atomic_u64_of(&stats->connect_time);
+	time >>= OD_STORAGE_ENDPOINT_STATS_SHIFT;
+
+	uint64_t error_rate = od_atomic_u64_of(&stats->error_rate) >>
+			      OD_STORAGE_ENDPOINT_STATS_SHIFT;
+
+	/* each failed connect costs a retry on another endpoint */
+	return time + time * error_rate / OD_STORAGE_ENDPOINT_STATS_ERROR +
+	       OD_STORAGE_ENDPOINT_STATS_ERROR_PENALTY_US * error_rate /
+		       OD_STORAGE_ENDPOINT_STATS_ERROR;
+}
+
 od_storage_watchdog_t *od_storage_watchdog_allocate(od_global_t *global)
 {
 	od_storage_watchdog_t *watchdog;
@@ -89,11 +224,18 @@ od_storage_watchdog_t *od_storage_watchdog_allocate(od_global_t *global)
 	memset(watchdog, 0, sizeof(od_storage_watchdog_t));
 	watchdog->global = global;
 	watchdog->online = 1;
+	watchdog->poll_interval_ms = 1000;
 	watchdog->is_finished = machine_wait_flag_create();
 	if (watchdog->is_finished == NULL) {
 		od_free(watchdog);
 		return NULL;
 	}
+	watchdog->monitor_is_finished = machine_wait_flag_create();
+	if (watchdog->monitor_is_finished == NULL) {
+		machine_wait_flag_destroy(watchdog->is_finished);
+		od_free(watchdog);
+		return NULL;
+	}
 	pthread_mutex_init(&watchdog->mu, NULL);
 
 	return watchdog;
@@ -122,6 +264,7 @@ od_storage_watchdog_soft_exit(od_storage_watchdog_t *watchdog)
 {
 	od_storage_watchdog_set_offline(watchdog);
 	machine_wait_flag_wait(watchdog->is_finished, UINT32_MAX);
+	machine_wait_flag_wait(watchdog->monitor_is_finished, UINT32_MAX);
 	od_storage_watchdog_free(watchdog);
 }
 
@@ -136,6 +279,7 @@ int od_storage_watchdog_free(od_storage_watchdog_t *watchdog)
 	}
 
 	machine_wait_flag_destroy(watchdog->is_finished);
+	machine_wait_flag_destroy(watchdog->monitor_is_finished);
 	pthread_mutex_destroy(&watchdog->mu);
 
 	od_free(watchdog);
@@ -227,6 +371,10 @@ void od_rules_storage_free(od_rule_storage_t *storage)
 		for (size_t i = 0; i < storage->endpoints_count; ++i) {
 			od_storage_endpoint_status_destroy(
 				&storage->endpoints[i].status);
+			if (storage->endpoints[i].stats != NULL) {
+				od_storage_endpoint_stats_unref(
+					storage->endpoints[i].stats);
+			}
 			od_address_destroy(&storage->endpoints[i].address);
 		}
 
@@ -237,6 +385,16 @@ void od_rules_storage_free(od_rule_storage_t *storage)
 		od_hashmap_free(storage->acache);
 	}
 
+	if (storage->shards) {
+		od_free(storage->shards);
+	}
+	if (storage->shard_ranges_str) {
+		od_free(storage->shard_ranges_str);
+	}
+	if (storage->shard_ranges) {
+		od_free(storage->shard_ranges);
+	}
+
 	od_list_unlink(&storage->link);
 	od_free(storage);
 }
@@ -308,6 +466,8 @@ od_rule_storage_t *od_rules_storage_copy(od_rule_storage_t *storage)
 		if (copy->endpoints == NULL) {
 			goto error;
 		}
+		memset(copy->endpoints, 0,
+		       sizeof(od_storage_endpoint_t) * copy->endpoints_count);
 
 		for (size_t i = 0; i < copy->endpoints_count; ++i) {
 			od_address_init(&copy->endpoints[i].address);
@@ -319,11 +479,43 @@ od_rule_storage_t *od_rules_storage_copy(od_rule_storage_t *storage)
 			}
 			od_storage_endpoint_status_init(
 				&copy->endpoints[i].status);
+
+			od_storage_endpoint_t *endpoint = &copy->endpoints[i];
+			endpoint->shard = storage->endpoints[i].shard;
+			endpoint->stats = od_storage_endpoint_stats_get(
+				&endpoint->address);
+			if (endpoint->stats == NULL) {
+				goto error;
+			}
 		}
 	}
 
 	copy->endpoints_status_poll_interval_ms =
 		storage->endpoints_status_poll_interval_ms;
+	copy->load_balance = storage->load_balance;
+
+	if (storage->shards) {
+		copy->shards = od_strdup(storage->shards);
+		if (copy->shards == NULL) {
+			goto error;
+		}
+	}
+	copy->shards_count = storage->shards_count;
+	copy->shard_by = storage->shard_by;
+	if (storage->shard_ranges_str) {
+		copy->shard_ranges_str = od_strdup(storage->shard_ranges_str);
+		if (copy->shard_ranges_str == NULL) {
+			goto error;
+		}
+	}
+	if (storage->shard_ranges) {
+		size_t size = sizeof(int64_t) * storage->shards_count;
+		copy->shard_ranges = od_malloc(size);
+		if (copy->shard_ranges == NULL) {
+			goto error;
+		}
+		memcpy(copy->shard_ranges, storage->shard_ranges, size);
+	}
 
 	/* storage auth cache not copied */
 
@@ -390,7 +582,8 @@ static inline int od_router_update_heartbeat_cb(od_route_t *route, void **argv)
 }
 
 static inline od_client_t *
-od_storage_watchdog_prepare_client(od_storage_watchdog_t *watchdog)
+od_storage_watchdog_prepare_client(od_storage_watchdog_t *watchdog,
+				   char *name)
 {
 	od_global_t *global = watchdog->global;
 	od_router_t *router = global->router;
@@ -398,7 +591,7 @@ od_storage_watchdog_prepare_client(od_storage_watchdog_t *watchdog)
 
 	od_client_t *watchdog_client;
 	watchdog_client =
-		od_client_allocate_internal(global, "storage-watchdog");
+		od_client_allocate_internal(global, name);
 	if (watchdog_client == NULL) {
 		od_error(&instance->logger, "watchdog", NULL, NULL,
 			 "route storage watchdog failed to allocate client");
@@ -456,7 +649,8 @@ od_storage_create_and_connect_watchdog_client(od_storage_watchdog_t *watchdog)
 	od_instance_t *instance = global->instance;
 
 	od_client_t *watchdog_client;
-	watchdog_client = od_storage_watchdog_prepare_client(watchdog);
+	watchdog_client = od_storage_watchdog_prepare_client(
+		watchdog, "storage-watchdog");
 	if (watchdog_client == NULL) {
 		od_error(&instance->logger, "watchdog", NULL, NULL,
 			 "route storage watchdog failed to prepare client");
@@ -489,19 +683,57 @@ static inline void od_storage_update_route_last_heartbeats(
 	od_router_foreach(router, od_router_update_heartbeat_cb, argv);
 }
 
+/*
+ * server connection is kept between polls, it is reopened
+ * after an error, on reload and after server_lifetime
+ */
+static inline int
+od_storage_watchdog_client_is_reusable(od_client_t *watchdog_client)
+{
+	od_server_t *server = watchdog_client->server;
+	if (server == NULL || server->offline) {
+		return 0;
+	}
+
+	if (watchdog_client->rule->obsolete) {
+		return 0;
+	}
+
+	if (server->lifetime_deadline_us != 0 &&
+	    machine_time_us() >= server->lifetime_deadline_us) {
+		return 0;
+	}
+
+	return server->io.io != NULL && machine_connected(server->io.io);
+}
+
 static inline void
-od_storage_watchdog_do_polling_step(od_storage_watchdog_t *watchdog)
+od_storage_watchdog_do_polling_step(od_storage_watchdog_t *watchdog,
+				    od_client_t **client)
 {
 	od_global_t *global = watchdog->global;
 	od_router_t *router = global->router;
 	od_instance_t *instance = global->instance;
 
-	od_client_t *watchdog_client;
-	watchdog_client =
-		od_storage_create_and_connect_watchdog_client(watchdog);
+	od_client_t *watchdog_client = *client;
+	if (watchdog_client != NULL &&
+	    !od_storage_watchdog_client_is_reusable(watchdog_client)) {
+		od_debug(&instance->logger, "watchdog", watchdog_client,
+			 watchdog_client->server,
+			 "reopening backend connection");
+		od_storage_watchdog_close_client(watchdog, watchdog_client);
+		watchdog_client = NULL;
+	}
+
 	if (watchdog_client == NULL) {
-		return;
+		watchdog_client =
+			od_storage_create_and_connect_watchdog_client(watchdog);
+		if (watchdog_client == NULL) {
+			*client = NULL;
+			return;
+		}
 	}
+	*client = watchdog_client;
 
 	od_server_t *server;
 	server = watchdog_client->server;
@@ -513,6 +745,7 @@ od_storage_watchdog_do_polling_step(od_storage_watchdog_t *watchdog)
 			 "receive msg failed, closing backend connection");
 
 		od_storage_watchdog_close_client(watchdog, watchdog_client);
+		*client = NULL;
 		return;
 	}
 
@@ -528,17 +761,30 @@ od_storage_watchdog_do_polling_step(od_storage_watchdog_t *watchdog)
 	}
 
 	machine_msg_free(msg);
-
-	od_storage_watchdog_close_client(watchdog, watchdog_client);
 }
 
 static inline void
 od_storage_watchdog_do_polling_loop(od_storage_watchdog_t *watchdog)
 {
+	od_client_t *watchdog_client = NULL;
+
 	while (od_storage_watchdog_is_online(watchdog)) {
-		od_storage_watchdog_do_polling_step(watchdog);
+		od_storage_watchdog_do_polling_step(watchdog,
+						    &watchdog_client);
+
+		/* wake up at least every second to notice soft exit */
+		uint64_t deadline_ms =
+			machine_time_ms() + watchdog->poll_interval_ms;
+		uint64_t now_ms = machine_time_ms();
+		while (now_ms < deadline_ms &&
+		       od_storage_watchdog_is_online(watchdog)) {
+			machine_sleep(od_min(deadline_ms - now_ms, 1000));
+			now_ms = machine_time_ms();
+		}
+	}
 
-		machine_sleep(1000);
+	if (watchdog_client != NULL) {
+		od_storage_watchdog_close_client(watchdog, watchdog_client);
 	}
 }
 
@@ -558,6 +804,145 @@ void od_storage_watchdog_watch(void *arg)
 	machine_wait_flag_set(watchdog->is_finished);
 }
 
+/*
+ * Endpoints monitor keeps a connection to every endpoint of the storage
+ * under the watchdog route and refreshes their read-write status twice
+ * per endpoints_status_poll_interval, so target_session_attrs checks
+ * find it fresh and do not query on attach.
+ */
+static inline void
+od_storage_endpoints_monitor_step(od_storage_watchdog_t *watchdog,
+				  od_storage_endpoint_t *endpoint,
+				  od_client_t **client)
+{
+	od_global_t *global = watchdog->global;
+	od_router_t *router = global->router;
+	od_instance_t *instance = global->instance;
+
+	od_client_t *monitor_client = *client;
+	if (monitor_client != NULL &&
+	    !od_storage_watchdog_client_is_reusable(monitor_client)) {
+		od_storage_watchdog_close_client(watchdog, monitor_client);
+		monitor_client = NULL;
+	}
+	*client = NULL;
+
+	if (monitor_client == NULL) {
+		monitor_client = od_storage_watchdog_prepare_client(
+			watchdog, "storage-monitor");
+		if (monitor_client == NULL) {
+			return;
+		}
+		if (od_attach_extended_endpoint(instance, "monitor", router,
+						monitor_client,
+						endpoint) != OK_RESPONSE) {
+			od_router_unroute(router, monitor_client);
+			od_client_free_extended(monitor_client);
+			return;
+		}
+	}
+
+	if (!od_storage_endpoint_status_refresh_begin(endpoint)) {
+		/* refreshed by a client right now */
+		*client = monitor_client;
+		return;
+	}
+
+	od_retcode_t rc;
+	rc = od_backend_update_endpoint_status(instance, monitor_client,
+					       monitor_client->server,
+					       "monitor", endpoint);
+	od_storage_endpoint_status_refresh_end(endpoint);
+
+	if (rc != OK_RESPONSE) {
+		od_storage_watchdog_close_client(watchdog, monitor_client);
+		return;
+	}
+
+	*client = monitor_client;
+}
+
+void od_storage_endpoints_monitor(void *arg)
+{
+	od_storage_watchdog_t *watchdog = (od_storage_watchdog_t *)arg;
+	od_global_t *global = watchdog->global;
+	od_instance_t *instance = global->instance;
+	od_rule_storage_t *storage = watchdog->storage;
+
+	od_debug(&instance->logger, "monitor", NULL, NULL,
+		 "start endpoints monitor for storage '%s'", storage->name);
+
+	od_client_t *clients[OD_STORAGE_MAX_ENDPOINTS];
+	memset(clients, 0, sizeof(clients));
+
+	uint64_t interval_ms = storage->endpoints_status_poll_interval_ms / 2;
+	if (interval_ms == 0) {
+		interval_ms = 1;
+	}
+
+	while (od_storage_watchdog_is_online(watchdog)) {
+		for (size_t i = 0; i < storage->endpoints_count &&
+				   od_storage_watchdog_is_online(watchdog);
+		     ++i) {
+			od_storage_endpoints_monitor_step(
+				watchdog, &storage->endpoints[i], &clients[i]);
+		}
+
+		uint64_t deadline_ms = machine_time_ms() + interval_ms;
+		uint64_t now_ms = machine_time_ms();
+		while (now_ms < deadline_ms &&
+		       od_storage_watchdog_is_online(watchdog)) {
+			machine_sleep(od_min(deadline_ms - now_ms, 1000));
+			now_ms = machine_time_ms();
+		}
+	}
+
+	for (size_t i = 0; i < storage->endpoints_count; ++i) {
+		if (clients[i] != NULL) {
+			od_storage_watchdog_close_client(watchdog, clients[i]);
+		}
+	}
+
+	od_log(&instance->logger, "monitor", NULL, NULL,
+	       "finishing endpoints monitor for storage '%s'", storage->name);
+	machine_wait_flag_set(watchdog->monitor_is_finished);
+}
+
+int od_rules_storage_shard_of(od_rule_storage_t *storage, const char *key,
+			      int key_len)
+{
+	assert(storage->shards_count > 0);
+
+	if (key_len <= 0) {
+		return -1;
+	}
+
+	if (storage->shard_by == OD_STORAGE_SHARD_BY_HASH) {
+		return od_murmur_hash(key, key_len) % storage->shards_count;
+	}
+
+	char buf[32];
+	if (key_len >= (int)sizeof(buf)) {
+		return -1;
+	}
+	memcpy(buf, key, key_len);
+	buf[key_len] = 0;
+
+	char *end;
+	errno = 0;
+	long long value = strtoll(buf, &end, 10);
+	if (errno != 0 || end == buf || *end != 0) {
+		return -1;
+	}
+
+	size_t shard = 0;
+	while (shard < storage->shards_count - 1 &&
+	       value >= storage->shard_ranges[shard]) {
+		shard++;
+	}
+	return shard;
+}
+
 int od_storage_parse_endpoints(const char *host_str,
 			       od_storage_endpoint_t **out, size_t *count)
 {
@@ -585,6 +970,8 @@ int od_storage_parse_endpoints(const char *host_str,
 		od_address_t *result_addr = &result[i].address;
 		od_address_init(result_addr);
 		od_address_move(result_addr, &addrs[i]);
+		result[i].stats = NULL;
+		result[i].shard = 0;
 	}
 
 	od_free(addrs);
@@ -624,6 +624,13 @@ static inline void od_system(void *arg)
 		return;
 	}
 
+	/* start background connections coroutine */
+	rc = od_connect_factory_start(&router->connect_factory,
+				      system->global);
+	if (rc == -1) {
+		return;
+	}
+
 	/* start worker threads */
 	od_worker_pool_t *worker_pool = system->global->worker_pool;
 	rc = od_worker_pool_start(worker_pool, system->global,
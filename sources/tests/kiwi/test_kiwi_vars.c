@@ -0,0 +1,47 @@
+#include <kiwi/kiwi.h>
+#include <tests/odyssey_test.h>
+
+static void test_vars_set(kiwi_vars_t *vars, kiwi_var_type_t type,
+			  const char *value)
+{
+	test(kiwi_vars_set(vars, type, value, strlen(value) + 1) == 0);
+}
+
+void kiwi_test_vars_fingerprint(void)
+{
+	kiwi_vars_t client;
+	kiwi_vars_t server;
+	kiwi_vars_init(&client);
+	kiwi_vars_init(&server);
+
+	test(kiwi_vars_fingerprint(&client) == kiwi_vars_fingerprint(&server));
+
+	test_vars_set(&client, KIWI_VAR_SEARCH_PATH, "public");
+	test_vars_set(&client, KIWI_VAR_TIMEZONE, "UTC");
+	test(kiwi_vars_fingerprint(&client) != kiwi_vars_fingerprint(&server));
+
+	test_vars_set(&server, KIWI_VAR_TIMEZONE, "UTC");
+	test_vars_set(&server, KIWI_VAR_SEARCH_PATH, "public");
+	test(kiwi_vars_fingerprint(&client) == kiwi_vars_fingerprint(&server));
+
+	/* equal fingerprint means nothing to deploy */
+	char query[512];
+	test(kiwi_vars_cas(&client, &server, query, sizeof(query), 0) == 0);
+
+	/* odyssey own and volatile params are never deployed */
+	test_vars_set(&client, KIWI_VAR_ODYSSEY_TARGET_SESSION_ATTRS,
+		      "read-only");
+	test_vars_set(&client, KIWI_VAR_IS_HOT_STANDBY, "off");
+	test_vars_set(&client, KIWI_VAR_COMPRESSION, "on");
+	test(kiwi_vars_fingerprint(&client) == kiwi_vars_fingerprint(&server));
+
+	/* same value in another var must not collide */
+	test_vars_set(&server, KIWI_VAR_APPLICATION_NAME, "UTC");
+	kiwi_vars_unset(&server, KIWI_VAR_TIMEZONE);
+	test(kiwi_vars_fingerprint(&client) != kiwi_vars_fingerprint(&server));
+
+	kiwi_vars_unset(&server, KIWI_VAR_APPLICATION_NAME);
+	test_vars_set(&server, KIWI_VAR_TIMEZONE, "Europe/Moscow");
+	test(kiwi_vars_fingerprint(&client) != kiwi_vars_fingerprint(&server));
+	test(kiwi_vars_cas(&client, &server, query, sizeof(query), 0) > 0);
+}
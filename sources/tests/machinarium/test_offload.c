@@ -0,0 +1,60 @@
+
+#include <machinarium/machinarium.h>
+#include <tests/odyssey_test.h>
+
+#include <stdatomic.h>
+#include <unistd.h>
+
+static atomic_int resolved;
+
+static void blocking_call(void *arg)
+{
+	int *done = arg;
+	/* blocks until the resolver is done */
+	while (!atomic_load(&resolved)) {
+		usleep(1000);
+	}
+	*done = 1;
+}
+
+static void test_offloader(void *arg)
+{
+	(void)arg;
+	int done = 0;
+	test(machine_offload(blocking_call, &done) == 0);
+	test(done);
+}
+
+static void test_resolver(void *arg)
+{
+	(void)arg;
+	struct addrinfo *res = NULL;
+	int rc = machine_getaddrinfo("localhost", "http", NULL, &res,
+				     UINT32_MAX);
+	if (rc == 0 && res != NULL) {
+		freeaddrinfo(res);
+	}
+	atomic_store(&resolved, 1);
+}
+
+void machinarium_test_offload(void)
+{
+	/* offloaded call does not occupy the only resolver */
+	machinarium_set_pool_size(1);
+	machinarium_set_offload_pool_size(1);
+	machinarium_init();
+	atomic_init(&resolved, 0);
+
+	int offloader;
+	offloader = machine_create("offloader", test_offloader, NULL);
+	test(offloader != -1);
+
+	int resolver;
+	resolver = machine_create("resolver", test_resolver, NULL);
+	test(resolver != -1);
+
+	test(machine_wait(resolver) != -1);
+	test(machine_wait(offloader) != -1);
+
+	machinarium_free();
+}
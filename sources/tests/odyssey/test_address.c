@@ -232,3 +232,28 @@ void odyssey_test_address_cmp(void)
 		    address_unix("/var/lib/.s.54322", "", 0),
 		    strcmp("/var/lib/.s.54324", "/var/lib/.s.54322"));
 }
+
+void odyssey_test_address_hostname(void)
+{
+	od_address_range_t range = { .string_value = "db.example.com",
+				     .string_value_len = 14,
+				     .is_hostname = 1 };
+
+	struct sockaddr_storage sa;
+	test(od_address_read(&sa, "192.0.2.1") == 0);
+
+	/* name is not resolved, matching must not resolve it */
+	test(!od_address_validate(&range, &sa, NULL));
+	test(!od_address_validate(&range, &sa, ""));
+
+	/* only the name resolved for the client is used */
+	test(od_address_validate(&range, &sa, "db.example.com"));
+	test(od_address_validate(&range, &sa, "DB.example.com"));
+	test(!od_address_validate(&range, &sa, "other.example.com"));
+
+	od_address_range_t suffix = { .string_value = ".example.com",
+				      .string_value_len = 12,
+				      .is_hostname = 1 };
+	test(od_address_validate(&suffix, &sa, "db.example.com"));
+	test(!od_address_validate(&suffix, &sa, "db.example.org"));
+}
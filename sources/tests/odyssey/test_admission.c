@@ -0,0 +1,231 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <admission.h>
+#include <tests/odyssey_test.h>
+
+static od_admission_queue_t *
+admission_next(od_admission_t *admission, od_admission_ticket_t *tickets,
+	       int count)
+{
+	for (int i = 0; i < count; i++) {
+		if (tickets[i].queue != NULL &&
+		    od_admission_turn(admission, &tickets[i])) {
+			test(od_admission_wait(admission, &tickets[i], 0) == 0);
+			od_admission_queue_t *queue = tickets[i].queue;
+			od_admission_dequeue(admission, &tickets[i]);
+			return queue;
+		}
+	}
+	return NULL;
+}
+
+static void test_admission_drr(void)
+{
+	od_admission_t admission;
+	od_admission_init(&admission);
+
+	od_admission_queue_t heavy, light;
+	od_admission_queue_init(&heavy);
+	od_admission_queue_init(&light);
+
+	od_admission_ticket_t tickets[8];
+	for (int i = 0; i < 6; i++) {
+		test(od_admission_enqueue(&admission, &heavy, &tickets[i], 3,
+					  0) == OK_RESPONSE);
+	}
+	for (int i = 6; i < 8; i++) {
+		test(od_admission_enqueue(&admission, &light, &tickets[i], 1,
+					  0) == OK_RESPONSE);
+	}
+	test(od_admission_has_waiting(&admission));
+	test(atomic_load(&heavy.waiting) == 6);
+
+	/* not chosen yet */
+	test(od_admission_wait(&admission, &tickets[7], 1) == -1);
+
+	od_admission_queue_t *expected[] = {
+		&heavy, &heavy, &heavy, &light, &heavy, &heavy, &heavy, &light,
+	};
+	for (int i = 0; i < 8; i++) {
+		test(admission_next(&admission, tickets, 8) == expected[i]);
+	}
+	test(!od_admission_has_waiting(&admission));
+	test(admission.current == NULL);
+
+	od_admission_free(&admission);
+}
+
+static void test_admission_priority(void)
+{
+	od_admission_t admission;
+	od_admission_init(&admission);
+
+	od_admission_queue_t normal, important;
+	od_admission_queue_init(&normal);
+	od_admission_queue_init(&important);
+
+	od_admission_ticket_t tickets[4];
+	for (int i = 0; i < 3; i++) {
+		test(od_admission_enqueue(&admission, &normal, &tickets[i], 1,
+					  0) == OK_RESPONSE);
+	}
+	/* the chosen one keeps its turn */
+	test(od_admission_enqueue(&admission, &important, &tickets[3], 1,
+				  10) == OK_RESPONSE);
+	test(od_admission_turn(&admission, &tickets[0]));
+
+	test(admission_next(&admission, tickets, 4) == &normal);
+	test(admission_next(&admission, tickets, 4) == &important);
+	test(admission_next(&admission, tickets, 4) == &normal);
+	test(admission_next(&admission, tickets, 4) == &normal);
+	test(!od_admission_has_waiting(&admission));
+
+	od_admission_free(&admission);
+}
+
+static void test_admission_yield(void)
+{
+	od_admission_t admission;
+	od_admission_init(&admission);
+
+	od_admission_queue_t full, free;
+	od_admission_queue_init(&full);
+	od_admission_queue_init(&free);
+
+	od_admission_ticket_t tickets[4];
+	for (int i = 0; i < 2; i++) {
+		test(od_admission_enqueue(&admission, &full, &tickets[i], 1,
+					  10) == OK_RESPONSE);
+	}
+	for (int i = 2; i < 4; i++) {
+		test(od_admission_enqueue(&admission, &free, &tickets[i], 1,
+					  0) == OK_RESPONSE);
+	}
+	test(od_admission_turn(&admission, &tickets[0]));
+
+	/* route of the chosen one has no room, others are served */
+	od_admission_yield(&admission, &tickets[0]);
+	test(od_admission_blocked(&admission, &tickets[0]));
+	test(!od_admission_blocked(&admission, &tickets[1]));
+	test(admission_next(&admission, tickets, 4) == &free);
+
+	/* server of the route is released */
+	od_admission_unblock(&admission, &tickets[0]);
+	test(!od_admission_blocked(&admission, &tickets[0]));
+	test(od_admission_turn(&admission, &tickets[3]));
+	test(admission_next(&admission, tickets, 4) == &free);
+	test(admission_next(&admission, tickets, 4) == &full);
+
+	/* gone blocked ticket does not block its queue */
+	test(od_admission_turn(&admission, &tickets[1]));
+	od_admission_yield(&admission, &tickets[1]);
+	test(admission.current == NULL);
+	od_admission_dequeue(&admission, &tickets[1]);
+	test(!od_admission_has_waiting(&admission));
+	test(!full.blocked);
+
+	od_admission_free(&admission);
+}
+
+static void test_admission_wait_again(void)
+{
+	od_admission_t admission;
+	od_admission_init(&admission);
+
+	od_admission_queue_t full, other;
+	od_admission_queue_init(&full);
+	od_admission_queue_init(&other);
+
+	od_admission_ticket_t tickets[2];
+	test(od_admission_enqueue(&admission, &full, &tickets[0], 1, 0) ==
+	     OK_RESPONSE);
+	test(od_admission_enqueue(&admission, &other, &tickets[1], 1, 0) ==
+	     OK_RESPONSE);
+	test(od_admission_wait(&admission, &tickets[0], 0) == 0);
+
+	/* chosen once, the ticket sleeps again while another one is chosen */
+	od_admission_yield(&admission, &tickets[0]);
+	od_admission_unblock(&admission, &tickets[0]);
+	test(od_admission_turn(&admission, &tickets[1]));
+	test(od_admission_wait(&admission, &tickets[0], 10) == -1);
+
+	od_admission_dequeue(&admission, &tickets[1]);
+	test(od_admission_wait(&admission, &tickets[0], 10) == 0);
+	od_admission_dequeue(&admission, &tickets[0]);
+
+	od_admission_free(&admission);
+}
+
+static void test_admission_head_timeout(void)
+{
+	od_admission_t admission;
+	od_admission_init(&admission);
+
+	od_admission_queue_t stuck, other;
+	od_admission_queue_init(&stuck);
+	od_admission_queue_init(&other);
+
+	od_admission_ticket_t tickets[2];
+	test(od_admission_enqueue(&admission, &stuck, &tickets[0], 1, 0) ==
+	     OK_RESPONSE);
+	test(od_admission_enqueue(&admission, &other, &tickets[1], 1, 0) ==
+	     OK_RESPONSE);
+	test(od_admission_turn(&admission, &tickets[0]));
+	test(!od_admission_turn(&admission, &tickets[1]));
+
+	/* chosen one does not try to attach */
+	test(admission.chosen_ms >= OD_ADMISSION_HEAD_TIMEOUT_MS);
+	admission.chosen_ms -= OD_ADMISSION_HEAD_TIMEOUT_MS;
+	test(od_admission_turn(&admission, &tickets[1]));
+	test(od_admission_blocked(&admission, &tickets[0]));
+
+	od_admission_dequeue(&admission, &tickets[1]);
+	od_admission_dequeue(&admission, &tickets[0]);
+	test(!od_admission_has_waiting(&admission));
+
+	od_admission_free(&admission);
+}
+
+static void test_admission_wait_time(void)
+{
+	od_admission_queue_t queue;
+	od_admission_queue_init(&queue);
+
+	od_admission_queue_wait_time(&queue, 0);
+	od_admission_queue_wait_time(&queue, 5);
+	od_admission_queue_wait_time(&queue, 6);
+	od_admission_queue_wait_time(&queue, 100000);
+
+	test(atomic_load(&queue.wait_hgram[0]) == 1);
+	test(atomic_load(&queue.wait_hgram[1]) == 1);
+	test(atomic_load(&queue.wait_hgram[2]) == 1);
+	test(atomic_load(&queue.wait_hgram[OD_ADMISSION_HGRAM_BUCKETS - 1]) ==
+	     1);
+}
+
+static void tester(void *arg)
+{
+	(void)arg;
+
+	test_admission_drr();
+	test_admission_priority();
+	test_admission_yield();
+	test_admission_wait_again();
+	test_admission_head_timeout();
+	test_admission_wait_time();
+}
+
+void odyssey_test_admission(void)
+{
+	machinarium_init();
+
+	int64_t rc;
+	rc = machine_create("tester", tester, NULL);
+	test(rc > 0);
+
+	test(machine_wait(rc) == 0);
+
+	machinarium_free();
+}
@@ -0,0 +1,97 @@
+#include <odyssey.h>
+
+#include <arpa/inet.h>
+
+#include <kiwi/kiwi.h>
+
+#include <attach_hint.h>
+#include <tests/odyssey_test.h>
+
+static size_t write_msg(char *buf, char type, const char *name,
+			const char *query)
+{
+	size_t pos = sizeof(kiwi_header_t);
+	if (name != NULL) {
+		memcpy(buf + pos, name, strlen(name) + 1);
+		pos += strlen(name) + 1;
+	}
+	memcpy(buf + pos, query, strlen(query) + 1);
+	pos += strlen(query) + 1;
+
+	buf[0] = type;
+	uint32_t len = htonl(pos - 1);
+	memcpy(buf + 1, &len, sizeof(len));
+	return pos;
+}
+
+static int parse_query(od_attach_hint_t *hint, const char *query)
+{
+	char buf[256];
+	size_t size = write_msg(buf, KIWI_FE_QUERY, NULL, query);
+	od_attach_hint_init(hint);
+	return od_attach_hint_parse(hint, buf, size);
+}
+
+static void test_attach_hint_query(void)
+{
+	od_attach_hint_t hint;
+
+	test(parse_query(&hint, "/* odyssey: tsa=read-only */ select 1") == 1);
+	test(hint.tsa == OD_TARGET_SESSION_ATTRS_RO);
+	test(hint.az[0] == 0);
+
+	test(parse_query(&hint,
+			 "  /*odyssey: az=zone-a, tsa=read-write*/begin") == 1);
+	test(hint.tsa == OD_TARGET_SESSION_ATTRS_RW);
+	test(strcmp(hint.az, "zone-a") == 0);
+
+	test(parse_query(&hint, "/* odyssey: shard=user-42 */ select 1") == 1);
+	test(hint.tsa == OD_TARGET_SESSION_ATTRS_UNDEF);
+	test(hint.shard_key_len == 7);
+	test(memcmp(hint.shard_key, "user-42", 7) == 0);
+
+	/* unknown keys are ignored */
+	test(parse_query(&hint, "/* odyssey: app=x tsa=any */ select 1") == 1);
+	test(hint.tsa == OD_TARGET_SESSION_ATTRS_ANY);
+}
+
+static void test_attach_hint_none(void)
+{
+	od_attach_hint_t hint;
+
+	test(parse_query(&hint, "select 1 /* odyssey: tsa=read-only */") == 0);
+	test(parse_query(&hint, "/* just comment */ select 1") == 0);
+	test(parse_query(&hint, "/* odyssey: tsa=read-only") == 0);
+	test(parse_query(&hint, "/* odyssey: tsa=primary */ select 1") == 0);
+	test(parse_query(&hint, "/* odyssey: az=availability-zone-x */") == 0);
+	test(parse_query(&hint, "/* odyssey: */ select 1") == 0);
+	test(hint.tsa == OD_TARGET_SESSION_ATTRS_UNDEF);
+	test(hint.az[0] == 0);
+}
+
+static void test_attach_hint_parse_msg(void)
+{
+	od_attach_hint_t hint;
+	char buf[256];
+	size_t size;
+
+	size = write_msg(buf, KIWI_FE_PARSE, "stmt",
+			 "/* odyssey: tsa=read-only */ select $1");
+	od_attach_hint_init(&hint);
+	test(od_attach_hint_parse(&hint, buf, size) == 1);
+	test(hint.tsa == OD_TARGET_SESSION_ATTRS_RO);
+
+	/* the comment is not complete in the buffer */
+	od_attach_hint_init(&hint);
+	test(od_attach_hint_parse(&hint, buf, 20) == 0);
+
+	size = write_msg(buf, KIWI_FE_SYNC, NULL, "/* odyssey: tsa=any */");
+	test(od_attach_hint_parse(&hint, buf, size) == 0);
+}
+
+void odyssey_test_attach_hint(void)
+{
+	test_attach_hint_query();
+	test_attach_hint_none();
+	test_attach_hint_parse_msg();
+}
@@ -0,0 +1,220 @@
+#include <odyssey.h>
+
+#include <arpa/inet.h>
+
+#include <machinarium/machinarium.h>
+
+#include <dns_cache.h>
+#include <tests/odyssey_test.h>
+
+static socklen_t test_dns_cache_addr(struct sockaddr_in *sin, const char *ip)
+{
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(5432);
+	test(inet_pton(AF_INET, ip, &sin->sin_addr) == 1);
+	return sizeof(*sin);
+}
+
+static void test_dns_cache_ttl(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = test_dns_cache_addr(&sin, "10.0.0.1");
+
+	struct sockaddr_storage out;
+	socklen_t outlen;
+
+	test(od_dns_cache_lookup("db", 5432, 1000, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_MISS);
+	/* the first miss resolves the host, others wait for it */
+	test(od_dns_cache_lookup("db", 5432, 1000, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_PENDING);
+
+	test(od_dns_cache_store("db", 5432, 1000, (struct sockaddr *)&sin,
+				len) == OK_RESPONSE);
+	test(od_dns_cache_lookup("db", 5432, 1050, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_HIT);
+	test(outlen == len);
+	test(memcmp(&out, &sin, len) == 0);
+
+	/* other port is other entry */
+	test(od_dns_cache_lookup("db", 6432, 1050, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_MISS);
+
+	/* expired, only one refresh at a time */
+	test(od_dns_cache_lookup("db", 5432, 1100, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_REFRESH);
+	test(od_dns_cache_lookup("db", 5432, 1150, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_STALE);
+	test(memcmp(&out, &sin, len) == 0);
+
+	od_dns_cache_refresh_failed("db", 5432);
+	test(od_dns_cache_lookup("db", 5432, 1150, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_REFRESH);
+
+	/* too old to be used */
+	test(od_dns_cache_lookup("db", 5432, 1200, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_MISS);
+	test(od_dns_cache_lookup("db", 5432, 1200, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_PENDING);
+
+	/* refreshed address replaces the old one */
+	len = test_dns_cache_addr(&sin, "10.0.0.2");
+	test(od_dns_cache_store("db", 5432, 1200, (struct sockaddr *)&sin,
+				len) == OK_RESPONSE);
+	test(od_dns_cache_lookup("db", 5432, 1200, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_HIT);
+	test(memcmp(&out, &sin, len) == 0);
+
+	od_dns_cache_invalidate("db", 5432);
+	test(od_dns_cache_lookup("db", 5432, 1200, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_MISS);
+
+	/* failed resolve lets the next one try */
+	od_dns_cache_resolve_failed("db", 5432);
+	test(od_dns_cache_lookup("db", 5432, 1200, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_MISS);
+}
+
+static void test_dns_cache_negative(void)
+{
+	struct sockaddr_storage out;
+	socklen_t outlen;
+
+	test(od_dns_cache_store("nowhere", 5432, 1000, NULL, 0) ==
+	     OK_RESPONSE);
+	test(od_dns_cache_lookup("nowhere", 5432, 1005, 100, 10, &out,
+				 &outlen) == OD_DNS_CACHE_NEGATIVE);
+	/* disabled negative caching */
+	test(od_dns_cache_lookup("nowhere", 5432, 1005, 100, 0, &out,
+				 &outlen) == OD_DNS_CACHE_MISS);
+
+	test(od_dns_cache_store("nowhere", 5432, 1000, NULL, 0) ==
+	     OK_RESPONSE);
+	test(od_dns_cache_lookup("nowhere", 5432, 1010, 100, 10, &out,
+				 &outlen) == OD_DNS_CACHE_MISS);
+}
+
+static void test_dns_cache_flush(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = test_dns_cache_addr(&sin, "10.0.0.1");
+
+	od_dns_cache_flush();
+	test(od_dns_cache_store("a", 5432, 1000, (struct sockaddr *)&sin,
+				len) == OK_RESPONSE);
+	test(od_dns_cache_store("b", 5432, 1000, NULL, 0) == OK_RESPONSE);
+	test(od_dns_cache_flush() == 2);
+
+	struct sockaddr_storage out;
+	socklen_t outlen;
+	test(od_dns_cache_lookup("a", 5432, 1000, 100, 10, &out, &outlen) ==
+	     OD_DNS_CACHE_MISS);
+	/* pending entry of the miss */
+	test(od_dns_cache_flush() == 1);
+	test(od_dns_cache_flush() == 0);
+}
+
+typedef struct {
+	int rc;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+} test_dns_cache_waiter_t;
+
+static int test_dns_cache_done;
+
+static void test_dns_cache_waiter(void *arg)
+{
+	test_dns_cache_waiter_t *waiter = arg;
+	waiter->rc = od_dns_cache_resolve("localhost", 5432, 100000, 1000,
+					  &waiter->addr, &waiter->addrlen);
+	test_dns_cache_done++;
+}
+
+static void test_dns_cache_start_waiters(test_dns_cache_waiter_t *waiters,
+					 int count)
+{
+	test_dns_cache_done = 0;
+	for (int i = 0; i < count; i++) {
+		int64_t id;
+		id = machine_coroutine_create(test_dns_cache_waiter,
+					      &waiters[i]);
+		test(id != INVALID_COROUTINE_ID);
+	}
+
+	/* nobody calls the resolver while the host is pending */
+	machine_sleep(50);
+	test(test_dns_cache_done == 0);
+}
+
+static void test_dns_cache_wait_waiters(int count)
+{
+	while (test_dns_cache_done < count) {
+		machine_sleep(1);
+	}
+}
+
+static void test_dns_cache_concurrent_miss(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = test_dns_cache_addr(&sin, "10.0.0.9");
+
+	struct sockaddr_storage out;
+	socklen_t outlen;
+
+	od_dns_cache_flush();
+
+	/* this one resolves the host, the others wait for its address */
+	test(od_dns_cache_lookup("localhost", 5432, machine_time_ms(), 100000,
+				 1000, &out, &outlen) == OD_DNS_CACHE_MISS);
+
+	test_dns_cache_waiter_t waiters[4];
+	test_dns_cache_start_waiters(waiters, 4);
+
+	test(od_dns_cache_store("localhost", 5432, machine_time_ms(),
+				(struct sockaddr *)&sin, len) == OK_RESPONSE);
+	test_dns_cache_wait_waiters(4);
+	for (int i = 0; i < 4; i++) {
+		test(waiters[i].rc == OK_RESPONSE);
+		test(waiters[i].addrlen == len);
+		test(memcmp(&waiters[i].addr, &sin, len) == 0);
+	}
+
+	/* the waiters of a failed resolve retry on their own */
+	od_dns_cache_flush();
+	test(od_dns_cache_lookup("localhost", 5432, machine_time_ms(), 100000,
+				 1000, &out, &outlen) == OD_DNS_CACHE_MISS);
+	test_dns_cache_start_waiters(waiters, 4);
+
+	od_dns_cache_resolve_failed("localhost", 5432);
+	test_dns_cache_wait_waiters(4);
+	for (int i = 0; i < 4; i++) {
+		test(waiters[i].rc == OK_RESPONSE);
+	}
+
+	od_dns_cache_flush();
+}
+
+static void tester(void *arg)
+{
+	(void)arg;
+
+	test_dns_cache_concurrent_miss();
+}
+
+void odyssey_test_dns_cache(void)
+{
+	test_dns_cache_ttl();
+	test_dns_cache_negative();
+	test_dns_cache_flush();
+
+	machinarium_init();
+
+	int64_t rc;
+	rc = machine_create("tester", tester, NULL);
+	test(rc > 0);
+
+	test(machine_wait(rc) == 0);
+
+	machinarium_free();
+}
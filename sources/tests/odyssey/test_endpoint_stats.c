@@ -0,0 +1,140 @@
+#include <odyssey.h>
+
+#include <storage.h>
+#include <tests/odyssey_test.h>
+
+static void test_endpoint_stats_shared(void)
+{
+	od_storage_endpoint_t *endpoints;
+	size_t count;
+	test(od_storage_parse_endpoints("host1:5432,host2:5432,host1:5432",
+					&endpoints, &count) == OK_RESPONSE);
+	test(count == 3);
+
+	od_storage_endpoint_stats_t *stats[3];
+	for (size_t i = 0; i < count; i++) {
+		stats[i] = od_storage_endpoint_stats_get(&endpoints[i].address);
+		test(stats[i] != NULL);
+	}
+	/* same address, same stats */
+	test(stats[0] == stats[2]);
+	test(stats[0] != stats[1]);
+
+	od_storage_endpoint_stats_query(stats[2], 100);
+	test(od_atomic_u64_of(&stats[0]->count_query) == 1);
+
+	for (size_t i = 0; i < count; i++) {
+		od_storage_endpoint_stats_unref(stats[i]);
+		od_address_destroy(&endpoints[i].address);
+	}
+	od_free(endpoints);
+}
+
+static void test_endpoint_stats_score(void)
+{
+	od_storage_endpoint_t *endpoints;
+	size_t count;
+	test(od_storage_parse_endpoints("fast:5432,slow:5432,failing:5432",
+					&endpoints, &count) == OK_RESPONSE);
+
+	od_storage_endpoint_stats_t *fast, *slow, *failing;
+	fast = od_storage_endpoint_stats_get(&endpoints[0].address);
+	slow = od_storage_endpoint_stats_get(&endpoints[1].address);
+	failing = od_storage_endpoint_stats_get(&endpoints[2].address);
+	test(fast != NULL && slow != NULL && failing != NULL);
+
+	/* the first sample is taken as is */
+	od_storage_endpoint_stats_query(fast, 1000);
+	test(od_storage_endpoint_stats_score(fast) == 1000);
+
+	/* converges to the recent latency */
+	for (int i = 0; i < 100; i++) {
+		od_storage_endpoint_stats_query(fast, 200);
+		od_storage_endpoint_stats_query(slow, 5000);
+	}
+	uint64_t fast_score = od_storage_endpoint_stats_score(fast);
+	uint64_t slow_score = od_storage_endpoint_stats_score(slow);
+	test(fast_score >= 200 && fast_score < 210);
+	test(slow_score > 4900 && slow_score <= 5000);
+
+	/* failed connects are penalized even without latency samples */
+	for (int i = 0; i < 10; i++) {
+		od_storage_endpoint_stats_connect(failing, 0, 1);
+	}
+	test(od_atomic_u64_of(&failing->count_error) == 10);
+	test(od_storage_endpoint_stats_score(failing) > slow_score);
+
+	/* and recover after successful ones */
+	for (int i = 0; i < 100; i++) {
+		od_storage_endpoint_stats_connect(failing, 100, 0);
+	}
+	test(od_storage_endpoint_stats_score(failing) < slow_score);
+
+	od_storage_endpoint_stats_unref(fast);
+	od_storage_endpoint_stats_unref(slow);
+	od_storage_endpoint_stats_unref(failing);
+	for (size_t i = 0; i < count; i++) {
+		od_address_destroy(&endpoints[i].address);
+	}
+	od_free(endpoints);
+}
+
+static void test_endpoint_stats_status(void)
+{
+	od_storage_endpoint_t *endpoints;
+	size_t count;
+	test(od_storage_parse_endpoints("host1:5432,host1:5432", &endpoints,
+					&count) == OK_RESPONSE);
+	test(count == 2);
+
+	/* without stats the endpoint status is its own */
+	od_storage_endpoint_status_init(&endpoints[0].status);
+	test(od_storage_endpoint_status_of(&endpoints[0]) ==
+	     &endpoints[0].status);
+	test(od_storage_endpoint_status_refresh_begin(&endpoints[0]));
+	test(od_storage_endpoint_status_refresh_begin(&endpoints[0]));
+	od_storage_endpoint_status_destroy(&endpoints[0].status);
+
+	for (size_t i = 0; i < count; i++) {
+		endpoints[i].stats =
+			od_storage_endpoint_stats_get(&endpoints[i].address);
+		test(endpoints[i].stats != NULL);
+	}
+
+	/* role found via one storage is seen by the other */
+	od_storage_endpoint_status_t status;
+	od_storage_endpoint_status_init(&status);
+	status.is_read_write = false;
+	status.last_update_time_ms = 42;
+	od_storage_endpoint_status_set(
+		od_storage_endpoint_status_of(&endpoints[0]), &status);
+
+	od_storage_endpoint_status_t out;
+	od_storage_endpoint_status_init(&out);
+	od_storage_endpoint_status_get(
+		od_storage_endpoint_status_of(&endpoints[1]), &out);
+	test(out.last_update_time_ms == 42);
+	test(!out.is_read_write);
+
+	/* single flight */
+	test(od_storage_endpoint_status_refresh_begin(&endpoints[0]));
+	test(!od_storage_endpoint_status_refresh_begin(&endpoints[1]));
+	od_storage_endpoint_status_refresh_end(&endpoints[0]);
+	test(od_storage_endpoint_status_refresh_begin(&endpoints[1]));
+	od_storage_endpoint_status_refresh_end(&endpoints[1]);
+
+	od_storage_endpoint_status_destroy(&status);
+	od_storage_endpoint_status_destroy(&out);
+	for (size_t i = 0; i < count; i++) {
+		od_storage_endpoint_stats_unref(endpoints[i].stats);
+		od_address_destroy(&endpoints[i].address);
+	}
+	od_free(endpoints);
+}
+
+void odyssey_test_endpoint_stats(void)
+{
+	test_endpoint_stats_shared();
+	test_endpoint_stats_score();
+	test_endpoint_stats_status();
+}
@@ -0,0 +1,82 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <hot_stmts.h>
+#include <tests/odyssey_test.h>
+
+static od_prep_stmt_body_t *intern(od_prep_stmt_registry_t *registry, int id)
+{
+	char data[32];
+	int len = snprintf(data, sizeof(data), "select %d", id);
+	return od_prep_stmt_registry_intern(registry, od_murmur_hash(data, len),
+					    data, len);
+}
+
+static void test_hot_stmts_top(void)
+{
+	od_prep_stmt_registry_t *registry = od_prep_stmt_registry_create();
+	test(registry != NULL);
+
+	od_hot_stmts_t hot;
+	od_hot_stmts_init(&hot);
+
+	/* statement i is used i times, more than slots are seen */
+	int count = OD_HOT_STMTS_SLOTS * 2;
+	for (int i = 1; i <= count; i++) {
+		od_prep_stmt_body_t *body = intern(registry, i);
+		test(body != NULL);
+		for (int j = 0; j < i; j++) {
+			od_hot_stmts_record(&hot, body, 1);
+		}
+		od_prep_stmt_body_unref(body);
+	}
+	test(hot.count == OD_HOT_STMTS_SLOTS);
+
+	od_prep_stmt_body_t *top[4];
+	test(od_hot_stmts_top(&hot, top, 4) == 4);
+	for (int i = 0; i < 4; i++) {
+		od_prep_stmt_body_t *body = intern(registry, count - i);
+		test(top[i] == body);
+		od_prep_stmt_body_unref(body);
+		od_prep_stmt_body_unref(top[i]);
+	}
+
+	/* weighted record */
+	od_prep_stmt_body_t *body = intern(registry, 1);
+	od_hot_stmts_record(&hot, body, 100000);
+	test(od_hot_stmts_top(&hot, top, 1) == 1);
+	test(top[0] == body);
+	od_prep_stmt_body_unref(top[0]);
+	od_prep_stmt_body_unref(body);
+
+	/* unused statements decay away */
+	for (int i = 0; i < OD_HOT_STMTS_DECAY_TICKS * 20; i++) {
+		od_hot_stmts_tick(&hot);
+	}
+	test(hot.count == 0);
+	test(registry->count == 0);
+
+	od_hot_stmts_free(&hot);
+	od_prep_stmt_registry_free(registry);
+}
+
+static void tester(void *arg)
+{
+	(void)arg;
+
+	test_hot_stmts_top();
+}
+
+void odyssey_test_hot_stmts(void)
+{
+	machinarium_init();
+
+	int64_t rc;
+	rc = machine_create("tester", tester, NULL);
+	test(rc > 0);
+
+	test(machine_wait(rc) == 0);
+
+	machinarium_free();
+}
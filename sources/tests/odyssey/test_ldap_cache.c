@@ -0,0 +1,92 @@
+#include <odyssey.h>
+
+#include <od_memory.h>
+#include <ldap_cache.h>
+#include <tests/odyssey_test.h>
+
+static int rule_a;
+static int rule_b;
+
+static void test_ldap_cache_check(void)
+{
+	od_ldap_cache_t cache;
+	od_ldap_cache_init(&cache);
+
+	/* disabled by default */
+	test(od_ldap_cache_store(&cache, &rule_a, "u", "db", "secret", 1000,
+				 "uid=u", NULL) == OK_RESPONSE);
+	test(!od_ldap_cache_check(&cache, &rule_a, "u", "db", "secret", 1000));
+	test(cache.count == 0);
+
+	cache.ttl_ms = 100;
+	test(od_ldap_cache_store(&cache, &rule_a, "u", "db", "secret", 1000,
+				 "uid=u", "group_ro") == OK_RESPONSE);
+	test(od_ldap_cache_check(&cache, &rule_a, "u", "db", "secret", 1050));
+	test(!od_ldap_cache_check(&cache, &rule_a, "u", "db", "other", 1050));
+	test(!od_ldap_cache_check(&cache, &rule_b, "u", "db", "secret", 1050));
+	test(!od_ldap_cache_check(&cache, &rule_a, "u", "db2", "secret",
+				  1050));
+	test(atomic_load(&cache.hits) == 1);
+	test(atomic_load(&cache.misses) == 3);
+
+	char *auth_dn;
+	char *lsc_name;
+	test(od_ldap_cache_find(&cache, &rule_a, "u", "db", 1050, &auth_dn,
+				&lsc_name));
+	test(strcmp(auth_dn, "uid=u") == 0);
+	test(strcmp(lsc_name, "group_ro") == 0);
+	od_free(auth_dn);
+	od_free(lsc_name);
+
+	/* expired entry is dropped */
+	test(!od_ldap_cache_check(&cache, &rule_a, "u", "db", "secret", 1100));
+	test(!od_ldap_cache_find(&cache, &rule_a, "u", "db", 1100, &auth_dn,
+				 &lsc_name));
+	test(auth_dn == NULL && lsc_name == NULL);
+	test(cache.count == 0);
+
+	/* new password replaces the old one */
+	test(od_ldap_cache_store(&cache, &rule_a, "u", "db", "secret", 1000,
+				 "uid=u", NULL) == OK_RESPONSE);
+	test(od_ldap_cache_store(&cache, &rule_a, "u", "db", "changed", 1010,
+				 "uid=u", NULL) == OK_RESPONSE);
+	test(cache.count == 1);
+	test(!od_ldap_cache_check(&cache, &rule_a, "u", "db", "secret", 1020));
+	test(od_ldap_cache_check(&cache, &rule_a, "u", "db", "changed", 1020));
+
+	od_ldap_cache_free(&cache);
+}
+
+static void test_ldap_cache_evict(void)
+{
+	od_ldap_cache_t cache;
+	od_ldap_cache_init(&cache);
+	cache.ttl_ms = 1000;
+	cache.size = 2;
+
+	test(od_ldap_cache_store(&cache, &rule_a, "a", "db", "pa", 0, "uid=a",
+				 NULL) == OK_RESPONSE);
+	test(od_ldap_cache_store(&cache, &rule_a, "b", "db", "pb", 0, "uid=b",
+				 NULL) == OK_RESPONSE);
+
+	/* a is used recently, so b is evicted */
+	test(od_ldap_cache_check(&cache, &rule_a, "a", "db", "pa", 10));
+	test(od_ldap_cache_store(&cache, &rule_a, "c", "db", "pc", 20, "uid=c",
+				 NULL) == OK_RESPONSE);
+	test(cache.count == 2);
+	test(od_ldap_cache_check(&cache, &rule_a, "a", "db", "pa", 30));
+	test(!od_ldap_cache_check(&cache, &rule_a, "b", "db", "pb", 30));
+	test(od_ldap_cache_check(&cache, &rule_a, "c", "db", "pc", 30));
+
+	test(od_ldap_cache_flush(&cache) == 2);
+	test(cache.count == 0);
+	test(!od_ldap_cache_check(&cache, &rule_a, "a", "db", "pa", 40));
+
+	od_ldap_cache_free(&cache);
+}
+
+void odyssey_test_ldap_cache(void)
+{
+	test_ldap_cache_check();
+	test_ldap_cache_evict();
+}
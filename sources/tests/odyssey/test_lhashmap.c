@@ -0,0 +1,124 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <lhashmap.h>
+#include <tests/odyssey_test.h>
+
+static int dtor_calls = 0;
+
+static void test_lhashmap_dtor(od_lhashmap_entry_t *entry)
+{
+	(void)entry;
+	dtor_calls++;
+}
+
+static void test_lhashmap_key(int id, char *buf, size_t size,
+			      od_hashmap_elt_t *key, od_hash_t *keyhash)
+{
+	key->len = snprintf(buf, size, "stmt_%d", id);
+	key->data = buf;
+	*keyhash = od_murmur_hash(key->data, key->len);
+}
+
+static void test_lhashmap_insert_find(int n)
+{
+	dtor_calls = 0;
+	od_lhashmap_t *map = od_lhashmap_create(0, test_lhashmap_dtor);
+	test(map != NULL);
+
+	char buf[32];
+	od_hashmap_elt_t key;
+	od_hash_t keyhash;
+
+	for (int i = 0; i < n; i++) {
+		test_lhashmap_key(i, buf, sizeof(buf), &key, &keyhash);
+		od_hashmap_elt_t value = { &i, sizeof(i) };
+		od_hashmap_elt_t *value_ptr = &value;
+		test(od_lhashmap_insert(map, keyhash, &key, &value_ptr) == 0);
+		test(*(int *)value_ptr->data == i);
+	}
+	test(map->count == (size_t)n);
+	test(map->capacity * 3 >= map->count * 4);
+
+	for (int i = 0; i < n; i++) {
+		test_lhashmap_key(i, buf, sizeof(buf), &key, &keyhash);
+		od_hashmap_elt_t *value = od_lhashmap_find(map, keyhash, &key);
+		test(value != NULL);
+		test(*(int *)value->data == i);
+	}
+	test_lhashmap_key(n, buf, sizeof(buf), &key, &keyhash);
+	test(od_lhashmap_find(map, keyhash, &key) == NULL);
+
+	/* remove every odd key */
+	for (int i = 1; i < n; i += 2) {
+		test_lhashmap_key(i, buf, sizeof(buf), &key, &keyhash);
+		test(od_lhashmap_remove(map, keyhash, &key) == OK_RESPONSE);
+		test(od_lhashmap_remove(map, keyhash, &key) ==
+		     NOT_OK_RESPONSE);
+	}
+	test(dtor_calls == n / 2);
+	test(map->count == (size_t)(n - n / 2));
+
+	for (int i = 0; i < n; i++) {
+		test_lhashmap_key(i, buf, sizeof(buf), &key, &keyhash);
+		od_hashmap_elt_t *value = od_lhashmap_find(map, keyhash, &key);
+		if (i % 2) {
+			test(value == NULL);
+		} else {
+			test(value != NULL);
+			test(*(int *)value->data == i);
+		}
+	}
+
+	size_t count = 0;
+	od_lhashmap_entry_t *entry = NULL;
+	while ((entry = od_lhashmap_next(map, entry)) != NULL) {
+		test(*(int *)entry->value.data % 2 == 0);
+		count++;
+	}
+	test(count == map->count);
+
+	od_lhashmap_free(map);
+	test(dtor_calls == n);
+}
+
+static void test_lhashmap_replace(void)
+{
+	dtor_calls = 0;
+	od_lhashmap_t *map = od_lhashmap_create(16, test_lhashmap_dtor);
+	test(map != NULL);
+	test(map->capacity == 16);
+
+	char buf[32];
+	od_hashmap_elt_t key;
+	od_hash_t keyhash;
+	test_lhashmap_key(1, buf, sizeof(buf), &key, &keyhash);
+
+	od_hashmap_elt_t value = { "select 1", 9 };
+	od_hashmap_elt_t *value_ptr = &value;
+	test(od_lhashmap_insert(map, keyhash, &key, &value_ptr) == 0);
+
+	value.data = "select 22";
+	value.len = 10;
+	value_ptr = &value;
+	test(od_lhashmap_insert(map, keyhash, &key, &value_ptr) == 1);
+	test(value_ptr->len == 10);
+	test(strcmp(value_ptr->data, "select 22") == 0);
+	test(map->count == 1);
+
+	od_lhashmap_empty(map);
+	test(map->count == 0);
+	test(dtor_calls == 1);
+	test(od_lhashmap_find(map, keyhash, &key) == NULL);
+
+	od_lhashmap_free(map);
+}
+
+void odyssey_test_lhashmap(void)
+{
+	test_lhashmap_insert_find(1);
+	test_lhashmap_insert_find(100);
+	test_lhashmap_insert_find(10000);
+	test_lhashmap_replace();
+}
@@ -0,0 +1,201 @@
+#include <machinarium/machinarium.h>
+#include <odyssey.h>
+
+#include <multi_pool.h>
+
+#include <tests/odyssey_test.h>
+
+static inline void test_multi_pool_key(od_multi_pool_key_t *key, char *db,
+				       char *user, char *host, int port)
+{
+	memset(key, 0, sizeof(od_multi_pool_key_t));
+	key->dbname = db;
+	key->username = user;
+	key->address.host = host;
+	key->address.port = port;
+	key->address.type = OD_ADDRESS_TYPE_TCP;
+}
+
+void odyssey_test_multi_pool(void)
+{
+	od_multi_pool_t *mpool = od_multi_pool_create(od_pg_server_pool_free);
+	test(mpool != NULL);
+
+	char *hosts[] = { "host1", "host2", "host3" };
+	const int names = 200;
+
+	od_multi_pool_element_t **elements = od_malloc(
+		names * 3 * sizeof(od_multi_pool_element_t *));
+	test(elements != NULL);
+
+	for (int i = 0; i < names; i++) {
+		char db[32];
+		char user[32];
+		snprintf(db, sizeof(db), "db%d", i);
+		snprintf(user, sizeof(user), "user%d", i);
+
+		for (int h = 0; h < 3; h++) {
+			od_multi_pool_key_t key;
+			test_multi_pool_key(&key, db, user, hosts[h], 5432);
+			elements[i * 3 + h] =
+				od_multi_pool_get_or_create_locked(mpool, &key);
+			test(elements[i * 3 + h] != NULL);
+			test(strcmp(elements[i * 3 + h]->key.dbname, db) == 0);
+		}
+	}
+
+	test(mpool->count == (size_t)names * 3);
+
+	/* same keys must be found after the index was grown */
+	for (int i = 0; i < names; i++) {
+		char db[32];
+		char user[32];
+		snprintf(db, sizeof(db), "db%d", i);
+		snprintf(user, sizeof(user), "user%d", i);
+
+		for (int h = 0; h < 3; h++) {
+			od_multi_pool_key_t key;
+			test_multi_pool_key(&key, db, user, hosts[h], 5432);
+			test(od_multi_pool_get_or_create_locked(mpool, &key) ==
+			     elements[i * 3 + h]);
+		}
+
+		/* and the groups they are linked to */
+		const int parent = OD_MULTI_POOL_PARENT_NAMES;
+		test(od_multi_pool_names_counters_locked(mpool, db, user) ==
+		     elements[i * 3]->pool.parents[parent]);
+
+		/* names are interned, elements of them share the pointers */
+		od_multi_pool_group_t *interned;
+		interned = od_multi_pool_names_locked(mpool, db, user);
+		test(interned == elements[i * 3]->names);
+		for (int h = 0; h < 3; h++) {
+			test(elements[i * 3 + h]->key.dbname ==
+			     interned->key.dbname);
+			od_address_t *address = &elements[h]->key.address;
+			test(od_multi_pool_get_or_create_names_locked(
+				     mpool, interned, address) ==
+			     elements[i * 3 + h]);
+		}
+	}
+	test(mpool->groups_by_names.count == (size_t)names);
+	test(mpool->groups_by_address.count == 3);
+
+	/* keys without db and user are distinct from the ones with */
+	od_multi_pool_key_t key;
+	test_multi_pool_key(&key, NULL, NULL, "host1", 5432);
+	od_multi_pool_element_t *el =
+		od_multi_pool_get_or_create_locked(mpool, &key);
+	test(el != NULL);
+	test(el->key.dbname == NULL);
+	test(od_multi_pool_get_or_create_locked(mpool, &key) == el);
+
+	test_multi_pool_key(&key, NULL, NULL, "host1", 6432);
+	test(od_multi_pool_get_or_create_locked(mpool, &key) != el);
+
+	test(mpool->count == (size_t)names * 3 + 2);
+
+	od_free(elements);
+	od_multi_pool_destroy(mpool);
+}
+
+static inline int test_filter_by_names(void *arg,
+				       const od_multi_pool_key_t *key)
+{
+	const od_multi_pool_key_t *names = arg;
+	return strcmp(names->dbname, key->dbname) == 0 &&
+	       strcmp(names->username, key->username) == 0;
+}
+
+void odyssey_test_multi_pool_counters(void)
+{
+	od_multi_pool_t *mpool = od_multi_pool_create(od_pg_server_pool_free);
+	test(mpool != NULL);
+
+	char *dbs[] = { "db1", "db2" };
+	char *hosts[] = { "host1", "host2" };
+	od_multi_pool_element_t *elements[4];
+	od_server_t servers[32];
+
+	for (int i = 0; i < 4; i++) {
+		od_multi_pool_key_t key;
+		test_multi_pool_key(&key, dbs[i / 2], "user", hosts[i % 2],
+				    5432);
+		elements[i] = od_multi_pool_get_or_create_locked(mpool, &key);
+		test(elements[i] != NULL);
+	}
+
+	for (int i = 0; i < 32; i++) {
+		memset(&servers[i], 0, sizeof(od_server_t));
+		servers[i].state = OD_SERVER_UNDEF;
+		od_list_init(&servers[i].link);
+	}
+
+	/* move servers over random states and compare with full scans */
+	unsigned int seed = 7;
+	for (int step = 0; step < 10000; step++) {
+		od_server_t *server = &servers[rand_r(&seed) % 32];
+		od_multi_pool_element_t *el = elements[(server - servers) % 4];
+		od_server_state_t states[] = { OD_SERVER_UNDEF, OD_SERVER_IDLE,
+					       OD_SERVER_ACTIVE };
+		od_server_state_t state = states[rand_r(&seed) % 3];
+		od_pg_server_pool_set(&el->pool, server, state);
+
+		for (int d = 0; d < 2; d++) {
+			od_multi_pool_key_t names;
+			test_multi_pool_key(&names, dbs[d], "user", NULL, 0);
+			od_server_pool_counters_t *counters;
+			counters = od_multi_pool_names_counters_locked(
+				mpool, dbs[d], "user");
+			test(counters != NULL);
+			test(counters->count_active ==
+			     od_multi_pool_count_active_locked(
+				     mpool, test_filter_by_names, &names));
+			test(counters->count_idle ==
+			     od_multi_pool_count_idle_locked(
+				     mpool, test_filter_by_names, &names));
+		}
+
+		int active = 0;
+		int idle = 0;
+		for (int i = 0; i < 4; i++) {
+			active += od_server_pool_active(&elements[i]->pool);
+			idle += od_server_pool_idle(&elements[i]->pool);
+		}
+		test(od_multi_pool_count_active_locked(mpool, NULL, NULL) ==
+		     active);
+		test(od_multi_pool_count_idle_locked(mpool, NULL, NULL) ==
+		     idle);
+
+		/* elements 0 and 2 share the address */
+		const int parent = OD_MULTI_POOL_PARENT_ADDRESS;
+		od_server_pool_counters_t *address;
+		address = elements[0]->pool.parents[parent];
+		test(address == elements[2]->pool.parents[parent]);
+		test(address->count_active + address->count_idle ==
+		     od_server_pool_total(&elements[0]->pool) +
+			     od_server_pool_total(&elements[2]->pool));
+	}
+
+	/* empty counters are created, an element links them later */
+	od_server_pool_counters_t *db3;
+	db3 = od_multi_pool_names_counters_locked(mpool, "db3", "user");
+	test(db3 != NULL);
+	test(db3->count_active == 0 && db3->count_idle == 0);
+	test(od_multi_pool_names_counters_locked(mpool, "db3", "user") == db3);
+
+	od_multi_pool_key_t key;
+	test_multi_pool_key(&key, "db3", "user", "host1", 5432);
+	od_multi_pool_element_t *el;
+	el = od_multi_pool_get_or_create_locked(mpool, &key);
+	test(el != NULL);
+	test(el->pool.parents[OD_MULTI_POOL_PARENT_NAMES] == db3);
+
+	for (int i = 0; i < 32; i++) {
+		od_multi_pool_element_t *el = elements[i % 4];
+		od_pg_server_pool_set(&el->pool, &servers[i], OD_SERVER_UNDEF);
+	}
+	test(od_multi_pool_total_locked(mpool, NULL, NULL) == 0);
+
+	od_multi_pool_destroy(mpool);
+}
@@ -0,0 +1,59 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <pairing_heap.h>
+#include <tests/odyssey_test.h>
+
+#define NODES 2000
+
+void odyssey_test_pairing_heap(void)
+{
+	unsigned int seed = 7;
+	static od_pairing_heap_node_t nodes[NODES];
+	static int in_heap[NODES];
+
+	od_pairing_heap_t heap;
+	od_pairing_heap_init(&heap);
+	test(od_pairing_heap_pop(&heap) == NULL);
+
+	for (int i = 0; i < NODES; i++) {
+		od_pairing_heap_insert(&heap, &nodes[i], rand_r(&seed) % 500);
+		in_heap[i] = 1;
+	}
+
+	/* remove arbitrary nodes, including the root */
+	for (int i = 0; i < NODES / 2; i++) {
+		int n = rand_r(&seed) % NODES;
+		if (!in_heap[n]) {
+			continue;
+		}
+		od_pairing_heap_remove(&heap, &nodes[n]);
+		in_heap[n] = 0;
+		od_pairing_heap_node_t *root = od_pairing_heap_peek(&heap);
+		if (i % 10 == 0 && root != NULL) {
+			int r = (int)(root - nodes);
+			od_pairing_heap_remove(&heap, root);
+			in_heap[r] = 0;
+		}
+	}
+
+	int count = 0;
+	for (int i = 0; i < NODES; i++) {
+		count += in_heap[i];
+	}
+	test(heap.count == count);
+
+	/* the rest comes out ordered */
+	uint64_t prev = 0;
+	od_pairing_heap_node_t *node;
+	while ((node = od_pairing_heap_pop(&heap)) != NULL) {
+		test(node->key >= prev);
+		test(in_heap[node - nodes]);
+		in_heap[node - nodes] = 0;
+		prev = node->key;
+		count--;
+	}
+	test(count == 0);
+	test(heap.count == 0);
+}
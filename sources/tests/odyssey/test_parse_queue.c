@@ -0,0 +1,75 @@
+#include <odyssey.h>
+
+#include <parse_queue.h>
+#include <tests/odyssey_test.h>
+
+static void test_parse_queue_order(void)
+{
+	od_parse_queue_t queue;
+	od_parse_queue_init(&queue);
+
+	test(od_parse_queue_pop(&queue, 0) == -1);
+
+	/* internal Parse before Bind, then Parse of the client */
+	test(od_parse_queue_push(&queue, 0, 0) == OK_RESPONSE);
+	test(od_parse_queue_push(&queue, 0, 1) == OK_RESPONSE);
+	test(od_parse_queue_pop(&queue, 0) == 0);
+	test(od_parse_queue_pop(&queue, 0) == 1);
+	test(od_parse_queue_pop(&queue, 0) == -1);
+
+	od_parse_queue_free(&queue);
+}
+
+static void test_parse_queue_grow(void)
+{
+	od_parse_queue_t queue;
+	od_parse_queue_init(&queue);
+
+	/* wrap around before growing */
+	int count = OD_PARSE_QUEUE_MIN_CAPACITY * 4 + 3;
+	for (int i = 0; i < OD_PARSE_QUEUE_MIN_CAPACITY / 2; i++) {
+		test(od_parse_queue_push(&queue, 0, 0) == OK_RESPONSE);
+		test(od_parse_queue_pop(&queue, 0) == 0);
+	}
+	for (int i = 0; i < count; i++) {
+		test(od_parse_queue_push(&queue, 0, i % 2) == OK_RESPONSE);
+	}
+	test(queue.count == (size_t)count);
+	for (int i = 0; i < count; i++) {
+		test(od_parse_queue_pop(&queue, 0) == i % 2);
+	}
+	test(od_parse_queue_pop(&queue, 0) == -1);
+
+	od_parse_queue_free(&queue);
+}
+
+static void test_parse_queue_stale(void)
+{
+	od_parse_queue_t queue;
+	od_parse_queue_init(&queue);
+
+	/* Parse of the first sync epoch is skipped after an error */
+	test(od_parse_queue_push(&queue, 0, 1) == OK_RESPONSE);
+	test(od_parse_queue_push(&queue, 0, 0) == OK_RESPONSE);
+	test(od_parse_queue_push(&queue, 1, 0) == OK_RESPONSE);
+	test(od_parse_queue_push(&queue, 1, 1) == OK_RESPONSE);
+	test(od_parse_queue_pop(&queue, 0) == 1);
+
+	/* ReadyForQuery of the first epoch received */
+	test(od_parse_queue_pop(&queue, 1) == 0);
+	test(od_parse_queue_pop(&queue, 1) == 1);
+	test(queue.count == 0);
+
+	test(od_parse_queue_push(&queue, 2, 1) == OK_RESPONSE);
+	od_parse_queue_clear(&queue);
+	test(od_parse_queue_pop(&queue, 2) == -1);
+
+	od_parse_queue_free(&queue);
+}
+
+void odyssey_test_parse_queue(void)
+{
+	test_parse_queue_order();
+	test_parse_queue_grow();
+	test_parse_queue_stale();
+}
@@ -0,0 +1,61 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <pool_warmup.h>
+#include <tests/odyssey_test.h>
+
+static void test_pool_warmup_peak_decay(void)
+{
+	od_pool_warmup_t warmup;
+	od_pool_warmup_init(&warmup);
+
+	/* a short burst is kept for the whole window */
+	const int window = 32;
+	od_pool_warmup_sample(&warmup, 40, window);
+	for (int i = 0; i < window - 2; i++) {
+		od_pool_warmup_sample(&warmup, 0, window);
+		test(od_pool_warmup_target(&warmup, 0) >= 40);
+	}
+
+	/* and forgotten after it */
+	for (int i = 0; i < window; i++) {
+		od_pool_warmup_sample(&warmup, 0, window);
+	}
+	test(od_pool_warmup_target(&warmup, 0) == 0);
+}
+
+static void test_pool_warmup_ramp(void)
+{
+	od_pool_warmup_t warmup;
+	od_pool_warmup_init(&warmup);
+
+	/* on a steady ramp the target is ahead of the demand */
+	int demand = 0;
+	for (int i = 0; i < 30; i++) {
+		demand += 2;
+		od_pool_warmup_sample(&warmup, demand, 60);
+	}
+	test(od_pool_warmup_target(&warmup, 0) > demand);
+
+	/* but never above pool_size */
+	test(od_pool_warmup_target(&warmup, 50) == 50);
+}
+
+static void test_pool_warmup_steady(void)
+{
+	od_pool_warmup_t warmup;
+	od_pool_warmup_init(&warmup);
+
+	for (int i = 0; i < 100; i++) {
+		od_pool_warmup_sample(&warmup, 10, 60);
+	}
+	test(od_pool_warmup_target(&warmup, 0) == 10);
+}
+
+void odyssey_test_pool_warmup(void)
+{
+	test_pool_warmup_peak_decay();
+	test_pool_warmup_ramp();
+	test_pool_warmup_steady();
+}
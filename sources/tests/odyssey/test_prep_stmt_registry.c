@@ -0,0 +1,102 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <prep_stmt_registry.h>
+#include <tests/odyssey_test.h>
+
+static od_prep_stmt_body_t *intern(od_prep_stmt_registry_t *registry,
+				   const char *data)
+{
+	size_t len = strlen(data);
+	return od_prep_stmt_registry_intern(
+		registry, od_murmur_hash((void *)data, len), data, len);
+}
+
+static void test_prep_stmt_registry_intern(void)
+{
+	od_prep_stmt_registry_t *registry = od_prep_stmt_registry_create();
+	test(registry != NULL);
+
+	od_prep_stmt_body_t *a = intern(registry, "select 1");
+	od_prep_stmt_body_t *b = intern(registry, "select 1");
+	od_prep_stmt_body_t *c = intern(registry, "select 2");
+	test(a != NULL && c != NULL);
+	test(a == b);
+	test(a != c);
+	test(a->refcnt == 2);
+	test(a->len == 8);
+	test(memcmp(a->data, "select 1", 8) == 0);
+	test(registry->count == 2);
+	test(registry->bytes == 16);
+
+	od_prep_stmt_body_ref(c);
+	od_prep_stmt_body_unref(c);
+	test(registry->count == 2);
+
+	od_prep_stmt_body_unref(a);
+	od_prep_stmt_body_unref(b);
+	test(registry->count == 1);
+	od_prep_stmt_body_unref(c);
+	test(registry->count == 0);
+	test(registry->bytes == 0);
+
+	/* released body is interned again */
+	a = intern(registry, "select 1");
+	test(a->refcnt == 1);
+	od_prep_stmt_body_unref(a);
+
+	od_prep_stmt_registry_free(registry);
+}
+
+static void test_prep_stmt_registry_many(void)
+{
+	od_prep_stmt_registry_t *registry = od_prep_stmt_registry_create();
+	test(registry != NULL);
+
+	enum { count = 10000 };
+	static od_prep_stmt_body_t *bodies[count];
+	char data[32];
+	for (int i = 0; i < count; i++) {
+		snprintf(data, sizeof(data), "select %d", i);
+		bodies[i] = intern(registry, data);
+		test(bodies[i] != NULL);
+	}
+	test(registry->count == count);
+
+	for (int i = 0; i < count; i++) {
+		snprintf(data, sizeof(data), "select %d", i);
+		od_prep_stmt_body_t *body = intern(registry, data);
+		test(body == bodies[i]);
+		od_prep_stmt_body_unref(body);
+	}
+
+	for (int i = 0; i < count; i += 2) {
+		od_prep_stmt_body_unref(bodies[i]);
+	}
+	test(registry->count == count / 2);
+
+	/* freed with the remaining bodies */
+	od_prep_stmt_registry_free(registry);
+}
+
+static void tester(void *arg)
+{
+	(void)arg;
+
+	test_prep_stmt_registry_intern();
+	test_prep_stmt_registry_many();
+}
+
+void odyssey_test_prep_stmt_registry(void)
+{
+	machinarium_init();
+
+	int64_t rc;
+	rc = machine_create("tester", tester, NULL);
+	test(rc > 0);
+
+	test(machine_wait(rc) == 0);
+
+	machinarium_free();
+}
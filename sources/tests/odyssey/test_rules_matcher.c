@@ -0,0 +1,245 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+#include <kiwi/kiwi.h>
+
+#include <rules.h>
+#include <rules_matcher.h>
+#include <pool.h>
+#include <tests/odyssey_test.h>
+
+static unsigned int seed;
+
+static inline int random_in(int n)
+{
+	return rand_r(&seed) % n;
+}
+
+static void random_address_range(od_address_range_t *range, int ipv6)
+{
+	char addr[INET6_ADDRSTRLEN];
+	char prefix[16];
+
+	if (ipv6) {
+		snprintf(addr, sizeof(addr), "fd00:%x::%x", random_in(4),
+			 random_in(4));
+		snprintf(prefix, sizeof(prefix), "%d", 16 + random_in(113));
+	} else {
+		snprintf(addr, sizeof(addr), "10.%d.%d.%d", random_in(4),
+			 random_in(4), random_in(4));
+		snprintf(prefix, sizeof(prefix), "%d", 8 + random_in(25));
+	}
+
+	memset(range, 0, sizeof(od_address_range_t));
+	test(od_address_read(&range->addr, addr) == 0);
+	range->mask.ss_family = range->addr.ss_family;
+	test(od_address_range_read_prefix(range, prefix) == 0);
+
+	char value[64];
+	snprintf(value, sizeof(value), "%s/%s", addr, prefix);
+	range->string_value = od_strdup(value);
+	range->string_value_len = strlen(value);
+}
+
+static void random_client_addr(struct sockaddr_storage *sa)
+{
+	char addr[INET6_ADDRSTRLEN];
+
+	memset(sa, 0, sizeof(struct sockaddr_storage));
+	switch (random_in(3)) {
+	case 0:
+		sa->ss_family = AF_UNIX;
+		return;
+	case 1:
+		snprintf(addr, sizeof(addr), "10.%d.%d.%d", random_in(4),
+			 random_in(4), random_in(4));
+		break;
+	default:
+		snprintf(addr, sizeof(addr), "fd00:%x::%x", random_in(4),
+			 random_in(4));
+		break;
+	}
+	test(od_address_read(sa, addr) == 0);
+}
+
+static void add_random_rules(od_rules_t *rules, int count, int names)
+{
+	for (int i = 0; i < count; i++) {
+		char db[32];
+		char user[32];
+		int db_is_default = random_in(4) == 0;
+		int user_is_default = random_in(4) == 0;
+		snprintf(db, sizeof(db), "db%d", random_in(names));
+		snprintf(user, sizeof(user), "user%d", random_in(names));
+
+		od_address_range_t range;
+		switch (random_in(3)) {
+		case 0:
+			range = od_address_range_create_default();
+			break;
+		default:
+			random_address_range(&range, random_in(2));
+			break;
+		}
+
+		od_rule_conn_type_t conn_type = random_in(5);
+		int pool_internal = random_in(8) == 0;
+
+		od_rule_t *rule = od_rules_add_new_rule(
+			rules, db_is_default ? "default" : db, db_is_default,
+			user_is_default ? "default" : user, user_is_default,
+			&range, conn_type, pool_internal);
+		od_address_range_destroy(&range);
+		if (rule == NULL) {
+			/* duplicate */
+			continue;
+		}
+		rule->pool->routing = pool_internal ?
+					      OD_RULE_POOL_INTERNAL :
+					      OD_RULE_POOL_CLIENT_VISIBLE;
+		rule->obsolete = random_in(16) == 0;
+	}
+}
+
+static void random_startup(kiwi_be_startup_t *startup, int names)
+{
+	char db[32];
+	char user[32];
+	snprintf(db, sizeof(db), "db%d", random_in(names));
+	snprintf(user, sizeof(user), "user%d", random_in(names));
+
+	kiwi_be_startup_init(startup);
+	kiwi_var_set(&startup->database, KIWI_VAR_UNDEF, db, strlen(db) + 1);
+	kiwi_var_set(&startup->user, KIWI_VAR_UNDEF, user, strlen(user) + 1);
+	startup->is_ssl_request = random_in(2);
+}
+
+static od_rule_t *find_linear(od_rules_t *rules,
+			      const kiwi_be_startup_t *startup,
+			      struct sockaddr_storage *sa, int pool_internal)
+{
+	od_list_t *i;
+	od_list_foreach (&rules->rules, i) {
+		od_rule_t *rule = od_container_of(i, od_rule_t, link);
+		if (od_rule_matches(rule, startup, sa, NULL, pool_internal)) {
+			return rule;
+		}
+	}
+	return NULL;
+}
+
+void odyssey_test_rules_matcher(void)
+{
+	seed = 42;
+
+	od_rules_t rules;
+	od_rules_init(&rules);
+	add_random_rules(&rules, 2000, 20);
+
+	od_rules_matcher_t *matcher = od_rules_matcher_create(&rules.rules);
+	test(matcher != NULL);
+
+	for (int i = 0; i < 100000; i++) {
+		kiwi_be_startup_t startup;
+		random_startup(&startup, 25);
+		struct sockaddr_storage sa;
+		random_client_addr(&sa);
+		int pool_internal = random_in(8) == 0;
+
+		od_rule_t *expected =
+			find_linear(&rules, &startup, &sa, pool_internal);
+		od_rule_t *actual = od_rules_matcher_find(
+			matcher, &startup, &sa, NULL, pool_internal);
+		test(expected == actual);
+	}
+
+	od_rules_matcher_free(matcher);
+	od_rules_free(&rules);
+}
+
+static void add_tenant_rules(od_rules_t *rules, int tenants)
+{
+	/* exact rules first, as specificity sorting would place them */
+	for (int i = 0; i < tenants; i++) {
+		char db[32];
+		char user[32];
+		snprintf(db, sizeof(db), "db%d", i);
+		snprintf(user, sizeof(user), "user%d", i);
+
+		od_address_range_t range;
+		if (i % 2) {
+			random_address_range(&range, 0);
+		} else {
+			range = od_address_range_create_default();
+		}
+
+		od_rule_t *rule = od_rules_add_new_rule(
+			rules, db, 0, user, 0, &range,
+			OD_RULE_CONN_TYPE_DEFAULT, 0);
+		od_address_range_destroy(&range);
+		test(rule != NULL);
+		rule->pool->routing = OD_RULE_POOL_CLIENT_VISIBLE;
+	}
+
+	od_address_range_t range = od_address_range_create_default();
+	od_rule_t *rule = od_rules_add_new_rule(rules, "default", 1, "default",
+						1, &range,
+						OD_RULE_CONN_TYPE_DEFAULT, 0);
+	od_address_range_destroy(&range);
+	test(rule != NULL);
+	rule->pool->routing = OD_RULE_POOL_CLIENT_VISIBLE;
+}
+
+void odyssey_rules_matcher_benchmark(void)
+{
+	seed = 1;
+
+	/* synthetic multi-tenant config of 10k rules */
+	const int tenants = 10000;
+	od_rules_t rules;
+	od_rules_init(&rules);
+	add_tenant_rules(&rules, tenants);
+
+	od_rules_matcher_t *matcher = od_rules_matcher_create(&rules.rules);
+	test(matcher != NULL);
+
+	const int lookups = 10000;
+	kiwi_be_startup_t *startups =
+		od_malloc(lookups * sizeof(kiwi_be_startup_t));
+	struct sockaddr_storage *addrs =
+		od_malloc(lookups * sizeof(struct sockaddr_storage));
+	test(startups != NULL && addrs != NULL);
+	for (int i = 0; i < lookups; i++) {
+		random_startup(&startups[i], tenants);
+		random_client_addr(&addrs[i]);
+	}
+
+	benchmark_timer_t timer;
+	size_t found = 0;
+
+	timer_start(&timer);
+	for (int i = 0; i < lookups; i++) {
+		found += find_linear(&rules, &startups[i], &addrs[i], 0) !=
+			 NULL;
+	}
+	double linear = timer_end(&timer);
+
+	timer_start(&timer);
+	for (int i = 0; i < lookups; i++) {
+		found += od_rules_matcher_find(matcher, &startups[i],
+					       &addrs[i], NULL, 0) != NULL;
+	}
+	double compiled = timer_end(&timer);
+
+	printf("\n%zu rules, %d lookups (%zu found)\n", matcher->rules_count,
+	       lookups, found / 2);
+	printf("linear:   %.3f sec, %.0f lookups/sec\n", linear,
+	       lookups / linear);
+	printf("compiled: %.3f sec, %.0f lookups/sec\n", compiled,
+	       lookups / compiled);
+
+	od_free(addrs);
+	od_free(startups);
+	od_rules_matcher_free(matcher);
+	od_rules_free(&rules);
+}
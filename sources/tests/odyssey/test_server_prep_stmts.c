@@ -0,0 +1,107 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <server_prep_stmts.h>
+#include <tests/odyssey_test.h>
+
+static od_prep_stmt_registry_t *registry;
+
+static int use_stmt(od_server_prep_stmts_t *stmts, int id)
+{
+	char data[32];
+	int len = snprintf(data, sizeof(data), "select %d", id);
+	od_prep_stmt_body_t *body;
+	body = od_prep_stmt_registry_intern(
+		registry, od_murmur_hash(data, len), data, len);
+	test(body != NULL);
+	int rc = od_server_prep_stmts_use(stmts, body);
+	od_prep_stmt_body_unref(body);
+	return rc;
+}
+
+static void test_server_prep_stmts_lru(void)
+{
+	registry = od_prep_stmt_registry_create();
+	test(registry != NULL);
+	od_server_prep_stmts_t *stmts = od_server_prep_stmts_create(16);
+	test(stmts != NULL);
+
+	for (int i = 0; i < 8; i++) {
+		test(use_stmt(stmts, i) == 0);
+	}
+	test(stmts->count == 8);
+	test(use_stmt(stmts, 0) == 1);
+
+	char query[1024];
+	/* within the limits */
+	test(od_server_prep_stmts_evict_query(stmts, 8, 0, 64, query,
+					      sizeof(query)) == 0);
+
+	/* evicted down to 3/4 of the limit, least recently used first */
+	int n = od_server_prep_stmts_evict_query(stmts, 4, 0, 64, query,
+						 sizeof(query));
+	test(n == 5);
+	char name[16];
+	snprintf(name, sizeof(name), "\"%08x\"",
+		 od_murmur_hash("select 1", strlen("select 1")));
+	test(strstr(query, name) != NULL);
+	snprintf(name, sizeof(name), "\"%08x\"",
+		 od_murmur_hash("select 0", strlen("select 0")));
+	test(strstr(query, name) == NULL);
+
+	od_server_prep_stmts_evict(stmts, n);
+	test(stmts->count == 3);
+	/* evicted bodies are released */
+	test(registry->count == 3);
+	test(use_stmt(stmts, 0) == 1);
+	test(use_stmt(stmts, 1) == 0);
+
+	od_server_prep_stmts_empty(stmts);
+	test(stmts->count == 0);
+	test(stmts->bytes == 0);
+	test(use_stmt(stmts, 0) == 0);
+
+	od_server_prep_stmts_free(stmts);
+	test(registry->count == 0);
+	od_prep_stmt_registry_free(registry);
+}
+
+static void test_server_prep_stmts_discard(void)
+{
+	const char *queries_all[] = { "DISCARD ALL", "discard all;",
+				      "  DEALLOCATE\nALL" };
+	for (size_t i = 0; i < 3; i++) {
+		test(od_server_prep_stmts_query_drops_all(
+			queries_all[i], strlen(queries_all[i])));
+	}
+
+	const char *queries_keep[] = { "DISCARD PLANS", "DISCARD TEMP",
+				       "DISCARD SEQUENCES", "DEALLOCATE foo",
+				       "DISCARDALL", "SELECT 1" };
+	for (size_t i = 0; i < 6; i++) {
+		test(!od_server_prep_stmts_query_drops_all(
+			queries_keep[i], strlen(queries_keep[i])));
+	}
+}
+
+static void tester(void *arg)
+{
+	(void)arg;
+
+	test_server_prep_stmts_lru();
+	test_server_prep_stmts_discard();
+}
+
+void odyssey_test_server_prep_stmts(void)
+{
+	machinarium_init();
+
+	int64_t rc;
+	rc = machine_create("tester", tester, NULL);
+	test(rc > 0);
+
+	test(machine_wait(rc) == 0);
+
+	machinarium_free();
+}
@@ -0,0 +1,157 @@
+#include <odyssey.h>
+
+#include <machinarium/machinarium.h>
+
+#include <kiwi/kiwi.h>
+
+#include <session_state.h>
+#include <tests/odyssey_test.h>
+
+static void test_session_state_tags(void)
+{
+	test(od_session_state_from_tag("SELECT 1") == 0);
+	test(od_session_state_from_tag("INSERT 0 1") == 0);
+	test(od_session_state_from_tag("SET") == OD_SESSION_STATE_SET);
+	test(od_session_state_from_tag("SETX") == 0);
+	test(od_session_state_from_tag("LISTEN") == OD_SESSION_STATE_LISTEN);
+	test(od_session_state_from_tag("DECLARE CURSOR") ==
+	     OD_SESSION_STATE_CURSOR);
+	test(od_session_state_from_tag("CREATE TABLE") ==
+	     OD_SESSION_STATE_TEMP);
+	test(od_session_state_from_tag("PREPARE") == OD_SESSION_STATE_PREPARE);
+	/* CREATE TABLE AS and SELECT INTO, TEMP is found in the query */
+	test(od_session_state_from_tag("SELECT 5") == 0);
+	test(od_session_state_from_tag("DISCARD ALL") == -1);
+}
+
+static void test_session_state_queries(void)
+{
+	const char *q = "select 1";
+	test(od_session_state_from_query(q, strlen(q)) == 0);
+
+	q = "SELECT pg_advisory_lock(1)";
+	test(od_session_state_from_query(q, strlen(q)) ==
+	     OD_SESSION_STATE_ADVISORY);
+
+	q = "create TEMPORARY table t as select 1";
+	test(od_session_state_from_query(q, strlen(q)) ==
+	     OD_SESSION_STATE_TEMP);
+
+	q = "select set_config('a.b', 'c', false)";
+	test(od_session_state_from_query(q, strlen(q)) ==
+	     OD_SESSION_STATE_SET);
+
+	q = "select * from t into temp t2";
+	test(od_session_state_from_query(q, strlen(q)) ==
+	     OD_SESSION_STATE_TEMP);
+
+	q = "create table pg_temp.t as select 1";
+	test(od_session_state_from_query(q, strlen(q)) ==
+	     OD_SESSION_STATE_TEMP);
+
+	/* words containing the keywords */
+	q = "select template, attempts, temperature from contemplate";
+	test(od_session_state_from_query(q, strlen(q)) == 0);
+
+	/* not calls, literals, comments and quoted names */
+	q = "select pg_advisory_lock_count, set_config from \"temp\" -- temp\n"
+	    "where a = 'pg_advisory_lock(1)' /* temp */ and b = $$temp$$ "
+	    "and c = $x$set_config('a', 'b', true)$x$ and d = $1";
+	test(od_session_state_from_query(q, strlen(q)) == 0);
+
+	q = "select pg_advisory_xact_lock (1), $1 from temp_t where temp = 1";
+	test(od_session_state_from_query(q, strlen(q)) ==
+	     (OD_SESSION_STATE_ADVISORY | OD_SESSION_STATE_TEMP));
+}
+
+static uint32_t test_session_state_message(char *buf, char type,
+					   const char *fields, size_t len)
+{
+	buf[0] = type;
+	uint32_t size = htonl(sizeof(uint32_t) + len);
+	memcpy(buf + 1, &size, sizeof(size));
+	memcpy(buf + 1 + sizeof(size), fields, len);
+	return 1 + sizeof(size) + len;
+}
+
+static int test_session_state_parse(const char *fields, size_t len)
+{
+	char buf[64];
+	uint32_t size = test_session_state_message(buf, KIWI_FE_PARSE, fields,
+						   len);
+	char *name, *query;
+	uint32_t name_len, query_len;
+	test(kiwi_be_read_parse(buf, size, &name, &name_len, &query,
+				&query_len) == 0);
+	return od_session_state_from_query(query, query_len) |
+	       od_session_state_from_name(name_len);
+}
+
+static int test_session_state_close(const char *fields, size_t len)
+{
+	char buf[64];
+	uint32_t size = test_session_state_message(buf, KIWI_FE_CLOSE, fields,
+						   len);
+	char *name;
+	uint32_t name_len;
+	kiwi_fe_close_type_t type;
+	test(kiwi_be_read_close(buf, size, &name, &name_len, &type) == 0);
+	return od_session_state_from_name(name_len);
+}
+
+static void test_session_state_names(void)
+{
+	/* unnamed statement lives until the next Parse */
+	test(test_session_state_parse("\0select 1\0\0\0", 12) == 0);
+
+	/* named one stays on the server, DISCARD or DEALLOCATE is needed */
+	test(test_session_state_parse("S_1\0select 1\0\0\0", 15) ==
+	     OD_SESSION_STATE_PREPARE);
+
+	test(test_session_state_close("S\0", 2) == 0);
+	test(test_session_state_close("SS_1\0", 5) ==
+	     OD_SESSION_STATE_PREPARE);
+	test(test_session_state_close("PC_1\0", 5) ==
+	     OD_SESSION_STATE_PREPARE);
+
+	/* named statement is deallocated unless the pooler keeps them */
+	char query[256];
+	test(od_session_state_reset_query(OD_SESSION_STATE_PREPARE, 0, query,
+					  sizeof(query)) > 0);
+	test(strcmp(query, "DEALLOCATE ALL;") == 0);
+}
+
+static void test_session_state_reset_query(void)
+{
+	char query[256];
+
+	test(od_session_state_reset_query(0, 0, query, sizeof(query)) == 0);
+
+	size_t len = od_session_state_reset_query(OD_SESSION_STATE_LISTEN, 0,
+						  query, sizeof(query));
+	test(len == strlen(query) + 1);
+	test(strcmp(query, "UNLISTEN *;") == 0);
+
+	/* prepared statements of the pooler itself are kept */
+	test(od_session_state_reset_query(OD_SESSION_STATE_PREPARE, 1, query,
+					  sizeof(query)) == 0);
+
+	len = od_session_state_reset_query(OD_SESSION_STATE_UNKNOWN, 0, query,
+					   sizeof(query));
+	test(strcmp(query, "DISCARD ALL") == 0);
+
+	len = od_session_state_reset_query(OD_SESSION_STATE_SET |
+						   OD_SESSION_STATE_TEMP,
+					   1, query, sizeof(query));
+	test(strstr(query, "RESET ALL;") != NULL);
+	test(strstr(query, "DISCARD TEMP;") != NULL);
+	test(strstr(query, "DEALLOCATE") == NULL);
+}
+
+void odyssey_test_session_state(void)
+{
+	test_session_state_tags();
+	test_session_state_queries();
+	test_session_state_names();
+	test_session_state_reset_query();
+}
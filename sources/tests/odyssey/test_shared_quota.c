@@ -0,0 +1,117 @@
+#include <machinarium/machinarium.h>
+#include <odyssey.h>
+
+#include <route.h>
+#include <shared_pool.h>
+
+#include <tests/odyssey_test.h>
+
+static od_multi_pool_element_t *test_shared_quota_element(od_route_t *route)
+{
+	od_address_t address;
+	memset(&address, 0, sizeof(od_address_t));
+	address.host = "host1";
+	address.port = 5432;
+	address.type = OD_ADDRESS_TYPE_TCP;
+	return od_route_get_server_pool_element_locked(route, &address);
+}
+
+void odyssey_test_shared_quota(void)
+{
+	od_shared_pool_t *sp = od_shared_pool_create("sp");
+	test(sp != NULL);
+	sp->pool_size = 4;
+
+	od_rule_t rules[2];
+	od_route_t routes[2];
+	od_multi_pool_element_t *elements[2];
+	char *dbs[] = { "db1", "db2" };
+	for (int i = 0; i < 2; i++) {
+		memset(&rules[i], 0, sizeof(od_rule_t));
+		rules[i].pool = od_rule_pool_alloc();
+		test(rules[i].pool != NULL);
+
+		memset(&routes[i], 0, sizeof(od_route_t));
+		routes[i].rule = &rules[i];
+		routes[i].shared_pool = sp;
+		routes[i].id.database = dbs[i];
+		routes[i].id.user = "user";
+	}
+	rules[0].pool->shared_max_size = 2;
+	rules[0].pool->shared_min_size = 1;
+	for (int i = 0; i < 2; i++) {
+		elements[i] = test_shared_quota_element(&routes[i]);
+		test(elements[i] != NULL);
+	}
+	test(elements[0]->min_size == 1);
+	test(elements[1]->min_size == 0);
+
+	od_server_t servers[4];
+	for (int i = 0; i < 4; i++) {
+		memset(&servers[i], 0, sizeof(od_server_t));
+		servers[i].state = OD_SERVER_UNDEF;
+		od_list_init(&servers[i].link);
+	}
+
+	/* capped by shared_pool_max_size */
+	test(od_route_server_pool_can_add_locked(&routes[0], elements[0]));
+	od_pg_server_pool_set(&elements[0]->pool, &servers[0], OD_SERVER_IDLE);
+	od_pg_server_pool_set(&elements[0]->pool, &servers[1],
+			      OD_SERVER_ACTIVE);
+	test(!od_route_server_pool_can_add_locked(&routes[0], elements[0]));
+
+	/* others borrow the rest of pool_size */
+	test(od_route_server_pool_can_add_locked(&routes[1], elements[1]));
+	od_pg_server_pool_set(&elements[1]->pool, &servers[2],
+			      OD_SERVER_ACTIVE);
+	od_pg_server_pool_set(&elements[1]->pool, &servers[3],
+			      OD_SERVER_ACTIVE);
+	test(!od_route_server_pool_can_add_locked(&routes[1], elements[1]));
+
+	/* released capacity is available again */
+	od_pg_server_pool_set(&elements[0]->pool, &servers[0], OD_SERVER_UNDEF);
+	test(od_route_server_pool_can_add_locked(&routes[1], elements[1]));
+	test(od_route_server_pool_can_add_locked(&routes[0], elements[0]));
+
+	od_pg_server_pool_set(&elements[0]->pool, &servers[1], OD_SERVER_UNDEF);
+	od_pg_server_pool_set(&elements[1]->pool, &servers[2], OD_SERVER_UNDEF);
+	od_pg_server_pool_set(&elements[1]->pool, &servers[3], OD_SERVER_UNDEF);
+
+	/* others took the whole pool while the route was away */
+	for (int i = 0; i < 4; i++) {
+		od_pg_server_pool_set(&elements[1]->pool, &servers[i],
+				      OD_SERVER_IDLE);
+	}
+	test(!od_route_server_pool_can_add_locked(&routes[0], elements[0]));
+
+	/* the route takes back its minimum from the lender */
+	od_server_t *lent = od_route_shared_lender_locked(elements[0]);
+	test(lent != NULL && lent->state == OD_SERVER_IDLE);
+	od_pg_server_pool_set(&elements[1]->pool, lent, OD_SERVER_UNDEF);
+	od_pg_server_pool_set(&elements[0]->pool, lent, OD_SERVER_IDLE);
+
+	/* its own minimum is not lent back */
+	test(od_route_shared_lender_locked(elements[1]) == NULL);
+
+	/* busy servers are not reclaimed */
+	for (int i = 0; i < 4; i++) {
+		if (&servers[i] != lent) {
+			od_pg_server_pool_set(&elements[1]->pool, &servers[i],
+					      OD_SERVER_ACTIVE);
+		}
+	}
+	test(od_route_shared_lender_locked(elements[0]) == NULL);
+
+	od_pg_server_pool_set(&elements[0]->pool, lent, OD_SERVER_UNDEF);
+	for (int i = 0; i < 4; i++) {
+		if (&servers[i] != lent) {
+			od_pg_server_pool_set(&elements[1]->pool, &servers[i],
+					      OD_SERVER_UNDEF);
+		}
+	}
+
+	for (int i = 0; i < 2; i++) {
+		od_rule_pool_free(rules[i].pool);
+	}
+	od_shared_pool_unref(sp);
+}
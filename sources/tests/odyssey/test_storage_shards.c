@@ -0,0 +1,61 @@
+#include <odyssey.h>
+
+#include <storage.h>
+#include <tests/odyssey_test.h>
+
+static void test_storage_shards_hash(void)
+{
+	od_rule_storage_t *storage = od_rules_storage_allocate();
+	test(storage != NULL);
+	storage->shards_count = 3;
+	storage->shard_by = OD_STORAGE_SHARD_BY_HASH;
+
+	int seen[3] = { 0, 0, 0 };
+	char key[16];
+	for (int i = 0; i < 64; i++) {
+		int len = snprintf(key, sizeof(key), "%d", i);
+		int shard = od_rules_storage_shard_of(storage, key, len);
+		test(shard >= 0 && shard < 3);
+		/* same key, same shard */
+		test(od_rules_storage_shard_of(storage, key, len) == shard);
+		seen[shard]++;
+	}
+	test(seen[0] > 0 && seen[1] > 0 && seen[2] > 0);
+
+	test(od_rules_storage_shard_of(storage, "", 0) == -1);
+
+	od_rules_storage_free(storage);
+}
+
+static void test_storage_shards_range(void)
+{
+	od_rule_storage_t *storage = od_rules_storage_allocate();
+	test(storage != NULL);
+	storage->shards_count = 3;
+	storage->shard_by = OD_STORAGE_SHARD_BY_RANGE;
+	storage->shard_ranges = od_malloc(sizeof(int64_t) * 2);
+	test(storage->shard_ranges != NULL);
+	storage->shard_ranges[0] = 100;
+	storage->shard_ranges[1] = 200;
+
+	test(od_rules_storage_shard_of(storage, "-5", 2) == 0);
+	test(od_rules_storage_shard_of(storage, "99", 2) == 0);
+	test(od_rules_storage_shard_of(storage, "100", 3) == 1);
+	test(od_rules_storage_shard_of(storage, "199", 3) == 1);
+	test(od_rules_storage_shard_of(storage, "200", 3) == 2);
+	test(od_rules_storage_shard_of(storage, "100000", 6) == 2);
+
+	/* only the key length is used */
+	test(od_rules_storage_shard_of(storage, "1000", 2) == 0);
+
+	test(od_rules_storage_shard_of(storage, "abc", 3) == -1);
+	test(od_rules_storage_shard_of(storage, "12x", 3) == -1);
+
+	od_rules_storage_free(storage);
+}
+
+void odyssey_test_storage_shards(void)
+{
+	test_storage_shards_hash();
+	test_storage_shards_range();
+}
@@ -22,6 +22,7 @@ char test_substring[1024] = { 0 };
 /* KIWI */
 extern void kiwi_test_enquote(void);
 extern void kiwi_test_pgoptions(void);
+extern void kiwi_test_vars_fingerprint(void);
 
 /* MACHINARIUM */
 extern void machinarium_test_init(void);
@@ -68,6 +69,7 @@ extern void machinarium_test_advice_keepalive_usr_timeout(void);
 extern void machinarium_test_getaddrinfo0(void);
 extern void machinarium_test_getaddrinfo1(void);
 extern void machinarium_test_getaddrinfo2(void);
+extern void machinarium_test_offload(void);
 extern void machinarium_test_client_server0(void);
 extern void machinarium_test_client_server1(void);
 extern void machinarium_test_client_server2(void);
@@ -115,7 +117,27 @@ extern void odyssey_test_util(void);
 extern void odyssey_test_hba(void);
 extern void odyssey_test_address_parse(void);
 extern void odyssey_test_address_cmp(void);
+extern void odyssey_test_address_hostname(void);
 extern void odyssey_test_hashmap(void);
+extern void odyssey_test_rules_matcher(void);
+extern void odyssey_test_multi_pool(void);
+extern void odyssey_test_multi_pool_counters(void);
+extern void odyssey_test_pool_warmup(void);
+extern void odyssey_test_pairing_heap(void);
+extern void odyssey_test_session_state(void);
+extern void odyssey_test_server_prep_stmts(void);
+extern void odyssey_test_lhashmap(void);
+extern void odyssey_test_prep_stmt_registry(void);
+extern void odyssey_test_hot_stmts(void);
+extern void odyssey_test_parse_queue(void);
+extern void odyssey_test_attach_hint(void);
+extern void odyssey_test_endpoint_stats(void);
+extern void odyssey_test_storage_shards(void);
+extern void odyssey_test_admission(void);
+extern void odyssey_test_shared_quota(void);
+extern void odyssey_test_dns_cache(void);
+extern void odyssey_test_ldap_cache(void);
+extern void odyssey_rules_matcher_benchmark(void);
 
 extern void machinarium_test_tsan_simple_race_example(void);
 
@@ -135,6 +157,7 @@ int main(int argc, char *argv[])
 
 	odyssey_test(kiwi_test_enquote);
 	odyssey_test(kiwi_test_pgoptions);
+	odyssey_test(kiwi_test_vars_fingerprint);
 	odyssey_test(machinarium_test_init);
 	odyssey_test(machinarium_test_create0);
 	odyssey_test(machinarium_test_create1);
@@ -178,6 +201,7 @@ int main(int argc, char *argv[])
 	odyssey_test(machinarium_test_getaddrinfo0);
 	odyssey_test(machinarium_test_getaddrinfo1);
 	odyssey_test(machinarium_test_getaddrinfo2);
+	odyssey_test(machinarium_test_offload);
 	odyssey_test(machinarium_test_client_server0);
 	odyssey_test(machinarium_test_client_server1);
 	odyssey_test(machinarium_test_client_server2);
@@ -225,7 +249,27 @@ int main(int argc, char *argv[])
 	odyssey_test(odyssey_test_hba);
 	odyssey_test(odyssey_test_address_parse);
 	odyssey_test(odyssey_test_address_cmp);
+	odyssey_test(odyssey_test_address_hostname);
 	odyssey_test(odyssey_test_hashmap);
+	odyssey_test(odyssey_test_rules_matcher);
+	odyssey_playground_test(odyssey_rules_matcher_benchmark);
+	odyssey_test(odyssey_test_multi_pool);
+	odyssey_test(odyssey_test_multi_pool_counters);
+	odyssey_test(odyssey_test_pool_warmup);
+	odyssey_test(odyssey_test_pairing_heap);
+	odyssey_test(odyssey_test_session_state);
+	odyssey_test(odyssey_test_server_prep_stmts);
+	odyssey_test(odyssey_test_lhashmap);
+	odyssey_test(odyssey_test_prep_stmt_registry);
+	odyssey_test(odyssey_test_hot_stmts);
+	odyssey_test(odyssey_test_parse_queue);
+	odyssey_test(odyssey_test_attach_hint);
+	odyssey_test(odyssey_test_endpoint_stats);
+	odyssey_test(odyssey_test_storage_shards);
+	odyssey_test(odyssey_test_admission);
+	odyssey_test(odyssey_test_shared_quota);
+	odyssey_test(odyssey_test_dns_cache);
+	odyssey_test(odyssey_test_ldap_cache);
 
 	odyssey_playground_test(machinarium_test_tsan_simple_race_example);
 
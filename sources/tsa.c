@@ -51,6 +51,11 @@ od_target_session_attrs_t od_tsa_get_effective(od_client_t *client)
 		}
 	}
 
+	/* hint of the current transaction overrides the session ones */
+	if (client->attach_hint.tsa != OD_TARGET_SESSION_ATTRS_UNDEF) {
+		effective_tsa = client->attach_hint.tsa;
+	}
+
 	/* 'read-write' and 'read-only' is passed as is, 'any' or unknown == any */
 
 	if (effective_tsa == OD_TARGET_SESSION_ATTRS_UNDEF) {